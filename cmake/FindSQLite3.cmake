@@ -0,0 +1,57 @@
+# - Try to find SQLite3 (embedded SQL database engine)
+# Once done this will define
+#
+#  SQLITE3_FOUND - system has SQLite3
+#  SQLITE3_INCLUDE_DIRS - the SQLite3 include directory
+#  SQLITE3_LIBRARIES - Link these to use SQLite3
+#
+
+if (SQLITE3_LIBRARIES AND SQLITE3_INCLUDE_DIRS)
+  # in cache already
+  set(SQLITE3_FOUND TRUE)
+else (SQLITE3_LIBRARIES AND SQLITE3_INCLUDE_DIRS)
+  find_path(SQLITE3_INCLUDE_DIR
+    NAMES
+      sqlite3.h
+    PATHS
+      /usr/include
+      /usr/local/include
+      /opt/local/include
+      /sw/include
+  )
+
+  find_library(SQLITE3_LIBRARY
+    NAMES
+      sqlite3
+    PATHS
+      /usr/lib
+      /usr/local/lib
+      /opt/local/lib
+      /sw/lib
+  )
+
+  set(SQLITE3_INCLUDE_DIRS
+    ${SQLITE3_INCLUDE_DIR}
+  )
+  set(SQLITE3_LIBRARIES
+    ${SQLITE3_LIBRARY}
+  )
+
+  if (SQLITE3_INCLUDE_DIRS AND SQLITE3_LIBRARIES)
+    set(SQLITE3_FOUND TRUE)
+  endif (SQLITE3_INCLUDE_DIRS AND SQLITE3_LIBRARIES)
+
+  if (SQLITE3_FOUND)
+    if (NOT SQLite3_FIND_QUIETLY)
+      message(STATUS "Found SQLite3: ${SQLITE3_LIBRARIES}")
+    endif (NOT SQLite3_FIND_QUIETLY)
+  else (SQLITE3_FOUND)
+    if (SQLite3_FIND_REQUIRED)
+      message(FATAL_ERROR "Could not find SQLite3")
+    endif (SQLite3_FIND_REQUIRED)
+  endif (SQLITE3_FOUND)
+
+  # show the SQLITE3_INCLUDE_DIRS and SQLITE3_LIBRARIES variables only in the advanced view
+  mark_as_advanced(SQLITE3_INCLUDE_DIRS SQLITE3_LIBRARIES)
+
+endif (SQLITE3_LIBRARIES AND SQLITE3_INCLUDE_DIRS)
@@ -1173,177 +1173,105 @@ static inline void read_processor_register(uint32_t reg_num, uint32_t *data)
 	*data = *((uint32_t*)(reg->value));
 }
 
-void oocdw_read_reg(uint32_t reg_num, uint32_t *data)
+/*
+ * Index of a core register in the register cache of the A9 (the current
+ * mode's R0-R15, then the banked registers and the PSRs), -1 if unknown
+ */
+static int processor_register_index(uint32_t reg_num)
 {
-	assert((target_a9->state == TARGET_HALTED) && "Target not halted");
-
+	if (reg_num <= fail::RI_R15) {
+		return reg_num;
+	}
 	switch (reg_num) {
-	case fail::RI_DFAR:
-		/* fall through */
-	case fail::RI_DFSR:
-		read_dpm_register(reg_num, data);
-		break;
-
-	case fail::RI_R0:
-		/* fall through */
-	case fail::RI_R1:
-		/* fall through */
-	case fail::RI_R2:
-		/* fall through */
-	case fail::RI_R3:
-		/* fall through */
-	case fail::RI_R4:
-		/* fall through */
-	case fail::RI_R5:
-		/* fall through */
-	case fail::RI_R6:
-		/* fall through */
-	case fail::RI_R7:
-		/* fall through */
-	case fail::RI_R8:
-		/* fall through */
-	case fail::RI_R9:
-		/* fall through */
-	case fail::RI_R10:
-		/* fall through */
-	case fail::RI_R11:
-		/* fall through */
-	case fail::RI_R12:
-		/* fall through */
-	case fail::RI_R13:
-		/* fall through */
-	case fail::RI_R14:
-		/* fall through */
-	case fail::RI_R15:
-		read_processor_register(reg_num, data);
-		break;
 	case fail::RI_R8_FIQ:
-		read_processor_register(16, data);
-		break;
+		return 16;
 	case fail::RI_R9_FIQ:
-		read_processor_register(17, data);
-		break;
+		return 17;
 	case fail::RI_R10_FIQ:
-		read_processor_register(18, data);
-		break;
+		return 18;
 	case fail::RI_R11_FIQ:
-		read_processor_register(19, data);
-		break;
+		return 19;
 	case fail::RI_R12_FIQ:
-		read_processor_register(20, data);
-		break;
+		return 20;
 	case fail::RI_SP_FIQ:
-		read_processor_register(21, data);
-		break;
+		return 21;
 	case fail::RI_LR_FIQ:
-		read_processor_register(22, data);
-		break;
+		return 22;
 	case fail::RI_SP_IRQ:
-		read_processor_register(23, data);
-		break;
+		return 23;
 	case fail::RI_LR_IRQ:
-		read_processor_register(24, data);
-		break;
+		return 24;
 	case fail::RI_SP_SVC:
-		read_processor_register(25, data);
-		break;
+		return 25;
 	case fail::RI_LR_SVC:
-		read_processor_register(26, data);
-		break;
+		return 26;
 	case fail::RI_SP_ABT:
-		read_processor_register(27, data);
-		break;
+		return 27;
 	case fail::RI_LR_ABT:
-		read_processor_register(28, data);
-		break;
+		return 28;
 	case fail::RI_SP_UND:
-		read_processor_register(29, data);
-		break;
+		return 29;
 	case fail::RI_LR_UND:
-		read_processor_register(30, data);
-		break;
+		return 30;
 	case fail::RI_CPSR:
-		read_processor_register(31, data);
-		break;
+		return 31;
 	case fail::RI_SPSR_FIQ:
-		read_processor_register(32, data);
-		break;
+		return 32;
 	case fail::RI_SPSR_IRQ:
-		read_processor_register(33, data);
-		break;
+		return 33;
 	case fail::RI_SPSR_SVC:
-		read_processor_register(34, data);
-		break;
+		return 34;
 	case fail::RI_SPSR_ABT:
-		read_processor_register(35, data);
-		break;
+		return 35;
 	case fail::RI_SPSR_UND:
-		read_processor_register(36, data);
-		break;
+		return 36;
 	case fail::RI_SP_MON:
-		read_processor_register(37, data);
-		break;
+		return 37;
 	case fail::RI_LR_MON:
-		read_processor_register(38, data);
-		break;
+		return 38;
 	case fail::RI_SPSR_MON:
-		read_processor_register(39, data);
-		break;
+		return 39;
 	default:
-		LOG << "ERROR: Register with id " << reg_num << " unknown." << endl;
-		break;
+		return -1;
 	}
 }
 
-// ToDo: Writing registers above R15 not yet needed, so writing was not
-// implemented
-void oocdw_write_reg(uint32_t reg_num, uint32_t data)
+void oocdw_read_reg(uint32_t reg_num, uint32_t *data)
 {
 	assert((target_a9->state == TARGET_HALTED) && "Target not halted");
 
 	switch (reg_num) {
-	case fail::RI_R0:
-		/* fall through */
-	case fail::RI_R1:
-		/* fall through */
-	case fail::RI_R2:
-		/* fall through */
-	case fail::RI_R3:
-		/* fall through */
-	case fail::RI_R4:
-		/* fall through */
-	case fail::RI_R5:
-		/* fall through */
-	case fail::RI_R6:
-		/* fall through */
-	case fail::RI_R7:
-		/* fall through */
-	case fail::RI_R8:
-		/* fall through */
-	case fail::RI_R9:
-		/* fall through */
-	case fail::RI_R10:
-		/* fall through */
-	case fail::RI_R11:
-		/* fall through */
-	case fail::RI_R12:
-		/* fall through */
-	case fail::RI_R13:
-		/* fall through */
-	case fail::RI_R14:
+	case fail::RI_DFAR:
 		/* fall through */
-	case fail::RI_R15:
+	case fail::RI_DFSR:
+		read_dpm_register(reg_num, data);
+		break;
+	default:
 	{
-		struct reg *reg = get_reg_by_number(reg_num);
-
-		reg->type->set(reg, (uint8_t*)(&data));
+		int index = processor_register_index(reg_num);
+		if (index < 0) {
+			LOG << "ERROR: Register with id " << reg_num << " unknown." << endl;
+			break;
+		}
+		read_processor_register(index, data);
 	}
 		break;
-	default:
+	}
+}
+
+void oocdw_write_reg(uint32_t reg_num, uint32_t data)
+{
+	assert((target_a9->state == TARGET_HALTED) && "Target not halted");
+
+	int index = processor_register_index(reg_num);
+	if (index < 0) {
 		LOG << "ERROR: Register with id " << reg_num << " unknown for writing."
 			<< endl;
-		break;
+		return;
 	}
+	struct reg *reg = get_reg_by_number(index);
+
+	reg->type->set(reg, (uint8_t*)(&data));
 }
 
 
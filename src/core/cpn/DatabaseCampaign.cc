@@ -1,17 +1,27 @@
 #include <vector>
+#include <algorithm>
+#include <sstream>
 
 #include "DatabaseCampaign.hpp"
 #include "cpn/CampaignManager.hpp"
 #include "util/CommandLine.hpp"
 #include "util/Logger.hpp"
 #include "util/Database.hpp"
+#include "util/Sampling.hpp"
 #include "comm/ExperimentData.hpp"
 #include "InjectionPoint.hpp"
 
 #ifndef __puma
 #include <boost/thread.hpp>
+#include <boost/math/distributions/normal.hpp>
 #endif
 
+// online sampling: minimum number of samples before the normal
+// approximation of the confidence intervals is trusted
+static const uint64_t ONLINE_MIN_SAMPLES = 30;
+// resends of a round's missing pilots before online sampling gives up
+static const unsigned ONLINE_MAX_RESENDS = 3;
+
 
 using namespace fail;
 
@@ -59,6 +69,44 @@ bool DatabaseCampaign::run() {
 		cmd.addOption("","inject-randomjumps", Arg::None,
 			"--inject-randomjumps \tinject random jumps (interpret data_address as jump target, as prepared by RandomJumpImporter)");
 
+	CommandLine::option_handle PACKED =
+		cmd.addOption("", "packed-results", Arg::None,
+			"--packed-results \tstore one result row per pilot instead of one per bit offset (result table becomes a view, MySQL only)");
+	CommandLine::option_handle PHASE_TIMES =
+		cmd.addOption("", "phase-times", Arg::None,
+			"--phase-times \tstore the experiments' per-phase run times (restore, fast-forward, inject, resume) as result columns (not with --packed-results)");
+
+	CommandLine::option_handle CHECKPOINT_DIR =
+		cmd.addOption("", "checkpoint-dir", Arg::Required,
+			"--checkpoint-dir DIR \tgolden-run checkpoints (generic-tracing --checkpoint-dir; only DIR/index is read): "
+			"experiments restore the nearest checkpoint before their injection point (single variant only)");
+
+	CommandLine::option_handle ONLINE =
+		cmd.addOption("", "online-sampling", Arg::None,
+			"--online-sampling \tdraw pilots weighted by their fault-space share until the outcome estimates are precise enough, instead of running all pilots");
+	CommandLine::option_handle TARGET_ERROR =
+		cmd.addOption("", "target-error", Arg::Required,
+			"--target-error E \tonline sampling: maximum half width of the confidence intervals (default: 0.01)");
+	CommandLine::option_handle CONFIDENCE =
+		cmd.addOption("", "confidence", Arg::Required,
+			"--confidence C \tonline sampling: confidence level (default: 0.95)");
+	CommandLine::option_handle MAX_SAMPLES =
+		cmd.addOption("", "max-samples", Arg::Required,
+			"--max-samples N \tonline sampling: stop after N samples per variant (default: unlimited)");
+	CommandLine::option_handle SAMPLING_ROUND =
+		cmd.addOption("", "sampling-round", Arg::Required,
+			"--sampling-round N \tonline sampling: samples drawn before waiting for their results (default: 1000)");
+	CommandLine::option_handle ONLINE_TIMEOUT =
+		cmd.addOption("", "online-timeout", Arg::Required,
+			"--online-timeout SECONDS \tonline sampling: resend the missing pilots of a round after SECONDS without a result, "
+			"give up after 3 resends (default: 600)");
+	CommandLine::option_handle OUTCOME_FIELD =
+		cmd.addOption("", "outcome-field", Arg::Required,
+			"--outcome-field NAME \tonline sampling: result field that classifies the outcome (default: resulttype)");
+	CommandLine::option_handle SAMPLING_SEED =
+		cmd.addOption("", "sampling-seed", Arg::Required,
+			"--sampling-seed N \tonline sampling: random seed (default: random)");
+
 	if (!cmd.parse()) {
 		log_send << "Error parsing arguments." << std::endl;
 		exit(-1);
@@ -132,6 +180,59 @@ bool DatabaseCampaign::run() {
 		m_fspmethod = "%";
 	}
 
+	if (cmd[CHECKPOINT_DIR]) {
+		m_checkpoints.setDirectory(cmd[CHECKPOINT_DIR].first()->arg);
+		if (!m_checkpoints.load()) {
+			log_send << "couldn't read the checkpoint index in " << m_checkpoints.getDirectory() << std::endl;
+			exit(-1);
+		}
+		m_use_checkpoints = true;
+		log_send << "golden-run checkpoints: " << m_checkpoints.size() << std::endl;
+	}
+
+	m_online = cmd[ONLINE];
+	if (m_online) {
+		m_target_error = cmd[TARGET_ERROR] ? atof(cmd[TARGET_ERROR].first()->arg) : 0.01;
+		double confidence = cmd[CONFIDENCE] ? atof(cmd[CONFIDENCE].first()->arg) : 0.95;
+		if (m_target_error <= 0 || confidence <= 0 || confidence >= 1) {
+			log_send << "invalid --target-error or --confidence" << std::endl;
+			exit(-1);
+		}
+#ifndef __puma
+		m_z = boost::math::quantile(boost::math::normal(), 1 - (1 - confidence) / 2);
+#endif
+		m_max_samples = cmd[MAX_SAMPLES] ? strtoull(cmd[MAX_SAMPLES].first()->arg, 0, 10) : 0;
+		m_sampling_round = cmd[SAMPLING_ROUND] ? strtoul(cmd[SAMPLING_ROUND].first()->arg, 0, 10) : 1000;
+		if (m_sampling_round == 0) {
+			m_sampling_round = 1;
+		}
+		m_online_timeout = cmd[ONLINE_TIMEOUT] ? strtoul(cmd[ONLINE_TIMEOUT].first()->arg, 0, 10) : 600;
+		if (m_online_timeout == 0) {
+			log_send << "invalid --online-timeout" << std::endl;
+			exit(-1);
+		}
+#ifdef CONFIG_INJECTIONPOINT_HOPS
+		// samples come in random order; without the table, SmartHops would
+		// rescan the trace from the beginning for every round
+		if (!getenv("FAIL_HOPS_TABLE")) {
+			log_send << "online sampling with hops needs a precomputed hop table"
+				" (compute-hops --table) in FAIL_HOPS_TABLE" << std::endl;
+			exit(-1);
+		}
+#endif
+		m_outcome_field = cmd[OUTCOME_FIELD] ? cmd[OUTCOME_FIELD].first()->arg : "resulttype";
+		m_sampling_seed = cmd[SAMPLING_SEED] ? strtoull(cmd[SAMPLING_SEED].first()->arg, 0, 0) : random_seed();
+		log_send << "online sampling: target error " << m_target_error
+			<< " at confidence " << confidence << " (z = " << m_z << "), seed "
+			<< m_sampling_seed << std::endl;
+	}
+
+	if (cmd[PACKED] && cmd[PHASE_TIMES]) {
+		// per-bit run times differ for every bit, so no row could be packed
+		log_send << "--packed-results and --phase-times cannot be combined" << std::endl;
+		exit(-1);
+	}
+
 	db = Database::cmdline_connect();
 
 	/* Set up the adapter that maps the results into the MySQL
@@ -139,6 +240,8 @@ bool DatabaseCampaign::run() {
 	db_connect.set_database_handle(db);
 
 	const google::protobuf::Descriptor *desc = cb_result_message();
+	db_connect.set_packed(cmd[PACKED]);
+	db_connect.set_optional_columns(cmd[PHASE_TIMES]);
 	db_connect.create_table(desc);
 
 	// collect results in parallel to avoid deadlock
@@ -149,13 +252,20 @@ bool DatabaseCampaign::run() {
 	std::vector<Database::Variant> variantlist =
 		db->get_variants(variants, variants_exclude, benchmarks, benchmarks_exclude);
 
+	// the checkpoints belong to one golden run
+	if (m_use_checkpoints && variantlist.size() > 1) {
+		log_send << "--checkpoint-dir needs a single variant/benchmark, found "
+			<< variantlist.size() << std::endl;
+		return false;
+	}
+
 	// Which Pilots were already processed?
 	load_completed_pilots(variantlist);
 
 	for (std::vector<Database::Variant>::const_iterator it = variantlist.begin();
 		 it != variantlist.end(); ++it) {
 		// Push all other variants to the queue
-		if (!run_variant(*it)) {
+		if (!(m_online ? run_variant_online(*it) : run_variant(*it))) {
 			log_send << "run_variant failed for " << it->variant << "/" << it->benchmark <<std::endl;
 			return false;
 		}
@@ -182,13 +292,18 @@ void DatabaseCampaign::collect_result_thread() {
 	ExperimentData *res;
 
 	while ((res = static_cast<ExperimentData *>(campaignmanager.getDone()))) {
-		db_connect.insert_row(&res->getMessage());
+		if (!db_connect.insert_row(&res->getMessage())) {
+			log_recv << "failed to insert a result row" << std::endl;
+		}
+		if (m_online) {
+			record_outcomes(res->getMessage());
+		}
 		delete res;
 	}
 
 	log_recv << "Results complete, updating DB statistics ..." << std::endl;
 	std::stringstream ss;
-	ss << "ANALYZE TABLE " << db_connect.result_table();
+	ss << "ANALYZE TABLE " << db_connect.storage_tables();
 	if (!db_recv->query(ss.str().c_str())) {
 		log_recv << "failed!" << std::endl;
 	} else {
@@ -198,7 +313,23 @@ void DatabaseCampaign::collect_result_thread() {
 	delete db_recv;
 }
 
+void DatabaseCampaign::load_golden_run_length(const Database::Variant &variant)
+{
+	// the last ECs of the trace end with its last instruction
+	std::stringstream ss;
+	ss << "SELECT MAX(instr2) FROM trace WHERE variant_id = " << variant.id;
+	Database::Result *res = db->query(ss.str().c_str(), true);
+	if (!res) {
+		exit(1);
+	}
+	MYSQL_ROW row = db->fetch_row(res);
+	m_golden_run_instr = row && row[0] ? strtoul(row[0], NULL, 10) + 1 : 0;
+	log_send << "golden run: " << m_golden_run_instr << " instructions" << std::endl;
+}
+
 bool DatabaseCampaign::run_variant(Database::Variant variant) {
+	load_golden_run_length(variant);
+
 	/* Gather jobs */
 	unsigned long experiment_count;
 	std::stringstream ss;
@@ -212,15 +343,15 @@ bool DatabaseCampaign::run_variant(Database::Variant variant) {
 	std::string sql_body = ss.str();
 
 	/* Get the number of unfinished experiments */
-	MYSQL_RES *count = db->query(("SELECT COUNT(*) " + sql_body).c_str(), true);
+	Database::Result *count = db->query(("SELECT COUNT(*) " + sql_body).c_str(), true);
 	if (!count) {
 		exit(1);
 	}
-	MYSQL_ROW row = mysql_fetch_row(count);
+	MYSQL_ROW row = db->fetch_row(count);
 	experiment_count = strtoul(row[0], NULL, 10);
 
 
-	MYSQL_RES *pilots = db->query_stream ((sql_select + sql_body).c_str());
+	Database::Result *pilots = db->query_stream ((sql_select + sql_body).c_str());
 	if (!pilots) {
 		exit(1);
 	}
@@ -238,7 +369,7 @@ bool DatabaseCampaign::run_variant(Database::Variant variant) {
 	unsigned expected_results = expected_number_of_results(variant.variant, variant.benchmark);
 
 	unsigned sent_pilots = 0, skipped_pilots = 0;
-	while ((row = mysql_fetch_row(pilots)) != 0) {
+	while ((row = db->fetch_row(pilots)) != 0) {
 		unsigned pilot_id        = strtoul(row[0], NULL, 10);
 		if (existing_results_for_pilot(pilot_id) == expected_results) {
 			skipped_pilots++;
@@ -246,40 +377,15 @@ bool DatabaseCampaign::run_variant(Database::Variant variant) {
 			continue;
 		}
 
-		unsigned injection_instr = strtoul(row[1], NULL, 10);
-		unsigned data_address    = strtoul(row[3], NULL, 10);
-		unsigned data_width      = strtoul(row[4], NULL, 10);
-		unsigned instr1          = strtoul(row[5], NULL, 10);
-		unsigned instr2          = strtoul(row[6], NULL, 10);
-
-		DatabaseCampaignMessage pilot;
-		pilot.set_pilot_id(pilot_id);
-		// ToDo: Remove this, if all experiments work with abstract API (InjectionPoint)
-		pilot.set_injection_instr(injection_instr);
-		pilot.set_variant(variant.variant);
-		pilot.set_benchmark(variant.benchmark);
-
-		ip.parseFromInjectionInstr(instr1, instr2);
-		ip.addToCampaignMessage(pilot);
-
-		if (row[2]) {
-			unsigned injection_instr_absolute = strtoul(row[2], NULL, 10);
-			pilot.set_injection_instr_absolute(injection_instr_absolute);
-		}
-		pilot.set_data_address(data_address);
-		pilot.set_data_width(data_width);
-		pilot.set_inject_bursts(m_inject_bursts);
-		pilot.set_register_injection_mode(m_register_injection_mode);
-
-		this->cb_send_pilot(pilot);
+		send_pilot(parse_pilot_row(row), variant, ip);
 
 		if ((++sent_pilots) % 10000 == 0) {
 			log_send << "pushed " << sent_pilots << " pilots into the queue" << std::endl;
 		}
 	}
 
-	if (*mysql_error(db->getHandle())) {
-		log_send << "MYSQL ERROR: " << mysql_error(db->getHandle()) << std::endl;
+	if (db->error().size()) {
+		log_send << "MYSQL ERROR: " << db->error() << std::endl;
 		return false;
 	}
 
@@ -288,10 +394,386 @@ bool DatabaseCampaign::run_variant(Database::Variant variant) {
 	assert(experiment_count == sent_pilots + skipped_pilots &&
 		"ERROR: not all unfinished experiments pushed to queue");
 
-	mysql_free_result(pilots);
+	db->free_result(pilots);
+
+	return true;
+
+}
+
+DatabaseCampaign::PilotRow DatabaseCampaign::parse_pilot_row(MYSQL_ROW row)
+{
+	PilotRow p;
+	p.id              = strtoul(row[0], NULL, 10);
+	p.injection_instr = strtoul(row[1], NULL, 10);
+	p.has_injection_instr_absolute = row[2];
+	p.injection_instr_absolute = row[2] ? strtoul(row[2], NULL, 10) : 0;
+	p.data_address    = strtoul(row[3], NULL, 10);
+	p.data_width      = strtoul(row[4], NULL, 10);
+	p.instr1          = strtoul(row[5], NULL, 10);
+	p.instr2          = strtoul(row[6], NULL, 10);
+	return p;
+}
+
+void DatabaseCampaign::send_pilot(const PilotRow &p, const Database::Variant &variant,
+	ConcreteInjectionPoint &ip)
+{
+	DatabaseCampaignMessage pilot;
+	pilot.set_pilot_id(p.id);
+	// ToDo: Remove this, if all experiments work with abstract API (InjectionPoint)
+	pilot.set_injection_instr(p.injection_instr);
+	pilot.set_variant(variant.variant);
+	pilot.set_benchmark(variant.benchmark);
+
+	ip.parseFromInjectionInstr(p.instr1, p.instr2);
+	ip.addToCampaignMessage(pilot);
+
+	if (p.has_injection_instr_absolute) {
+		pilot.set_injection_instr_absolute(p.injection_instr_absolute);
+	}
+	pilot.set_data_address(p.data_address);
+	pilot.set_data_width(p.data_width);
+	pilot.set_inject_bursts(m_inject_bursts);
+	pilot.set_register_injection_mode(m_register_injection_mode);
+	pilot.set_golden_run_instr(m_golden_run_instr);
+
+#ifdef CONFIG_INJECTIONPOINT_HOPS
+	// A hop chain is only valid from its own checkpoint (if any), as it
+	// contains the remaining hops only
+	const InjectionPointMessage &ipm = pilot.injection_point();
+	if (ipm.has_checkpoint_id()) {
+		if (m_use_checkpoints && !m_checkpoints.find(ipm.checkpoint_trace_position())) {
+			log_send << "hop chain needs checkpoint #" << ipm.checkpoint_id()
+				<< " @ instr " << ipm.checkpoint_trace_position()
+				<< ", which is missing in " << m_checkpoints.getDirectory() << std::endl;
+			exit(1);
+		}
+		pilot.set_checkpoint_instr(ipm.checkpoint_trace_position());
+	}
+#else
+	if (m_use_checkpoints) {
+		const CheckpointLadder::Checkpoint *c = m_checkpoints.preceding(p.injection_instr);
+		if (c) {
+			pilot.set_checkpoint_instr(c->instr);
+		}
+	}
+#endif
+
+	this->cb_send_pilot(pilot);
+}
+
+bool DatabaseCampaign::run_variant_online(Database::Variant variant)
+{
+	load_golden_run_length(variant);
+
+	/* The population: all pilots, weighted by the fault-space coordinates
+	   they stand for */
+	std::stringstream ss;
+	ss << "SELECT p.id, p.injection_instr, p.injection_instr_absolute, p.data_address, p.data_width, t.instr1, t.instr2, w.weight"
+	   << " FROM fsppilot p "
+	   << " JOIN trace t"
+	   << " ON t.variant_id = p.variant_id AND t.data_address = p.data_address AND t.instr2 = p.instr2"
+	   // pruners that do not set a weight (e.g., basic) group whole ECs
+	   << " JOIN (SELECT g.pilot_id, SUM(COALESCE(g.weight, tg.time2 - tg.time1 + 1)) AS weight"
+	   << "       FROM fspgroup g"
+	   << "       JOIN trace tg"
+	   << "       ON tg.variant_id = g.variant_id AND tg.data_address = g.data_address AND tg.instr2 = g.instr2"
+	   << "       WHERE g.variant_id = " << variant.id
+	   << "         AND g.fspmethod_id IN (SELECT id FROM fspmethod WHERE method LIKE '" << m_fspmethod << "')"
+	   << "       GROUP BY g.pilot_id) w"
+	   << " ON w.pilot_id = p.id"
+	   << " WHERE p.fspmethod_id IN (SELECT id FROM fspmethod WHERE method LIKE '" << m_fspmethod << "')"
+	   << "	  AND p.variant_id = " << variant.id;
+	Database::Result *res = db->query_stream(ss.str().c_str());
+	if (!res) {
+		exit(1);
+	}
+	std::vector<PilotRow> pilots;
+	std::vector<uint64_t> weights;
+	uint64_t total_weight = 0;
+	MYSQL_ROW row;
+	while ((row = db->fetch_row(res)) != 0) {
+		pilots.push_back(parse_pilot_row(row));
+		weights.push_back(row[7] ? strtoull(row[7], NULL, 10) : 0);
+		total_weight += weights.back();
+	}
+	if (db->error().size()) {
+		log_send << "MYSQL ERROR: " << db->error() << std::endl;
+		return false;
+	}
+	db->free_result(res);
+
+	log_send << "Found " << pilots.size() << " pilots covering " << total_weight
+		<< " fault-space coordinates in database. ("
+		<< variant.variant << "/" << variant.benchmark << ")" << std::endl;
+	if (total_weight == 0) {
+		return true;
+	}
+
+	AliasTable table(weights);
+	std::vector<uint64_t>().swap(weights);
+	SampleRNG rng(derive_seed(m_sampling_seed, variant.id));
+
+	unsigned expected_results = expected_number_of_results(variant.variant, variant.benchmark);
+	load_outcomes(variant, expected_results);
+
+	// one injection point for all rounds (with hops: any order of pilots,
+	// as the hop table is required for online sampling)
+	ConcreteInjectionPoint ip;
+	uint64_t sent_pilots = 0, reused = 0;
+	std::unordered_map<unsigned, size_t> pilot_index; // pilot ID -> index into pilots
+	while (true) {
+		std::vector<size_t> to_send; // indices into pilots
+		{
+#ifndef __puma
+			boost::unique_lock<boost::mutex> lock(m_online_mutex);
+#endif
+			uint64_t samples = m_estimator.samples();
+			if (samples >= ONLINE_MIN_SAMPLES && m_estimator.max_half_width(m_z) <= m_target_error) {
+				break;
+			}
+			if (m_max_samples && samples >= m_max_samples) {
+				log_send << "reached --max-samples before the target error" << std::endl;
+				break;
+			}
+
+			uint64_t round = m_sampling_round;
+			if (m_max_samples && m_max_samples - samples < round) {
+				round = m_max_samples - samples;
+			}
+			for (uint64_t i = 0; i < round; ++i) {
+				size_t idx = table.sample(rng);
+				unsigned pilot_id = pilots[idx].id;
+				std::unordered_map<unsigned, SampleEstimator::outcome_counts>::const_iterator it =
+					m_pilot_outcomes.find(pilot_id);
+				if (it != m_pilot_outcomes.end()) {
+					// result already known, no need to run the experiment (again)
+					m_estimator.add(it->second);
+					++reused;
+				} else if (m_pending[pilot_id]++ == 0) {
+					to_send.push_back(idx);
+					pilot_index[pilot_id] = idx;
+				}
+			}
+		}
+
+		campaignmanager.increaseTotalCount(to_send.size());
+		for (size_t i = 0; i < to_send.size(); ++i) {
+			send_pilot(pilots[to_send[i]], variant, ip);
+		}
+		sent_pilots += to_send.size();
 
+		// wait for the whole round, so the estimate is not biased towards
+		// experiments that finish early
+#ifndef __puma
+		boost::unique_lock<boost::mutex> lock(m_online_mutex);
+		size_t missing = m_pending.size();
+		unsigned resends = 0;
+		while (!m_pending.empty()) {
+			if (m_online_cond.timed_wait(lock, boost::posix_time::seconds(m_online_timeout))) {
+				continue;
+			} else if (m_pending.size() < missing) {
+				// still making progress
+				missing = m_pending.size();
+				resends = 0;
+				continue;
+			} else if (resends == ONLINE_MAX_RESENDS) {
+				log_send << "no results for " << m_pending.size() << " pilots after " << resends
+					<< " resends, giving up (a client crashes on them?)" << std::endl;
+				return false;
+			}
+			++resends;
+			std::vector<size_t> missing_pilots;
+			for (std::unordered_map<unsigned, uint64_t>::const_iterator it = m_pending.begin();
+				 it != m_pending.end(); ++it) {
+				missing_pilots.push_back(pilot_index[it->first]);
+			}
+			log_send << "no results for " << missing_pilots.size() << " pilots in "
+				<< m_online_timeout << "s, resending them" << std::endl;
+			// duplicate results are ignored by record_outcomes()
+			lock.unlock();
+			campaignmanager.increaseTotalCount(missing_pilots.size());
+			for (size_t i = 0; i < missing_pilots.size(); ++i) {
+				send_pilot(pilots[missing_pilots[i]], variant, ip);
+			}
+			lock.lock();
+		}
+#endif
+		if (m_estimator.samples() == 0) {
+			log_send << "no outcomes found in the results, check --outcome-field" << std::endl;
+			return false;
+		}
+		log_send << m_estimator.samples() << " samples (" << sent_pilots << " pilots sent, "
+			<< reused << " samples reused), largest confidence interval half width "
+			<< m_estimator.max_half_width(m_z) << std::endl;
+	}
+
+#ifndef __puma
+	boost::lock_guard<boost::mutex> lock(m_online_mutex);
+#endif
+	log_send << "estimates for " << variant.variant << "/" << variant.benchmark
+		<< " from " << m_estimator.samples() << " samples:" << std::endl;
+	for (unsigned i = 0; i < m_estimator.outcomes(); ++i) {
+		double center = m_estimator.center(i, m_z), hw = m_estimator.half_width(i, m_z);
+		log_send << "  " << m_estimator.outcome_name(i) << ": "
+			<< m_estimator.mean(i) << ", Wilson interval [" << std::max(0.0, center - hw)
+			<< ", " << std::min(1.0, center + hw) << "]" << std::endl;
+	}
 	return true;
+}
+
+void DatabaseCampaign::load_outcomes(const Database::Variant &variant, unsigned expected_results)
+{
+#ifndef __puma
+	boost::lock_guard<boost::mutex> lock(m_online_mutex);
+#endif
+	m_estimator = SampleEstimator();
+	m_pilot_outcomes.clear();
+	m_pending.clear();
+
+	std::stringstream sql;
+	sql << "SELECT r.pilot_id, r." << m_outcome_field << ", COUNT(*)"
+	    << " FROM " << db_connect.result_table() << " r"
+	    << " JOIN fsppilot p ON r.pilot_id = p.id"
+	    << " WHERE p.variant_id = " << variant.id
+	    << "   AND p.fspmethod_id IN (SELECT id FROM fspmethod WHERE method LIKE '" << m_fspmethod << "')"
+	    << " GROUP BY r.pilot_id, r." << m_outcome_field;
+	Database::Result *res = db->query_stream(sql.str().c_str());
+	if (!res) {
+		exit(1);
+	}
+	std::unordered_map<unsigned, unsigned> result_count;
+	MYSQL_ROW row;
+	while ((row = db->fetch_row(res)) != 0) {
+		unsigned pilot_id = strtoul(row[0], NULL, 10);
+		unsigned count = strtoul(row[2], NULL, 10);
+		unsigned outcome = m_estimator.outcome(row[1] ? row[1] : "NULL");
+		m_pilot_outcomes[pilot_id].push_back(std::make_pair(outcome, count));
+		result_count[pilot_id] += count;
+	}
+	db->free_result(res);
+
+	// incomplete pilots are run again
+	for (std::unordered_map<unsigned, unsigned>::const_iterator it = result_count.begin();
+		 it != result_count.end(); ++it) {
+		if (it->second != expected_results) {
+			m_pilot_outcomes.erase(it->first);
+		}
+	}
+	log_send << "found results for " << m_pilot_outcomes.size() << " pilots" << std::endl;
+}
+
+// Appends the values of all fields called "name" within msg (also in nested
+// and repeated messages) as strings to out.
+static void collect_field_values(const google::protobuf::Message &msg,
+	const std::string &name, std::vector<std::string> &out)
+{
+	using google::protobuf::FieldDescriptor;
+	const google::protobuf::Descriptor *desc = msg.GetDescriptor();
+	const google::protobuf::Reflection *ref = msg.GetReflection();
+	for (int i = 0; i < desc->field_count(); ++i) {
+		const FieldDescriptor *field = desc->field(i);
+		int count = field->is_repeated() ? ref->FieldSize(msg, field) : 1;
+		if (field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+			if (field->message_type() == DatabaseCampaignMessage::descriptor()) {
+				continue;
+			}
+			for (int j = 0; j < count; ++j) {
+				collect_field_values(field->is_repeated() ?
+					ref->GetRepeatedMessage(msg, field, j) : ref->GetMessage(msg, field),
+					name, out);
+			}
+			continue;
+		}
+		if (field->name() != name || (!field->is_repeated() && !ref->HasField(msg, field))) {
+			continue;
+		}
+		for (int j = 0; j < count; ++j) {
+			std::stringstream ss;
+			bool rep = field->is_repeated();
+			switch (field->cpp_type()) {
+			case FieldDescriptor::CPPTYPE_ENUM:
+				ss << (rep ? ref->GetRepeatedEnum(msg, field, j) : ref->GetEnum(msg, field))->name();
+				break;
+			case FieldDescriptor::CPPTYPE_STRING:
+				ss << (rep ? ref->GetRepeatedString(msg, field, j) : ref->GetString(msg, field));
+				break;
+			case FieldDescriptor::CPPTYPE_INT32:
+				ss << (rep ? ref->GetRepeatedInt32(msg, field, j) : ref->GetInt32(msg, field));
+				break;
+			case FieldDescriptor::CPPTYPE_UINT32:
+				ss << (rep ? ref->GetRepeatedUInt32(msg, field, j) : ref->GetUInt32(msg, field));
+				break;
+			case FieldDescriptor::CPPTYPE_INT64:
+				ss << (rep ? ref->GetRepeatedInt64(msg, field, j) : ref->GetInt64(msg, field));
+				break;
+			case FieldDescriptor::CPPTYPE_UINT64:
+				ss << (rep ? ref->GetRepeatedUInt64(msg, field, j) : ref->GetUInt64(msg, field));
+				break;
+			case FieldDescriptor::CPPTYPE_BOOL:
+				ss << (rep ? ref->GetRepeatedBool(msg, field, j) : ref->GetBool(msg, field));
+				break;
+			default:
+				continue;
+			}
+			out.push_back(ss.str());
+		}
+	}
+}
 
+void DatabaseCampaign::record_outcomes(const google::protobuf::Message &msg)
+{
+	const google::protobuf::Descriptor *desc = msg.GetDescriptor();
+	const google::protobuf::Reflection *ref = msg.GetReflection();
+
+	// the pilot ID lives in the embedded DatabaseCampaignMessage
+	const google::protobuf::Message *pilot = 0;
+	for (int i = 0; i < desc->field_count() && !pilot; ++i) {
+		const google::protobuf::FieldDescriptor *field = desc->field(i);
+		if (!field->is_repeated()
+		    && field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE
+		    && field->message_type() == DatabaseCampaignMessage::descriptor()) {
+			pilot = &ref->GetMessage(msg, field);
+		}
+	}
+	if (!pilot) {
+		log_recv << "result message without DatabaseCampaignMessage, ignored for online sampling" << std::endl;
+		return;
+	}
+	const google::protobuf::FieldDescriptor *id_field =
+		DatabaseCampaignMessage::descriptor()->FindFieldByName("pilot_id");
+	unsigned pilot_id = pilot->GetReflection()->GetUInt32(*pilot, id_field);
+
+	std::vector<std::string> values;
+	collect_field_values(msg, m_outcome_field, values);
+
+#ifndef __puma
+	boost::lock_guard<boost::mutex> lock(m_online_mutex);
+#endif
+	SampleEstimator::outcome_counts counts;
+	for (size_t i = 0; i < values.size(); ++i) {
+		unsigned outcome = m_estimator.outcome(values[i]);
+		SampleEstimator::outcome_counts::iterator it = counts.begin();
+		while (it != counts.end() && it->first != outcome) {
+			++it;
+		}
+		if (it == counts.end()) {
+			counts.push_back(std::make_pair(outcome, 1));
+		} else {
+			++it->second;
+		}
+	}
+	std::unordered_map<unsigned, uint64_t>::iterator it = m_pending.find(pilot_id);
+	if (it == m_pending.end()) {
+		return;
+	}
+	m_estimator.add(counts, it->second);
+	m_pilot_outcomes[pilot_id] = counts;
+	m_pending.erase(it);
+#ifndef __puma
+	if (m_pending.empty()) {
+		m_online_cond.notify_all();
+	}
+#endif
 }
 
 void DatabaseCampaign::load_completed_pilots(std::vector<Database::Variant> &variants)
@@ -317,13 +799,13 @@ void DatabaseCampaign::load_completed_pilots(std::vector<Database::Variant> &var
 	    << " WHERE variant_id in (" << variant_str.str() << ")"
 	    << "   AND fspmethod_id IN (SELECT id FROM fspmethod WHERE method LIKE '" << m_fspmethod << "')"
 	    << " GROUP BY pilot_id ";
-	MYSQL_RES *ids = db->query_stream(sql.str().c_str());
+	Database::Result *ids = db->query_stream(sql.str().c_str());
 	if (!ids) {
 		exit(1);
 	}
 	MYSQL_ROW row;
 	unsigned rowcount = 0;
-	while ((row = mysql_fetch_row(ids)) != 0) {
+	while ((row = db->fetch_row(ids)) != 0) {
 		unsigned pilot_id     = strtoul(row[0], NULL, 10);
 		unsigned result_count = strtoul(row[1], NULL, 10);
 #ifndef __puma
@@ -338,7 +820,7 @@ void DatabaseCampaign::load_completed_pilots(std::vector<Database::Variant> &var
 		}
 	}
 	std::cerr << std::endl;
-	mysql_free_result(ids);
+	db->free_result(ids);
 #ifndef __puma
 	log_send << "found "
 		<< completed_pilots.size() << " pilots ("
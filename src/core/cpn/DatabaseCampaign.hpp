@@ -3,13 +3,19 @@
 
 #include "util/Database.hpp"
 #include "util/DatabaseProtobufAdapter.hpp"
+#include "util/CheckpointLadder.hpp"
 #include "comm/DatabaseCampaignMessage.pb.h"
 #include "Campaign.hpp"
 #include "comm/ExperimentData.hpp"
+#include "SampleEstimator.hpp"
+#include "InjectionPoint.hpp"
 #include <google/protobuf/message.h>
+#include <unordered_map>
 
 #ifndef __puma
 #include <boost/icl/interval_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #endif
 
 namespace fail {
@@ -42,8 +48,46 @@ class DatabaseCampaign : public Campaign {
 	bool m_inject_bursts; // !< inject burst faults?
 	DatabaseCampaignMessage::RegisterInjectionMode m_register_injection_mode; // !< inject into registers? OFF, ON, AUTO (= use registers if address is small)
 
+	bool m_use_checkpoints; // !< send the nearest golden-run checkpoint with each pilot?
+	CheckpointLadder m_checkpoints; // !< golden-run checkpoints (--checkpoint-dir)
+
+	//! One row of the pilot query in run_variant()
+	struct PilotRow {
+		unsigned id, injection_instr, injection_instr_absolute;
+		bool has_injection_instr_absolute;
+		unsigned data_address, data_width, instr1, instr2;
+	};
+	static PilotRow parse_pilot_row(MYSQL_ROW row);
+	unsigned m_golden_run_instr; // !< trace length of the current variant (DatabaseCampaignMessage::golden_run_instr)
+	void load_golden_run_length(const fail::Database::Variant &variant);
+	void send_pilot(const PilotRow &p, const fail::Database::Variant &variant,
+		ConcreteInjectionPoint &ip);
+
+	// online sampling (--online-sampling)
+	bool m_online; // !< draw pilots until the estimates are precise enough
+	double m_target_error; // !< maximum half width of the confidence intervals
+	double m_z; // !< normal quantile for the requested confidence level
+	uint64_t m_max_samples; // !< upper bound for the number of samples per variant (0 = none)
+	uint64_t m_sampling_seed;
+	unsigned m_sampling_round; // !< samples drawn before waiting for their results
+	unsigned m_online_timeout; // !< seconds without results before the missing ones are resent
+	std::string m_outcome_field; // !< result message field that names the outcome
+
+	SampleEstimator m_estimator; // !< estimates of the current variant
+	//! outcomes of finished pilots of the current variant
+	std::unordered_map<unsigned, SampleEstimator::outcome_counts> m_pilot_outcomes;
+	//! pilots sent to the clients -> number of times they were drawn
+	std::unordered_map<unsigned, uint64_t> m_pending;
+#ifndef __puma
+	boost::mutex m_online_mutex; // !< protects the estimator and the maps above
+	boost::condition_variable m_online_cond; // !< signalled when m_pending shrinks
+#endif
+
+	void load_outcomes(const fail::Database::Variant &variant, unsigned expected_results);
+	void record_outcomes(const google::protobuf::Message &msg);
+
 public:
-	DatabaseCampaign() {};
+	DatabaseCampaign() : m_use_checkpoints(false), m_golden_run_instr(0), m_online(false) {};
 
 	/**
 	 * Defines the campaign. In the DatabaseCampaign the database
@@ -59,6 +103,15 @@ public:
 	 */
 	virtual bool run_variant(fail::Database::Variant);
 
+	/**
+	 * Replaces run_variant() with --online-sampling: draws pilots
+	 * weighted by the size of their equivalence class, until the
+	 * confidence intervals of all outcome shares are narrower than the
+	 * target error (or --max-samples is reached).
+	 * @return \c true if the campaign was successful, \c false otherwise
+	 */
+	virtual bool run_variant_online(fail::Database::Variant);
+
 	/**
 	 * How many results have to are expected from each fsppilot. If
 	 * there are less result rows, the pilot will be again sent to the clients
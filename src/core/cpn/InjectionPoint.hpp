@@ -6,6 +6,7 @@
 #include "config/FailConfig.hpp"
 
 #include <vector>
+#include <deque>
 
 namespace fail {
 
@@ -54,16 +55,20 @@ public:
 #include "comm/InjectionPointHopsMessage.pb.h"
 
 class SmartHops;
+class HopTable;
 
 /**
  * \class InjectionPointHops
  *
  * Concrete injection point which contains a hop chain to the target
- * trace instruction.
+ * trace instruction.  The chains are looked up in a hop table precomputed
+ * by compute-hops --table if FAIL_HOPS_TABLE is set; otherwise they are
+ * calculated on the fly from FAIL_TRACE_PATH, which requires ascending instr1.
  */
 class InjectionPointHops : public InjectionPointBase {
 private:
 	SmartHops *m_sa;	// !< Hop calculator which generates the hop chain
+	HopTable *m_table;	// !< Precomputed hop chains (replaces m_sa)
 
 	// Boundaries must be signed to ensure, they can be initialized as outside of beginning
 	// of the trace (instr is -1).
@@ -71,11 +76,11 @@ private:
 	long m_curr_instr2;		// !< Upper end of instructions for which currently a hop chain is available
 
 	bool m_initialized;
-	std::vector<InjectionPointMessage> m_results;
+	std::deque<InjectionPointMessage> m_results;	// !< Hop chains for [m_curr_instr1, m_curr_instr2]
 
 	void init();
 public:
-	InjectionPointHops() : InjectionPointBase(), m_sa(NULL), m_curr_instr1(-1),
+	InjectionPointHops() : InjectionPointBase(), m_sa(NULL), m_table(NULL), m_curr_instr1(-1),
 							m_curr_instr2(-1), m_initialized(false) {}
 
 	virtual ~InjectionPointHops();
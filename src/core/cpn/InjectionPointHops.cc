@@ -1,19 +1,35 @@
 #include "InjectionPoint.hpp"
 #include "util/smarthops/SmartHops.hpp"
+#include "util/smarthops/HopTable.hpp"
 
 #include <algorithm>
 #include <limits>
+#include <stdio.h>
 
 namespace fail {
 
 InjectionPointHops::~InjectionPointHops() {
 	if (m_initialized) {
 		delete m_sa;
+		delete m_table;
 	}
 }
 
 void InjectionPointHops::init()
 {
+	char *table_path = getenv("FAIL_HOPS_TABLE");
+	if (table_path != NULL) {
+		m_table = new HopTable();
+		if (!m_table->open(table_path)) {
+			m_log << "FATAL ERROR: cannot open hop table " << table_path << std::endl;
+			exit(-1);
+		}
+		m_log << "hop chains from " << table_path << " (" << m_table->size()
+			<< " instructions)" << std::endl;
+		m_initialized = true;
+		return;
+	}
+
 	m_sa = new SmartHops();
 
 	char * elfpath = getenv("FAIL_TRACE_PATH");
@@ -24,6 +40,20 @@ void InjectionPointHops::init()
 		m_sa->init((const char*) elfpath);
 	}
 
+	// Start long hop chains at golden-run checkpoints, parameters as for
+	// compute-hops: "COSTS_THRESHOLD,CP_COSTS,ROLLBACK_THRESHOLD"
+	char *cp_params = getenv("FAIL_HOPS_CHECKPOINTS");
+	if (cp_params != NULL) {
+		unsigned cp_thresh, cost_cp, rollback_thresh;
+		if (sscanf(cp_params, "%u,%u,%u", &cp_thresh, &cost_cp, &rollback_thresh) != 3
+			|| !m_sa->setCheckpointing(cp_thresh, cost_cp, rollback_thresh)) {
+			m_log << "FATAL ERROR: FAIL_HOPS_CHECKPOINTS must be "
+				"\"COSTS_THRESHOLD,CP_COSTS,ROLLBACK_THRESHOLD\"" << std::endl;
+			exit(-1);
+		}
+		m_log << "hop chains may start at checkpoints (" << cp_params << ")" << std::endl;
+	}
+
 	m_initialized = true;
 }
 
@@ -38,37 +68,35 @@ void InjectionPointHops::parseFromInjectionInstr(unsigned instr1, unsigned instr
 		init();
 	}
 
-	// clear results older than instr1, as the input needs to be sorted by instr1, these
-	// results won't be needed anymore
-	std::vector<InjectionPointMessage>::iterator it = m_results.begin(), delete_iterator = m_results.end();
-	for (; it != m_results.end(); it++) {
-		if (!it->has_target_trace_position()) {
-			m_log << "FATAL ERROR: Target trace offset must be delivered in order to calculate minimum costs" << std::endl;
-			m_log << m_results.size() << std::endl;
-			exit(0);
-		}
-		if (it->target_trace_position() < instr1) {
-			delete_iterator = it;
+	if (m_table) {
+		// any order of equivalence classes
+		if (instr2 >= m_table->size()
+			|| !m_table->get(m_table->cheapest(instr1, instr2), m_ip)) {
+			m_log << "FATAL ERROR: hop table does not contain instruction offset "
+				<< instr2 << std::endl;
+			exit(-1);
 		}
+		return;
 	}
 
-	// Delete as chunk
-	if (delete_iterator != m_results.end()) {
-		m_results.erase(m_results.begin(), delete_iterator);
+	// clear results older than instr1, as the input needs to be sorted by instr1, these
+	// results won't be needed anymore
+	if ((long)instr1 < m_curr_instr1) {
+		m_log << "FATAL ERROR: equivalence classes must be sorted by instr1 (or use FAIL_HOPS_TABLE)" << std::endl;
+		exit(-1);
+	}
+	while (!m_results.empty() && m_curr_instr1 < (long)instr1) {
+		m_results.pop_front();
+		m_curr_instr1++;
+	}
+	// if instr1 is bigger than the current instr2, we can skip instructions
+	if (m_results.empty()) {
 		m_curr_instr1 = instr1;
 	}
 
 	// Calculate next needed results
 	while ((long)instr2 > m_curr_instr2) {
-		// if instr1 is bigger than nex instr2, we can skip instructions
-		// And current instr1 will be newly defined
-		unsigned new_curr_instr2;
-		if ((long)instr1 > m_curr_instr2) {
-			m_curr_instr1 = instr1;
-			new_curr_instr2 = instr1;
-		} else {
-			new_curr_instr2 = m_curr_instr2 + 1;
-		}
+		unsigned new_curr_instr2 = std::max(m_curr_instr1, m_curr_instr2 + 1);
 
 		InjectionPointMessage m;
 		if (!m_sa->calculateFollowingHop(m, new_curr_instr2)) {
@@ -82,10 +110,10 @@ void InjectionPointHops::parseFromInjectionInstr(unsigned instr1, unsigned instr
 	}
 
 	// Choose minimum
-	InjectionPointMessage *min_cost_msg;
+	InjectionPointMessage *min_cost_msg = NULL;
 	uint32_t min_costs = std::numeric_limits<uint32_t>::max();
 
-	std::vector<InjectionPointMessage>::iterator search, search_end;
+	std::deque<InjectionPointMessage>::iterator search, search_end;
 	search = m_results.begin() + (instr1 - m_curr_instr1);
 	search_end = m_results.begin() + (instr2 - m_curr_instr1);
 
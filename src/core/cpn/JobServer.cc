@@ -11,6 +11,7 @@
 #include <string.h>
 #include <thread>
 #include <tuple>
+#include <map>
 
 #include "JobServer.hpp"
 
@@ -132,6 +133,8 @@ static bool sendMsg(tcp::socket &socket, google::protobuf::Message &msg,
 struct JobServer::impl {
 	io_service accept_service;
 	io_service comm_service;
+	//! latest phase statistics of each minion (only used by comm_thread)
+	std::map<std::string, PhaseStatistics> phase_statistics;
 	std::thread comm_thread;
 	std::atomic<uint64_t> redundant_results{0};
 
@@ -144,10 +147,13 @@ struct JobServer::impl {
 		      comm_service.run();
 		      std::cout << "Received " << redundant_results
 				<< " redundant results." << std::endl;
+		      print_phase_statistics();
 	      })
 	{
 	}
 
+	void print_phase_statistics();
+
 	~impl()
 	{
 		comm_service.stop();
@@ -157,6 +163,44 @@ struct JobServer::impl {
 	}
 };
 
+static void print_phases(const PhaseStatistics &s)
+{
+	const double total = s.restore_time() + s.fastforward_time()
+		+ s.inject_time() + s.resume_time();
+	const auto share = [total](double t) { return total > 0 ? t / total * 100 : 0; };
+	std::cout << std::fixed << std::setprecision(1)
+		<< s.experiments() << " experiments, "
+		<< "restore " << s.restore_time() << "s (" << share(s.restore_time()) << "%), "
+		<< "fast-forward " << s.fastforward_time() << "s (" << share(s.fastforward_time()) << "%, "
+		<< s.fastforward_instr() << " instr, " << s.fastforward_ticks() << " ticks), "
+		<< "inject " << s.inject_time() << "s (" << share(s.inject_time()) << "%), "
+		<< "resume " << s.resume_time() << "s (" << share(s.resume_time()) << "%, "
+		<< s.resume_ticks() << " ticks)" << std::endl;
+}
+
+void JobServer::impl::print_phase_statistics()
+{
+	if (phase_statistics.empty()) {
+		return;
+	}
+	PhaseStatistics total;
+	for (auto &&it : phase_statistics) {
+		const PhaseStatistics &s = it.second;
+		std::cout << "[Server] " << it.first << ": ";
+		print_phases(s);
+		total.set_experiments(total.experiments() + s.experiments());
+		total.set_restore_time(total.restore_time() + s.restore_time());
+		total.set_fastforward_time(total.fastforward_time() + s.fastforward_time());
+		total.set_inject_time(total.inject_time() + s.inject_time());
+		total.set_resume_time(total.resume_time() + s.resume_time());
+		total.set_fastforward_instr(total.fastforward_instr() + s.fastforward_instr());
+		total.set_fastforward_ticks(total.fastforward_ticks() + s.fastforward_ticks());
+		total.set_resume_ticks(total.resume_ticks() + s.resume_ticks());
+	}
+	std::cout << "[Server] " << phase_statistics.size() << " minions: ";
+	print_phases(total);
+}
+
 JobServer::JobServer(const unsigned short port)
     : m_d(std::make_shared<impl>()), m_port(port), m_finish(false),
       m_threadtimeout(0), m_undoneJobs(SERVER_OUT_QUEUE_SIZE)
@@ -355,6 +399,11 @@ void CommThread::operator()(yield_context yield)
 			cout << "!![Server] ignoring old client's results" << endl;
 			break;
 		}
+		// statistics are cumulative, keep the latest
+		if (ctrlmsg.has_phase_statistics()) {
+			m_js.m_d->phase_statistics[ctrlmsg.phase_statistics().minion()] =
+				ctrlmsg.phase_statistics();
+		}
 		// get results and put to done queue.
 		receiveExperimentResults(ctrlmsg, yield);
 		break;
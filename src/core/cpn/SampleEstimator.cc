@@ -0,0 +1,94 @@
+#include <math.h>
+#include <algorithm>
+#include "SampleEstimator.hpp"
+
+using namespace fail;
+
+unsigned SampleEstimator::outcome(const std::string& name)
+{
+	std::map<std::string, unsigned>::const_iterator it = m_outcome_index.find(name);
+	if (it != m_outcome_index.end()) {
+		return it->second;
+	}
+	unsigned idx = m_outcome_names.size();
+	m_outcome_index[name] = idx;
+	m_outcome_names.push_back(name);
+	// earlier samples had a share of 0 for this outcome
+	m_sum.push_back(0);
+	return idx;
+}
+
+void SampleEstimator::add(const outcome_counts& counts, uint64_t times)
+{
+	unsigned total = 0;
+	for (outcome_counts::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+		total += it->second;
+	}
+	if (total == 0 || times == 0) {
+		return;
+	}
+	for (outcome_counts::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+		double share = (double) it->second / total;
+		m_sum[it->first] += times * share;
+	}
+	m_samples += times;
+}
+
+double SampleEstimator::mean(unsigned idx) const
+{
+	return m_samples ? m_sum[idx] / m_samples : 0;
+}
+
+/**
+ * Wilson score interval for a share p estimated from n samples:
+ *   center     = (p + z^2 / 2n) / (1 + z^2 / n)
+ *   half width = z / (1 + z^2 / n) * sqrt(p(1-p) / n + z^2 / 4n^2)
+ * Unlike the Wald interval (z * sqrt(p(1-p) / n)), it does not collapse to
+ * zero for shares of 0 or 1, e.g. for a rare outcome that has not been seen
+ * yet.
+ */
+static double wilson_center(double p, uint64_t n, double z)
+{
+	double z2 = z * z;
+	return (p + z2 / (2.0 * n)) / (1 + z2 / n);
+}
+
+static double wilson_half_width(double p, uint64_t n, double z)
+{
+	double z2 = z * z;
+	return z / (1 + z2 / n) * sqrt(p * (1 - p) / n + z2 / (4.0 * n * n));
+}
+
+double SampleEstimator::center(unsigned idx, double z) const
+{
+	if (m_samples == 0) {
+		return 0.5;
+	}
+	return wilson_center(mean(idx), m_samples, z);
+}
+
+double SampleEstimator::half_width(unsigned idx, double z) const
+{
+	if (m_samples < 2) {
+		return 1;
+	}
+	// rounding errors may push the mean slightly out of [0, 1]
+	double p = std::min(1.0, std::max(0.0, mean(idx)));
+	return wilson_half_width(p, m_samples, z);
+}
+
+double SampleEstimator::max_half_width(double z) const
+{
+	if (m_samples < 2) {
+		return 1;
+	}
+	// an outcome not seen so far
+	double max = wilson_half_width(0, m_samples, z);
+	for (unsigned i = 0; i < m_sum.size(); ++i) {
+		double hw = half_width(i, z);
+		if (hw > max) {
+			max = hw;
+		}
+	}
+	return max;
+}
@@ -0,0 +1,63 @@
+#ifndef __CPN_SAMPLE_ESTIMATOR_H__
+#define __CPN_SAMPLE_ESTIMATOR_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+namespace fail {
+
+/**
+ * \class SampleEstimator
+ *
+ * Estimates the share of each experiment outcome in the fault space from a
+ * growing number of samples.  Each sample is one fault-space coordinate
+ * drawn with replacement; as one experiment covers all bits of the
+ * coordinate, a sample contributes the fraction of its results with the
+ * respective outcome.  The confidence interval of each share is the Wilson
+ * score interval for the estimated share p, which stays nonzero for outcomes
+ * with a share of 0 or 1.  As a sample's contribution lies in [0, 1], its
+ * variance is at most p(1-p), so the interval is conservative for samples
+ * that mix outcomes.
+ */
+class SampleEstimator {
+public:
+	//! (outcome index, number of results with this outcome)
+	typedef std::vector<std::pair<unsigned, unsigned> > outcome_counts;
+
+private:
+	std::map<std::string, unsigned> m_outcome_index;
+	std::vector<std::string> m_outcome_names;
+	std::vector<double> m_sum;
+	uint64_t m_samples;
+
+public:
+	SampleEstimator() : m_samples(0) {}
+
+	//! Index of an outcome name, registered on first use.
+	unsigned outcome(const std::string& name);
+	unsigned outcomes() const { return m_outcome_names.size(); }
+	const std::string& outcome_name(unsigned idx) const { return m_outcome_names[idx]; }
+
+	/**
+	 * Accounts the results of one experiment "times" times (the same
+	 * coordinate may be drawn repeatedly).
+	 */
+	void add(const outcome_counts& counts, uint64_t times = 1);
+
+	uint64_t samples() const { return m_samples; }
+	//! Estimated share of an outcome.
+	double mean(unsigned idx) const;
+	//! Center of the confidence interval for quantile z (e.g. 1.96 for 95%).
+	double center(unsigned idx, double z) const;
+	//! Half width of the confidence interval for quantile z.
+	double half_width(unsigned idx, double z) const;
+	//! Largest half width over all outcomes, including one not seen yet.
+	double max_half_width(double z) const;
+};
+
+} // end-of-namespace: fail
+
+#endif // __CPN_SAMPLE_ESTIMATOR_H__
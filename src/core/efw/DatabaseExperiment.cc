@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/message.h>
@@ -14,6 +15,7 @@
 #include "sal/Listener.hpp"
 #include "efw/DatabaseExperiment.hpp"
 #include "comm/DatabaseCampaignMessage.pb.h"
+#include "util/WallclockTimer.hpp"
 
 #if defined(BUILD_CAPSTONE_DISASSEMBLER)
 #  include "util/capstonedisassembler/CapstoneToFailTranslator.hpp"
@@ -185,6 +187,12 @@ bool DatabaseExperiment::run()
 
 	unsigned executed_jobs = 0;
 
+	char hostname[256] = "";
+	gethostname(hostname, sizeof(hostname) - 1);
+	m_phase_statistics.set_minion(std::string(hostname) + ":" + std::to_string(getpid()));
+	WallclockTimer phase;
+	simtime_t ticks;
+
 	while (executed_jobs < 25 || m_jc->getNumberOfUndoneJobs() > 0) {
 		m_log << "asking jobserver for parameters" << endl;
 		ExperimentData * param = this->cb_allocate_experiment_data();
@@ -214,6 +222,24 @@ bool DatabaseExperiment::run()
 		unsigned injection_width =
 			(fsppilot->inject_bursts() || fsppilot->register_injection_mode() == fsppilot->RANDOMJUMP) ? 8 : 1;
 
+		// Start from the nearest golden-run checkpoint before the injection
+		// point, if the campaign chose one and the experiment has it
+		unsigned checkpoint_instr = fsppilot->checkpoint_instr();
+		std::string state_dir = cb_state_directory();
+		if (checkpoint_instr > 0) {
+			std::string checkpoint_dir;
+			if (checkpoint_instr <= injection_instr) {
+				checkpoint_dir = cb_checkpoint_directory(checkpoint_instr);
+			}
+			if (checkpoint_dir.empty()) {
+				m_log << "ignoring checkpoint @ instr #" << dec << checkpoint_instr << endl;
+				checkpoint_instr = 0;
+			} else {
+				state_dir = checkpoint_dir;
+			}
+		}
+		m_restored_checkpoint = checkpoint_instr;
+
 		for (unsigned bit_offset = 0; bit_offset < width * 8; bit_offset += injection_width) {
 			// 8 results in one job
 			Message *outer_result = cb_new_result(param);
@@ -221,27 +247,37 @@ bool DatabaseExperiment::run()
 			DatabaseExperimentMessage *result =
 				protobufFindSubmessageByTypename<DatabaseExperimentMessage>(outer_result, "DatabaseExperimentMessage");
 			result->set_bitoffset(bit_offset);
-			m_log << "restoring state" << endl;
-			// Restore to the image, which starts at address(main)
-			simulator.restore(cb_state_directory());
+			m_log << "restoring state " << state_dir << endl;
+			// Restore to the image, which starts at address(main) or at the
+			// checkpoint
+			phase.reset();
+			phase.startTimer();
+			simulator.restore(state_dir);
+			phase.stopTimer();
+			result->set_restore_time(phase.getRuntimeAsDouble());
+			m_phase_statistics.set_restore_time(m_phase_statistics.restore_time() + phase.getRuntimeAsDouble());
+			m_phase_statistics.set_experiments(m_phase_statistics.experiments() + 1);
 			executed_jobs ++;
 
 			m_log << "Trying to inject @ instr #" << dec << injection_instr << endl;
 
 			simulator.clearListeners(this);
 
+			phase.reset();
+			phase.startTimer();
+			ticks = simulator.getTimerTicks();
 			if (!this->cb_before_fast_forward()) {
 				continue;
 			}
 
 			// Do we need to fast-forward at all?
 			fail::BaseListener *listener = 0;
-			if (injection_instr > 0) {
+			if (injection_instr > checkpoint_instr) {
 				// Create a listener that matches any IP event. It is used to
 				// forward to the injection point.
 				BPSingleListener bp;
 				bp.setWatchInstructionPointer(ANY_ADDR);
-				bp.setCounter(injection_instr);
+				bp.setCounter(injection_instr - checkpoint_instr);
 				simulator.addListener(&bp);
 
 				while (true) {
@@ -255,6 +291,13 @@ bool DatabaseExperiment::run()
 					}
 				}
 			}
+			phase.stopTimer();
+			result->set_fastforward_time(phase.getRuntimeAsDouble());
+			m_phase_statistics.set_fastforward_time(m_phase_statistics.fastforward_time() + phase.getRuntimeAsDouble());
+			m_phase_statistics.set_fastforward_ticks(m_phase_statistics.fastforward_ticks() + (simulator.getTimerTicks() - ticks));
+			if (injection_instr > checkpoint_instr) {
+				m_phase_statistics.set_fastforward_instr(m_phase_statistics.fastforward_instr() + (injection_instr - checkpoint_instr));
+			}
 			if (!this->cb_after_fast_forward(listener)) {
 				continue; // Continue to next injection experiment
 			}
@@ -279,6 +322,8 @@ bool DatabaseExperiment::run()
 			simulator.clearListeners(this);
 
 			// inject fault (single-bit flip or burst)
+			phase.reset();
+			phase.startTimer();
 			result->set_original_value(
 				injectFault(data_address + bit_offset / 8, bit_offset % 8,
 					fsppilot->inject_bursts(),
@@ -286,6 +331,9 @@ bool DatabaseExperiment::run()
 					fsppilot->register_injection_mode() == fsppilot->FORCE,
 					fsppilot->register_injection_mode() == fsppilot->RANDOMJUMP));
 			result->set_injection_width(injection_width);
+			phase.stopTimer();
+			result->set_inject_time(phase.getRuntimeAsDouble());
+			m_phase_statistics.set_inject_time(m_phase_statistics.inject_time() + phase.getRuntimeAsDouble());
 
 			if (!this->cb_before_resume()) {
 				continue; // Continue to next experiment
@@ -293,18 +341,28 @@ bool DatabaseExperiment::run()
 
 			m_log << "Resuming till the crash" << std::endl;
 			// resume and wait for results
+			phase.reset();
+			phase.startTimer();
+			ticks = simulator.getTimerTicks();
 			while (true) {
 				listener = simulator.resume();
 				bool should_continue = this->cb_during_resume(listener);
 				if (!should_continue)
 					break;
 			}
+			phase.stopTimer();
+			ticks = simulator.getTimerTicks() - ticks;
+			result->set_resume_time(phase.getRuntimeAsDouble());
+			result->set_resume_ticks(ticks);
+			m_phase_statistics.set_resume_time(m_phase_statistics.resume_time() + phase.getRuntimeAsDouble());
+			m_phase_statistics.set_resume_ticks(m_phase_statistics.resume_ticks() + ticks);
 			m_log << "Resume done" << std::endl;
 			this->cb_after_resume(listener);
 
 			simulator.clearListeners(this);
 		}
 #ifndef LOCAL
+		m_jc->setPhaseStatistics(m_phase_statistics);
 		m_jc->sendResult(*param);
 #else
 		break;
@@ -5,6 +5,7 @@
 #include "efw/ExperimentFlow.hpp"
 #include "efw/JobClient.hpp"
 #include "util/Logger.hpp"
+#include "comm/FailControlMessage.pb.h"
 #include <string>
 #include <stdlib.h>
 
@@ -24,9 +25,14 @@ class DatabaseExperiment : public fail::ExperimentFlow {
 	ExperimentData *m_current_param;
 	google::protobuf::Message *m_current_result;
 
+	unsigned m_restored_checkpoint;
+
+	//! time spent in the experiment phases, reported to the JobServer
+	PhaseStatistics m_phase_statistics;
+
 public:
 	DatabaseExperiment(const std::string &name)
-		: m_log(name, false), m_mm(fail::simulator.getMemoryManager()) {
+		: m_restored_checkpoint(0), m_log(name, false), m_mm(fail::simulator.getMemoryManager()) {
 
 		/* The fail server can be set with an environent variable,
 		   otherwise the JOBSERVER configured by cmake ist used */
@@ -57,6 +63,11 @@ protected:
 	 */
 	google::protobuf::Message * get_current_result() { return m_current_result; }
 
+	/** Returns the instruction count of the golden-run checkpoint the
+	 * current experiment was restored from (0 = the start state).
+	 */
+	unsigned get_restored_checkpoint() { return m_restored_checkpoint; }
+
 
 	//////////////////////////////////////////////////////////////////
 	// Can be overwritten by experiment
@@ -67,6 +78,14 @@ protected:
 	 */
 	virtual std::string cb_state_directory() { return "state"; }
 
+	/**
+	 * Get path to the golden-run checkpoint taken \a instr instructions
+	 * after the start state (see DatabaseCampaignMessage::checkpoint_instr).
+	 * An empty path ignores the checkpoint, i.e., the experiment restores
+	 * cb_state_directory() and fast-forwards all the way.
+	 */
+	virtual std::string cb_checkpoint_directory(unsigned instr) { return ""; }
+
 	/**
 	 * Callback that is called, before the actual experiment
 	 * starts. Simulation is terminated on false.
@@ -319,6 +319,9 @@ bool JobClient::sendResultsToServer()
 		ctrlmsg.set_build_id(42);
 		ctrlmsg.set_run_id(m_server_runid);
 		ctrlmsg.set_job_size(m_results.size()); //Store how many results will be sent
+		if (m_phase_statistics.has_minion()) {
+			ctrlmsg.mutable_phase_statistics()->CopyFrom(m_phase_statistics);
+		}
 
 		cout << "[Client] Sending back result [";
 
@@ -44,6 +44,8 @@ private:
 
 	bool m_connect_failed;
 
+	PhaseStatistics m_phase_statistics;
+
 	bool connectToServer();
 	bool sendResultsToServer();
 	FailControlMessage_Command tryToGetExperimentData(ExperimentData& exp);
@@ -75,6 +77,11 @@ public:
 	 * @return the number of undone jobs.
 	 */
 	int getNumberOfUndoneJobs() { return m_parameters.size(); }
+	/**
+	 * Set the phase statistics reported to the JobServer with the next
+	 * results.
+	 */
+	void setPhaseStatistics(const PhaseStatistics& stats) { m_phase_statistics.CopyFrom(stats); }
 };
 
 } // end-of-namespace: fail
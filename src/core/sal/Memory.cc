@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "Memory.hpp"
+
+namespace fail {
+
+const size_t MemoryManager::FINGERPRINT_PAGE_SIZE;
+
+// 64-bit finalizer of MurmurHash3
+static inline uint64_t mix64(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static uint64_t hashPage(const uint64_t *words, size_t count)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ULL;
+	for (size_t i = 0; i < count; ++i) {
+		h = (h ^ mix64(words[i])) * 0x100000001b3ULL;
+	}
+	return mix64(h);
+}
+
+static inline uint64_t hashNode(uint64_t left, uint64_t right)
+{
+	// not commutative: swapping two pages changes the fingerprint
+	return mix64(left * 0x9e3779b97f4a7c15ULL + (right ^ (right >> 29)));
+}
+
+void MemoryManager::markAllDirty()
+{
+	m_DirtyList.clear();
+	for (size_t page = 0; page < m_Dirty.size(); ++page) {
+		m_Dirty[page] = true;
+		m_DirtyList.push_back(page);
+	}
+}
+
+bool MemoryManager::readPage(size_t page, void *dest)
+{
+	guest_address_t addr = page * FINGERPRINT_PAGE_SIZE;
+	if (!isMapped(addr))
+		return false;
+	size_t cnt = std::min(FINGERPRINT_PAGE_SIZE, getPoolSize() - addr);
+	getBytes(addr, cnt, dest);
+	std::fill(static_cast<char *>(dest) + cnt, static_cast<char *>(dest) + FINGERPRINT_PAGE_SIZE, 0);
+	return true;
+}
+
+uint64_t MemoryManager::fingerprint()
+{
+	size_t pages = (getPoolSize() + FINGERPRINT_PAGE_SIZE - 1) / FINGERPRINT_PAGE_SIZE;
+	if (pages != m_Dirty.size()) {
+		// (re)build the tree; the padding leaves stay 0
+		m_Dirty.assign(pages, false);
+		for (m_Leaves = 1; m_Leaves < pages; m_Leaves *= 2)
+			;
+		m_Tree.assign(2 * m_Leaves, 0);
+		markAllDirty();
+	} else if (!m_DirtyTracking) {
+		markAllDirty();
+	}
+
+	static const size_t WORDS = FINGERPRINT_PAGE_SIZE / sizeof(uint64_t);
+	uint64_t buf[WORDS];
+	static uint64_t zero_hash = 0;
+	if (!zero_hash) {
+		std::fill(buf, buf + WORDS, 0);
+		zero_hash = hashPage(buf, WORDS);
+	}
+
+	// rehash the dirty leaves ...
+	m_Rehashed = m_DirtyList.size();
+	std::vector<size_t> nodes;
+	nodes.swap(m_DirtyList);
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		size_t page = nodes[i];
+		m_Dirty[page] = false;
+		m_Tree[m_Leaves + page] = readPage(page, buf) ? hashPage(buf, WORDS) : zero_hash;
+		nodes[i] = m_Leaves + page;
+	}
+
+	// ... and then their ancestors, level by level
+	std::sort(nodes.begin(), nodes.end());
+	while (!nodes.empty() && nodes[0] > 1) {
+		size_t n = 0;
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			size_t parent = nodes[i] / 2;
+			if (n == 0 || nodes[n - 1] != parent)
+				nodes[n++] = parent;
+		}
+		nodes.resize(n);
+		for (size_t i = 0; i < n; ++i)
+			m_Tree[nodes[i]] = hashNode(m_Tree[2 * nodes[i]], m_Tree[2 * nodes[i] + 1]);
+	}
+	nodes.clear();
+	nodes.swap(m_DirtyList); // keep the allocation
+
+	return m_Tree[1];
+}
+
+} // end-of-namespace: fail
@@ -68,6 +68,78 @@ public:
 		// default implementation
 		return addr < getPoolSize();
 	}
+
+	/* ********************************************************************
+	 * State fingerprints:
+	 * ********************************************************************/
+	static const size_t FINGERPRINT_PAGE_SIZE = 4096;
+	/**
+	 * Marks the memory pages overlapping [\a addr, \a addr + \a cnt) as
+	 * modified since the last fingerprint().  Called by the simulator
+	 * backend on every write to the memory pool.
+	 * @param addr The (physical) address of the first modified byte.
+	 * @param cnt The number of modified bytes.
+	 */
+	void markDirty(guest_address_t addr, size_t cnt)
+	{
+		if (m_Dirty.empty() || cnt == 0)
+			return;
+		size_t last = (addr + cnt - 1) / FINGERPRINT_PAGE_SIZE;
+		for (size_t page = addr / FINGERPRINT_PAGE_SIZE; page <= last && page < m_Dirty.size(); ++page) {
+			if (!m_Dirty[page]) {
+				m_Dirty[page] = true;
+				m_DirtyList.push_back(page);
+			}
+		}
+	}
+	/**
+	 * Marks the whole memory pool as modified, e.g., after the simulator
+	 * state has been restored.
+	 */
+	void markAllDirty();
+	/**
+	 * Tells whether the backend reports all writes to the memory pool via
+	 * markDirty().  Otherwise, fingerprint() needs to rehash all pages.
+	 */
+	bool hasDirtyTracking() const { return m_DirtyTracking; }
+	/**
+	 * Computes a 64-bit fingerprint of the complete memory pool.  Only the
+	 * pages modified since the last call are rehashed; the page hashes are
+	 * combined in a binary hash tree whose root is the fingerprint, so the
+	 * costs are O(dirty pages * log(pages)).
+	 * @return the fingerprint (equal memory contents give equal fingerprints)
+	 */
+	uint64_t fingerprint();
+	/**
+	 * Retrieves the number of pages covered by the fingerprint.
+	 */
+	size_t getPageCount() const { return m_Dirty.size(); }
+	/**
+	 * Retrieves the number of pages rehashed by the last fingerprint().
+	 */
+	size_t getRehashedPages() const { return m_Rehashed; }
+protected:
+	MemoryManager() : m_DirtyTracking(false), m_Leaves(0), m_Rehashed(0) { }
+	/**
+	 * Enables the incremental fingerprint() for backends that report all
+	 * writes to the memory pool via markDirty().
+	 */
+	void setDirtyTracking(bool enabled) { m_DirtyTracking = enabled; }
+	/**
+	 * Copies page \a page (FINGERPRINT_PAGE_SIZE bytes, starting at the
+	 * physical address page * FINGERPRINT_PAGE_SIZE) to \a dest.  The
+	 * default implementation assumes guest addresses to be physical.
+	 * @return \c false if the page is not backed by memory (then it is
+	 *         hashed like a page full of zeroes)
+	 */
+	virtual bool readPage(size_t page, void *dest);
+private:
+	bool m_DirtyTracking;
+	std::vector<bool> m_Dirty; //!< page modified since the last fingerprint()?
+	std::vector<size_t> m_DirtyList; //!< dito, as a list
+	std::vector<uint64_t> m_Tree; //!< hash tree: node i has children 2i, 2i+1
+	size_t m_Leaves; //!< index of the first leaf (= page 0) in m_Tree
+	size_t m_Rehashed;
 };
 
 } // end-of-namespace: fail
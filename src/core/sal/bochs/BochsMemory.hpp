@@ -2,6 +2,7 @@
 #define __BOCHS_MEMORY_HPP__
 
 #include "../Memory.hpp"
+#include "config/FailConfig.hpp"
 
 namespace fail {
 
@@ -16,7 +17,13 @@ public:
 	 * Constructs a new MemoryManager object and initializes
 	 * it's attributes appropriately.
 	 */
-	BochsMemoryManager() : MemoryManager() {  }
+	BochsMemoryManager() : MemoryManager()
+	{
+#ifdef CONFIG_DIRTY_PAGES
+		// the DirtyPages aspect reports all writes to physical memory
+		setDirtyTracking(true);
+#endif
+	}
 	/**
 	 * Retrieves the size of the available simulated memory.
 	 * @return the size of the memory pool in bytes
@@ -62,10 +69,13 @@ public:
 	 */
 	void setByte(guest_address_t addr, byte_t data)
 	{
-		host_address_t haddr = guestToHost(addr);
+		bx_phy_address physicalAddr;
+		host_address_t haddr = guestToHost(addr, &physicalAddr);
 		assert(haddr != (host_address_t)ADDR_INV &&
 			   "FATAL ERROR: Invalid guest address provided!");
 		*reinterpret_cast<Bit8u*>(haddr) = data;
+		// bypasses Bochs' write path (and thus the DirtyPages aspect)
+		markDirty(physicalAddr, 1);
 	}
 	/**
 	 * Copies data to memory.
@@ -84,9 +94,10 @@ public:
 	/**
 	 * Transforms the guest address \a addr to a host address.  Bochs specific.
 	 * @param addr The (logical) guest address to be transformed
+	 * @param phys If not \c NULL, receives the physical address
 	 * @return the transformed (host) address or \c ADDR_INV on errors
 	 */
-	host_address_t guestToHost(guest_address_t addr)
+	host_address_t guestToHost(guest_address_t addr, bx_phy_address *phys = NULL)
 	{
 		const unsigned SEGMENT_SELECTOR_IDX = 2; // always the code segment
 		const bx_address logicalAddr = static_cast<bx_address>(addr); // offset within the segment
@@ -103,6 +114,9 @@ public:
 		if (!hostAddr) {
 			return (host_address_t) ADDR_INV; // error
 		}
+		if (phys) {
+			*phys = physicalAddr;
+		}
 
 		return reinterpret_cast<host_address_t>(hostAddr);
 	}
@@ -117,6 +131,22 @@ public:
 			return false;
 		return true;
 	}
+#ifdef CONFIG_DIRTY_PAGES
+protected:
+	/**
+	 * Copies physical page \a page to \a dest, bypassing paging and
+	 * without allocating memory blocks Bochs did not use yet.
+	 */
+	bool readPage(size_t page, void *dest)
+	{
+		const Bit8u *src = BX_MEM(0)->fail_getPage(page * FINGERPRINT_PAGE_SIZE);
+		if (!src) {
+			return false;
+		}
+		memcpy(dest, src, FINGERPRINT_PAGE_SIZE);
+		return true;
+	}
+#endif
 };
 
 } // end-of-namespace: fail
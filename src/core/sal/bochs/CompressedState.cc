@@ -0,0 +1,71 @@
+#include <unistd.h>
+#include <zlib.h>
+
+#include "CompressedState.hpp"
+
+namespace fail {
+
+size_t fread_compressed(void *ptr, size_t size, size_t nmemb, FILE *stream)
+{
+	size_t remaining = size * nmemb;
+	ssize_t ret;
+	char *cbuf = (char *) ptr;
+	// the stream may have buffered ahead (is_compressed() peeks at it)
+	int fd = dup(fileno(stream));
+	lseek(fd, ftell(stream), SEEK_SET);
+	// FIXME check return values
+	gzFile f = gzdopen(fd, "rb");
+#if ZLIB_VERNUM >= 0x1240
+	gzbuffer(f, 1024*1024);
+#endif
+
+	do {
+		ret = gzread(f, cbuf, remaining);
+		// EOF or error?
+		if (ret == 0 || ret == -1) {
+			break;
+		}
+		remaining -= ret;
+		cbuf += ret;
+	} while (remaining);
+	gzclose(f);
+
+	return (cbuf - (char *)ptr) / size;
+}
+
+size_t fwrite_compressed(const void *ptr, size_t size, size_t nmemb, FILE *stream)
+{
+	size_t remaining = size * nmemb;
+	ssize_t ret;
+	const char *cbuf = (const char *) ptr;
+	// FIXME check return values
+	gzFile f = gzdopen(dup(fileno(stream)), "wb9");
+#if ZLIB_VERNUM >= 0x1240
+	gzbuffer(f, 1024*1024);
+#endif
+
+	do {
+		ret = gzwrite(f, cbuf, remaining);
+		// error?
+		if (ret == 0) {
+			break;
+		}
+		remaining -= ret;
+		cbuf += ret;
+	} while (remaining);
+	gzclose(f);
+
+	return (cbuf - (const char *)ptr) / size;
+}
+
+bool is_compressed(FILE *stream)
+{
+	unsigned char magic[2];
+	long pos = ftell(stream);
+	bool found = fread(magic, sizeof(magic), 1, stream) == 1
+		&& magic[0] == 0x1f && magic[1] == 0x8b;
+	fseek(stream, pos, SEEK_SET);
+	return found;
+}
+
+} // end-of-namespace: fail
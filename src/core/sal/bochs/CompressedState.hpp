@@ -0,0 +1,24 @@
+#ifndef __BOCHS_COMPRESSED_STATE_HPP__
+#define __BOCHS_COMPRESSED_STATE_HPP__
+
+#include <stdio.h>
+
+namespace fail {
+
+/**
+ * gzip-compressed binary blobs of a Bochs save state (see CompressState.ah).
+ * Each call reads or writes one complete gzip stream at the current position
+ * of \a stream; the return values are those of fread()/fwrite().
+ */
+size_t fread_compressed(void *ptr, size_t size, size_t nmemb, FILE *stream);
+size_t fwrite_compressed(const void *ptr, size_t size, size_t nmemb, FILE *stream);
+
+/**
+ * Does a gzip stream start at the current position of \a stream?  The
+ * position is left unchanged.
+ */
+bool is_compressed(FILE *stream);
+
+} // end-of-namespace: fail
+
+#endif // __BOCHS_COMPRESSED_STATE_HPP__
@@ -1,9 +1,14 @@
 #include <sstream>
+#include <fstream>
+#include <vector>
+#include <string.h>
 
 #include "PandaController.hpp"
 #include "PandaMemory.hpp"
 #include "../SALInst.hpp"
 #include "../Listener.hpp"
+#include "../arm/ArmArchitecture.hpp"
+#include "util/ElfReader.hpp"
 
 
 #include "openocd_wrapper.hpp"
@@ -12,10 +17,6 @@
 	#error Firing interrupts not implemented for Pandaboard
 #endif
 
-#if defined(CONFIG_SR_RESTORE) || defined(CONFIG_SR_SAVE)
-	#error Save/Restore is not yet implemented for Pandaboard
-#endif
-
 #if defined(CONFIG_EVENT_IOPORT)
 	#error IoPort events not implemented for pandaboard
 #endif
@@ -54,17 +55,109 @@ void PandaController::onTimerTrigger(void* thisPtr)
 	simulator.m_LstList.triggerActiveListeners();
 }
 
+/*
+ * Snapshot layout: MAGIC, the number of registers followed by (id, value)
+ * pairs, then the number of memory ranges followed by (address, size, data)
+ */
+static const char SNAPSHOT_MAGIC[8] = { 'F', 'A', 'I', 'L', 'P', 'N', 'D', '1' };
+
+// core registers of all modes, see oocdw_read_reg()
+static const uint32_t snapshot_registers[] = {
+	RI_R8_FIQ, RI_R9_FIQ, RI_R10_FIQ, RI_R11_FIQ, RI_R12_FIQ, RI_SP_FIQ, RI_LR_FIQ,
+	RI_SP_IRQ, RI_LR_IRQ, RI_SP_SVC, RI_LR_SVC, RI_SP_ABT, RI_LR_ABT,
+	RI_SP_UND, RI_LR_UND, RI_SP_MON, RI_LR_MON,
+	RI_SPSR_FIQ, RI_SPSR_IRQ, RI_SPSR_SVC, RI_SPSR_ABT, RI_SPSR_UND, RI_SPSR_MON,
+	RI_CPSR,
+	RI_R0, RI_R1, RI_R2, RI_R3, RI_R4, RI_R5, RI_R6, RI_R7,
+	RI_R8, RI_R9, RI_R10, RI_R11, RI_R12, RI_R13, RI_R14, RI_R15
+};
+
 bool PandaController::save(const std::string& path)
 {
-	// TODO
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out) {
+		m_log << "cannot create snapshot " << path << std::endl;
+		return false;
+	}
+	out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+
+	uint32_t count = sizeof(snapshot_registers) / sizeof(*snapshot_registers);
+	out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t value;
+		oocdw_read_reg(snapshot_registers[i], &value);
+		out.write(reinterpret_cast<const char *>(&snapshot_registers[i]), sizeof(uint32_t));
+		out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
 
-	return true;
+	// all memory the program may have written: its writable segments
+	// (including .bss and, for bare-metal programs, the stacks)
+	ElfReader elf;
+	std::vector<ElfSegment> ranges;
+	for (ElfReader::segment_iterator it = elf.seg_begin(); it != elf.seg_end(); ++it) {
+		if (it->isWriteable() && it->getSize() > 0) {
+			ranges.push_back(*it);
+		}
+	}
+	count = ranges.size();
+	out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+	std::vector<char> buf;
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		uint32_t addr = ranges[i].getStart(), size = ranges[i].getSize();
+		buf.resize(size);
+		m_Mem->getBytes(addr, size, &buf[0]);
+		out.write(reinterpret_cast<const char *>(&addr), sizeof(addr));
+		out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+		out.write(&buf[0], size);
+	}
+	out.close();
+	return !out.fail();
 }
 
 void PandaController::restore(const std::string& path)
 {
 	clearListeners();
-	// TODO
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	char magic[sizeof(SNAPSHOT_MAGIC)];
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+		m_log << "FATAL ERROR: " << path << " is no snapshot saved by PandaController::save()" << std::endl;
+		terminate(1);
+	}
+
+	// Snapshots do not include coprocessor and peripheral state: start from
+	// the state right before main (see oocdw_reboot()), where the golden
+	// run's snapshots were taken relative to, and overwrite registers and
+	// RAM
+	oocdw_reboot();
+
+	uint32_t count, id, value;
+	std::vector<std::pair<uint32_t, uint32_t> > regs;
+	in.read(reinterpret_cast<char *>(&count), sizeof(count));
+	for (uint32_t i = 0; in && i < count; ++i) {
+		in.read(reinterpret_cast<char *>(&id), sizeof(id));
+		in.read(reinterpret_cast<char *>(&value), sizeof(value));
+		regs.push_back(std::make_pair(id, value));
+	}
+	std::vector<char> buf;
+	in.read(reinterpret_cast<char *>(&count), sizeof(count));
+	for (uint32_t i = 0; in && i < count; ++i) {
+		uint32_t addr, size;
+		in.read(reinterpret_cast<char *>(&addr), sizeof(addr));
+		in.read(reinterpret_cast<char *>(&size), sizeof(size));
+		buf.resize(size);
+		if (size > 0 && in.read(&buf[0], size)) {
+			m_Mem->setBytes(addr, size, &buf[0]);
+		}
+	}
+	if (!in) {
+		m_log << "FATAL ERROR: snapshot " << path << " is truncated" << std::endl;
+		terminate(1);
+	}
+	// CPSR before the current mode's R0-R15 (see snapshot_registers)
+	for (size_t i = 0; i < regs.size(); ++i) {
+		oocdw_write_reg(regs[i].first, regs[i].second);
+	}
 }
 
 void PandaController::reboot()
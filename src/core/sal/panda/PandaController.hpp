@@ -44,13 +44,18 @@ public:
 	 * Simulator Controller & Access API:
 	 * ********************************************************************/
 	/**
-	 * Save simulator state.
+	 * Save the board's state: the core registers of all modes and the
+	 * memory of the ELF's writable segments.
 	 * @param path Location to store state information
 	 * @return \c true if the state has been successfully saved, \c false otherwise
 	 */
 	bool save(const std::string& path);
 	/**
-	 * Restore simulator state. Clears all Listeners.
+	 * Restore the board's state. Clears all Listeners, reboots the board to
+	 * the instruction before main (see oocdw_reboot()) and loads the saved
+	 * registers and memory.  Coprocessor and peripheral state remain as
+	 * after the reboot, so this only reproduces snapshots of runs that
+	 * started the same way, e.g., the golden run from main on.
 	 * @param path Location to previously saved state information
 	 */
 	void restore(const std::string& path);
@@ -29,7 +29,11 @@ public:
 	 * Restore simulator state. Clears all Listeners.  TODO.
 	 * @param path Location to previously saved state information
 	 */
-	void restore(const std::string& path) {}
+	void restore(const std::string& path)
+	{
+		m_log << "FATAL ERROR: restoring " << path << ": save/restore not implemented for T32" << std::endl;
+		terminate(1);
+	}
 	/**
 	 * Reboot simulator. Clears all Listeners.  TODO.
 	 */
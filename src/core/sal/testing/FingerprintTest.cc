@@ -0,0 +1,96 @@
+#include "sal/Memory.hpp"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+using namespace fail;
+using std::cerr;
+using std::endl;
+
+void test_failed(std::string msg)
+{
+	cerr << "Fingerprint test failed (" << msg << ")!" << endl;
+	abort();
+}
+
+// memory pool in a vector, optionally reporting writes via markDirty()
+class VectorMemory : public MemoryManager {
+	std::vector<byte_t> m_mem;
+public:
+	VectorMemory(size_t size, bool tracking) : m_mem(size, 0) { setDirtyTracking(tracking); }
+	size_t getPoolSize() const { return m_mem.size(); }
+	host_address_t getStartAddr() const { return 0; }
+	byte_t getByte(guest_address_t addr) { return m_mem[addr]; }
+	void getBytes(guest_address_t addr, size_t cnt, void *dest) { memcpy(dest, &m_mem[addr], cnt); }
+	void setByte(guest_address_t addr, byte_t data) { setBytes(addr, 1, &data); }
+	void setBytes(guest_address_t addr, size_t cnt, void const *src)
+	{
+		memcpy(&m_mem[addr], src, cnt);
+		markDirty(addr, cnt);
+	}
+};
+
+int main()
+{
+	// 37.5 pages: the last one is padded with zeroes
+	const size_t size = 37 * MemoryManager::FINGERPRINT_PAGE_SIZE + 2048;
+	VectorMemory mem(size, true), full(size, false);
+	for (guest_address_t addr = 0; addr < size; addr += 997) {
+		mem.setByte(addr, addr * 7);
+		full.setByte(addr, addr * 7);
+	}
+
+	uint64_t fp = mem.fingerprint();
+	if (mem.getPageCount() != 38) {
+		test_failed("page count");
+	}
+	if (full.fingerprint() != fp) {
+		test_failed("incremental and full rehash differ");
+	}
+	if (mem.fingerprint() != fp || mem.getRehashedPages() != 0) {
+		test_failed("unmodified memory rehashed or changed");
+	}
+
+	// a single modified byte rehashes only its page
+	mem.setByte(size - 1, 0x42);
+	uint64_t fp2 = mem.fingerprint();
+	if (fp2 == fp || mem.getRehashedPages() != 1) {
+		test_failed("modified byte");
+	}
+	full.setByte(size - 1, 0x42);
+	if (full.fingerprint() != fp2 || full.getRehashedPages() != 38) {
+		test_failed("modified byte, full rehash");
+	}
+	mem.setByte(size - 1, 0);
+	if (mem.fingerprint() != fp) {
+		test_failed("restored byte");
+	}
+
+	// a write across a page boundary marks both pages
+	byte_t data[2] = { 1, 2 };
+	mem.setBytes(MemoryManager::FINGERPRINT_PAGE_SIZE - 1, 2, data);
+	mem.fingerprint();
+	if (mem.getRehashedPages() != 2) {
+		test_failed("write across a page boundary");
+	}
+
+	// swapped page contents are a different state
+	VectorMemory a(2 * MemoryManager::FINGERPRINT_PAGE_SIZE, true);
+	VectorMemory b(2 * MemoryManager::FINGERPRINT_PAGE_SIZE, true);
+	a.setByte(0, 1);
+	b.setByte(MemoryManager::FINGERPRINT_PAGE_SIZE, 1);
+	if (a.fingerprint() == b.fingerprint()) {
+		test_failed("swapped pages");
+	}
+
+	// markAllDirty() (e.g., after a restore) rehashes everything
+	mem.markAllDirty();
+	mem.fingerprint();
+	if (mem.getRehashedPages() != 38) {
+		test_failed("markAllDirty");
+	}
+
+	cerr << "Fingerprint test succeeded." << endl;
+	return 0;
+}
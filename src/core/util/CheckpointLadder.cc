@@ -0,0 +1,75 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cassert>
+
+#include "CheckpointLadder.hpp"
+
+namespace fail {
+
+std::string CheckpointLadder::path(uint64_t instr) const
+{
+	std::stringstream ss;
+	ss << m_dir << "/" << instr;
+	return ss.str();
+}
+
+void CheckpointLadder::add(uint64_t instr, uint64_t serial_length)
+{
+	assert((m_checkpoints.empty() || m_checkpoints.back().instr < instr)
+		&& "checkpoints must be added in ascending order");
+	Checkpoint c;
+	c.instr = instr;
+	c.serial_length = serial_length;
+	m_checkpoints.push_back(c);
+}
+
+bool CheckpointLadder::save() const
+{
+	std::ofstream os((m_dir + "/index").c_str());
+	if (!os.is_open()) {
+		return false;
+	}
+	for (std::vector<Checkpoint>::const_iterator it = m_checkpoints.begin();
+		 it != m_checkpoints.end(); ++it) {
+		os << it->instr << " " << it->serial_length << "\n";
+	}
+	return !os.fail();
+}
+
+bool CheckpointLadder::load()
+{
+	std::ifstream is((m_dir + "/index").c_str());
+	if (!is.is_open()) {
+		return false;
+	}
+	m_checkpoints.clear();
+	Checkpoint c;
+	while (is >> c.instr >> c.serial_length) {
+		if (!m_checkpoints.empty() && m_checkpoints.back().instr >= c.instr) {
+			return false;
+		}
+		m_checkpoints.push_back(c);
+	}
+	return is.eof();
+}
+
+static bool instr_before(uint64_t instr, const CheckpointLadder::Checkpoint& c)
+{
+	return instr < c.instr;
+}
+
+const CheckpointLadder::Checkpoint *CheckpointLadder::preceding(uint64_t instr) const
+{
+	std::vector<Checkpoint>::const_iterator it =
+		std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), instr, instr_before);
+	return it == m_checkpoints.begin() ? 0 : &*(it - 1);
+}
+
+const CheckpointLadder::Checkpoint *CheckpointLadder::find(uint64_t instr) const
+{
+	const Checkpoint *c = preceding(instr);
+	return c && c->instr == instr ? c : 0;
+}
+
+} // end-of-namespace: fail
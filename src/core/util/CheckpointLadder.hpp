@@ -0,0 +1,65 @@
+#ifndef __CHECKPOINT_LADDER_HPP__
+#define __CHECKPOINT_LADDER_HPP__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace fail {
+
+/**
+ * \class CheckpointLadder
+ *
+ * A set of simulator snapshots taken during the golden run (see
+ * generic-tracing --checkpoint-dir), so an experiment can restore the
+ * nearest snapshot preceding its injection point instead of the start state,
+ * and only needs to fast-forward the remainder.
+ *
+ * The snapshots live in subdirectories of one directory, named by their
+ * dynamic instruction count since the start state (the unit of
+ * DatabaseCampaignMessage::injection_instr).  The file "index" in this
+ * directory lists them, one "instr serial_length" line per checkpoint, where
+ * serial_length is the amount of serial output the golden run produced up
+ * to the checkpoint.
+ */
+class CheckpointLadder {
+public:
+	struct Checkpoint {
+		uint64_t instr;          //!< dynamic instruction count
+		uint64_t serial_length;  //!< serial output produced up to here
+	};
+
+private:
+	std::string m_dir;
+	std::vector<Checkpoint> m_checkpoints; //!< ascending instr
+
+public:
+	CheckpointLadder(const std::string& dir = "") : m_dir(dir) { }
+
+	void setDirectory(const std::string& dir) { m_dir = dir; }
+	const std::string& getDirectory() const { return m_dir; }
+
+	//! Path of the snapshot taken at instruction count \a instr
+	std::string path(uint64_t instr) const;
+
+	//! Appends a checkpoint; must be called with ascending instruction counts.
+	void add(uint64_t instr, uint64_t serial_length = 0);
+
+	//! Writes the index file.
+	bool save() const;
+
+	//! Reads the index file written by save().
+	bool load();
+
+	//! The last checkpoint at or before instruction count \a instr (0 if none).
+	const Checkpoint *preceding(uint64_t instr) const;
+
+	//! The checkpoint at instruction count \a instr (0 if none).
+	const Checkpoint *find(uint64_t instr) const;
+
+	size_t size() const { return m_checkpoints.size(); }
+};
+
+} // end-of-namespace: fail
+
+#endif // __CHECKPOINT_LADDER_HPP__
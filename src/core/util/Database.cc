@@ -1,7 +1,13 @@
 #include <sstream>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <ctype.h>
 #include "Database.hpp"
 #include "util/CommandLine.hpp"
+#ifdef BUILD_SQLITE_DATABASE
+#include <sqlite3.h>
+#endif
 #include "util/Logger.hpp"
 
 static fail::Logger LOG("Database", true);
@@ -12,14 +18,25 @@ using namespace fail;
 boost::mutex Database::m_global_lock;
 #endif
 
-static CommandLine::option_handle DATABASE, HOSTNAME, USERNAME, DBDEFAULTS;
+static CommandLine::option_handle DATABASE, HOSTNAME, USERNAME, DBDEFAULTS, BULKLOAD;
+#ifdef BUILD_SQLITE_DATABASE
+static CommandLine::option_handle DBFILE;
+#endif
+
+// flush bulk-load buffer when it exceeds this many bytes
+static const size_t BULKLOAD_BUFSIZE = 16 * 1024 * 1024;
 
-Database::Database(const std::string &username, const std::string &host, const std::string &database) {
+Database::Database(const std::string &username, const std::string &host, const std::string &database)
+	: m_bulkload(false)
+{
 #ifndef __puma
 	boost::lock_guard<boost::mutex> guard(m_global_lock);
 #endif
 	CommandLine &cmd = CommandLine::Inst();
 
+#ifdef BUILD_SQLITE_DATABASE
+	m_sqlite = 0;
+#endif
 	std::string db_conf_file = std::string(getenv("HOME")) + "/.my.cnf";
 	if (cmd[DBDEFAULTS].count()) {
 		db_conf_file = cmd[DBDEFAULTS].first()->arg;
@@ -27,6 +44,12 @@ Database::Database(const std::string &username, const std::string &host, const s
 	handle = mysql_init(0);
 	last_result = 0;
 	mysql_options(handle, MYSQL_READ_DEFAULT_FILE, db_conf_file.c_str());
+	if (cmd[BULKLOAD].count()) {
+		// LOAD DATA LOCAL INFILE must be allowed before connecting
+		unsigned int local_infile = 1;
+		mysql_options(handle, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+		m_bulkload = true;
+	}
 	if (!mysql_real_connect(handle, host.c_str(),
 							username.c_str(),
 							0, database.c_str(), 0, 0, 0)) {
@@ -41,17 +64,68 @@ Database::~Database()
 	// flush cached INSERTs if available
 	insert_multiple();
 
+	delete last_result;
+
 #ifndef __puma
 	boost::lock_guard<boost::mutex> guard(m_global_lock);
+#endif
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		sqlite3_close(m_sqlite);
+		return;
+	}
 #endif
 	mysql_close(handle);
 }
 
-MYSQL_RES* Database::query(char const *query, bool get_result) {
+bool Database::is_sqlite() const
+{
+#ifdef BUILD_SQLITE_DATABASE
+	return m_sqlite != 0;
+#else
+	return false;
+#endif
+}
+
+Database::Result::Result()
+	: res(0)
+#ifdef BUILD_SQLITE_DATABASE
+	, stmt(0), columns(0), next(0)
+#endif
+{
+}
+
+Database::Result::~Result()
+{
+	if (res) {
+		mysql_free_result(res);
+	}
+#ifdef BUILD_SQLITE_DATABASE
+	if (stmt) {
+		sqlite3_finalize(stmt);
+	}
+	for (std::vector<char *>::iterator it = cells.begin(); it != cells.end(); ++it) {
+		free(*it);
+	}
+#endif
+}
+
+Database::Result* Database::query(char const *query, bool get_result) {
 #ifndef __puma
 	boost::lock_guard<boost::mutex> guard(m_handle_lock);
 #endif
 
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		Result *res = sqlite_query(query, get_result, false);
+		if (get_result && res) {
+			delete last_result;
+			last_result = res;
+		}
+		return res;
+	}
+#endif
+
 	if (mysql_query(handle, query)) {
 		std::cerr << "query '" << query << "' failed: " << mysql_error(handle) << std::endl;
 		return 0;
@@ -59,26 +133,35 @@ MYSQL_RES* Database::query(char const *query, bool get_result) {
 
 	if (get_result) {
 		if (last_result != 0) {
-			mysql_free_result(last_result);
+			delete last_result;
 			last_result = 0;
 		}
 		MYSQL_RES *res = mysql_store_result(handle);
 		if (!res && mysql_errno(handle)) {
 			std::cerr << "mysql_store_result for query '" << query << "' failed: " << mysql_error(handle) << std::endl;
 			return 0;
+		} else if (!res) {
+			return 0;
 		}
-		last_result = res;
-		return res;
+		last_result = new Result;
+		last_result->res = res;
+		return last_result;
 	}
-	return (MYSQL_RES *) 1; // Invalid PTR!!!
+	return (Result *) 1; // Invalid PTR!!!
 }
 
-MYSQL_RES* Database::query_stream(char const *query)
+Database::Result* Database::query_stream(char const *query)
 {
 #ifndef __puma
 	boost::lock_guard<boost::mutex> guard(m_handle_lock);
 #endif
 
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		return sqlite_query(query, true, true);
+	}
+#endif
+
 	if (mysql_query(handle, query)) {
 		std::cerr << "query '" << query << "' failed: " << mysql_error(handle) << std::endl;
 		return 0;
@@ -88,15 +171,290 @@ MYSQL_RES* Database::query_stream(char const *query)
 	if (!res && mysql_errno(handle)) {
 		std::cerr << "mysql_use_result for query '" << query << "' failed: " << mysql_error(handle) << std::endl;
 		return 0;
+	} else if (!res) {
+		return 0;
+	}
+
+	Result *result = new Result;
+	result->res = res;
+	return result;
+}
+
+MYSQL_ROW Database::fetch_row(Result *res)
+{
+#ifdef BUILD_SQLITE_DATABASE
+	if (!res->res) {
+		if (res->stmt && !sqlite_fetch(res)) {
+			return 0;
+		} else if (res->stmt) {
+			return &res->cells[0];
+		} else if (res->columns == 0 || res->next * res->columns >= res->cells.size()) {
+			return 0;
+		}
+		return &res->cells[res->next++ * res->columns];
+	}
+#endif
+	return mysql_fetch_row(res->res);
+}
+
+my_ulonglong Database::num_rows(Result *res)
+{
+#ifdef BUILD_SQLITE_DATABASE
+	if (!res->res) {
+		return res->columns ? res->cells.size() / res->columns : 0;
+	}
+#endif
+	return mysql_num_rows(res->res);
+}
+
+void Database::free_result(Result *res)
+{
+	delete res;
+}
+
+std::string Database::error()
+{
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		return m_sqlite_error;
+	}
+#endif
+	return mysql_error(handle);
+}
+
+Database::Statement* Database::prepare(const std::string &sql)
+{
+#ifndef __puma
+	boost::lock_guard<boost::mutex> guard(m_handle_lock);
+#endif
+
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		return sqlite_prepare(sql);
+	}
+#endif
+
+	Statement *stmt = new Statement;
+	stmt->sql = sql;
+	stmt->stmt = mysql_stmt_init(handle);
+	if (mysql_stmt_prepare(stmt->stmt, sql.c_str(), sql.length())) {
+		LOG << "query '" << sql << "' failed: " << mysql_error(handle) << std::endl;
+		close_statement(stmt);
+		return 0;
+	}
+	return stmt;
+}
+
+bool Database::execute(Statement *stmt, MYSQL_BIND *bind)
+{
+#ifndef __puma
+	boost::lock_guard<boost::mutex> guard(m_handle_lock);
+#endif
+
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		return sqlite_execute(stmt, bind);
+	}
+#endif
+
+	if (mysql_stmt_bind_param(stmt->stmt, bind)) {
+		LOG << "mysql_stmt_bind_param() failed: " << mysql_stmt_error(stmt->stmt) << std::endl;
+		return false;
+	}
+	if (mysql_stmt_execute(stmt->stmt)) {
+		LOG << "mysql_stmt_execute() failed: " << mysql_stmt_error(stmt->stmt) << std::endl;
+		return false;
 	}
+	return true;
+}
+
+void Database::close_statement(Statement *stmt)
+{
+	if (stmt->stmt) {
+		mysql_stmt_close(stmt->stmt);
+	}
+#ifdef BUILD_SQLITE_DATABASE
+	if (stmt->sqlite_stmt) {
+		sqlite3_finalize(stmt->sqlite_stmt);
+	}
+#endif
+	delete stmt;
+}
 
-	return res;
+/**
+ * Translates the head of a multi-value INSERT ("INSERT [IGNORE] INTO t (a, b)
+ * VALUES " or "REPLACE INTO ...") into an equivalent LOAD DATA LOCAL INFILE
+ * statement.  Returns an empty string for anything it does not understand.
+ */
+static std::string bulkload_statement(const std::string& insertquery)
+{
+	std::string modifier;
+	size_t pos;
+	if (insertquery.compare(0, 19, "INSERT IGNORE INTO ") == 0) {
+		modifier = "IGNORE ";
+		pos = 19;
+	} else if (insertquery.compare(0, 12, "INSERT INTO ") == 0) {
+		pos = 12;
+	} else if (insertquery.compare(0, 13, "REPLACE INTO ") == 0) {
+		modifier = "REPLACE ";
+		pos = 13;
+	} else {
+		return "";
+	}
+
+	size_t open = insertquery.find('(', pos);
+	size_t close = insertquery.find(')', pos);
+	if (open == std::string::npos || close == std::string::npos || close < open
+		|| insertquery.find("VALUES", close) == std::string::npos) {
+		return "";
+	}
+	std::string table = insertquery.substr(pos, open - pos);
+	table.erase(table.find_last_not_of(' ') + 1);
+
+	return "LOAD DATA LOCAL INFILE 'fail-bulkload' " + modifier + "INTO TABLE "
+		+ table + " " + insertquery.substr(open, close - open + 1);
+}
+
+/**
+ * Converts a single SQL value tuple, e.g. "(1,NULL,'it''s')", into a row in
+ * LOAD DATA INFILE's default text format (tab-separated fields, "\N" for
+ * NULL, newline-terminated) and appends it to rows.  Backslash escapes from
+ * mysql_real_escape_string() have the same meaning in both formats and are
+ * copied verbatim.  Unquoted values must be plain numbers or NULL; anything
+ * else (e.g., a function call like NOW()) is rejected and rows is left
+ * unchanged.
+ */
+static bool bulkload_convert(const char *values, std::string& rows)
+{
+	std::string row;
+	const char *p = values;
+	while (isspace(*p)) ++p;
+	if (*p++ != '(') {
+		return false;
+	}
+
+	for (bool first = true; ; first = false) {
+		while (isspace(*p)) ++p;
+		if (!first) {
+			row += '\t';
+		}
+		if (*p == '\'') {
+			// quoted string
+			for (++p; ; ++p) {
+				if (!*p) {
+					return false;
+				} else if (*p == '\\') {
+					if (!p[1]) {
+						return false;
+					}
+					row += *p++;
+					row += *p;
+				} else if (*p == '\'' && p[1] == '\'') {
+					row += *p++;
+				} else if (*p == '\'') {
+					++p;
+					break;
+				} else if (*p == '\t') {
+					row += "\\t";
+				} else if (*p == '\n') {
+					row += "\\n";
+				} else {
+					row += *p;
+				}
+			}
+		} else {
+			// number or NULL
+			const char *start = p;
+			while (*p && *p != ',' && *p != ')') ++p;
+			const char *end = p;
+			while (end > start && isspace(end[-1])) --end;
+			if (end == start) {
+				return false;
+			} else if (end - start == 4 && strncasecmp(start, "NULL", 4) == 0) {
+				row += "\\N";
+			} else if (strspn(start, "0123456789+-.eE") >= (size_t) (end - start)) {
+				row.append(start, end - start);
+			} else {
+				return false; // an expression, LOAD DATA would store it as text
+			}
+		}
+		while (isspace(*p)) ++p;
+		if (*p == ')') {
+			break;
+		} else if (*p++ != ',') {
+			return false;
+		}
+	}
+
+	row += '\n';
+	rows += row;
+	return true;
+}
+
+// mysql_set_local_infile_handler() callbacks reading from a std::string
+struct BulkLoadSource {
+	const std::string *data;
+	size_t pos;
+};
+
+static int bulkload_infile_init(void **ptr, const char *, void *userdata)
+{
+	*ptr = userdata;
+	return 0;
+}
+
+static int bulkload_infile_read(void *ptr, char *buf, unsigned int buf_len)
+{
+	BulkLoadSource *src = (BulkLoadSource *) ptr;
+	size_t len = std::min<size_t>(buf_len, src->data->size() - src->pos);
+	memcpy(buf, src->data->data() + src->pos, len);
+	src->pos += len;
+	return len;
+}
+
+static void bulkload_infile_end(void *)
+{
+}
+
+static int bulkload_infile_error(void *, char *error_msg, unsigned int error_msg_len)
+{
+	strncpy(error_msg, "bulk-load buffer error", error_msg_len);
+	return 1;
+}
+
+bool Database::bulkload_flush()
+{
+	if (m_bulkload_rows.size() == 0) {
+		return true;
+	}
+
+	BulkLoadSource src = { &m_bulkload_rows, 0 };
+	mysql_set_local_infile_handler(handle, bulkload_infile_init,
+		bulkload_infile_read, bulkload_infile_end, bulkload_infile_error, &src);
+	bool ret = query(m_bulkload_stmt.c_str());
+	mysql_set_local_infile_default(handle);
+	m_bulkload_rows.clear();
+
+	// LOAD DATA LOCAL turns errors (e.g., duplicate keys) into warnings and
+	// skips the row; only INSERT IGNORE asked for that
+	unsigned warnings = ret ? mysql_warning_count(handle) : 0;
+	if (warnings > 0 && m_bulkload_stmt.find(" IGNORE INTO ") == std::string::npos) {
+		LOG << "bulk load: " << warnings << " warning(s), rows may have been dropped" << std::endl;
+		Result *res = query("SHOW WARNINGS LIMIT 1", true);
+		MYSQL_ROW row;
+		if (res && (row = fetch_row(res)) && row[2]) {
+			LOG << "first: " << row[2] << std::endl;
+		}
+		return false;
+	}
+	return ret;
 }
 
 bool Database::insert_multiple(char const *insertquery, char const *values)
 {
 	// different insertquery, but still cached values?
-	if (insertquery && m_insertquery != insertquery && m_insertquery_values.size() > 0) {
+	if (insertquery && m_insertquery != insertquery
+		&& (m_insertquery_values.size() > 0 || m_bulkload_rows.size() > 0)) {
 		// flush cache
 		insert_multiple();
 	} else if (!insertquery && m_insertquery.size() == 0) {
@@ -104,8 +462,24 @@ bool Database::insert_multiple(char const *insertquery, char const *values)
 		return false;
 	}
 
-	if (insertquery) {
+	if (insertquery && m_insertquery != insertquery) {
 		m_insertquery = insertquery;
+		m_bulkload_stmt = m_bulkload ? bulkload_statement(m_insertquery) : "";
+		if (m_bulkload && m_bulkload_stmt.size() == 0) {
+			LOG << "cannot bulk-load '" << m_insertquery << "', falling back to INSERT" << std::endl;
+		}
+	}
+
+	if (m_bulkload_stmt.size() > 0) {
+		if (values && !bulkload_convert(values, m_bulkload_rows)) {
+			// not convertible, INSERT this single tuple the classic way
+			std::string sql = m_insertquery + values;
+			return bulkload_flush() && query(sql.c_str());
+		}
+		if ((!values && m_bulkload_rows.size() > 0) || m_bulkload_rows.size() >= BULKLOAD_BUFSIZE) {
+			return bulkload_flush();
+		}
+		return true;
 	}
 
 	if (values) {
@@ -131,13 +505,49 @@ bool Database::insert_multiple(char const *insertquery, char const *values)
 	return true;
 }
 
+bool Database::set_bulkload(bool enabled)
+{
+	// flush cached tuples, they belong to the old mode
+	bool ret = insert_multiple();
+	if (enabled && is_sqlite()) {
+		LOG << "bulk loading is not available for SQLite databases" << std::endl;
+		enabled = false;
+	}
+	m_bulkload = enabled;
+	m_bulkload_stmt = m_bulkload ? bulkload_statement(m_insertquery) : "";
+	return ret || m_insertquery.size() == 0;
+}
+
+bool Database::disable_keys(const std::string &table)
+{
+	std::string sql = "ALTER TABLE " + table + " DISABLE KEYS";
+	return query(sql.c_str());
+}
+
+bool Database::enable_keys(const std::string &table)
+{
+	LOG << "rebuilding indexes of table " << table << " ..." << std::endl;
+	std::string sql = "ALTER TABLE " + table + " ENABLE KEYS";
+	return query(sql.c_str());
+}
+
 my_ulonglong Database::affected_rows()
 {
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		return sqlite3_changes(m_sqlite);
+	}
+#endif
 	return mysql_affected_rows(handle);
 }
 
 my_ulonglong Database::insert_id()
 {
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		return sqlite3_last_insert_rowid(m_sqlite);
+	}
+#endif
 	return mysql_insert_id(handle);
 }
 
@@ -204,13 +614,13 @@ std::vector<Database::Variant> Database::get_variants(
 	// dummy terminator to avoid special cases in query construction above
 	ss << "0)";
 
-	MYSQL_RES *variant_id_res = query(ss.str().c_str(), true);
+	Result *variant_id_res = query(ss.str().c_str(), true);
 	if (!variant_id_res) {
 		return result;
 	}
 
 	MYSQL_ROW row;
-	while ((row = mysql_fetch_row(variant_id_res))) {
+	while ((row = fetch_row(variant_id_res))) {
 		Variant var;
 		var.id = atoi(row[0]);
 		var.variant = row[1];
@@ -231,7 +641,7 @@ int Database::get_variant_id(const std::string &variant, const std::string &benc
 		if (!query(ss.str().c_str())) {
 			return 0;
 		}
-		return mysql_insert_id(handle);
+		return insert_id();
 	} else if (variants.size() == 1) {
 		return variants[0].id;
 	} else {
@@ -251,14 +661,14 @@ int Database::get_fspmethod_id(const std::string &method)
 
 	std::stringstream ss;
 	ss << "SELECT id FROM fspmethod WHERE method = '" << method << "'";
-	MYSQL_RES *res = query(ss.str().c_str(), true);
+	Result *res = query(ss.str().c_str(), true);
 
 	int id;
 
 	if (!res) {
 		return 0;
-	} else if (mysql_num_rows(res)) {
-		MYSQL_ROW row = mysql_fetch_row(res);
+	} else if (num_rows(res)) {
+		MYSQL_ROW row = fetch_row(res);
 		id = atoi(row[0]);
 	} else {
 		ss.str("");
@@ -266,7 +676,7 @@ int Database::get_fspmethod_id(const std::string &method)
 		if (!query(ss.str().c_str())) {
 			return 0;
 		}
-		id = mysql_insert_id(handle);
+		id = insert_id();
 	}
 
 	return id;
@@ -274,6 +684,21 @@ int Database::get_fspmethod_id(const std::string &method)
 
 std::string Database::escape_string(const std::string unescaped_string) {
 
+#ifdef BUILD_SQLITE_DATABASE
+	if (m_sqlite) {
+		// SQLite only knows doubled single quotes, no backslash escapes
+		std::string result;
+		for (std::string::const_iterator it = unescaped_string.begin();
+		     it != unescaped_string.end(); ++it) {
+			if (*it == '\'') {
+				result += '\'';
+			}
+			result += *it;
+		}
+		return result;
+	}
+#endif
+
 	char *temp = new char[(unescaped_string.size() * 2) + 1];
 
 	mysql_real_escape_string(handle, temp, unescaped_string.c_str(), unescaped_string.size());
@@ -295,7 +720,13 @@ void Database::cmdline_setup() {
 	USERNAME	  = cmd.addOption("u", "username", Arg::Required,
 								  "-u/--username \tMYSQL Username (default: taken from ~/.my.cnf, or your current user)");
 	DBDEFAULTS	  = cmd.addOption("", "database-option-file", Arg::Required,
-								  "--database-option-file \toverride MySQL ~/.my.cnf option file (prepend with './' for files in the CWD)\n");
+								  "--database-option-file \toverride MySQL ~/.my.cnf option file (prepend with './' for files in the CWD)");
+	BULKLOAD	  = cmd.addOption("", "bulk-load", Arg::None,
+								  "--bulk-load \tstream bulk INSERTs with LOAD DATA LOCAL INFILE (server must permit local_infile)\n");
+#ifdef BUILD_SQLITE_DATABASE
+	DBFILE		  = cmd.addOption("", "database-file", Arg::Required,
+								  "--database-file \tuse an embedded SQLite database file instead of a MySQL server");
+#endif
 
 	// should be called before any threads are spawned
 	mysql_library_init(0, NULL, NULL);
@@ -306,6 +737,12 @@ Database * Database::cmdline_connect() {
 
 	CommandLine &cmd = CommandLine::Inst();
 
+#ifdef BUILD_SQLITE_DATABASE
+	if (cmd[DBFILE].count() > 0) {
+		return new Database(std::string(cmd[DBFILE].first()->arg));
+	}
+#endif
+
 	if (cmd[USERNAME].count() > 0)
 		username = std::string(cmd[USERNAME].first()->arg);
 	else
@@ -9,6 +9,13 @@
 #include <mysql.h>
 #include <iostream>
 #include <string>
+#include "config/VariantConfig.hpp"
+
+#ifdef BUILD_SQLITE_DATABASE
+// from <sqlite3.h>, only needed in DatabaseSQLite.cc
+struct sqlite3;
+struct sqlite3_stmt;
+#endif
 
 namespace fail {
 
@@ -17,24 +24,83 @@ namespace fail {
 	 * Database abstraction layer that handles the database connection
 	 * parameters, the database connection and provides different
 	 * database access methods
+	 *
+	 * Besides a MySQL server connection, an embedded SQLite database file
+	 * can be used as storage backend (if FAIL* is built with
+	 * BUILD_SQLITE_DATABASE).  The SQLite backend translates the MySQL
+	 * dialect used throughout FAIL* on the fly.  Users of this class must
+	 * therefore not use the mysql_* API on results or the raw handle, but
+	 * the backend-independent methods fetch_row(), num_rows(), prepare()
+	 * etc.
 	 */
 	class Database {
+	public:
+		/**
+		 * Result set of query() or query_stream()
+		 */
+		struct Result {
+			MYSQL_RES *res; // !< MySQL result (0 for SQLite)
+#ifdef BUILD_SQLITE_DATABASE
+			sqlite3_stmt *stmt; // !< unfinished statement of a streamed result
+			unsigned columns;
+			std::vector<char *> cells; // !< all rows (stored) or the current row (streamed)
+			size_t next; // !< next row to return from a stored result
+#endif
+			Result();
+			~Result();
+		};
+		/**
+		 * Prepared statement, see prepare()
+		 */
+		struct Statement {
+			MYSQL_STMT *stmt;
+#ifdef BUILD_SQLITE_DATABASE
+			sqlite3_stmt *sqlite_stmt;
+#endif
+			std::string sql;
+			Statement() : stmt(0)
+#ifdef BUILD_SQLITE_DATABASE
+				, sqlite_stmt(0)
+#endif
+			{}
+		};
+
+	private:
 		MYSQL *handle; // !< The MySQL Database handle
-		MYSQL_RES *last_result; // !< Used for mysql_result_free
+#ifdef BUILD_SQLITE_DATABASE
+		sqlite3 *m_sqlite; // !< The SQLite database handle (0 for MySQL)
+		std::string m_sqlite_error; // !< Last SQLite error message
+#endif
+		Result *last_result; // !< Freed with the next query(..., true)
 #ifndef __puma
 		boost::mutex m_handle_lock;
 		static boost::mutex m_global_lock;
 #endif
 		std::string m_insertquery;
 		std::vector<std::string> m_insertquery_values;
+		bool m_bulkload; // !< Use LOAD DATA LOCAL INFILE in insert_multiple()
+		std::string m_bulkload_stmt; // !< LOAD DATA equivalent of m_insertquery
+		std::string m_bulkload_rows; // !< Cached rows in LOAD DATA format
 
 	public:
 		/**
 		 * Constructor that connects instantly to the database
 		 */
 		Database(const std::string &username, const std::string &host, const std::string &database);
+#ifdef BUILD_SQLITE_DATABASE
+		/**
+		 * Constructor that opens (or creates) an embedded SQLite database
+		 * file instead of connecting to a MySQL server
+		 */
+		explicit Database(const std::string &sqlite_file);
+#endif
 		~Database();
 
+		/**
+		 * Is this an embedded SQLite database?
+		 */
+		bool is_sqlite() const;
+
 		struct Variant {
 			int id;
 			std::string variant;
@@ -74,31 +140,87 @@ namespace fail {
 
 
 		/**
-		 * Get the raw mysql database handle
+		 * Get the raw mysql database handle (0 for the SQLite backend)
 		 */
 		MYSQL * getHandle() const { return handle; }
 		/**
-		 * Do a small database query. A return value of (MYSQL_RES *)0
+		 * Do a small database query. A return value of (Result *)0
 		 * indicates a query failure. If get_result is set to false, a return
-		 * value of (MYSQL_RES *)1 indicates success; if get_result is true, a
-		 * MySQL result handle is returned.  This handle is valid until the
+		 * value of (Result *)1 indicates success; if get_result is true, a
+		 * result handle is returned.  This handle is valid until the
 		 * next call to this->query(stmt, true)
 		 */
-		MYSQL_RES *query(char const *query, bool get_result = false);
+		Result *query(char const *query, bool get_result = false);
 		/**
 		 * Similar to Database::query, but this should be used for big
 		 * queries. The result is not copied instantly from the
-		 * database server, but a partial result is returned. Which
-		 * behaves as a normal MYSQL_RES pointer.
+		 * database server, but a partial result is returned, which must
+		 * be released with free_result().
 		 */
-		MYSQL_RES *query_stream(char const *query);
+		Result *query_stream(char const *query);
+
+		/**
+		 * Retrieves the next row of a result (0 when exhausted).  Column
+		 * values are NUL-terminated strings, SQL NULL is a null pointer.
+		 */
+		MYSQL_ROW fetch_row(Result *res);
+		/**
+		 * Number of rows in a result obtained by query(stmt, true).
+		 */
+		my_ulonglong num_rows(Result *res);
+		/**
+		 * Releases a result obtained by query_stream().
+		 */
+		void free_result(Result *res);
+		/**
+		 * Error message of the last failed operation (empty if none).
+		 */
+		std::string error();
+
+		/**
+		 * Prepares a statement with '?' parameter placeholders.  Returns 0
+		 * on failure.
+		 */
+		Statement *prepare(const std::string &sql);
+		/**
+		 * Executes a prepared statement with the given parameters, one
+		 * MYSQL_BIND per placeholder (buffer_type, buffer, buffer_length and
+		 * is_unsigned are evaluated for both backends).
+		 */
+		bool execute(Statement *stmt, MYSQL_BIND *bind);
+		/**
+		 * Releases a prepared statement.
+		 */
+		void close_statement(Statement *stmt);
 
 		/**
 		 * Caches multiple value tuples to combine into multi-value INSERTs.
 		 * Call without parameters to flush the cache.
+		 *
+		 * In bulk-load mode (see set_bulkload()), the value tuples are
+		 * converted to MySQL's LOAD DATA INFILE text format and streamed
+		 * to the server from an in-memory buffer with LOAD DATA LOCAL
+		 * INFILE, which is considerably faster for large imports.  Note
+		 * that LOAD DATA LOCAL turns duplicate-key errors into warnings.
 		 */
 		bool insert_multiple(char const *insertquery = 0, char const *values = 0);
 
+		/**
+		 * Enables or disables the bulk-load backend of insert_multiple().
+		 * Flushes all cached value tuples before switching.  Bulk loading
+		 * requires the connection to be opened with local infile support,
+		 * which happens when --bulk-load is given on the command line.
+		 */
+		bool set_bulkload(bool enabled);
+		bool get_bulkload() const { return m_bulkload; }
+
+		/**
+		 * Defers (disable_keys) or rebuilds (enable_keys) the non-unique
+		 * indexes of a MyISAM table.  Used to speed up large imports.
+		 */
+		bool disable_keys(const std::string &table);
+		bool enable_keys(const std::string &table);
+
 		/**
 		 * How many rows were affected by the last query
 		 */
@@ -126,6 +248,14 @@ namespace fail {
 
 	private:
 		bool create_variants_table();
+		bool bulkload_flush();
+#ifdef BUILD_SQLITE_DATABASE
+		// SQLite backend, implemented in DatabaseSQLite.cc
+		Result *sqlite_query(const char *query, bool get_result, bool stream);
+		bool sqlite_fetch(Result *res);
+		Statement *sqlite_prepare(const std::string &sql);
+		bool sqlite_execute(Statement *stmt, MYSQL_BIND *bind);
+#endif
 	};
 
 }
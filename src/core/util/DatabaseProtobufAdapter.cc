@@ -1,6 +1,8 @@
 #include <iostream>
 #include <sstream>
+#include <map>
 #include <assert.h>
+#include <string.h>
 #include "DatabaseProtobufAdapter.hpp"
 #include "util/Logger.hpp"
 #include "util/StringJoiner.hpp"
@@ -11,6 +13,11 @@ static fail::Logger LOG("DatabaseProtobufAdapter", true);
 using namespace fail;
 using namespace google::protobuf;
 
+// packed layout: table of the entry indexes 0..MAX_PACKED_ENTRIES-1 the view
+// joins with to unpack the entries blob
+static const unsigned MAX_PACKED_ENTRIES = 4096;
+static const char *PACKED_INDEX_TABLE = "result_packed_index";
+
 DatabaseProtobufAdapter::TypeBridge::TypeBridge(const FieldDescriptor *desc)
 	: desc(desc) {
 	/* We get the value of the field option extension in_primary_key
@@ -242,6 +249,8 @@ int DatabaseProtobufAdapter::TypeBridge_message::gatherTypes(StringJoiner &inser
 	for (std::vector<TypeBridge *>::iterator it = types.begin(); it != types.end(); ++it)
 		delete *it;
 	types.clear();
+	if (parent == 0)
+		columns.clear();
 
 	size_t count = msg_type->field_count();
 	field_count = 0;
@@ -262,6 +271,9 @@ int DatabaseProtobufAdapter::TypeBridge_message::gatherTypes(StringJoiner &inser
 			// Field should be ignored
 			continue;
 		}
+		if (field_options.GetExtension(sql_optional) && !this->top_level_msg()->optional_columns) {
+			continue;
+		}
 
 		switch (field->cpp_type()) {
 		case FieldDescriptor::CPPTYPE_INT32:
@@ -350,6 +362,14 @@ int DatabaseProtobufAdapter::TypeBridge_message::gatherTypes(StringJoiner &inser
 		insert_stmt.push_back(field->name());
 		if (bridge->primary_key)
 			primary_key.push_back(field->name());
+
+		Column column;
+		column.name = field->name();
+		column.sql_create_stmt = bridge->sql_create_stmt();
+		column.desc = field;
+		column.primary_key = bridge->primary_key;
+		column.repeated = in_repeated();
+		this->top_level_msg()->columns.push_back(column);
 	}
 
 	return field_count;
@@ -373,6 +393,11 @@ void DatabaseProtobufAdapter::create_table(const Descriptor *toplevel_desc) {
 	for (int i = 0; i < fields; i++)
 		question_marks.push_back("?");
 
+	if (m_packed) {
+		create_packed_tables();
+		return;
+	}
+
 	create_table_stmt << "CREATE TABLE IF NOT EXISTS " << result_table_name << "(";
 	create_table_stmt << top_level_msg.sql_create_stmt() << ", PRIMARY KEY(" << primary_join.join(", ") << "))";
 	create_table_stmt << " ENGINE=MyISAM";
@@ -384,6 +409,117 @@ void DatabaseProtobufAdapter::create_table(const Descriptor *toplevel_desc) {
 	db->query(create_table_stmt.str().c_str());
 }
 
+void DatabaseProtobufAdapter::create_packed_tables() {
+	if (db->is_sqlite()) {
+		LOG << "Packed results need the MySQL backend" << std::endl;
+		exit(-1);
+	}
+	packed_table_name = result_table_name + "_packed";
+	detail_table_name = result_table_name + "_detail";
+
+	/* Each entry of the blob: the primary-key fields of one repeated
+	   result (big endian uint32), followed by its code (big endian
+	   uint16) in the detail table */
+	std::vector<Column> &columns = top_level_msg.columns;
+	entry_size = 2;
+	for (std::vector<Column>::const_iterator it = columns.begin(); it != columns.end(); ++it) {
+		if (it->repeated && it->primary_key) {
+			if (it->desc->cpp_type() != FieldDescriptor::CPPTYPE_UINT32 || !it->desc->is_required()) {
+				LOG << "Cannot pack primary key field (must be a required uint32): " << it->name << std::endl;
+				exit(-1);
+			}
+			entry_size += 4;
+		}
+	}
+
+	StringJoiner packed_create, packed_insert, primary, pk_create, detail_create, detail_insert;
+	StringJoiner key_join, view_select;
+	unsigned offset = 0, detail_fields = 0;
+	for (std::vector<Column>::const_iterator it = columns.begin(); it != columns.end(); ++it) {
+		std::stringstream ss;
+		if (!it->repeated) {
+			packed_create.push_back(it->sql_create_stmt);
+			packed_insert.push_back(it->name);
+			view_select.push_back("p." + it->name);
+			if (it->primary_key) {
+				primary.push_back(it->name);
+				pk_create.push_back(it->sql_create_stmt);
+				key_join.push_back("d." + it->name + " = p." + it->name);
+			}
+		} else if (it->primary_key) {
+			ss << "CAST(CONV(HEX(SUBSTRING(p.entries, i.n * " << entry_size << " + " << offset + 1
+			   << ", 4)), 16, 10) AS UNSIGNED) AS " << it->name;
+			view_select.push_back(ss.str());
+			offset += 4;
+		} else {
+			detail_create.push_back(it->sql_create_stmt);
+			detail_insert.push_back(it->name);
+			view_select.push_back("d." + it->name);
+			detail_fields++;
+		}
+	}
+	std::stringstream code;
+	code << "CAST(CONV(HEX(SUBSTRING(p.entries, i.n * " << entry_size << " + " << offset + 1
+	     << ", 2)), 16, 10) AS UNSIGNED)";
+	key_join.push_back("d.code = " + code.str());
+	packed_insert.push_back("entries");
+	pk_create.push_back("code SMALLINT UNSIGNED NOT NULL");
+	detail_create.push_front(pk_create.join(", "));
+	detail_insert.push_front("code");
+	detail_insert.push_front(primary.join(","));
+
+	std::stringstream sql;
+	sql << "CREATE TABLE IF NOT EXISTS " << packed_table_name << "("
+	    << packed_create.join(", ") << ", entries BLOB NOT NULL"
+	    << ", PRIMARY KEY(" << primary.join(", ") << ")) ENGINE=MyISAM";
+	db->query(sql.str().c_str());
+	sql.str("");
+	sql << "CREATE TABLE IF NOT EXISTS " << detail_table_name << "("
+	    << detail_create.join(", ")
+	    << ", PRIMARY KEY(" << primary.join(", ") << ", code)) ENGINE=MyISAM";
+	db->query(sql.str().c_str());
+
+	sql.str("");
+	sql << "CREATE TABLE IF NOT EXISTS " << PACKED_INDEX_TABLE
+	    << "(n SMALLINT UNSIGNED NOT NULL, PRIMARY KEY(n)) ENGINE=MyISAM";
+	db->query(sql.str().c_str());
+	sql.str("");
+	sql << "INSERT IGNORE INTO " << PACKED_INDEX_TABLE << " (n) VALUES ";
+	std::string insert_index = sql.str();
+	for (unsigned n = 0; n < MAX_PACKED_ENTRIES; ++n) {
+		sql.str("");
+		sql << "(" << n << ")";
+		db->insert_multiple(insert_index.c_str(), sql.str().c_str());
+	}
+	db->insert_multiple();
+
+	/* The classic layout, one row per repeated result */
+	sql.str("");
+	sql << "CREATE OR REPLACE VIEW " << result_table_name << " AS"
+	    << " SELECT " << view_select.join(", ")
+	    << " FROM " << packed_table_name << " p"
+	    << " JOIN " << PACKED_INDEX_TABLE << " i ON i.n < LENGTH(p.entries) DIV " << entry_size
+	    << " JOIN " << detail_table_name << " d ON " << key_join.join(" AND ");
+	if (!db->query(sql.str().c_str())) {
+		LOG << "Cannot create the view " << result_table_name
+		    << " (does a result table with row-per-result layout exist?)" << std::endl;
+		exit(-1);
+	}
+
+	insert_stmt.str("");
+	insert_stmt << "INSERT INTO " << packed_table_name << "(" << packed_insert.join(",")
+	            << ") VALUES (";
+	for (size_t i = 0; i < packed_insert.size(); i++)
+		insert_stmt << (i ? ",?" : "?");
+	insert_stmt << ")";
+	insert_detail_stmt.str("");
+	insert_detail_stmt << "INSERT INTO " << detail_table_name << "(" << detail_insert.join(",")
+	                   << ") VALUES (";
+	for (size_t i = 0; i < primary.size() + 1 + detail_fields; i++)
+		insert_detail_stmt << (i ? ",?" : "?");
+	insert_detail_stmt << ")";
+}
+
 
 
 int DatabaseProtobufAdapter::field_size_at_pos(const Message *msg, std::vector<int> selector, int pos) {
@@ -409,16 +545,32 @@ int DatabaseProtobufAdapter::field_size_at_pos(const Message *msg, std::vector<i
 	return ref->FieldSize(*msg, top_level_msg.repeated_message_stack[i]->desc);
 }
 
+bool DatabaseProtobufAdapter::next_row(const Message *msg, std::vector<int> &selector) {
+	/* Increment the selector */
+	unsigned i = selector.size() - 1;
+	selector[i] ++;
+
+	while (i > 0 && field_size_at_pos(msg, selector, i) <= selector[i]) {
+		selector[i] = 0;
+		i--;
+		selector[i] ++;
+	}
+	return i != 0;
+}
+
 bool DatabaseProtobufAdapter::insert_row(const google::protobuf::Message *msg) {
 	assert (msg->GetDescriptor() != 0 && msg->GetReflection() != 0);
 
+	if (m_packed) {
+		return insert_packed_row(msg);
+	}
+
 	if (!stmt) {
 		// Prepare the insert statement
 		// We didn't do that right in create_table() because we need to use the
 		// right DB connection for that (which may not have existed yet then).
-		stmt = mysql_stmt_init(db_insert->getHandle());
-		if (mysql_stmt_prepare(stmt, insert_stmt.str().c_str(), insert_stmt.str().length())) {
-			LOG << "query '" << insert_stmt.str() << "' failed: " << mysql_error(db_insert->getHandle()) << std::endl;
+		stmt = db_insert->prepare(insert_stmt.str());
+		if (!stmt) {
 			exit(-1);
 		}
 	}
@@ -428,7 +580,8 @@ bool DatabaseProtobufAdapter::insert_row(const google::protobuf::Message *msg) {
 	/* We determine how many columns should be produced */
 	std::vector<int> selector    (top_level_msg.repeated_message_stack.size());
 
-	while (true) {
+	bool ok = true;
+	do {
 		// INSERT WITH SELECTOR
 		top_level_msg.selector = &selector;
 
@@ -437,32 +590,136 @@ bool DatabaseProtobufAdapter::insert_row(const google::protobuf::Message *msg) {
 		memset(bind, 0, sizeof(*bind) * (top_level_msg.field_count));
 		top_level_msg.bind(bind, msg);
 
-		// Insert the binded row
-		if (mysql_stmt_bind_param(stmt, bind)) {
-			LOG << "mysql_stmt_bind_param() failed: " << mysql_stmt_error(stmt) << std::endl;
-			delete[] bind;
-			return false;
+		// Insert the binded row; a failed row does not keep the others out
+		if (!db_insert->execute(stmt, bind)) {
+			ok = false;
 		}
+	} while (next_row(msg, selector));
 
-		if (mysql_stmt_execute(stmt)) {
-			LOG << "mysql_stmt_execute() failed: " << mysql_stmt_error(stmt) << std::endl;
-		}
+	delete[] bind;
 
+	return ok;
 
-		/* Increment the selector */
-		unsigned i = selector.size() - 1;
-		selector[i] ++;
+}
 
-		while (i > 0 && field_size_at_pos(msg, selector, i) <= selector[i]) {
-			selector[i] = 0;
-			i--;
-			selector[i] ++;
+/* Bound values are copied as [type, is_unsigned, length, bytes], because the
+   TypeBridge buffers are reused for the next row */
+static size_t bind_length(const MYSQL_BIND &bind) {
+	switch (bind.buffer_type) {
+	case MYSQL_TYPE_NULL:     return 0;
+	case MYSQL_TYPE_TINY:     return 1;
+	case MYSQL_TYPE_LONG:
+	case MYSQL_TYPE_FLOAT:    return 4;
+	case MYSQL_TYPE_LONGLONG:
+	case MYSQL_TYPE_DOUBLE:   return 8;
+	default:                  return bind.buffer_length; // strings, blobs
+	}
+}
+
+static void pack_bind(std::string &out, const MYSQL_BIND &bind) {
+	uint32_t length = bind_length(bind);
+	out.push_back((char) bind.buffer_type);
+	out.push_back((char) bind.is_unsigned);
+	out.append((const char *) &length, sizeof(length));
+	if (length > 0)
+		out.append((const char *) bind.buffer, length);
+}
+
+static const char *unpack_bind(const char *p, MYSQL_BIND &bind) {
+	uint32_t length;
+	memcpy(&length, p + 2, sizeof(length));
+	bind.buffer_type = (enum_field_types) (unsigned char) p[0];
+	bind.is_unsigned = p[1];
+	bind.buffer = (void *) (p + 2 + sizeof(length));
+	bind.buffer_length = length;
+	return p + 2 + sizeof(length) + length;
+}
+
+static void append_big_endian(std::string &out, uint32_t value, int bytes) {
+	while (bytes-- > 0)
+		out.push_back((char) ((value >> (8 * bytes)) & 0xff));
+}
+
+bool DatabaseProtobufAdapter::insert_packed_row(const google::protobuf::Message *msg) {
+	if (!stmt) {
+		stmt = db_insert->prepare(insert_stmt.str());
+		detail_stmt = db_insert->prepare(insert_detail_stmt.str());
+		if (!stmt || !detail_stmt) {
+			exit(-1);
 		}
-		if (i == 0) break;
 	}
 
+	const std::vector<Column> &columns = top_level_msg.columns;
+	MYSQL_BIND *bind = new MYSQL_BIND[top_level_msg.field_count];
+	std::vector<int> selector(top_level_msg.repeated_message_stack.size());
+
+	std::string message_fields, primary_fields, entries;
+	std::map<std::string, unsigned> codes;
+	std::vector<const std::string *> details;
+	unsigned rows = 0;
+
+	do {
+		top_level_msg.selector = &selector;
+		memset(bind, 0, sizeof(*bind) * (top_level_msg.field_count));
+		top_level_msg.bind(bind, msg);
+
+		std::string detail;
+		for (size_t i = 0; i < columns.size(); ++i) {
+			if (!columns[i].repeated) {
+				// the same for all rows
+				if (rows == 0) {
+					pack_bind(message_fields, bind[i]);
+					if (columns[i].primary_key)
+						pack_bind(primary_fields, bind[i]);
+				}
+			} else if (columns[i].primary_key) {
+				append_big_endian(entries, *(uint32_t *) bind[i].buffer, 4);
+			} else {
+				pack_bind(detail, bind[i]);
+			}
+		}
+		std::pair<std::map<std::string, unsigned>::iterator, bool> code =
+			codes.insert(std::make_pair(detail, codes.size()));
+		if (code.second)
+			details.push_back(&code.first->first);
+		append_big_endian(entries, code.first->second, 2);
+		rows ++;
+	} while (next_row(msg, selector));
+
 	delete[] bind;
 
-	return true;
+	if (rows > MAX_PACKED_ENTRIES) {
+		LOG << "Cannot pack more than " << MAX_PACKED_ENTRIES << " results per message" << std::endl;
+		return false;
+	}
+
+	/* One row in the packed table ... */
+	std::vector<MYSQL_BIND> row(columns.size() + 2);
+	memset(&row[0], 0, sizeof(MYSQL_BIND) * row.size());
+	size_t n = 0;
+	for (const char *p = message_fields.data(); p != message_fields.data() + message_fields.size(); )
+		p = unpack_bind(p, row[n++]);
+	row[n].buffer_type = MYSQL_TYPE_BLOB;
+	row[n].buffer = (void *) entries.data();
+	row[n].buffer_length = entries.size();
+	bool ok = db_insert->execute(stmt, &row[0]);
+
+	/* ... and one per distinct detail */
+	for (size_t code = 0; ok && code < details.size(); ++code) {
+		uint16_t code_value = code;
+		memset(&row[0], 0, sizeof(MYSQL_BIND) * row.size());
+		n = 0;
+		for (const char *p = primary_fields.data(); p != primary_fields.data() + primary_fields.size(); )
+			p = unpack_bind(p, row[n++]);
+		row[n].buffer_type = MYSQL_TYPE_SHORT;
+		row[n].is_unsigned = 1;
+		row[n].buffer = &code_value;
+		n++;
+		const std::string &detail = *details[code];
+		for (const char *p = detail.data(); p != detail.data() + detail.size(); )
+			p = unpack_bind(p, row[n++]);
+		ok = db_insert->execute(detail_stmt, &row[0]);
+	}
 
+	return ok;
 }
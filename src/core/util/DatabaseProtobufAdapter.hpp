@@ -14,11 +14,23 @@ namespace fail {
 
 class DatabaseProtobufAdapter {
 	Database *db, *db_insert;
-	MYSQL_STMT *stmt;
+	Database::Statement *stmt;
 	std::stringstream insert_stmt;
 
 	void error_create_table();
 
+	/** \class Column
+		A plain (non-message) field in the order of the bound parameters.
+		Fields inside a repeated message take one value per result row,
+		all others are the same for all rows of a message. */
+	struct Column {
+		std::string name;
+		std::string sql_create_stmt;
+		const google::protobuf::FieldDescriptor *desc;
+		bool primary_key;
+		bool repeated;
+	};
+
 	/** \class TypeBridge
 		A type bridge bridges the gap between a protobuf type and the
 		sql database. It defines how the result table is defined, and
@@ -169,10 +181,25 @@ class DatabaseProtobufAdapter {
 
 		std::vector<TypeBridge_message *> repeated_message_stack;
 
+		/* All plain fields in bind order (top-level message only) */
+		std::vector<Column> columns;
+
+		/* Include fields marked sql_optional (top-level message only) */
+		bool optional_columns;
+
+		/* Is this message (or one of its parents) repeated? */
+		bool in_repeated() {
+			for (TypeBridge_message *p = this; p != 0; p = p->parent) {
+				if (p->desc && p->desc->is_repeated()) return true;
+			}
+			return false;
+		}
+
 		TypeBridge_message(const google::protobuf::FieldDescriptor *desc,
 						   const google::protobuf::Descriptor *msg_type,
 						   TypeBridge_message *parent)
-			: TypeBridge(desc), msg_type(msg_type), field_count(0), selector(0), parent(parent) {
+			: TypeBridge(desc), msg_type(msg_type), field_count(0), selector(0), parent(parent),
+			  optional_columns(false) {
 			if (parent)
 				nesting_level = parent->nesting_level+1;
 			else
@@ -189,11 +216,22 @@ class DatabaseProtobufAdapter {
 
 	std::string result_table_name;
 
+	/* Packed layout, see set_packed() */
+	bool m_packed;
+	Database::Statement *detail_stmt;
+	std::stringstream insert_detail_stmt;
+	std::string packed_table_name, detail_table_name;
+	unsigned entry_size; // bytes per result row in the entries blob
+
 	int field_size_at_pos(const google::protobuf::Message *msg, std::vector<int> selector, int pos);
+	bool next_row(const google::protobuf::Message *msg, std::vector<int> &selector);
+	void create_packed_tables();
+	bool insert_packed_row(const google::protobuf::Message *msg);
 
 
 public:
-	DatabaseProtobufAdapter() : db(0), db_insert(0), stmt(0), top_level_msg(0, 0, 0) {}
+	DatabaseProtobufAdapter() : db(0), db_insert(0), stmt(0), top_level_msg(0, 0, 0),
+		m_packed(false), detail_stmt(0), entry_size(0) {}
 	void set_database_handle(Database *db)
 	{
 		this->db = db;
@@ -207,9 +245,30 @@ public:
 	 * set_database_handle() is still in use concurrently.
 	 */
 	void set_insert_database_handle(Database *db) { db_insert = db; }
+	/**
+	 * Store one row per message instead of one row per repeated result
+	 * (e.g., per bit offset); call before create_table().  The primary-key
+	 * fields of the repeated results (e.g., bitoffset) are packed into a
+	 * blob in result_<Msg>_packed, together with a code per result that
+	 * refers to the distinct values of the remaining fields in
+	 * result_<Msg>_detail.  result_<Msg> is a view that presents the
+	 * classic row-per-result layout, so queries need not be changed.
+	 * Requires the MySQL backend.
+	 */
+	void set_packed(bool packed) { m_packed = packed; }
+	/**
+	 * Create and fill columns for fields marked with the sql_optional
+	 * option, too (e.g., DatabaseExperimentMessage's phase times); call
+	 * before create_table().
+	 */
+	void set_optional_columns(bool optional) { top_level_msg.optional_columns = optional; }
 	void create_table(const google::protobuf::Descriptor *);
 	bool insert_row(const google::protobuf::Message *msg);
+	/** Table (or view) with one row per result */
 	std::string result_table() { return result_table_name; }
+	/** Tables the results are physically stored in (comma-separated) */
+	std::string storage_tables()
+	{ return m_packed ? packed_table_name + ", " + detail_table_name : result_table_name; }
 
 };
 
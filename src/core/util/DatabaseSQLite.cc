@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sstream>
+#include <sqlite3.h>
+#include "Database.hpp"
+#include "util/Logger.hpp"
+
+#ifndef __puma
+#include <boost/regex.hpp>
+#endif
+
+static fail::Logger LOG("Database", true);
+
+using namespace fail;
+
+/*
+ * SQLite storage backend of the Database class.  FAIL* tools talk MySQL's SQL
+ * dialect, which is mapped onto SQLite here (see sqlite_translate()).  The
+ * translation only covers the constructs the FAIL* tools actually use.
+ */
+
+Database::Database(const std::string &sqlite_file)
+	: handle(0), m_sqlite(0), last_result(0), m_bulkload(false)
+{
+#ifndef __puma
+	boost::lock_guard<boost::mutex> guard(m_global_lock);
+#endif
+	if (sqlite3_open_v2(sqlite_file.c_str(), &m_sqlite,
+		SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, 0) != SQLITE_OK) {
+		LOG << "cannot open SQLite database " << sqlite_file << ": "
+			<< (m_sqlite ? sqlite3_errmsg(m_sqlite) : "out of memory") << std::endl;
+		exit(-1);
+	}
+	// Several connections (campaign server threads, parallel tools) may
+	// access the same file: WAL lets readers proceed while one writer
+	// inserts, the busy timeout serializes concurrent writers.
+	sqlite3_busy_timeout(m_sqlite, 600 * 1000);
+	sqlite3_exec(m_sqlite, "PRAGMA journal_mode=WAL", 0, 0, 0);
+	sqlite3_exec(m_sqlite, "PRAGMA synchronous=OFF", 0, 0, 0);
+	LOG << "opened SQLite database " << sqlite_file << std::endl;
+}
+
+#ifndef __puma
+/**
+ * Applies a regex replacement (case-insensitive) to sql.
+ */
+static void sqlite_replace(std::string& sql, const char *expr, const char *fmt)
+{
+	boost::regex re(expr, boost::regex::perl | boost::regex::icase);
+	sql = boost::regex_replace(sql, re, fmt);
+}
+#endif
+
+/**
+ * Translates a MySQL statement into one or more SQLite statements.  String
+ * literals are left untouched.  For multi-value INSERTs only the statement
+ * head up to VALUES is translated, as the value tuples can be huge.
+ */
+static std::vector<std::string> sqlite_translate(const std::string& query)
+{
+	std::vector<std::string> out;
+#ifndef __puma
+	std::string sql = query, tail;
+	static const boost::regex values_re("^\\s*(INSERT|REPLACE)\\b[^']*?\\bVALUES\\b",
+		boost::regex::perl | boost::regex::icase);
+	boost::smatch m;
+	if (boost::regex_search(query, m, values_re)) {
+		sql = m.str(0);
+		tail = query.substr(m.length(0));
+	}
+
+	// hide string literals behind \x01<index>\x02 placeholders
+	std::vector<std::string> literals;
+	std::string code;
+	for (size_t i = 0; i < sql.size(); ++i) {
+		if (sql[i] != '\'') {
+			code += sql[i];
+			continue;
+		}
+		size_t start = i;
+		for (++i; i < sql.size(); ++i) {
+			if (sql[i] == '\'' && i + 1 < sql.size() && sql[i + 1] == '\'') {
+				++i;
+			} else if (sql[i] == '\'') {
+				break;
+			}
+		}
+		std::stringstream ph;
+		ph << '\x01' << literals.size() << '\x02';
+		literals.push_back(sql.substr(start, i - start + 1));
+		code += ph.str();
+	}
+
+	// no-ops in SQLite
+	if (boost::regex_match(code, boost::regex("\\s*ALTER\\s+TABLE\\s+\\S+\\s+(DISABLE|ENABLE)\\s+KEYS\\s*;?\\s*",
+		boost::regex::perl | boost::regex::icase))) {
+		return out;
+	}
+
+	// SQLite's ANALYZE takes a single table
+	boost::smatch analyze;
+	if (boost::regex_match(code, analyze, boost::regex("\\s*ANALYZE\\s+(?:NO_WRITE_TO_BINLOG\\s+|LOCAL\\s+)?TABLE\\s+([^;]*?)\\s*;?\\s*",
+		boost::regex::perl | boost::regex::icase))) {
+		std::string tables = analyze.str(1);
+		boost::regex name_re("`?(\\w+)`?");
+		for (boost::sregex_iterator it(tables.begin(), tables.end(), name_re), end; it != end; ++it) {
+			out.push_back("ANALYZE " + it->str(1));
+		}
+		return out;
+	}
+
+	sqlite_replace(code, "\\s*\\bengine\\s*=\\s*\\w+", "");
+	sqlite_replace(code, "\\bSELECT\\s+STRAIGHT_JOIN\\b", "SELECT");
+	sqlite_replace(code, "\\bSTRAIGHT_JOIN\\b", "JOIN");
+	sqlite_replace(code, "\\bUSE\\s+INDEX\\s*\\([^)]*\\)", "");
+	// MySQL's "/" always divides in floating point, SQLite's only if an
+	// operand is; queries that rely on it say so ("x * 1.0 / y")
+	sqlite_replace(code, "\\bDIV\\b", "/");
+	sqlite_replace(code, "\\bchar_length\\s*\\(", "length(");
+	sqlite_replace(code, "\\bINSERT\\s+IGNORE\\b", "INSERT OR IGNORE");
+	sqlite_replace(code, "\\benum\\s*\\([^)]*\\)", "TEXT");
+	sqlite_replace(code, "\\b(\\w+)\\s*\\(\\s*\\d+\\s*\\)(\\s+unsigned)\\b", "$1$2");
+	sqlite_replace(code, "^\\s*SHOW\\s+TABLES\\s+LIKE\\b",
+		"SELECT name FROM sqlite_master WHERE type = 'table' AND name LIKE");
+	sqlite_replace(code, "^\\s*ALTER\\s+TABLE\\s+`?(\\w+)`?\\s+ADD\\s+INDEX\\s+(IF\\s+NOT\\s+EXISTS\\s+)?`?(\\w+)`?\\s*\\(([^)]*)\\)",
+		"CREATE INDEX IF NOT EXISTS $1_$3 ON $1 ($4)");
+	sqlite_replace(code, "^\\s*ALTER\\s+TABLE\\s+`?(\\w+)`?\\s+ADD\\s+PRIMARY\\s+KEY\\s*\\(([^)]*)\\)",
+		"CREATE UNIQUE INDEX IF NOT EXISTS $1_primary ON $1 ($2)");
+
+	boost::smatch table;
+	if (boost::regex_search(code, table, boost::regex("^\\s*CREATE\\s+TABLE\\s+(IF\\s+NOT\\s+EXISTS\\s+)?`?(\\w+)`?",
+		boost::regex::perl | boost::regex::icase))) {
+		std::string name = table.str(2);
+
+		// AUTO_INCREMENT columns must be the INTEGER PRIMARY KEY in SQLite
+		boost::smatch autoinc;
+		if (boost::regex_search(code, autoinc, boost::regex("\\b(\\w+)\\s+int\\w*\\s*(\\(\\s*\\d+\\s*\\))?\\s+NOT\\s+NULL\\s+AUTO_INCREMENT\\b",
+			boost::regex::perl | boost::regex::icase))) {
+			std::string column = autoinc.str(1);
+			code.replace(autoinc.position(), autoinc.length(), column + " INTEGER PRIMARY KEY AUTOINCREMENT");
+			sqlite_replace(code, (",\\s*PRIMARY\\s+KEY\\s*\\(\\s*`?" + column + "`?\\s*\\)").c_str(), "");
+		}
+
+		sqlite_replace(code, "\\bUNIQUE\\s+KEY\\s+`?\\w+`?\\s*\\(", "UNIQUE (");
+
+		// secondary indexes must be created separately
+		boost::regex key_re(",\\s*KEY\\s+`?(\\w+)`?\\s*\\(([^)]*)\\)", boost::regex::perl | boost::regex::icase);
+		boost::smatch key;
+		std::vector<std::string> indexes;
+		while (boost::regex_search(code, key, key_re)) {
+			indexes.push_back("CREATE INDEX IF NOT EXISTS " + name + "_" + key.str(1)
+				+ " ON " + name + " (" + key.str(2) + ")");
+			code.erase(key.position(), key.length());
+		}
+		out.push_back(code);
+		out.insert(out.end(), indexes.begin(), indexes.end());
+	} else {
+		out.push_back(code);
+	}
+
+	// put the string literals back in place
+	for (std::vector<std::string>::iterator it = out.begin(); it != out.end(); ++it) {
+		std::string& stmt = *it;
+		std::string restored;
+		for (size_t i = 0; i < stmt.size(); ++i) {
+			if (stmt[i] == '\x01') {
+				size_t end = stmt.find('\x02', i);
+				restored += literals[atoi(stmt.c_str() + i + 1)];
+				i = end;
+			} else {
+				restored += stmt[i];
+			}
+		}
+		stmt = restored;
+	}
+	out[0] += tail;
+#endif
+	return out;
+}
+
+/**
+ * Copies the current row of stmt into res->cells (appending).
+ */
+static void sqlite_copy_row(sqlite3_stmt *stmt, Database::Result *res)
+{
+	for (unsigned i = 0; i < res->columns; ++i) {
+		const char *text = (const char *) sqlite3_column_text(stmt, i);
+		res->cells.push_back(text ? strdup(text) : 0);
+	}
+}
+
+Database::Result *Database::sqlite_query(const char *query, bool get_result, bool stream)
+{
+	m_sqlite_error.clear();
+	std::vector<std::string> stmts = sqlite_translate(query);
+	Result *res = 0;
+
+	for (std::vector<std::string>::const_iterator it = stmts.begin();
+	     it != stmts.end(); ++it) {
+		const char *sql = it->c_str();
+		while (*sql) {
+			sqlite3_stmt *stmt;
+			const char *tail;
+			if (sqlite3_prepare_v2(m_sqlite, sql, -1, &stmt, &tail) != SQLITE_OK) {
+				m_sqlite_error = sqlite3_errmsg(m_sqlite);
+				std::cerr << "query '" << *it << "' failed: " << m_sqlite_error << std::endl;
+				delete res;
+				return 0;
+			}
+			sql = tail;
+			if (!stmt) {
+				// whitespace or comment only
+				continue;
+			}
+
+			// only the first statement can deliver a result
+			bool collect = false;
+			if (get_result && !res) {
+				res = new Result;
+				res->columns = sqlite3_column_count(stmt);
+				if (stream) {
+					res->stmt = stmt;
+					continue;
+				}
+				collect = true;
+			}
+
+			int rc;
+			while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+				if (collect) {
+					sqlite_copy_row(stmt, res);
+				}
+			}
+			sqlite3_finalize(stmt);
+			if (rc != SQLITE_DONE) {
+				m_sqlite_error = sqlite3_errmsg(m_sqlite);
+				std::cerr << "query '" << *it << "' failed: " << m_sqlite_error << std::endl;
+				delete res;
+				return 0;
+			}
+		}
+	}
+
+	if (get_result) {
+		return res ? res : new Result;
+	}
+	return (Result *) 1; // Invalid PTR!!!
+}
+
+bool Database::sqlite_fetch(Result *res)
+{
+	for (std::vector<char *>::iterator it = res->cells.begin(); it != res->cells.end(); ++it) {
+		free(*it);
+	}
+	res->cells.clear();
+
+	int rc = sqlite3_step(res->stmt);
+	if (rc == SQLITE_ROW) {
+		sqlite_copy_row(res->stmt, res);
+		if (res->columns == 0) {
+			res->cells.push_back(0);
+		}
+		return true;
+	} else if (rc != SQLITE_DONE) {
+		m_sqlite_error = sqlite3_errmsg(m_sqlite);
+		LOG << "fetching row failed: " << m_sqlite_error << std::endl;
+	}
+	return false;
+}
+
+Database::Statement *Database::sqlite_prepare(const std::string &sql)
+{
+	std::vector<std::string> stmts = sqlite_translate(sql);
+	if (stmts.size() != 1) {
+		LOG << "cannot prepare '" << sql << "'" << std::endl;
+		return 0;
+	}
+
+	Statement *stmt = new Statement;
+	stmt->sql = sql;
+	if (sqlite3_prepare_v2(m_sqlite, stmts[0].c_str(), -1, &stmt->sqlite_stmt, 0) != SQLITE_OK) {
+		m_sqlite_error = sqlite3_errmsg(m_sqlite);
+		LOG << "query '" << sql << "' failed: " << m_sqlite_error << std::endl;
+		close_statement(stmt);
+		return 0;
+	}
+	return stmt;
+}
+
+bool Database::sqlite_execute(Statement *stmt, MYSQL_BIND *bind)
+{
+	sqlite3_stmt *s = stmt->sqlite_stmt;
+	sqlite3_reset(s);
+	sqlite3_clear_bindings(s);
+
+	int params = sqlite3_bind_parameter_count(s);
+	for (int i = 0; i < params; ++i) {
+		MYSQL_BIND &b = bind[i];
+		int rc;
+		if ((b.is_null && *b.is_null) || b.buffer_type == MYSQL_TYPE_NULL) {
+			rc = sqlite3_bind_null(s, i + 1);
+			continue;
+		}
+		unsigned long length = b.length ? *b.length : b.buffer_length;
+		switch (b.buffer_type) {
+		case MYSQL_TYPE_TINY:
+			rc = sqlite3_bind_int(s, i + 1, b.is_unsigned ?
+				*(unsigned char *) b.buffer : *(signed char *) b.buffer);
+			break;
+		case MYSQL_TYPE_SHORT:
+			rc = sqlite3_bind_int(s, i + 1, b.is_unsigned ?
+				*(unsigned short *) b.buffer : *(short *) b.buffer);
+			break;
+		case MYSQL_TYPE_LONG:
+			rc = sqlite3_bind_int64(s, i + 1, b.is_unsigned ?
+				(sqlite3_int64) *(uint32_t *) b.buffer : *(int32_t *) b.buffer);
+			break;
+		case MYSQL_TYPE_LONGLONG:
+			rc = sqlite3_bind_int64(s, i + 1, *(sqlite3_int64 *) b.buffer);
+			break;
+		case MYSQL_TYPE_FLOAT:
+			rc = sqlite3_bind_double(s, i + 1, *(float *) b.buffer);
+			break;
+		case MYSQL_TYPE_DOUBLE:
+			rc = sqlite3_bind_double(s, i + 1, *(double *) b.buffer);
+			break;
+		case MYSQL_TYPE_BLOB:
+			rc = sqlite3_bind_blob(s, i + 1, b.buffer, length, SQLITE_STATIC);
+			break;
+		default: // strings
+			rc = sqlite3_bind_text(s, i + 1, (const char *) b.buffer, length, SQLITE_STATIC);
+			break;
+		}
+		if (rc != SQLITE_OK) {
+			m_sqlite_error = sqlite3_errmsg(m_sqlite);
+			LOG << "binding parameter " << i << " failed: " << m_sqlite_error << std::endl;
+			return false;
+		}
+	}
+
+	int rc;
+	while ((rc = sqlite3_step(s)) == SQLITE_ROW)
+		;
+	if (rc != SQLITE_DONE) {
+		m_sqlite_error = sqlite3_errmsg(m_sqlite);
+		LOG << "executing '" << stmt->sql << "' failed: " << m_sqlite_error << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -25,13 +25,17 @@ class ElfSegment {
 		guest_address_t m_vaddress;
 		size_t m_size;
 		unsigned m_flags;
+		uint64_t m_offset;
+		size_t m_filesize;
 
 	public:
 		ElfSegment(Elf64_Phdr const * hdr)
 			: m_paddress(hdr->p_paddr),
 			  m_vaddress(hdr->p_vaddr),
 			  m_size(hdr->p_memsz),
-			  m_flags(hdr->p_flags) { }
+			  m_flags(hdr->p_flags),
+			  m_offset(hdr->p_offset),
+			  m_filesize(hdr->p_filesz) { }
 
 		bool isReadable() const   { return m_flags & PF_R; }
 		bool isWriteable() const  { return m_flags & PF_W; }
@@ -39,6 +43,10 @@ class ElfSegment {
 		guest_address_t getStart() const { assert(m_paddress == m_vaddress); return m_paddress; }
 		guest_address_t getEnd()   const { assert(m_paddress == m_vaddress); return m_paddress + m_size; }
 		guest_address_t getSize()  const { assert(m_paddress == m_vaddress); return m_size; }
+		//! Position of the segment's contents in the ELF file
+		uint64_t getFileOffset() const { return m_offset; }
+		//! Bytes stored in the file (the rest up to getSize() is zero)
+		size_t getFileSize() const { return m_filesize; }
 		friend std::ostream& operator << (std::ostream&,const ElfSegment&);
 };
 
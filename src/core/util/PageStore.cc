@@ -0,0 +1,318 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <zlib.h>
+#include <algorithm>
+
+#include "PageStore.hpp"
+
+namespace fail {
+
+const size_t PageStore::PAGE_SIZE;
+
+static const char MAGIC[8] = { 'F', 'A', 'I', 'L', 'P', 'G', 'S', '1' };
+
+struct ManifestHeader {
+	char magic[8];
+	uint64_t size;   //!< blob size in bytes
+	uint64_t pages;  //!< number of PageRefs following
+};
+
+// 64-bit finalizer of MurmurHash3
+static inline uint64_t mix64(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+PageStore::Hash PageStore::hashPage(const char *data, size_t len)
+{
+	// two independently seeded lanes
+	uint64_t a = 0x9e3779b97f4a7c15ULL ^ len, b = 0x6a09e667f3bcc909ULL ^ len;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t w;
+		memcpy(&w, data + i, sizeof(w));
+		a = (a ^ mix64(w)) * 0x100000001b3ULL;
+		b = (b + mix64(w ^ 0xc2b2ae3d27d4eb4fULL)) * 0xff51afd7ed558ccdULL;
+	}
+	for (; i < len; ++i) {
+		a = (a ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+		b = (b + (unsigned char) data[i]) * 0xff51afd7ed558ccdULL;
+	}
+	Hash h;
+	h.h[0] = mix64(a);
+	h.h[1] = mix64(b ^ h.h[0]);
+	return h;
+}
+
+bool PageStore::open(const std::string& dir)
+{
+	close();
+	if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+		return false;
+	}
+	m_dir = dir;
+	std::string pack = dir + "/pages.dat", index = dir + "/pages.idx";
+
+	// restoring clients may only have read access
+	m_writable = true;
+	m_pack = ::open(pack.c_str(), O_RDWR | O_CREAT, 0666);
+	if (m_pack == -1) {
+		m_writable = false;
+		m_pack = ::open(pack.c_str(), O_RDONLY);
+		if (m_pack == -1) {
+			return false;
+		}
+	}
+	struct stat st;
+	if (fstat(m_pack, &st) != 0) {
+		close();
+		return false;
+	}
+	m_pack_size = st.st_size;
+	if (m_writable) {
+		m_index = ::open(index.c_str(), O_RDWR | O_CREAT | O_APPEND, 0666);
+		if (m_index == -1) {
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void PageStore::close()
+{
+	if (m_map) {
+		munmap(const_cast<char *>(m_map), m_mapped);
+		m_map = 0;
+		m_mapped = 0;
+	}
+	if (m_pack != -1) {
+		::close(m_pack);
+		m_pack = -1;
+	}
+	if (m_index != -1) {
+		::close(m_index);
+		m_index = -1;
+	}
+	m_pages.clear();
+	m_index_pos = 0;
+}
+
+bool PageStore::loadIndex()
+{
+	// only the entries appended since the last call (by any process)
+	PageRef refs[256];
+	ssize_t n;
+	while ((n = pread(m_index, refs, sizeof(refs), m_index_pos)) > 0) {
+		size_t count = n / sizeof(PageRef);
+		for (size_t i = 0; i < count; ++i) {
+			// ignore pages whose write did not complete
+			if (refs[i].offset + refs[i].length <= m_pack_size) {
+				m_pages[refs[i].hash] = refs[i];
+			}
+		}
+		m_index_pos += count * sizeof(PageRef);
+		if (count * sizeof(PageRef) != (size_t) n) {
+			break; // incomplete entry of a crashed writer
+		}
+	}
+	return n >= 0;
+}
+
+namespace {
+
+//! exclusive flock() for the lifetime of the object
+class FileLock {
+	int m_fd;
+	bool m_locked;
+public:
+	FileLock(int fd) : m_fd(fd)
+	{
+		int ret;
+		while ((ret = flock(m_fd, LOCK_EX)) != 0 && errno == EINTR) { }
+		m_locked = ret == 0;
+	}
+	~FileLock()
+	{
+		if (m_locked) {
+			flock(m_fd, LOCK_UN);
+		}
+	}
+	bool locked() const { return m_locked; }
+};
+
+} // anonymous namespace
+
+static bool write_all(int fd, const void *buf, size_t len, off_t offset)
+{
+	const char *p = static_cast<const char *>(buf);
+	while (len > 0) {
+		ssize_t n = pwrite(fd, p, len, offset);
+		if (n <= 0) {
+			return false;
+		}
+		p += n;
+		len -= n;
+		offset += n;
+	}
+	return true;
+}
+
+bool PageStore::addPage(const char *data, size_t len, PageRef& ref)
+{
+	ref.hash = hashPage(data, len);
+	std::unordered_map<Hash, PageRef, HashHasher>::const_iterator it = m_pages.find(ref.hash);
+	if (it != m_pages.end()) {
+		ref = it->second;
+		++m_shared;
+		return true;
+	}
+
+	Bytef buf[PAGE_SIZE + PAGE_SIZE / 2];
+	uLongf clen = sizeof(buf);
+	const char *out = data;
+	if (compress2(buf, &clen, (const Bytef *) data, len, Z_BEST_SPEED) == Z_OK
+		&& clen < len * 3 / 4) {
+		ref.encoding = ZLIB;
+		ref.length = clen;
+		ref.offset = m_pack_size;
+		out = (const char *) buf;
+	} else {
+		// raw pages are page-aligned
+		ref.encoding = RAW;
+		ref.length = len;
+		ref.offset = (m_pack_size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+	}
+	if (!write_all(m_pack, out, ref.length, ref.offset)
+		|| write(m_index, &ref, sizeof(ref)) != sizeof(ref)) {
+		return false;
+	}
+	m_pack_size = ref.offset + ref.length;
+	m_pages[ref.hash] = ref;
+	++m_stored;
+	return true;
+}
+
+bool PageStore::store(const void *data, size_t size, FILE *manifest)
+{
+	if (!isOpen() || !m_writable) {
+		return false;
+	}
+	// other processes may append to the same store
+	FileLock lock(m_pack);
+	struct stat st;
+	if (!lock.locked() || fstat(m_pack, &st) != 0) {
+		return false;
+	}
+	m_pack_size = st.st_size;
+	if (!loadIndex()) {
+		return false;
+	}
+	ManifestHeader hdr;
+	memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+	hdr.size = size;
+	hdr.pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	if (fwrite(&hdr, sizeof(hdr), 1, manifest) != 1) {
+		return false;
+	}
+
+	static const char zero[PAGE_SIZE] = { 0 };
+	const char *p = static_cast<const char *>(data);
+	for (uint64_t i = 0; i < hdr.pages; ++i) {
+		size_t len = std::min<size_t>(PAGE_SIZE, size - i * PAGE_SIZE);
+		PageRef ref;
+		if (memcmp(p + i * PAGE_SIZE, zero, len) == 0) {
+			memset(&ref, 0, sizeof(ref));
+			ref.encoding = ZERO;
+			++m_zero;
+		} else if (!addPage(p + i * PAGE_SIZE, len, ref)) {
+			return false;
+		}
+		if (fwrite(&ref, sizeof(ref), 1, manifest) != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PageStore::isManifest(FILE *stream)
+{
+	char magic[sizeof(MAGIC)];
+	long pos = ftell(stream);
+	bool found = fread(magic, sizeof(magic), 1, stream) == 1
+		&& memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+	fseek(stream, pos, SEEK_SET);
+	return found;
+}
+
+bool PageStore::readPage(const PageRef& ref, char *dest, size_t len)
+{
+	if (ref.encoding == ZERO) {
+		memset(dest, 0, len);
+		return true;
+	}
+	if (ref.offset + ref.length > m_mapped) {
+		// the pack grew since it was mapped
+		struct stat st;
+		if (fstat(m_pack, &st) != 0 || ref.offset + ref.length > (uint64_t) st.st_size) {
+			return false;
+		}
+		if (m_map) {
+			munmap(const_cast<char *>(m_map), m_mapped);
+			m_map = 0;
+		}
+		void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, m_pack, 0);
+		if (map == MAP_FAILED) {
+			m_mapped = 0;
+			return false;
+		}
+		m_map = static_cast<const char *>(map);
+		m_mapped = st.st_size;
+	}
+	if (ref.encoding == RAW) {
+		if (ref.length != len) {
+			return false;
+		}
+		memcpy(dest, m_map + ref.offset, len);
+		return true;
+	}
+	uLongf dlen = len;
+	return uncompress((Bytef *) dest, &dlen, (const Bytef *) m_map + ref.offset, ref.length) == Z_OK
+		&& dlen == len;
+}
+
+size_t PageStore::restore(FILE *manifest, void *dest, size_t size)
+{
+	ManifestHeader hdr;
+	if (!isOpen() || fread(&hdr, sizeof(hdr), 1, manifest) != 1
+		|| memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) != 0) {
+		return 0;
+	}
+	size = std::min<size_t>(size, hdr.size);
+	char *p = static_cast<char *>(dest);
+	size_t done = 0;
+	for (uint64_t i = 0; i < hdr.pages && done < size; ++i) {
+		PageRef ref;
+		if (fread(&ref, sizeof(ref), 1, manifest) != 1) {
+			break;
+		}
+		size_t len = std::min<size_t>(PAGE_SIZE, hdr.size - i * PAGE_SIZE);
+		if (done + len > size || !readPage(ref, p + done, len)) {
+			break;
+		}
+		done += len;
+	}
+	return done;
+}
+
+} // end-of-namespace: fail
@@ -0,0 +1,119 @@
+#ifndef __PAGE_STORE_HPP__
+#define __PAGE_STORE_HPP__
+
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+
+namespace fail {
+
+/**
+ * \class PageStore
+ *
+ * Content-addressed storage for the large binary blobs (mainly the RAM
+ * image) of simulator snapshots.  A blob is split into pages, which are
+ * identified by a 128-bit hash of their contents and kept once per store,
+ * no matter how many snapshots contain them.  The snapshot itself only keeps
+ * a small manifest, i.e., the list of page references.
+ *
+ * A store is a directory with two files:
+ * - "pages.dat": the page contents, appended in order of their first
+ *   occurrence.  Pages that compress well (zlib, fastest level) are stored
+ *   compressed, all others raw at page-aligned offsets.
+ * - "pages.idx": (hash, offset, length, encoding) of each stored page.
+ * Pages that only contain zeroes are never stored.
+ *
+ * Restoring maps "pages.dat" into memory and copies (or inflates) the
+ * referenced pages directly into the destination, so all processes on a
+ * host share the page cache, and there is no stream decompression of the
+ * whole image.  Several processes may write to a store at the same time:
+ * store() holds an exclusive flock() on "pages.dat", picks up the pages the
+ * others added in the meantime, and appends at the current end of the file.
+ */
+class PageStore {
+public:
+	static const size_t PAGE_SIZE = 4096;
+
+	struct Hash {
+		uint64_t h[2];
+		bool operator==(const Hash& other) const { return h[0] == other.h[0] && h[1] == other.h[1]; }
+	};
+
+	enum Encoding { ZERO = 0, RAW = 1, ZLIB = 2 };
+
+	//! a page in the store, as found in the index and the manifests
+	struct PageRef {
+		Hash hash;
+		uint64_t offset;  //!< within pages.dat
+		uint32_t length;  //!< stored (i.e., maybe compressed) length
+		uint32_t encoding;
+	};
+
+private:
+	struct HashHasher {
+		size_t operator()(const Hash& h) const { return h.h[0]; }
+	};
+
+	std::string m_dir;
+	int m_pack;           //!< pages.dat
+	int m_index;          //!< pages.idx
+	bool m_writable;
+	uint64_t m_index_pos;  //!< bytes of pages.idx loaded into m_pages
+	uint64_t m_pack_size;
+	const char *m_map;    //!< pages.dat, mapped read-only
+	uint64_t m_mapped;
+	std::unordered_map<Hash, PageRef, HashHasher> m_pages; //!< the index
+
+	uint64_t m_stored, m_shared, m_zero;
+
+	static Hash hashPage(const char *data, size_t len);
+	bool loadIndex();
+	bool addPage(const char *data, size_t len, PageRef& ref);
+	bool readPage(const PageRef& ref, char *dest, size_t len);
+
+public:
+	PageStore() : m_pack(-1), m_index(-1), m_writable(false), m_index_pos(0),
+		m_pack_size(0), m_map(0), m_mapped(0),
+		m_stored(0), m_shared(0), m_zero(0) { }
+	~PageStore() { close(); }
+
+	/**
+	 * Opens (or creates) the store in directory \a dir.
+	 * @return \c true on success
+	 */
+	bool open(const std::string& dir);
+	void close();
+	bool isOpen() const { return m_pack != -1; }
+	const std::string& getDirectory() const { return m_dir; }
+
+	/**
+	 * Stores the blob [\a data, \a data + \a size) and writes its manifest
+	 * to \a manifest.
+	 * @return \c true on success
+	 */
+	bool store(const void *data, size_t size, FILE *manifest);
+
+	/**
+	 * Checks whether \a stream (at its beginning) contains a manifest
+	 * written by store().  The stream position is left unchanged.
+	 */
+	static bool isManifest(FILE *stream);
+
+	/**
+	 * Restores the blob described by the manifest in \a manifest to
+	 * \a dest, which has room for \a size bytes.
+	 * @return the number of restored bytes (\a size on success)
+	 */
+	size_t restore(FILE *manifest, void *dest, size_t size);
+
+	//! pages written to the store / found in the store / zero pages
+	uint64_t getStoredPages() const { return m_stored; }
+	uint64_t getSharedPages() const { return m_shared; }
+	uint64_t getZeroPages() const { return m_zero; }
+};
+
+} // end-of-namespace: fail
+
+#endif // __PAGE_STORE_HPP__
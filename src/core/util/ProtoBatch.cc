@@ -0,0 +1,44 @@
+#include <string.h>
+#include <netinet/in.h>
+#include "ProtoBatch.hpp"
+
+namespace fail {
+
+bool ProtoBatch::fill(ProtoIStream& ps, size_t size)
+{
+	while (data.size() < size) {
+		if (!ps.readFrame(data)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ProtoBatch::next(size_t& pos, const char *&msg, uint32_t& size) const
+{
+	if (pos + sizeof(size) > data.size()) {
+		return false;
+	}
+	memcpy(&size, &data[pos], sizeof(size));
+	size = ntohl(size);
+	msg = &data[pos + sizeof(size)];
+	pos += sizeof(size) + size;
+	return true;
+}
+
+void ProtoBatch::finish()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_done = true;
+	m_cond.notify_all();
+}
+
+void ProtoBatch::wait()
+{
+	boost::unique_lock<boost::mutex> lock(m_mutex);
+	while (!m_done) {
+		m_cond.wait(lock);
+	}
+}
+
+} // end-of-namespace: fail
@@ -0,0 +1,64 @@
+#ifndef __PROTOBATCH_HPP__
+#define __PROTOBATCH_HPP__
+
+#include <string>
+#include <stdint.h>
+
+#ifndef __puma
+#include <boost/thread.hpp>
+#endif
+
+#include "ProtoStream.hpp"
+
+namespace fail {
+
+/**
+ * \class ProtoBatch
+ *
+ * A chunk of encoded protobuf messages in the format written by
+ * ProtoOStream, which one thread reads (or collects) and hands to worker
+ * threads through a SynchronizedQueue.  Tools derive from it to store the
+ * per-batch results of the workers; a thread that consumes the batches in
+ * their original order uses \c wait() to block until the worker has called
+ * \c finish().
+ */
+class ProtoBatch {
+private:
+	bool m_done;
+#ifndef __puma
+	boost::mutex m_mutex;
+	boost::condition_variable m_cond;
+#endif
+public:
+	std::string data; //!< the encoded messages
+	ProtoBatch() : m_done(false) { }
+	virtual ~ProtoBatch() { }
+	/**
+	 *	Appends messages read from \c ps until the batch holds at least
+	 *  \c size bytes.
+	 *  @return Returns \c false if the stream ended, see
+	 *          \c ProtoIStream::truncated()
+	 */
+	bool fill(ProtoIStream& ps, size_t size);
+	/**
+	 *	Iterates over the messages in \c data.
+	 *  @param pos The position of the next message, 0 for the first; it
+	 *         is advanced to the following one
+	 *  @param msg Set to the encoded message
+	 *  @param size Set to its length
+	 *  @return Returns \c false if there are no more messages
+	 */
+	bool next(size_t& pos, const char *&msg, uint32_t& size) const;
+	/**
+	 *	Marks the batch as processed and wakes up \c wait().
+	 */
+	void finish();
+	/**
+	 *	Blocks until \c finish() has been called.
+	 */
+	void wait();
+};
+
+} // end-of-namespace: fail
+
+#endif // __PROTOBATCH_HPP__
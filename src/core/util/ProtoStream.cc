@@ -1,3 +1,4 @@
+#include <string.h>
 #include "ProtoStream.hpp"
 
 namespace fail {
@@ -25,7 +26,7 @@ bool ProtoOStream::writeMessage(google::protobuf::Message *m)
 	return true;
 }
 
-ProtoIStream::ProtoIStream(std::istream *infile) : m_infile(infile)
+ProtoIStream::ProtoIStream(std::istream *infile) : m_infile(infile), m_truncated(false)
 {
 	m_log.setDescription("ProtoStream");
 	// TODO: log-Level?
@@ -36,27 +37,35 @@ void ProtoIStream::reset()
 {
 	m_infile->clear();
 	m_infile->seekg(0, std::ios::beg);
+	m_truncated = false;
 }
 
 bool ProtoIStream::getNext(google::protobuf::Message *m)
 {
-	uint32_t m_size;
-	m_infile->read(reinterpret_cast<char*>(&m_size), sizeof(m_size));
-	if (!m_infile->good())
+	m_buf.clear();
+	if (!readFrame(m_buf))
 		return false;
-	m_size = ntohl(m_size);
+	m->ParseFromArray(m_buf.data() + sizeof(uint32_t), m_buf.size() - sizeof(uint32_t));
+	return true;
+}
 
-	// FIXME reuse buffer (efficiency)
-	// FIXME new[] may fail (i.e., return 0)
-	char *buf = new char[m_size];
-	m_infile->read(buf, m_size);
+bool ProtoIStream::readFrame(std::string& buf)
+{
+	uint32_t size_n;
+	m_infile->read(reinterpret_cast<char*>(&size_n), sizeof(size_n));
 	if (!m_infile->good())
-		// FIXME we're leaking buf[]
 		return false;
-	std::string st(buf, m_size);
-	m->ParseFromString(st);
+	uint32_t m_size = ntohl(size_n);
 
-	delete [] buf;
+	size_t pos = buf.size();
+	buf.resize(pos + sizeof(size_n) + m_size);
+	memcpy(&buf[pos], &size_n, sizeof(size_n));
+	m_infile->read(&buf[pos + sizeof(size_n)], m_size);
+	if (!m_infile->good()) {
+		buf.resize(pos);
+		m_truncated = true;
+		return false;
+	}
 	return true;
 }
 
@@ -18,6 +18,7 @@
 #define __PROTOSTREAM_HPP__
 
 #include <iostream>
+#include <string>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <google/protobuf/message.h>
@@ -59,6 +60,8 @@ private:
 	// TODO: comments needed here
 	Logger m_log;
 	std::istream *m_infile;
+	std::string m_buf;
+	bool m_truncated;
 public:
 	ProtoIStream(std::istream *infile);
 	virtual ~ProtoIStream() { }
@@ -73,6 +76,18 @@ public:
 	 *  @return Returns \c true on success, \c false otherwise
 	 */
 	bool getNext(google::protobuf::Message * m);
+	/**
+	 *	Appends the next message to \c buf without decoding it, together
+	 *  with its length information (see ProtoBatch).
+	 *  @param buf The buffer the message is appended to
+	 *  @return Returns \c true on success, \c false at the end of the
+	 *          stream or if the message is incomplete (see \c truncated())
+	 */
+	bool readFrame(std::string& buf);
+	/**
+	 *	@return Returns \c true if the stream ended within a message
+	 */
+	bool truncated() const { return m_truncated; }
 };
 
 } // end-of-namespace: fail
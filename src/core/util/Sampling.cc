@@ -0,0 +1,144 @@
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <boost/thread.hpp>
+#include "Sampling.hpp"
+
+namespace fail {
+
+// samples drawn from one RNG stream, the unit of work for the threads
+static const uint64_t SAMPLE_CHUNK = 1 << 20;
+
+uint64_t random_seed()
+{
+	std::ifstream dev_urandom("/dev/urandom", std::ifstream::binary);
+	uint64_t seed;
+	if (!dev_urandom.read((char *) &seed, sizeof(seed))) {
+		seed = SampleRNG::mix(time(0) ^ ((uint64_t) getpid() << 32));
+	}
+	return seed;
+}
+
+void AliasTable::build(const std::vector<uint64_t>& weights)
+{
+	size_t n = weights.size();
+	m_prob.assign(n, 0.0);
+	m_alias.assign(n, 0);
+
+	long double total = 0;
+	for (size_t i = 0; i < n; ++i) {
+		total += weights[i];
+	}
+
+	// scale weights to an average of 1, then let each "small" column be
+	// topped up by a "large" one (Vose)
+	std::vector<double> scaled(n);
+	std::vector<uint32_t> small, large;
+	for (size_t i = 0; i < n; ++i) {
+		scaled[i] = (double) (weights[i] * (long double) n / total);
+		if (scaled[i] < 1.0) {
+			small.push_back(i);
+		} else {
+			large.push_back(i);
+		}
+	}
+	while (!small.empty() && !large.empty()) {
+		uint32_t s = small.back(), l = large.back();
+		small.pop_back();
+		m_prob[s] = scaled[s];
+		m_alias[s] = l;
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if (scaled[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// leftovers are (up to rounding errors) exactly full
+	for (size_t i = 0; i < large.size(); ++i) {
+		m_prob[large[i]] = 1.0;
+		m_alias[large[i]] = large[i];
+	}
+	size_t fallback = 0;
+	while (fallback < n - 1 && weights[fallback] == 0) {
+		++fallback;
+	}
+	for (size_t i = 0; i < small.size(); ++i) {
+		if (weights[small[i]] > 0) {
+			m_prob[small[i]] = 1.0;
+			m_alias[small[i]] = small[i];
+		} else {
+			m_alias[small[i]] = fallback;
+		}
+	}
+}
+
+namespace {
+
+// Draws the sample positions of chunks taken from a shared counter
+class PositionWorker {
+	uint64_t total, seed;
+	boost::mutex *mutex;
+	uint64_t *next_chunk;
+	std::vector<uint64_t> *positions;
+public:
+	PositionWorker(uint64_t total, uint64_t seed, boost::mutex *mutex,
+		uint64_t *next_chunk, std::vector<uint64_t> *positions)
+		: total(total), seed(seed), mutex(mutex), next_chunk(next_chunk),
+		  positions(positions) {}
+	void operator()();
+};
+
+void PositionWorker::operator()()
+{
+	SampleRNG rng;
+	while (true) {
+		uint64_t chunk;
+		{
+			boost::lock_guard<boost::mutex> lock(*mutex);
+			chunk = (*next_chunk)++;
+		}
+		uint64_t start = chunk * SAMPLE_CHUNK;
+		if (start >= positions->size()) {
+			break;
+		}
+		uint64_t end = std::min<uint64_t>(positions->size(), start + SAMPLE_CHUNK);
+		rng.seed(derive_seed(seed, chunk));
+		for (uint64_t i = start; i < end; ++i) {
+			(*positions)[i] = rng.below(total);
+		}
+	}
+}
+
+} // anonymous namespace
+
+SortedSampler::SortedSampler(uint64_t total_weight, uint64_t count, uint64_t seed, unsigned threads)
+	: m_next(0), m_offset(0)
+{
+	if (total_weight == 0 || count == 0) {
+		return;
+	}
+	m_positions.resize(count);
+	uint64_t chunks = (count + SAMPLE_CHUNK - 1) / SAMPLE_CHUNK;
+	if (threads == 0) {
+		threads = 1;
+	}
+	if (threads > chunks) {
+		threads = chunks;
+	}
+	boost::mutex mutex;
+	uint64_t next_chunk = 0;
+	if (threads == 1) {
+		PositionWorker(total_weight, seed, &mutex, &next_chunk, &m_positions)();
+	} else {
+		boost::thread_group workers;
+		for (unsigned i = 0; i < threads; ++i) {
+			workers.create_thread(PositionWorker(total_weight, seed, &mutex, &next_chunk, &m_positions));
+		}
+		workers.join_all();
+	}
+	std::sort(m_positions.begin(), m_positions.end());
+}
+
+} // end-of-namespace: fail
@@ -0,0 +1,214 @@
+#ifndef __SAMPLING_HPP__
+#define __SAMPLING_HPP__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+// Building blocks for weighted fault-space sampling:
+//
+// - SampleRNG, a small and fast seedable pseudo-random number generator
+//   (xoshiro256**), so sampling results can be reproduced from a seed.
+// - AliasTable, Walker's/Vose's alias method for picking an element with a
+//   probability proportional to its weight in O(1), i.e., sampling with
+//   replacement.
+// - SortedSampler and WeightedReservoir, streaming sampling with and without
+//   replacement for populations too large to be kept in memory: the elements
+//   are offered one by one, and only the sample itself needs to be stored.
+
+namespace fail {
+
+class SampleRNG {
+	uint64_t s[4];
+
+	static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+public:
+	explicit SampleRNG(uint64_t seed = 0) { this->seed(seed); }
+
+	//! (Re)initializes the state from a 64-bit seed.
+	void seed(uint64_t seed)
+	{
+		for (int i = 0; i < 4; ++i) {
+			seed += 0x9e3779b97f4a7c15ULL;
+			s[i] = mix(seed);
+		}
+	}
+
+	//! Next 64 random bits.
+	uint64_t operator()()
+	{
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	//! Uniformly distributed number in [0, bound), bound > 0.
+	uint64_t below(uint64_t bound)
+	{
+		// Lemire's multiply-and-reject method, no division in the common case
+		unsigned __int128 m = (unsigned __int128) (*this)() * bound;
+		uint64_t low = (uint64_t) m;
+		if (low < bound) {
+			uint64_t threshold = -bound % bound;
+			while (low < threshold) {
+				m = (unsigned __int128) (*this)() * bound;
+				low = (uint64_t) m;
+			}
+		}
+		return m >> 64;
+	}
+
+	//! Uniformly distributed number in [0, 1).
+	double uniform() { return ((*this)() >> 11) * (1.0 / (1ULL << 53)); }
+
+	//! splitmix64 finalizer, maps a counter to well-distributed bits.
+	static uint64_t mix(uint64_t x)
+	{
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+};
+
+//! A seed from /dev/urandom, for runs that need not be reproduced.
+uint64_t random_seed();
+
+//! Seed of an independent stream (e.g., per variant or per chunk of work).
+inline uint64_t derive_seed(uint64_t seed, uint64_t stream)
+{
+	return SampleRNG::mix(seed ^ SampleRNG::mix(stream + 0x9e3779b97f4a7c15ULL));
+}
+
+class AliasTable {
+	std::vector<double> m_prob;
+	std::vector<uint32_t> m_alias;
+public:
+	AliasTable() {}
+	explicit AliasTable(const std::vector<uint64_t>& weights) { build(weights); }
+
+	//! Builds the table in O(n).  At least one weight must be non-zero.
+	void build(const std::vector<uint64_t>& weights);
+	size_t size() const { return m_prob.size(); }
+
+	//! Index of an element, picked with a probability proportional to its weight.
+	size_t sample(SampleRNG& rng) const
+	{
+		size_t i = rng.below(m_prob.size());
+		return rng.uniform() < m_prob[i] ? i : m_alias[i];
+	}
+};
+
+/**
+ * Key of element "index" with weight "weight" > 0 in weighted sampling
+ * without replacement (Efraimidis/Spirakis: u^(1/w), in the log domain).
+ * The elements with the largest keys form the sample, the probability of an
+ * element being picked next always being proportional to its weight among
+ * the remaining ones; u in (0, 1) only depends on the seed and the index.
+ */
+inline double weighted_key(uint64_t seed, uint64_t index, uint64_t weight)
+{
+	double u = ((SampleRNG::mix(seed ^ SampleRNG::mix(index)) >> 11) + 0.5) * (1.0 / (1ULL << 53));
+	return log(u) / weight;
+}
+
+/**
+ * Streaming sampling with replacement: draws "count" positions within the
+ * total weight up front and keeps them sorted (O(count) memory).  The
+ * elements must then be passed to hits() in a fixed order, which returns
+ * how often each one was picked.  The total weight must be known in advance
+ * (e.g., from an SQL aggregate).  The result only depends on the seed, not
+ * on the number of threads.
+ */
+class SortedSampler {
+	std::vector<uint64_t> m_positions;
+	size_t m_next;
+	uint64_t m_offset;
+public:
+	SortedSampler(uint64_t total_weight, uint64_t count, uint64_t seed, unsigned threads);
+
+	//! Number of times the next element (with the given weight) was picked.
+	uint32_t hits(uint64_t weight)
+	{
+		m_offset += weight;
+		size_t first = m_next;
+		while (m_next < m_positions.size() && m_positions[m_next] < m_offset) {
+			++m_next;
+		}
+		return m_next - first;
+	}
+	//! All samples assigned to an element?
+	bool done() const { return m_next == m_positions.size(); }
+};
+
+/**
+ * Streaming sampling without replacement (reservoir-style): keeps the
+ * "count" offered elements with the largest weighted_key(), together with
+ * a payload, in O(count) memory.  The picks only depend on the seed and the
+ * elements' indexes and weights, not on the order they are offered in.
+ */
+template <typename T>
+class WeightedReservoir {
+	struct Candidate {
+		double key;
+		uint64_t index;
+		T item;
+		// min-heap order: the weakest candidate first
+		bool operator<(const Candidate& other) const
+		{
+			return key > other.key || (key == other.key && index > other.index);
+		}
+	};
+	std::vector<Candidate> m_heap;
+	uint64_t m_count, m_seed;
+public:
+	WeightedReservoir(uint64_t count, uint64_t seed) : m_count(count), m_seed(seed) {}
+
+	//! Offers element "index"; zero weights are never picked.
+	void offer(uint64_t index, uint64_t weight, const T& item)
+	{
+		if (weight == 0 || m_count == 0) {
+			return;
+		}
+		Candidate c;
+		c.key = weighted_key(m_seed, index, weight);
+		if (m_heap.size() == m_count && !(c.key > m_heap.front().key)) {
+			return;
+		}
+		c.index = index;
+		c.item = item;
+		if (m_heap.size() == m_count) {
+			std::pop_heap(m_heap.begin(), m_heap.end());
+			m_heap.back() = c;
+		} else {
+			m_heap.push_back(c);
+		}
+		std::push_heap(m_heap.begin(), m_heap.end());
+	}
+
+	size_t size() const { return m_heap.size(); }
+
+	//! The picked items, in the order they were drawn; empties the reservoir.
+	void result(std::vector<T>& picked)
+	{
+		std::sort_heap(m_heap.begin(), m_heap.end());
+		picked.clear();
+		picked.reserve(m_heap.size());
+		for (size_t i = 0; i < m_heap.size(); ++i) {
+			picked.push_back(m_heap[i].item);
+		}
+		std::vector<Candidate>().swap(m_heap);
+	}
+};
+
+} // end-of-namespace: fail
+
+#endif // __SAMPLING_HPP__
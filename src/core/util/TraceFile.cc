@@ -0,0 +1,29 @@
+#include "TraceFile.hpp"
+
+namespace fail {
+
+std::istream *openStream(const char *input_file,
+	std::ifstream& normal_stream, igzstream& gz_stream)
+{
+	normal_stream.open(input_file);
+	if (!normal_stream) {
+		return 0;
+	}
+	unsigned char b1, b2;
+	normal_stream >> b1 >> b2;
+
+	if (b1 == 0x1f && b2 == 0x8b) {
+		normal_stream.close();
+		gz_stream.open(input_file);
+		if (!gz_stream) {
+			return 0;
+		}
+		return &gz_stream;
+	}
+
+	normal_stream.clear();
+	normal_stream.seekg(0);
+	return &normal_stream;
+}
+
+} // end-of-namespace: fail
@@ -0,0 +1,25 @@
+#ifndef __TRACEFILE_HPP__
+#define __TRACEFILE_HPP__
+
+#include <iostream>
+#include <fstream>
+
+#include "gzstream/gzstream.h"
+
+namespace fail {
+
+/**
+ * Opens a trace file (or any other file written by ProtoOStream) for
+ * reading, transparently decompressing it if it is gzipped.
+ * @param input_file The file name
+ * @param normal_stream Used for an uncompressed file
+ * @param gz_stream Used for a gzipped file
+ * @return Returns the stream to read from (one of the two), or 0 if the
+ *         file cannot be opened
+ */
+std::istream *openStream(const char *input_file,
+	std::ifstream& normal_stream, igzstream& gz_stream);
+
+} // end-of-namespace: fail
+
+#endif // __TRACEFILE_HPP__
@@ -157,6 +157,9 @@ int CapstoneDisassembler::disassemble_section(Elf_Data *data, Elf32_Shdr *shdr32
 					instr.address = insn[j].address;
 					// FIXME could not find a functionality in capstone
 					instr.conditional_branch = false;
+					instr.call_or_ret = insn[j].detail
+						&& (cs_insn_group(handle, &insn[j], CS_GRP_CALL)
+						    || cs_insn_group(handle, &insn[j], CS_GRP_RET));
 
 					if (read_count > 0) {
 //                        printf("\n\tRegisters read:");
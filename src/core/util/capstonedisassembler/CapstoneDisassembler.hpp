@@ -43,6 +43,7 @@ public:
 		unsigned int address;
 		unsigned char length;
 		bool conditional_branch;
+		bool call_or_ret;
 		std::vector<register_t> reg_uses;
 		std::vector<register_t> reg_defs;
 	};
@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "CapstoneInstrCache.hpp"
+#include "util/Logger.hpp"
+
+using namespace fail;
+
+static Logger LOG("CapstoneInstrCache", false);
+
+// sidecar layout (host byte order):
+//   magic[8] | elf hash (u64) | entry count (u64) | entries: address (u32), length (u8), flags (u8)
+static const char CACHE_MAGIC[8] = { 'F', 'A', 'I', 'L', 'I', 'N', 'S', '1' };
+static const size_t ENTRY_SIZE = sizeof(uint32_t) + 2;
+
+bool CapstoneInstrCache::hashFile(const std::string &path, uint64_t &hash)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in) {
+		return false;
+	}
+	hash = 14695981039346656037ULL;
+	char buf[65536];
+	while (in.read(buf, sizeof(buf)) || in.gcount() > 0) {
+		for (std::streamsize i = 0; i < in.gcount(); ++i) {
+			hash ^= (unsigned char) buf[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return true;
+}
+
+void CapstoneInstrCache::fill(CapstoneDisassembler &disas)
+{
+	const CapstoneDisassembler::InstrMap &instrs = disas.getInstrMap();
+	m_table.clear();
+	m_table.reserve(instrs.size());
+	for (CapstoneDisassembler::InstrMap::const_iterator it = instrs.begin();
+		 it != instrs.end(); ++it) {
+		Entry e;
+		e.address = it->second.address;
+		e.length = it->second.length;
+		e.flags = it->second.call_or_ret ? CALL_OR_RET : 0;
+		m_table.push_back(e);
+	}
+}
+
+bool CapstoneInstrCache::read(const std::string &cache_path, uint64_t elf_hash)
+{
+	std::ifstream in(cache_path.c_str(), std::ios::binary);
+	if (!in) {
+		return false;
+	}
+	char magic[sizeof(CACHE_MAGIC)];
+	uint64_t hash, count;
+	if (!in.read(magic, sizeof(magic))
+		|| memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0
+		|| !in.read((char *) &hash, sizeof(hash))
+		|| hash != elf_hash
+		|| !in.read((char *) &count, sizeof(count))) {
+		return false;
+	}
+	// a truncated or corrupt sidecar must not make us allocate count entries
+	std::streampos pos = in.tellg();
+	in.seekg(0, std::ios::end);
+	std::streamoff left = in.tellg() - pos;
+	in.seekg(pos);
+	if (!in || left < 0 || count != (uint64_t) left / ENTRY_SIZE
+		|| (uint64_t) left % ENTRY_SIZE != 0) {
+		LOG << "ignoring malformed instruction cache " << cache_path << std::endl;
+		return false;
+	}
+	std::vector<char> buf(count * ENTRY_SIZE);
+	if (!in.read(buf.data(), buf.size())) {
+		return false;
+	}
+	m_table.resize(count);
+	const char *p = buf.data();
+	for (uint64_t i = 0; i < count; ++i, p += ENTRY_SIZE) {
+		memcpy(&m_table[i].address, p, sizeof(uint32_t));
+		m_table[i].length = p[4];
+		m_table[i].flags = p[5];
+	}
+	m_elf_hash = elf_hash;
+	return true;
+}
+
+bool CapstoneInstrCache::write(const std::string &cache_path, uint64_t elf_hash) const
+{
+	// write to a temporary file first: concurrent readers (parallel
+	// pruners, several import-trace runs) never see a partial sidecar
+	std::string tmp_path = cache_path + ".tmp";
+	{
+		std::ofstream out(tmp_path.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out) {
+			return false;
+		}
+		uint64_t count = m_table.size();
+		out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		out.write((const char *) &elf_hash, sizeof(elf_hash));
+		out.write((const char *) &count, sizeof(count));
+		std::vector<char> buf(count * ENTRY_SIZE);
+		char *p = buf.data();
+		for (table_t::const_iterator it = m_table.begin(); it != m_table.end(); ++it, p += ENTRY_SIZE) {
+			memcpy(p, &it->address, sizeof(uint32_t));
+			p[4] = it->length;
+			p[5] = it->flags;
+		}
+		out.write(buf.data(), buf.size());
+		if (!out) {
+			std::remove(tmp_path.c_str());
+			return false;
+		}
+	}
+	return std::rename(tmp_path.c_str(), cache_path.c_str()) == 0;
+}
+
+bool CapstoneInstrCache::load(const std::string &elf_path, const std::string &cache_path)
+{
+	std::string path = cache_path.empty() ? defaultPath(elf_path) : cache_path;
+	uint64_t hash;
+	if (!hashFile(elf_path, hash)) {
+		LOG << "could not read " << elf_path << std::endl;
+		return false;
+	}
+	if (hash == m_elf_hash && !m_table.empty()) {
+		// already loaded for this binary
+		return true;
+	}
+	if (read(path, hash)) {
+		return true;
+	}
+
+	ElfReader elf(elf_path.c_str());
+	CapstoneDisassembler disas(&elf);
+	disas.disassemble();
+	fill(disas);
+	m_elf_hash = hash;
+	if (!write(path, hash)) {
+		// not fatal, we only lose the cache
+		LOG << "could not write instruction cache " << path << std::endl;
+	}
+	return true;
+}
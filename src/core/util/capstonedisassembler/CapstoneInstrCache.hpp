@@ -0,0 +1,76 @@
+#ifndef __CAPSTONEINSTRCACHE_HPP_
+#define __CAPSTONEINSTRCACHE_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "CapstoneDisassembler.hpp"
+
+namespace fail {
+
+/**
+ * Compact table of the static instructions of an ELF binary (address,
+ * length, call/return flag), as decoded by the CapstoneDisassembler.
+ *
+ * The table can be stored in a binary sidecar file next to the ELF binary.
+ * The sidecar is keyed by a hash of the ELF file's contents: a sidecar
+ * written for a different (e.g., rebuilt) binary is ignored and replaced.
+ * Tools that only need instruction boundaries (like the region pruners) can
+ * thereby skip both the disassembly and the objdump table.
+ */
+class CapstoneInstrCache {
+public:
+	enum {
+		CALL_OR_RET = 1
+	};
+
+	struct Entry {
+		uint32_t address;
+		uint8_t length;
+		uint8_t flags;
+	};
+	//! sorted by address
+	typedef std::vector<Entry> table_t;
+
+private:
+	table_t m_table;
+	uint64_t m_elf_hash;
+
+public:
+	CapstoneInstrCache() : m_elf_hash(0) {}
+
+	const table_t &getTable() const { return m_table; }
+	bool empty() const { return m_table.empty(); }
+	uint64_t getElfHash() const { return m_elf_hash; }
+
+	/**
+	 * Returns the instruction table of the given ELF binary: from the
+	 * sidecar file, if it matches the binary, otherwise by disassembling
+	 * the binary and (re)writing the sidecar.
+	 * @param elf_path path of the ELF binary
+	 * @param cache_path sidecar file, defaultPath(elf_path) if empty
+	 * @return false if the ELF binary could not be read
+	 */
+	bool load(const std::string &elf_path, const std::string &cache_path = "");
+
+	/**
+	 * Fills the table from an already disassembled binary.
+	 */
+	void fill(CapstoneDisassembler &disas);
+
+	//! Reads the sidecar; fails if missing, damaged or not matching elf_hash.
+	bool read(const std::string &cache_path, uint64_t elf_hash);
+	//! Writes the sidecar for the binary with the given hash.
+	bool write(const std::string &cache_path, uint64_t elf_hash) const;
+
+	//! 64-bit FNV-1a hash over the file's contents
+	static bool hashFile(const std::string &path, uint64_t &hash);
+	static std::string defaultPath(const std::string &elf_path) {
+		return elf_path + ".instrs";
+	}
+};
+
+} // end of namespace
+
+#endif // __CAPSTONEINSTRCACHE_HPP_
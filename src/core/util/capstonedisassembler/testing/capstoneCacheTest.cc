@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <iostream>
+#include "util/ElfReader.hpp"
+#include "../CapstoneInstrCache.hpp"
+
+using namespace fail;
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " ELF CACHEFILE" << std::endl;
+		return -1;
+	}
+	std::string elf_path = argv[1];
+	std::string cache_path = argv[2];
+	std::remove(cache_path.c_str());
+
+	// first load disassembles and writes the sidecar
+	CapstoneInstrCache written;
+	if (!written.load(elf_path, cache_path) || written.empty()) {
+		std::cerr << "disassembly failed" << std::endl;
+		return 1;
+	}
+
+	// must match what the disassembler sees
+	ElfReader elf(elf_path.c_str());
+	CapstoneDisassembler disas(&elf);
+	disas.disassemble();
+	CapstoneDisassembler::InstrMap &instr_map = disas.getInstrMap();
+	if (instr_map.size() != written.getTable().size()) {
+		std::cerr << "size mismatch" << std::endl;
+		return 1;
+	}
+
+	// second load must come from the sidecar, with identical contents
+	CapstoneInstrCache read;
+	if (!read.read(cache_path, written.getElfHash())) {
+		std::cerr << "reading the sidecar failed" << std::endl;
+		return 1;
+	}
+	const CapstoneInstrCache::table_t &a = written.getTable(), &b = read.getTable();
+	unsigned calls = 0;
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (a[i].address != b[i].address || a[i].length != b[i].length
+			|| a[i].flags != b[i].flags) {
+			std::cerr << "entry " << i << " differs" << std::endl;
+			return 1;
+		}
+		const CapstoneDisassembler::Instr &instr = instr_map[a[i].address];
+		if (instr.length != a[i].length) {
+			std::cerr << "length of " << std::hex << a[i].address << " differs" << std::endl;
+			return 1;
+		}
+		calls += (a[i].flags & CapstoneInstrCache::CALL_OR_RET) != 0;
+	}
+	if (calls == 0) {
+		std::cerr << "no calls/returns found" << std::endl;
+		return 1;
+	}
+
+	// a sidecar of a different binary is rejected
+	if (read.read(cache_path, written.getElfHash() + 1)) {
+		std::cerr << "sidecar with wrong hash accepted" << std::endl;
+		return 1;
+	}
+
+	std::cout << a.size() << " instructions, " << calls << " calls/returns" << std::endl;
+	std::remove(cache_path.c_str());
+	return 0;
+}
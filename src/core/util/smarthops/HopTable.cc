@@ -0,0 +1,147 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "HopTable.hpp"
+
+namespace fail {
+
+const char HopTable::MAGIC[8] = { 'F', 'A', 'I', 'L', 'H', 'O', 'P', '1' };
+
+bool HopTable::open(const std::string& path)
+{
+	close();
+	m_fd = ::open(path.c_str(), O_RDONLY);
+	if (m_fd == -1) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(m_fd, &st) != 0 || (size_t) st.st_size < sizeof(Trailer)) {
+		close();
+		return false;
+	}
+	void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (map == MAP_FAILED) {
+		close();
+		return false;
+	}
+	m_map = static_cast<const char *>(map);
+	m_size = st.st_size;
+
+	Trailer t;
+	memcpy(&t, m_map + m_size - sizeof(t), sizeof(t));
+	size_t index_end = m_size - sizeof(t);
+	if (memcmp(t.magic, MAGIC, sizeof(MAGIC)) != 0 || t.count == 0
+		|| t.costs_offset % sizeof(uint64_t) != 0 || t.offsets_offset % sizeof(uint64_t) != 0
+		|| t.costs_offset + t.count * sizeof(uint32_t) > t.offsets_offset
+		|| t.offsets_offset + (t.count + 1) * sizeof(uint64_t) > index_end) {
+		close();
+		return false;
+	}
+	m_count = t.count;
+	m_costs = reinterpret_cast<const uint32_t *>(m_map + t.costs_offset);
+	m_offsets = reinterpret_cast<const uint64_t *>(m_map + t.offsets_offset);
+	if (m_offsets[m_count] > t.costs_offset) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void HopTable::close()
+{
+	if (m_map) {
+		munmap(const_cast<char *>(m_map), m_size);
+		m_map = 0;
+		m_size = 0;
+	}
+	if (m_fd != -1) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_count = 0;
+	m_costs = 0;
+	m_offsets = 0;
+}
+
+bool HopTable::get(uint64_t instr, InjectionPointMessage& ipm) const
+{
+	if (instr >= m_count) {
+		return false;
+	}
+	uint64_t begin = m_offsets[instr], end = m_offsets[instr + 1];
+	if (begin == end) {
+		// like SmartHops for offset 0
+		ipm.Clear();
+		ipm.set_target_trace_position(0);
+		ipm.set_costs(0);
+		return true;
+	}
+	// skip the ProtoOStream frame
+	if (end - begin < sizeof(uint32_t)) {
+		return false;
+	}
+	begin += sizeof(uint32_t);
+	return ipm.ParseFromArray(m_map + begin, end - begin);
+}
+
+uint64_t HopTable::cheapest(uint64_t instr1, uint64_t instr2) const
+{
+	uint64_t best = instr1;
+	for (uint64_t i = instr1 + 1; i < instr2; ++i) {
+		if (m_costs[i] < m_costs[best]) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+bool HopTableWriter::open(const std::string& path)
+{
+	m_out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+	m_costs.clear();
+	m_offsets.clear();
+	// offset 0: the empty chain
+	m_costs.push_back(0);
+	m_offsets.push_back(0);
+	m_offsets.push_back(0);
+	return m_out.is_open();
+}
+
+void HopTableWriter::add(uint64_t length, uint32_t costs)
+{
+	m_costs.push_back(costs);
+	m_offsets.push_back(m_offsets.back() + length);
+}
+
+static void pad(std::ostream& out, uint64_t& pos)
+{
+	static const char zero[sizeof(uint64_t)] = { 0 };
+	if (pos % sizeof(uint64_t) != 0) {
+		size_t n = sizeof(uint64_t) - pos % sizeof(uint64_t);
+		out.write(zero, n);
+		pos += n;
+	}
+}
+
+bool HopTableWriter::close()
+{
+	uint64_t pos = m_offsets.back();
+	HopTable::Trailer t;
+	t.count = m_costs.size();
+	pad(m_out, pos);
+	t.costs_offset = pos;
+	m_out.write(reinterpret_cast<const char *>(&m_costs[0]), m_costs.size() * sizeof(uint32_t));
+	pos += m_costs.size() * sizeof(uint32_t);
+	pad(m_out, pos);
+	t.offsets_offset = pos;
+	m_out.write(reinterpret_cast<const char *>(&m_offsets[0]), m_offsets.size() * sizeof(uint64_t));
+	memcpy(t.magic, HopTable::MAGIC, sizeof(t.magic));
+	m_out.write(reinterpret_cast<const char *>(&t), sizeof(t));
+	m_out.close();
+	return !m_out.fail();
+}
+
+} // end-of-namespace: fail
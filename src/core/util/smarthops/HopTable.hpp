@@ -0,0 +1,93 @@
+#ifndef __HOP_TABLE_HPP__
+#define __HOP_TABLE_HPP__
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "comm/InjectionPointHopsMessage.pb.h"
+
+namespace fail {
+
+/**
+ * \class HopTable
+ *
+ * Precomputed hop chains (compute-hops --table), indexed by trace
+ * instruction offset, so the campaign does not need to run SmartHops while
+ * it generates jobs.  The file is mapped read-only; looking up a chain is a
+ * single index access and parsing its message.
+ *
+ * Layout: the chains for offsets 1..N as ProtoOStream-framed
+ * InjectionPointMessages (i.e., the same bytes as compute-hops -b writes,
+ * uncompressed), followed by the costs (uint32_t) and the message offsets
+ * (uint64_t) of offsets 0..N, and a trailer.  Offset 0 is the empty chain.
+ */
+class HopTable {
+public:
+	struct Trailer {
+		uint64_t count;           //!< number of instruction offsets (N + 1)
+		uint64_t costs_offset;    //!< uint32_t[count]
+		uint64_t offsets_offset;  //!< uint64_t[count + 1]
+		char magic[8];
+	};
+	static const char MAGIC[8];
+
+private:
+	int m_fd;
+	const char *m_map;
+	size_t m_size;
+	uint64_t m_count;
+	const uint32_t *m_costs;
+	const uint64_t *m_offsets;
+
+public:
+	HopTable() : m_fd(-1), m_map(0), m_size(0), m_count(0), m_costs(0), m_offsets(0) { }
+	~HopTable() { close(); }
+
+	bool open(const std::string& path);
+	void close();
+
+	//! Number of instruction offsets with a hop chain
+	uint64_t size() const { return m_count; }
+
+	uint32_t getCosts(uint64_t instr) const { return m_costs[instr]; }
+
+	/**
+	 * Copies the hop chain to instruction offset \a instr into \a ipm.
+	 * @return \c false if there is none
+	 */
+	bool get(uint64_t instr, InjectionPointMessage& ipm) const;
+
+	/**
+	 * The cheapest chain into the equivalence class [\a instr1, \a instr2]
+	 * (the first one of [instr1, instr2), or instr1 if both are equal).
+	 */
+	uint64_t cheapest(uint64_t instr1, uint64_t instr2) const;
+};
+
+/**
+ * \class HopTableWriter
+ *
+ * Writes a HopTable.  The framed chains for offsets 1, 2, ... are written to
+ * stream(), and each one is announced with add() afterwards.
+ */
+class HopTableWriter {
+	std::ofstream m_out;
+	std::vector<uint32_t> m_costs;
+	std::vector<uint64_t> m_offsets;
+public:
+	bool open(const std::string& path);
+	std::ostream& stream() { return m_out; }
+
+	//! The chain for the next offset was written, it is \a length bytes long.
+	void add(uint64_t length, uint32_t costs);
+
+	//! Writes the index.
+	bool close();
+};
+
+} // end-of-namespace: fail
+
+#endif // __HOP_TABLE_HPP__
@@ -14,6 +14,20 @@ void SmartHops::init(const char *filename) {
 	m_trace_reader.openTraceFile(filename);
 }
 
+bool SmartHops::setCheckpointing(unsigned cp_thresh, unsigned cost_cp, unsigned rollback_thresh) {
+	// same constraints as in compute-hops
+	if (!(cp_thresh > cost_cp) || !(rollback_thresh < ((cp_thresh - cost_cp) / 2))) {
+		m_log << "inconsistent checkpoint parameters: costs threshold " << cp_thresh
+			<< ", costs " << cost_cp << ", rollback threshold " << rollback_thresh << std::endl;
+		return false;
+	}
+	m_use_checkpoints = true;
+	m_cp_thresh = cp_thresh;
+	m_cost_cp = cost_cp;
+	m_rollback_thresh = rollback_thresh;
+	return true;
+}
+
 void SmartHops::convertToIPM(std::vector<result_tuple > &result, unsigned costs, InjectionPointMessage &ipm) {
 
 	ipm.Clear();
@@ -21,10 +35,12 @@ void SmartHops::convertToIPM(std::vector<result_tuple > &result, unsigned costs,
 	std::vector<result_tuple >::iterator it_hop = result.begin();
 	if (it_hop != result.end() && it_hop->first.second == ACCESS_CHECKPOINT) {
 		ipm.set_checkpoint_id(it_hop->first.first);
+		ipm.set_checkpoint_trace_position(it_hop->second);
 		it_hop++;
 	}
 
-	if (result.size() > 0 && result.back().first.second != ACCESS_CHECKPOINT) {
+	// A chain consisting of the checkpoint only targets its position
+	if (result.size() > 0) {
 		ipm.set_target_trace_position(result.back().second);
 	} else {
 		ipm.set_target_trace_position(0);
@@ -101,6 +117,8 @@ bool SmartHops::calculateFollowingHop(InjectionPointMessage &ip, unsigned instru
 					m_result.clear();
 					m_result.push_back(result_tuple(*it_te, m_trace_pos));
 					m_costs = COST_CHANGE;
+					// no chain can return to the checkpoints before
+					m_checkpoints.clear();
 					hop_found = true;
 				}
 			} else {
@@ -152,10 +170,10 @@ bool SmartHops::calculateFollowingHop(InjectionPointMessage &ip, unsigned instru
 			if ((rit_pre_last == m_result.rend())) {
 				// First node in hop list is Checkpoint? => Look at result before CP-Creation
 				if (rit_last->first.second == ACCESS_CHECKPOINT) {
-					rit_pre_last = (m_checkpoints[rit_last->first.first]).second.rbegin();
+					rit_pre_last = m_checkpoints[rit_last->first.first].second.rbegin();
 
 					// This should never happen:
-					if (rit_pre_last == (m_checkpoints[rit_last->first.first]).second.rend()) {
+					if (rit_pre_last == m_checkpoints[rit_last->first.first].second.rend()) {
 						break;
 					}
 
@@ -201,18 +219,19 @@ bool SmartHops::calculateFollowingHop(InjectionPointMessage &ip, unsigned instru
 			// There will be no past in the trace
 			// Reconfigure result and iterators
 			if (rit_last->first.second == ACCESS_CHECKPOINT) {
-				m_costs = m_checkpoints[rit_last->first.first].first;
+				std::map<unsigned int, checkpoint_tuple_t>::iterator cp =
+					m_checkpoints.find(rit_last->first.first);
+				m_costs = cp->second.first;
 
 				m_result.clear();
-				std::vector<result_tuple > *tmp = &(m_checkpoints[rit_last->first.first].second);
-				m_result.insert(m_result.end(), tmp->begin(), tmp->end());
+				m_result.insert(m_result.end(), cp->second.second.begin(), cp->second.second.end());
 
 				rit_last = m_result.rbegin();
 				rit_pre_last = m_result.rbegin();
 				rit_pre_last++;
 
-				// CP could be removed from m_checkpoints, but to do this
-				// m_checkpoints needs to be a map (CP-ID is implicit as vector index)
+				// the chain is past this CP now
+				m_checkpoints.erase(cp);
 
 				continue;
 			}
@@ -241,7 +260,7 @@ bool SmartHops::calculateFollowingHop(InjectionPointMessage &ip, unsigned instru
 		// Check if Checkpoint needed
 		if (m_use_checkpoints && (m_costs > m_cp_thresh) && !checkpoint_forbidden) {
 			checkpoint_tuple_t new_cp(m_costs, std::vector<result_tuple >(m_result));
-			m_checkpoints.push_back(new_cp);
+			m_checkpoints.insert(std::make_pair(m_next_cp_id, new_cp));
 			m_result.clear();
 			m_result.push_back(result_tuple(trace_event_tuple_t(m_next_cp_id++,
 																ACCESS_CHECKPOINT),
@@ -27,9 +27,6 @@ typedef std::pair<unsigned int, std::vector<result_tuple > > checkpoint_tuple_t;
 class SmartHops {
 public:
 
-	// ToDo: If you want to use checkoints as additional hop-chain-element, you may switch
-	// m_use_checkpoints to true, but there will be additional changes needed for this to fully work.
-	// The sal must, for example, generate CPs at the given positions
 	SmartHops() : m_trace_pos(0), m_costs(0), m_next_cp_id(0), m_log("SmartHops", false), m_use_watchpoints(true),
 		m_use_weights(true), m_use_checkpoints(false), m_cp_thresh(0), m_cost_cp(0), m_rollback_thresh(0) {}
 
@@ -45,6 +42,22 @@ public:
 	 * @returns \c true if calculation succeeded and \c false if it did not
 	 */
 	bool calculateFollowingHop(InjectionPointMessage &ip, unsigned instruction_offset);
+
+	/**
+	 * Enables checkpoints as first element of hop chains, with the same
+	 * parameters as compute-hops --use-checkpoints.  A hop chain then starts
+	 * at a golden-run checkpoint (InjectionPointMessage::checkpoint_id and
+	 * checkpoint_trace_position) once its costs exceed \a cp_thresh.  The
+	 * checkpoints are created at the same trace positions compute-hops
+	 * --cp-output lists, so they must have been captured in the golden run
+	 * (generic-tracing --checkpoint-positions).
+	 * Must be called before the first calculateFollowingHop().
+	 * @param cp_thresh costs of a hop chain that trigger a new checkpoint
+	 * @param cost_cp costs of restoring a checkpoint
+	 * @param rollback_thresh see compute-hops --cp-rollback-threshold
+	 * @returns \c false if the parameters are inconsistent
+	 */
+	bool setCheckpointing(unsigned cp_thresh, unsigned cost_cp, unsigned rollback_thresh);
 private:
 
 	/**
@@ -78,7 +91,8 @@ private:
 
 
 	std::map<trace_event_tuple_t, trace_pos_t> m_last_positions;
-	std::vector<checkpoint_tuple_t > m_checkpoints;
+	// CPs the current hop chain may still return to, by ID
+	std::map<unsigned int, checkpoint_tuple_t> m_checkpoints;
 
 	std::vector<trace_event_tuple_t > m_trace_events;
 	std::vector<result_tuple > m_result;
@@ -3,14 +3,163 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <atomic>
+#include <boost/thread.hpp>
+
+#include "util/ProtoBatch.hpp"
+#include "util/SynchronizedQueue.hpp"
 
 using std::endl;
 using fail::ProtoIStream;
 
 namespace fail {
 
+// hand a batch of encoded events to a decoder thread when it reaches this size
+static const size_t BATCH_SIZE = 1024 * 1024;
+
+namespace {
+
+// A sequence of encoded trace events, and the trace events (as delivered by
+// getNextTraceEvents()) decoded from it
+struct TraceBatch : public ProtoBatch {
+	std::vector<trace_event_tuple_t> events;
+	bool first;   //!< starts the trace
+
+	TraceBatch() : first(false) {}
+};
+
+} // anonymous namespace
+
+/**
+ * Reads the trace in one thread and decodes it in several others; the
+ * batches are consumed in their original order.  The queues bound the
+ * number of batches in flight, and with it the memory usage.
+ */
+class TraceReader::Decoder {
+	SynchronizedQueue<TraceBatch *> m_work, m_order;
+	std::atomic<bool> m_stop;
+	boost::thread_group m_threads;
+	TraceBatch *m_batch; //!< currently consumed batch
+	size_t m_pos;        //!< within m_batch->events
+	bool m_end;
+
+	void read(std::istream *in);
+	void decode();
+	const trace_event_tuple_t *peek();
+public:
+	Decoder(std::istream *in, unsigned threads);
+	~Decoder();
+
+	//! Appends the events of the next instruction to \a events.
+	bool next(std::vector<trace_event_tuple_t>& events);
+};
+
+TraceReader::Decoder::Decoder(std::istream *in, unsigned threads)
+	: m_work(2 * threads), m_order(4 * threads), m_stop(false),
+	  m_batch(0), m_pos(0), m_end(false)
+{
+	for (unsigned i = 0; i < threads; ++i) {
+		m_threads.create_thread([this] { decode(); });
+	}
+	m_threads.create_thread([this, in] { read(in); });
+}
+
+TraceReader::Decoder::~Decoder()
+{
+	// release everything still in flight
+	m_stop = true;
+	delete m_batch;
+	TraceBatch *batch;
+	while ((batch = m_order.Dequeue()) != 0) {
+		batch->wait();
+		delete batch;
+	}
+	m_threads.join_all();
+}
+
+void TraceReader::Decoder::read(std::istream *in)
+{
+	// like getNext(), a truncated event ends the trace
+	ProtoIStream ps(in);
+	bool more, first = true;
+	do {
+		TraceBatch *batch = new TraceBatch;
+		batch->first = first;
+		first = false;
+		more = batch->fill(ps, BATCH_SIZE);
+		// decoders may finish batches in any order, next() takes them in
+		// this one
+		m_order.Enqueue(batch);
+		m_work.Enqueue(batch);
+	} while (more && !m_stop);
+	m_work.setIsFinished();
+	m_order.setIsFinished();
+}
+
+void TraceReader::Decoder::decode()
+{
+	Trace_Event ev;
+	TraceBatch *batch;
+	while ((batch = m_work.Dequeue()) != 0) {
+		size_t pos = 0;
+		const char *msg;
+		uint32_t size;
+		while (!m_stop && batch->next(pos, msg, size)) {
+			bool first = batch->first && batch->events.empty();
+			// like ProtoIStream::getNext(), ignore decoding errors
+			ev.ParseFromArray(msg, size);
+
+			// same events as getNextTraceEvents() without a Decoder: the
+			// first event is always taken as instruction
+			if (!ev.has_memaddr() || first) {
+				batch->events.push_back(trace_event_tuple_t(ev.ip(), ACCESS_NONE));
+			} else if (ev.has_width()) {
+				for (unsigned int i = 0; i < ev.width(); i++) {
+					batch->events.push_back(
+						trace_event_tuple_t(ev.memaddr() + i,
+						ev.accesstype() == ev.READ ? ACCESS_READ : ACCESS_WRITE));
+				}
+			}
+		}
+		// the encoded data is not needed anymore
+		std::string().swap(batch->data);
+		batch->finish();
+	}
+}
+
+const trace_event_tuple_t *TraceReader::Decoder::peek()
+{
+	while (!m_end && (!m_batch || m_pos >= m_batch->events.size())) {
+		delete m_batch;
+		m_batch = m_order.Dequeue();
+		m_pos = 0;
+		if (!m_batch) {
+			m_end = true;
+			break;
+		}
+		m_batch->wait();
+	}
+	return m_end ? 0 : &m_batch->events[m_pos];
+}
+
+bool TraceReader::Decoder::next(std::vector<trace_event_tuple_t>& events)
+{
+	const trace_event_tuple_t *te = peek();
+	if (!te) {
+		return false;
+	}
+	// the instruction, and its memory accesses
+	do {
+		events.push_back(*te);
+		++m_pos;
+	} while ((te = peek()) && te->second != ACCESS_NONE);
+	return true;
+}
+
 TraceReader::~TraceReader()
 {
+	// stops the threads reading from the streams
+	delete m_decoder;
 	delete ps;
 	delete normal_stream;
 	delete gz_stream;
@@ -45,7 +194,12 @@ bool TraceReader::openTraceFile(const char *filename, unsigned int num_inst)
 {
 	normal_stream = new std::ifstream();
 	gz_stream = new igzstream();
-	ps = new fail::ProtoIStream(&openStream(filename, *normal_stream, *gz_stream, m_log));
+	std::istream& in = openStream(filename, *normal_stream, *gz_stream, m_log);
+	if (m_threads > 0) {
+		m_decoder = new Decoder(&in, m_threads);
+	} else {
+		ps = new fail::ProtoIStream(&in);
+	}
 
 	m_max_num_inst = num_inst;
 
@@ -66,6 +220,14 @@ bool TraceReader::getNextTraceEvents(trace_pos_t& trace_pos,
 	// empty, so it must be cleared
 	trace_events.clear();
 
+	if (m_decoder) {
+		if (!m_decoder->next(trace_events)) {
+			return false;
+		}
+		m_current_position++;
+		return true;
+	}
+
 	if (m_current_position == 1) {
 		if (!ps->getNext(&ev)) {
 			return false;
@@ -34,6 +34,8 @@ public:
 					gz_stream(0),
 					m_max_num_inst(0),
 					ev_avail(false),
+					m_threads(0),
+					m_decoder(0),
 					m_log("TraceReader", false) {}
 
 	~TraceReader();
@@ -43,7 +45,17 @@ public:
 		std::vector<trace_event_tuple_t >& trace_events);
 
 	bool openTraceFile(const char *filename, unsigned int num_inst = 0);
+
+	/**
+	 * Decodes the trace ahead in \a threads worker threads, while a further
+	 * thread reads (and decompresses) it.  getNextTraceEvents() delivers the
+	 * same events as without threads.  Must be called before openTraceFile();
+	 * 0 (the default) decodes in the calling thread.
+	 */
+	void setThreads(unsigned threads) { m_threads = threads; }
 private:
+	class Decoder;
+
 	unsigned int m_current_position;
 	ProtoIStream* ps;
 	std::ifstream *normal_stream;
@@ -51,6 +63,8 @@ private:
 	unsigned int m_max_num_inst;
 	Trace_Event ev;
 	bool ev_avail;
+	unsigned m_threads;
+	Decoder *m_decoder;
 
 	Logger m_log;
 };
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <sstream>
+#include <set>
+#include <algorithm>
+#include <functional>
+#include <stdlib.h>
+#include <math.h>
+#include "util/Sampling.hpp"
+
+using namespace fail;
+using std::cerr;
+using std::endl;
+
+void test_failed(std::string msg)
+{
+	cerr << "Sampling test failed (" << msg << ")!" << endl;
+	abort();
+}
+
+// reference implementations of in-memory sampling
+
+// with replacement: how often each element of "table" was picked
+static void sample_with_replacement(const AliasTable& table, uint64_t count,
+	uint64_t seed, std::vector<uint32_t>& hits)
+{
+	SampleRNG rng(seed);
+	hits.assign(table.size(), 0);
+	for (uint64_t i = 0; i < count; ++i) {
+		++hits[table.sample(rng)];
+	}
+}
+
+// without replacement (Efraimidis/Spirakis): the indexes of the elements with
+// the largest weighted_key(), in the order they were drawn
+static void sample_without_replacement(const std::vector<uint64_t>& weights, uint64_t count,
+	uint64_t seed, std::vector<size_t>& picked)
+{
+	std::vector<std::pair<double, size_t> > keys;
+	for (size_t i = 0; i < weights.size(); ++i) {
+		if (weights[i] > 0) {
+			keys.push_back(std::make_pair(weighted_key(seed, i, weights[i]), i));
+		}
+	}
+	std::sort(keys.begin(), keys.end(), std::greater<std::pair<double, size_t> >());
+	picked.clear();
+	for (size_t i = 0; i < keys.size() && i < count; ++i) {
+		picked.push_back(keys[i].second);
+	}
+}
+
+int main()
+{
+	std::stringstream ss;
+
+	// weights 0, 1, 2, ..., 9 (sum 45)
+	std::vector<uint64_t> weights;
+	for (unsigned i = 0; i < 10; ++i) {
+		weights.push_back(i);
+	}
+	AliasTable table(weights);
+
+	// with replacement: reproducible, proportional
+	const uint64_t count = 9000000;
+	std::vector<uint32_t> hits1, hits_again;
+	sample_with_replacement(table, count, 42, hits1);
+	sample_with_replacement(table, count, 42, hits_again);
+	if (hits1 != hits_again) {
+		test_failed("same seed, different result");
+	}
+	if (hits1[0] != 0) {
+		test_failed("zero-weight element picked");
+	}
+	uint64_t sum = 0;
+	for (unsigned i = 0; i < hits1.size(); ++i) {
+		sum += hits1[i];
+		double expected = count * weights[i] / 45.0;
+		// 5 sigma
+		if (fabs(hits1[i] - expected) > 5 * sqrt(expected) + 1) {
+			ss << "element " << i << " picked " << hits1[i] << " times, expected " << expected;
+			test_failed(ss.str());
+		}
+	}
+	if (sum != count) {
+		test_failed("wrong number of samples");
+	}
+	std::vector<uint32_t> hits_other;
+	sample_with_replacement(table, count, 43, hits_other);
+	if (hits_other == hits1) {
+		test_failed("seed has no effect");
+	}
+
+	// without replacement: distinct, no zero weights
+	std::vector<size_t> picked1;
+	sample_without_replacement(weights, 5, 42, picked1);
+	if (std::set<size_t>(picked1.begin(), picked1.end()).size() != 5) {
+		test_failed("duplicate picks");
+	}
+	sample_without_replacement(weights, 100, 42, picked1);
+	if (picked1.size() != 9 || std::set<size_t>(picked1.begin(), picked1.end()).count(0)) {
+		test_failed("not all non-zero elements picked");
+	}
+
+	// the first pick is proportional to the weight
+	std::vector<unsigned> first(weights.size());
+	for (unsigned seed = 0; seed < 45000; ++seed) {
+		sample_without_replacement(weights, 1, seed, picked1);
+		++first[picked1[0]];
+	}
+	for (unsigned i = 0; i < first.size(); ++i) {
+		double expected = 1000.0 * weights[i];
+		if (fabs(first[i] - expected) > 5 * sqrt(expected) + 1) {
+			ss << "element " << i << " picked first " << first[i] << " times, expected " << expected;
+			test_failed(ss.str());
+		}
+	}
+
+	// streaming with replacement: reproducible, proportional, all samples used
+	SortedSampler sorted1(45, count, 42, 1), sorted4(45, count, 42, 4);
+	sum = 0;
+	for (unsigned i = 0; i < weights.size(); ++i) {
+		uint32_t h = sorted1.hits(weights[i]);
+		if (h != sorted4.hits(weights[i])) {
+			test_failed("#threads changes the result (streaming)");
+		}
+		sum += h;
+		double expected = count * weights[i] / 45.0;
+		if (fabs(h - expected) > 5 * sqrt(expected) + 1) {
+			ss << "element " << i << " streamed " << h << " times, expected " << expected;
+			test_failed(ss.str());
+		}
+	}
+	if (sum != count || !sorted1.done()) {
+		test_failed("wrong number of samples (streaming)");
+	}
+
+	// streaming without replacement: same picks as the in-memory variant,
+	// in any order of offering
+	for (unsigned n = 1; n <= 10; ++n) {
+		WeightedReservoir<size_t> reservoir(n, 42), reversed(n, 42);
+		for (size_t i = 0; i < weights.size(); ++i) {
+			reservoir.offer(i, weights[i], i);
+			size_t j = weights.size() - 1 - i;
+			reversed.offer(j, weights[j], j);
+		}
+		std::vector<size_t> streamed, streamed_reversed;
+		reservoir.result(streamed);
+		reversed.result(streamed_reversed);
+		sample_without_replacement(weights, n, 42, picked1);
+		if (streamed != picked1 || streamed_reversed != picked1) {
+			test_failed("reservoir differs from the reference implementation");
+		}
+	}
+
+	return 0;
+}
@@ -19,6 +19,7 @@
 #include <vector>
 #include <stdexcept>
 #include <limits>
+#include <algorithm>
 
 #include "campaign.hpp"
 #include "generic-experiment.pb.h"
@@ -30,6 +31,26 @@ using namespace fail;
 
 GenericExperiment::~GenericExperiment() {}
 
+// Does the state hash cover the pilot's injection target?  A fault in memory
+// outside the hashed ranges would be classified MASKED as soon as the hashed
+// state happens to match the golden run.
+static bool state_hash_covers(const StateHash& state_hash, const DatabaseCampaignMessage& pilot)
+{
+	if (pilot.register_injection_mode() == pilot.RANDOMJUMP
+		|| (pilot.register_injection_mode() != pilot.OFF && pilot.data_address() < (128 << 4))) {
+		return true; // all registers are hashed (see DatabaseExperiment::injectFault)
+	}
+	uint64_t begin = pilot.data_address();
+	uint64_t end = begin + std::max<uint64_t>(pilot.data_width(), 1);
+	const std::vector<StateHash::address_range>& ranges = state_hash.getRanges();
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		if (ranges[i].first <= begin && end <= ranges[i].second) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static GenericExperimentData space_for_param;
 ExperimentData* GenericExperiment::cb_allocate_experiment_data() {
     return &space_for_param;
@@ -140,6 +161,24 @@ bool GenericExperiment::cb_start_experiment() {
 	CommandLine::option_handle TIMEOUT = cmd.addOption("", "timeout", Arg::Required,
 		"--timeout TIME \tExperiment timeout in uS");
 
+	CommandLine::option_handle TIMEOUT_FACTOR = cmd.addOption("", "timeout-factor", Arg::Required,
+		"--timeout-factor F \tTimeout after F times the instructions the golden run executes after "
+		"the injection point (e.g., 2.0; none if the campaign does not know the golden run's length)");
+	CommandLine::option_handle TIMEOUT_MIN = cmd.addOption("", "timeout-min", Arg::Required,
+		"--timeout-min N \t--timeout-factor: wait at least N instructions (default: 100000)");
+
+	CommandLine::option_handle LOOP_DETECTION = cmd.addOption("", "loop-detection", Arg::Required,
+		"--loop-detection N \tTimeout as soon as the machine state (registers and all of RAM) "
+		"repeats, compared every N instructions; not for targets that busy-wait for interrupts");
+
+	CommandLine::option_handle STATE_HASH_FILE = cmd.addOption("", "state-hash-file", Arg::Required,
+		"--state-hash-file FILE \tGolden-run state hashes (generic-tracing --state-hash-file): "
+		"stop as MASKED once the state matches the golden run");
+
+	CommandLine::option_handle CHECKPOINT_DIR = cmd.addOption("", "checkpoint-dir", Arg::Required,
+		"--checkpoint-dir DIR \tGolden-run checkpoints (generic-tracing --checkpoint-dir): "
+		"restore the one chosen by the campaign instead of the state dir");
+
 	CommandLine::option_handle SERIAL_FILE = cmd.addOption("", "serial-file", Arg::Required,
 		"--serial-file FILE \tGolden-run serial output recording to check against");
 	CommandLine::option_handle SERIAL_PORT = cmd.addOption("", "serial-port", Arg::Required,
@@ -290,6 +329,52 @@ bool GenericExperiment::cb_start_experiment() {
 		m_log << "Enabled Experiment Timeout of " << dec << m_Timeout << " microseconds" << endl;
 	}
 
+	if (cmd[TIMEOUT_FACTOR]) {
+		m_timeout_factor = strtod(cmd[TIMEOUT_FACTOR].first()->arg, NULL);
+		if (m_timeout_factor <= 0) {
+			m_log << "Could not parse --timeout-factor argument" << endl;
+			return false; // Initialization failed
+		}
+		if (cmd[TIMEOUT_MIN]) {
+			m_timeout_min = strtoull(cmd[TIMEOUT_MIN].first()->arg, NULL, 0);
+		}
+		enabled_instr_timeout = true;
+		m_log << "Enabled Experiment Timeout of " << m_timeout_factor
+			  << " x the remaining golden run, at least " << dec << m_timeout_min << " instructions" << endl;
+	}
+
+	if (cmd[STATE_HASH_FILE]) {
+		if (!state_hash.load(cmd[STATE_HASH_FILE].first()->arg)) {
+			return false; // Initialization failed
+		}
+		enabled_state_hash = true;
+		m_log << "Enabled state-hash convergence check every " << dec << state_hash.getInterval()
+			  << " instructions" << endl;
+	}
+
+	if (cmd[LOOP_DETECTION]) {
+		m_loop_interval = strtoull(cmd[LOOP_DETECTION].first()->arg, NULL, 0);
+		if (m_loop_interval == 0) {
+			m_log << "Could not parse --loop-detection argument" << endl;
+			return false; // Initialization failed
+		}
+		// a loop counting in memory that is not hashed would look endless
+		loop_hash.addRange(0, simulator.getMemoryManager().getPoolSize());
+		enabled_loop_detection = true;
+		m_log << "Enabled endless-loop detection every " << dec << m_loop_interval
+			  << " instructions" << endl;
+	}
+
+	if (cmd[CHECKPOINT_DIR]) {
+		checkpoints.setDirectory(cmd[CHECKPOINT_DIR].first()->arg);
+		if (!checkpoints.load()) {
+			m_log << "Could not read the checkpoint index in " << checkpoints.getDirectory() << endl;
+			return false; // Initialization failed
+		}
+		enabled_checkpoints = true;
+		m_log << "Enabled " << dec << checkpoints.size() << " golden-run checkpoints" << endl;
+	}
+
 	for (std::map<std::string, CommandLine::option_handle>::iterator it = option_handles.begin();
 		 it != option_handles.end(); ++it) {
 		if (cmd[option_handles[it->first]]) {
@@ -305,11 +390,25 @@ bool GenericExperiment::cb_start_experiment() {
 }
 
 
+std::string GenericExperiment::cb_checkpoint_directory(unsigned instr)
+{
+	if (!enabled_checkpoints || !checkpoints.find(instr)) {
+		return "";
+	}
+	return checkpoints.path(instr);
+}
+
 bool GenericExperiment::cb_before_fast_forward()
 {
 	if (serial_enabled) {
 		// output may already appear *before* FI
 		simulator.addFlow(&sol);
+
+		// ... or even before the restored checkpoint
+		const CheckpointLadder::Checkpoint *c = checkpoints.find(get_restored_checkpoint());
+		if (get_restored_checkpoint() > 0 && c) {
+			sol.setOutput(serial_goldenrun.substr(0, c->serial_length));
+		}
 	}
 	return true;
 }
@@ -330,14 +429,77 @@ bool GenericExperiment::cb_before_resume() {
 	if (enabled_timeout)
 		simulator.addListener(&l_timeout);
 
+	GenericExperimentData *param = static_cast<GenericExperimentData *>(get_current_experiment_data());
+	uint64_t injection_instr = param->msg.fsppilot().injection_instr();
+
+	if (enabled_instr_timeout) {
+		uint64_t golden_run_instr = param->msg.fsppilot().golden_run_instr();
+		if (golden_run_instr > injection_instr) {
+			m_instr_timeout = std::max<uint64_t>(m_timeout_min,
+				m_timeout_factor * (golden_run_instr - injection_instr));
+			l_instr_timeout.setCounter(m_instr_timeout);
+			simulator.addListener(&l_instr_timeout);
+		} else {
+			// the campaign does not know the golden run, any limit could cut
+			// off a regular run
+			m_log << "golden-run length unknown, no --timeout-factor timeout" << endl;
+		}
+	}
+
+	if (enabled_loop_detection) {
+		loop_digests.clear();
+		m_loop_instr = 0;
+		l_loop.setCounter(m_loop_interval);
+		simulator.addListener(&l_loop);
+	}
+
 	for (std::set<BaseListener *>::iterator it = end_markers.begin();
 		 it != end_markers.end(); ++it) {
 		simulator.addListener(*it);
 	}
 
+	if (enabled_state_hash && !state_hash_covers(state_hash, param->msg.fsppilot())) {
+		m_log << "injection target 0x" << hex << param->msg.fsppilot().data_address() << dec
+			  << " is not part of the state hash, no convergence check" << endl;
+	} else if (enabled_state_hash) {
+		// the first golden state after the injection point
+		next_state_hash = state_hash.next(injection_instr);
+		if (next_state_hash) {
+			l_state_hash.setCounter(next_state_hash->instr - injection_instr);
+			simulator.addListener(&l_state_hash);
+		}
+	}
+
 	return true; // everything OK
 }
 
+bool GenericExperiment::cb_during_resume(fail::BaseListener *event) {
+	if (event == &l_loop) {
+		m_loop_instr += m_loop_interval;
+		if (!loop_digests.insert(loop_hash.digest()).second) {
+			m_log << "state repeats after " << dec << m_loop_instr << " instructions: endless loop" << endl;
+			return false;
+		}
+		l_loop.setCounter(m_loop_interval);
+		simulator.addListener(&l_loop);
+		return true;
+	}
+	if (event != &l_state_hash) {
+		return false; // experiment ends
+	}
+	if (state_hash.digest() == next_state_hash->digest) {
+		m_log << "state converged to golden run @ instr #" << dec << next_state_hash->instr << endl;
+		return false;
+	}
+	const StateHash::Record *next = state_hash.next(next_state_hash->instr);
+	if (next) {
+		l_state_hash.setCounter(next->instr - next_state_hash->instr);
+		simulator.addListener(&l_state_hash);
+	}
+	next_state_hash = next;
+	return true;
+}
+
 
 
 void GenericExperiment::cb_after_resume(fail::BaseListener *event) {
@@ -348,6 +510,20 @@ void GenericExperiment::cb_after_resume(fail::BaseListener *event) {
 
 	if (event == &l_timeout) {
 		handleEvent(*result, result->TIMEOUT, m_Timeout);
+	}  else if (event == &l_instr_timeout) {
+		handleEvent(*result, result->TIMEOUT, m_instr_timeout);
+	}  else if (event == &l_loop) {
+		handleEvent(*result, result->TIMEOUT, m_loop_instr);
+	}  else if (event == &l_state_hash) {
+		handleEvent(*result, result->MASKED, next_state_hash->instr);
+
+		// a masked fault may still have changed the output so far
+		if (serial_enabled) {
+			std::string serial_experiment = sol.getOutput();
+			if (serial_goldenrun.compare(0, next_state_hash->serial_length, serial_experiment) != 0) {
+				handleEvent(*result, result->SDC, 0);
+			}
+		}
 	}  else if (event == &l_trap) {
 		handleEvent(*result, result->TRAP, l_trap.getTriggerNumber());
 	}
@@ -7,11 +7,14 @@
 #include "efw/JobClient.hpp"
 #include "util/Logger.hpp"
 #include "util/ElfReader.hpp"
+#include "util/CheckpointLadder.hpp"
 #include "../plugins/serialoutput/SerialOutputLogger.hpp"
+#include "../plugins/checkpoint/StateHash.hpp"
 #include <string>
 #include <stdlib.h>
 #include <map>
 #include <set>
+#include <unordered_set>
 
 
 class GenericExperiment : public fail::DatabaseExperiment {
@@ -20,6 +23,9 @@ class GenericExperiment : public fail::DatabaseExperiment {
 
 	std::string m_state_dir;
 
+	bool enabled_checkpoints;
+	fail::CheckpointLadder checkpoints;
+
 	fail::guest_address_t serial_port;
 	SerialOutputLogger sol;
 	bool serial_enabled = false;
@@ -41,6 +47,26 @@ class GenericExperiment : public fail::DatabaseExperiment {
 	unsigned m_Timeout;
 	fail::TimerListener l_timeout;
 
+	// timeout relative to the golden run's remaining length
+	bool enabled_instr_timeout;
+	double m_timeout_factor;
+	uint64_t m_timeout_min;
+	uint64_t m_instr_timeout;
+	fail::BPSingleListener l_instr_timeout;
+
+	// endless-loop detection: the machine state repeats
+	bool enabled_loop_detection;
+	StateHash loop_hash;
+	uint64_t m_loop_interval;
+	uint64_t m_loop_instr; // instructions since the injection
+	std::unordered_set<std::string> loop_digests;
+	fail::BPSingleListener l_loop;
+
+	bool enabled_state_hash;
+	StateHash state_hash;
+	fail::BPSingleListener l_state_hash;
+	const StateHash::Record *next_state_hash;
+
 	std::map<fail::BaseListener *, const fail::ElfSymbol *> listener_to_symbol;
 
 	typedef std::set<fail::BaseListener *> ListenerSet;
@@ -62,12 +88,20 @@ public:
 	GenericExperiment() : DatabaseExperiment("GenericExperiment"),
 						  m_state_dir("state"),
 						  sol(0),
-						  l_trap(fail::ANY_TRAP), l_timeout(0) {
+						  l_trap(fail::ANY_TRAP), l_timeout(0),
+						  m_timeout_factor(0), m_timeout_min(100000), m_instr_timeout(0),
+						  l_instr_timeout(fail::ANY_ADDR),
+						  m_loop_interval(0), m_loop_instr(0), l_loop(fail::ANY_ADDR),
+						  l_state_hash(fail::ANY_ADDR), next_state_hash(0) {
 		enabled_mem_text = false;
 		enabled_mem_outerspace = false;
 		enabled_mem_lowerspace = false;
 		enabled_trap = false;
 		enabled_timeout = false;
+		enabled_instr_timeout = false;
+		enabled_loop_detection = false;
+		enabled_state_hash = false;
+		enabled_checkpoints = false;
 
 		end_marker_groups["ok-marker"] = &OK_marker;
 		end_marker_groups["fail-marker"] = &FAIL_marker;
@@ -84,6 +118,12 @@ public:
 	 */
 	virtual std::string cb_state_directory() { return m_state_dir; }
 
+	/**
+	 * Get path to the golden-run checkpoint at instruction count \a instr
+	 * (empty if unknown)
+	 */
+	virtual std::string cb_checkpoint_directory(unsigned instr);
+
 	/**
 	 * Allocate enough space to hold the incoming ExperimentData message.
 	 */
@@ -120,6 +160,15 @@ public:
 	 */
 	virtual bool cb_before_resume();
 
+	/**
+	 * Callback that is called for each listener triggered during the
+	 * resume-till-crash phase.  Compares the machine state with the golden
+	 * run's state hashes, and stops the experiment when they match, or
+	 * when it repeats (endless loop).
+	 * @return \c true to continue resuming, \c false to stop
+	 */
+	virtual bool cb_during_resume(fail::BaseListener *event);
+
 	/**
 	 * Callback that is called after the resume-till-crash phase with
 	 * the last triggered listener. This callback should collect all
@@ -1,4 +1,4 @@
-SET(PLUGINS_ACTIVATED "tracing;serialoutput" CACHE STRING "")
+SET(PLUGINS_ACTIVATED "tracing;serialoutput;checkpoint" CACHE STRING "")
 
 SET(bochs_configure_params "--enable-a20-pin;--enable-x86-64;--enable-cpu-level=6;--enable-ne2000;--enable-acpi;--enable-pci;--enable-usb;--enable-trace-cache;--enable-fast-function-calls;--enable-host-specific-asms;--enable-readline;--enable-clgd54xx;--enable-fpu;--enable-vmx=2;--enable-monitor-mwait;--enable-cdrom;--enable-sb16=linux;--enable-gdb-stub;--with-nogui" CACHE STRING "")
 
@@ -3,11 +3,15 @@
 
 #include "sal/SALInst.hpp"
 #include "sal/Register.hpp"
+#include "sal/Memory.hpp"
 #include "sal/Listener.hpp"
 #include "experiment.hpp"
 #include "util/CommandLine.hpp"
 #include "util/gzstream/gzstream.h"
 #include <limits>
+#include <algorithm>
+#include <errno.h>
+#include <sys/stat.h>
 
 // You need to have the tracing plugin enabled for this
 #include "../plugins/tracing/TracingPlugin.hpp"
@@ -28,6 +32,16 @@ using namespace fail;
   #error This experiment needs: breakpoints, and save. Enable these in the configuration.
 #endif
 
+uint64_t GenericTracing::nextCheckpoint(uint64_t instr)
+{
+	if (checkpoint_positions.empty()) {
+		return instr + checkpoint_interval;
+	}
+	std::vector<uint64_t>::const_iterator it =
+		std::upper_bound(checkpoint_positions.begin(), checkpoint_positions.end(), instr);
+	return it == checkpoint_positions.end() ? std::numeric_limits<uint64_t>::max() : *it;
+}
+
 void  GenericTracing::parseOptions() {
 	CommandLine &cmd = CommandLine::Inst();
 	cmd.addOption("", "", Arg::None, "USAGE: fail-client -Wf,[option] -Wf,[option] ... <BochsOptions...>\n\n");
@@ -75,6 +89,23 @@ void  GenericTracing::parseOptions() {
 		"--check-bounds \tWhether or not to enable outerspace and text segment checkers which are used in the experiment stage during tracing. If these trip, something is wrong with your architecture implementation.");
 	CommandLine::option_handle CATCH_TRAP = cmd.addOption("", "catch-trap", Arg::None,
 		"--catch-trap \tCatch traps");
+	CommandLine::option_handle STATE_HASH_FILE = cmd.addOption("", "state-hash-file", Arg::Required,
+		"--state-hash-file FILE \tRecord periodic hashes of the machine state to FILE, "
+		"experiments stop once their state converges to the golden run (use with --restore)");
+	CommandLine::option_handle STATE_HASH_INTERVAL = cmd.addOption("", "state-hash-interval", Arg::Required,
+		"--state-hash-interval N \tHash the state every N instructions (default: 10000)");
+	CommandLine::option_handle STATE_HASH_REGION = cmd.addOption("", "state-hash-region", Arg::Required,
+		"--state-hash-region R \tMemory region included in the state hash, same formats as --memory-region "
+		"(default: the traced memory, i.e. all of RAM or the --memory-symbol/--memory-region areas "
+		"plus the ELF's address range; may be used more than once)");
+	CommandLine::option_handle CHECKPOINT_DIR = cmd.addOption("", "checkpoint-dir", Arg::Required,
+		"--checkpoint-dir DIR \tSave a checkpoint of the machine state to DIR every --checkpoint-interval "
+		"instructions, experiments restore the nearest one before their injection point (use with --restore)");
+	CommandLine::option_handle CHECKPOINT_INTERVAL = cmd.addOption("", "checkpoint-interval", Arg::Required,
+		"--checkpoint-interval N \tSave a checkpoint every N instructions (default: 1000000)");
+	CommandLine::option_handle CHECKPOINT_POSITIONS = cmd.addOption("", "checkpoint-positions", Arg::Required,
+		"--checkpoint-positions FILE \tSave the checkpoints at the trace positions in FILE (compute-hops "
+		"--cp-output) instead of every --checkpoint-interval instructions, for hop chains starting at checkpoints");
 
 	if (!cmd.parse()) {
 		cerr << "Error parsing arguments." << endl;
@@ -160,6 +191,8 @@ void  GenericTracing::parseOptions() {
 	}
 
 	use_memory_map = false;
+	// traced areas [begin, end), the default state-hash ranges
+	std::vector<std::pair<guest_address_t, guest_address_t> > traced_ranges;
 
 	if (cmd[MEM_SYMBOL]) {
 		use_memory_map = true;
@@ -175,6 +208,7 @@ void  GenericTracing::parseOptions() {
 			m_log << "Adding '" << opt->arg << "' == 0x" << std::hex << symbol.getAddress()
 				  << "+" << std::dec << symbol.getSize() << " to trace map" << std::endl;
 			traced_memory_map.add(symbol.getAddress(), symbol.getSize());
+			traced_ranges.push_back(std::make_pair(symbol.getAddress(), symbol.getAddress() + symbol.getSize()));
 
 			opt = opt->next();
 		}
@@ -185,37 +219,14 @@ void  GenericTracing::parseOptions() {
 		option::Option *opt = cmd[MEM_REGION].first();
 
 		while (opt != 0) {
-			char *endptr;
-			guest_address_t begin = strtoul(opt->arg, &endptr, 16);
-			guest_address_t size;
-			if (endptr == opt->arg) {
-				m_log << "Couldn't parse " << opt->arg << std::endl;
-				exit(-1);
-			}
-
-			char delim = *endptr;
-			if (delim == 0) {
-				size = 1;
-			} else if (delim == ':') {
-				char *p = endptr +1;
-				size = strtoul(p, &endptr, 16) - begin;
-				if (p == endptr || *endptr != 0) {
-					m_log << "Couldn't parse " << opt->arg << std::endl;
-					exit(-1);
-				}
-			} else if (delim == '+') {
-				char *p = endptr +1;
-				size = strtoul(p, &endptr, 10);
-				if (p == endptr || *endptr != 0) {
-					m_log << "Couldn't parse " << opt->arg << std::endl;
-					exit(-1);
-				}
-			} else {
+			guest_address_t begin, size;
+			if (!parseRegion(opt->arg, begin, size)) {
 				m_log << "Couldn't parse " << opt->arg << std::endl;
 				exit(-1);
 			}
 
 			traced_memory_map.add(begin, size);
+			traced_ranges.push_back(std::make_pair(begin, begin + size));
 
 			m_log << "Adding " << opt->arg << " 0x" << std::hex << begin
 				  << "+" << std::dec << size << " to trace map" << std::endl;
@@ -260,6 +271,78 @@ void  GenericTracing::parseOptions() {
 		enabled_trap = true;
 	}
 
+	if (cmd[STATE_HASH_FILE]) {
+		state_hash_file = cmd[STATE_HASH_FILE].first()->arg;
+		if (cmd[STATE_HASH_INTERVAL]) {
+			state_hash.setInterval(strtoull(cmd[STATE_HASH_INTERVAL].first()->arg, NULL, 10));
+			if (state_hash.getInterval() == 0) {
+				m_log << "--state-hash-interval must be > 0" << std::endl;
+				exit(-1);
+			}
+		}
+		for (option::Option *opt = cmd[STATE_HASH_REGION]; opt; opt = opt->next()) {
+			guest_address_t begin, size;
+			if (!parseRegion(opt->arg, begin, size)) {
+				m_log << "Couldn't parse " << opt->arg << std::endl;
+				exit(-1);
+			}
+			state_hash.addRange(begin, begin + size);
+		}
+		if (state_hash.getRanges().empty() && !use_memory_map) {
+			// faults may be injected anywhere
+			state_hash.addRange(0, simulator.getMemoryManager().getPoolSize());
+		} else if (state_hash.getRanges().empty()) {
+			// every injection target, plus the program's own data
+			for (size_t i = 0; i < traced_ranges.size(); ++i) {
+				state_hash.addRange(traced_ranges[i].first, traced_ranges[i].second);
+			}
+			if (m_elf != NULL) {
+				std::pair<guest_address_t, guest_address_t> bounds = m_elf->getValidAddressBounds();
+				state_hash.addRange(bounds.first, bounds.second);
+			}
+		}
+		m_log << "state hashes every " << std::dec << state_hash.getInterval()
+			  << " instructions: " << state_hash_file << std::endl;
+	}
+
+	if (cmd[CHECKPOINT_DIR]) {
+		checkpoints.setDirectory(cmd[CHECKPOINT_DIR].first()->arg);
+		if (cmd[CHECKPOINT_INTERVAL]) {
+			checkpoint_interval = strtoull(cmd[CHECKPOINT_INTERVAL].first()->arg, NULL, 10);
+			if (checkpoint_interval == 0) {
+				m_log << "--checkpoint-interval must be > 0" << std::endl;
+				exit(-1);
+			}
+		}
+		if (cmd[CHECKPOINT_POSITIONS]) {
+			const char *filename = cmd[CHECKPOINT_POSITIONS].first()->arg;
+			std::ifstream is(filename);
+			if (!is.is_open()) {
+				m_log << "Couldn't open checkpoint positions file: " << filename << std::endl;
+				exit(-1);
+			}
+			// "id trace_position" lines; position 0 is the start state
+			unsigned id;
+			uint64_t pos;
+			while (is >> id >> pos) {
+				if (pos > 0) {
+					checkpoint_positions.push_back(pos);
+				}
+			}
+			std::sort(checkpoint_positions.begin(), checkpoint_positions.end());
+			checkpoint_positions.erase(std::unique(checkpoint_positions.begin(), checkpoint_positions.end()),
+				checkpoint_positions.end());
+			m_log << checkpoint_positions.size() << " checkpoints at the positions in "
+				  << filename << ": " << checkpoints.getDirectory() << std::endl;
+		} else {
+			m_log << "checkpoints every " << std::dec << checkpoint_interval
+				  << " instructions: " << checkpoints.getDirectory() << std::endl;
+		}
+	} else if (cmd[CHECKPOINT_POSITIONS]) {
+		m_log << "--checkpoint-positions needs --checkpoint-dir" << std::endl;
+		exit(-1);
+	}
+
 	if(cmd[CHECK_BOUNDS]) {
 		this->check_bounds = true;
 		m_log << "enabled bounds sanity check" << std::endl;
@@ -279,6 +362,35 @@ void  GenericTracing::parseOptions() {
 	m_log << "full-trace: "	  << this->full_trace << std::endl;
 }
 
+bool GenericTracing::parseRegion(const char *arg, guest_address_t &begin, guest_address_t &size)
+{
+	char *endptr;
+	begin = strtoul(arg, &endptr, 16);
+	if (endptr == arg) {
+		return false;
+	}
+
+	char delim = *endptr;
+	if (delim == 0) {
+		size = 1;
+	} else if (delim == ':') {
+		char *p = endptr +1;
+		size = strtoul(p, &endptr, 16) - begin;
+		if (p == endptr || *endptr != 0) {
+			return false;
+		}
+	} else if (delim == '+') {
+		char *p = endptr +1;
+		size = strtoul(p, &endptr, 10);
+		if (p == endptr || *endptr != 0) {
+			return false;
+		}
+	} else {
+		return false;
+	}
+	return true;
+}
+
 bool GenericTracing::run()
 {
 	parseOptions();
@@ -365,7 +477,47 @@ bool GenericTracing::run()
 	}
 
 	simulator.addListener(&l_stop_symbol);
-	fail::BaseListener* listener = simulator.resume();
+
+	// periodic state hashes and checkpoints, counted like
+	// DatabaseExperiment's fast forward
+	const uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+	uint64_t instr = 0;
+	uint64_t next_hash = state_hash_file != "" ? state_hash.getInterval() : NEVER;
+	uint64_t next_checkpoint = NEVER;
+	if (checkpoints.getDirectory() != "") {
+		if (mkdir(checkpoints.getDirectory().c_str(), 0777) != 0 && errno != EEXIST) {
+			m_log << "Couldn't create checkpoint dir: " << checkpoints.getDirectory() << std::endl;
+			exit(-1);
+		}
+		next_checkpoint = nextCheckpoint(0);
+	}
+	BPSingleListener l_instr(ANY_ADDR);
+	if (std::min(next_hash, next_checkpoint) != NEVER) {
+		l_instr.setCounter(std::min(next_hash, next_checkpoint));
+		simulator.addListener(&l_instr);
+	}
+
+	fail::BaseListener* listener;
+	while ((listener = simulator.resume()) == &l_instr) {
+		instr = std::min(next_hash, next_checkpoint);
+		if (instr == next_hash) {
+			state_hash.record(instr, sol.getOutput().size());
+			next_hash += state_hash.getInterval();
+		}
+		if (instr == next_checkpoint) {
+			if (!simulator.save(checkpoints.path(instr))) {
+				m_log << "Couldn't save checkpoint " << checkpoints.path(instr) << std::endl;
+				exit(-1);
+			}
+			checkpoints.add(instr, sol.getOutput().size());
+			next_checkpoint = nextCheckpoint(instr);
+		}
+		if (std::min(next_hash, next_checkpoint) == NEVER) {
+			continue; // past the last --checkpoint-positions entry
+		}
+		l_instr.setCounter(std::min(next_hash, next_checkpoint) - instr);
+		simulator.addListener(&l_instr);
+	}
 	int exitcode = 0;
 	if (listener == &l_trap)
 	{
@@ -411,6 +563,22 @@ bool GenericTracing::run()
 	}
 	of.close();
 
+	if (state_hash_file != "") {
+		if (!state_hash.save(state_hash_file)) {
+			m_log << "failed to write " << state_hash_file << std::endl;
+			return false;
+		}
+		m_log << state_hash.size() << " state hashes written" << std::endl;
+	}
+
+	if (checkpoints.getDirectory() != "") {
+		if (!checkpoints.save()) {
+			m_log << "failed to write the checkpoint index in " << checkpoints.getDirectory() << std::endl;
+			return false;
+		}
+		m_log << checkpoints.size() << " checkpoints saved" << std::endl;
+	}
+
 	if (serial_file != "") {
 		simulator.removeFlow(&sol);
 		ofstream of_serial(serial_file.c_str(), ios::out|ios::binary);
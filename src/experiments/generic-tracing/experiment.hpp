@@ -5,6 +5,8 @@
 #include "util/Logger.hpp"
 #include "util/ElfReader.hpp"
 #include "util/MemoryMap.hpp"
+#include "util/CheckpointLadder.hpp"
+#include "../plugins/checkpoint/StateHash.hpp"
 #include <string>
 #include <vector>
 
@@ -29,17 +31,29 @@ class GenericTracing : public fail::ExperimentFlow {
 	fail::guest_address_t serial_port;
 	std::string serial_file;
 
+	std::string state_hash_file;
+	StateHash state_hash;
+
+	fail::CheckpointLadder checkpoints;
+	uint64_t checkpoint_interval;
+	std::vector<uint64_t> checkpoint_positions; //!< --checkpoint-positions, ascending
+
 	fail::Logger m_log;
 	fail::ElfReader *m_elf;
 	
 	bool enabled_trap;
 
+	//! instruction count of the next checkpoint after \a instr
+	uint64_t nextCheckpoint(uint64_t instr);
+
+	bool parseRegion(const char *arg, fail::guest_address_t &begin, fail::guest_address_t &size);
+
 public:
 	void parseOptions();
 	bool run();
 
 	GenericTracing() : restore(false),
-		full_trace(false), check_bounds(false), m_log("GenericTracing", false),
+		full_trace(false), check_bounds(false), checkpoint_interval(1000000), m_log("GenericTracing", false),
 		enabled_trap(false)
 		{}
 };
@@ -8,6 +8,7 @@
 #include "sal/Memory.hpp"
 #include "config/FailConfig.hpp"
 #include "util/WallclockTimer.hpp"
+#include "util/CheckpointLadder.hpp"
 
 #include "util/gzstream/gzstream.h"
 #include "util/WallclockTimer.hpp"
@@ -20,8 +21,12 @@
 #include "config/FailConfig.hpp"
 
 #include <fstream>
+#include <vector>
+#include <algorithm>
 
 #include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include <math.h>
 
@@ -63,10 +68,16 @@ bool LRASimplePandaExperiment::navigateToInjectionPoint(ConcreteInjectionPoint &
 	InjectionPointMessage ipm;
 	ip.copyInjectionPointMessage(ipm);
 	if (ipm.has_checkpoint_id()) {
-		// ToDo: Load CP state!
-
-		log_nav << "FATAL ERROR: CPs not yet implemented!" << endl;
-		simulator.terminate(1);
+		// The hop chain continues from a golden-run checkpoint
+		if (!ipm.has_checkpoint_trace_position()) {
+			log_nav << "FATAL ERROR: Hop chain lacks the position of checkpoint "
+					<< ipm.checkpoint_id() << endl;
+			simulator.terminate(1);
+		}
+		CheckpointLadder checkpoints(LRASP_CHECKPOINT_DIR);
+		log_nav << "Restoring checkpoint " << ipm.checkpoint_id() << " @ trace position "
+				<< ipm.checkpoint_trace_position() << endl;
+		simulator.restore(checkpoints.path(ipm.checkpoint_trace_position()));
 	}
 
 	log_nav << "Navigating to next instruction at navigational costs of " << ipm.costs() << endl;
@@ -151,6 +162,31 @@ bool LRASimplePandaExperiment::run()
 	// this must be done *after* configuring the plugin:
 	simulator.addFlow(&tp);
 
+	// golden-run checkpoints for hop chains, at the positions computed by
+	// compute-hops --cp-output ("id trace_position" lines), if available
+	std::vector<uint64_t> cp_positions;
+	CheckpointLadder checkpoints(LRASP_CHECKPOINT_DIR);
+	{
+		ifstream is(LRASP_CHECKPOINT_POSITIONS);
+		unsigned id;
+		uint64_t pos;
+		while (is >> id >> pos) {
+			if (pos > 0) {
+				cp_positions.push_back(pos);
+			}
+		}
+	}
+	sort(cp_positions.begin(), cp_positions.end());
+	cp_positions.erase(unique(cp_positions.begin(), cp_positions.end()), cp_positions.end());
+	if (!cp_positions.empty()) {
+		if (mkdir(LRASP_CHECKPOINT_DIR, 0777) != 0 && errno != EEXIST) {
+			logger << "FATAL ERROR: Couldn't create checkpoint dir " << LRASP_CHECKPOINT_DIR << endl;
+			simulator.terminate(1);
+		}
+		logger << cp_positions.size() << " checkpoints from " << LRASP_CHECKPOINT_POSITIONS << endl;
+	}
+	std::vector<uint64_t>::const_iterator next_cp = cp_positions.begin();
+
 	BPSingleListener func_end(elfReader->getSymbol("main").getEnd() - 4 - 28);
 	simulator.addListener(&func_end);
 	BPSingleListener step(ANY_ADDR);
@@ -166,6 +202,14 @@ bool LRASimplePandaExperiment::run()
 			break;
 		}
 		counter++;
+		if (next_cp != cp_positions.end() && *next_cp == (uint64_t) counter) {
+			if (!simulator.save(checkpoints.path(counter))) {
+				logger << "FATAL ERROR: Couldn't save checkpoint " << checkpoints.path(counter) << endl;
+				simulator.terminate(1);
+			}
+			checkpoints.add(counter);
+			++next_cp;
+		}
 		if ((counter % 1000) == 0) {
 			timer.stopTimer();
 			logger << "Traced " << counter << " insturctions in " << timer << " seconds" << endl;
@@ -176,6 +220,10 @@ bool LRASimplePandaExperiment::run()
 	logger << "Traced " << counter << " insturctions in " << timer << " seconds" << endl << endl;
 
 	logger << "golden run took " << dec << counter << " instructions" << endl;
+	if (checkpoints.size() > 0 && !checkpoints.save()) {
+		logger << "failed to write the checkpoint index" << endl;
+		return false;
+	}
 	simulator.removeFlow(&tp);
 
 	of.flush();
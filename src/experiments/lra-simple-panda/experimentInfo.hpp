@@ -2,6 +2,8 @@
 #define __LRA_SIMPLE_PANDA_EXPERIMENT_INFO_HPP__
 
 #define LRASP_TRACE				"trace.tc"
+#define LRASP_CHECKPOINT_DIR	"checkpoints" // golden-run checkpoints of hop chains
+#define LRASP_CHECKPOINT_POSITIONS	"checkpoints.pos" // compute-hops --cp-output
 #define LRASP_TIMEOUT			3000000 // 1500ms
 #define LRASP_RESULT_ADDRESS 	0x834106b0
 #define LRASP_RESULTS_BYTES		1000
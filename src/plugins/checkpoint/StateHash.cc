@@ -0,0 +1,150 @@
+#include "StateHash.hpp"
+#include "sal/SALInst.hpp"
+#include "sal/Memory.hpp"
+#include "sha1.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+using namespace fail;
+
+// memory is read page-wise; unmapped pages contribute their address only
+static const address_t PAGE_SIZE_HASH = 4096;
+
+string StateHash::digest()
+{
+	SHA1Context sha;
+	int err = SHA1Reset(&sha);
+	assert(err == 0);
+
+	// all registers of all CPUs (including the instruction pointer)
+	for (size_t i = 0; i < simulator.getCPUCount(); i++) {
+		ConcreteCPU& cpu = simulator.getCPU(i);
+		for (ConcreteCPU::iterator it = cpu.begin(); it != cpu.end(); ++it) {
+			regdata_t value = cpu.getRegisterContent(*it);
+			err = SHA1Input(&sha, (uint8_t*) &value, sizeof(value));
+			assert(err == 0);
+		}
+	}
+
+	MemoryManager& mm = simulator.getMemoryManager();
+
+	// disable paging on x86
+	#ifdef BUILD_X86
+	const Register *reg_cr0 = simulator.getCPU(0).getRegister(RID_CR0);
+	uint32_t cr0 = simulator.getCPU(0).getRegisterContent(reg_cr0);
+	simulator.getCPU(0).setRegisterContent(reg_cr0, cr0 & ~(1<<31));
+	#endif
+
+	uint8_t buf[PAGE_SIZE_HASH];
+	for (vector<address_range>::const_iterator it = m_ranges.begin(); it != m_ranges.end(); ++it) {
+		if (it->first == 0 && it->second == mm.getPoolSize()) {
+			// all of RAM: only rehash the pages modified since the last digest
+			uint64_t fp = mm.fingerprint();
+			err = SHA1Input(&sha, (uint8_t*) &fp, sizeof(fp));
+			assert(err == 0);
+			continue;
+		}
+		address_t addr = it->first;
+		while (addr < it->second) {
+			address_t len = min<address_t>(it->second - addr, PAGE_SIZE_HASH - addr % PAGE_SIZE_HASH);
+			if (mm.isMapped(addr)) {
+				mm.getBytes(addr, len, buf);
+				err = SHA1Input(&sha, buf, len);
+			} else {
+				err = SHA1Input(&sha, (uint8_t*) &addr, sizeof(addr));
+			}
+			assert(err == 0);
+			addr += len;
+		}
+	}
+
+	// restore paging on x86
+	#ifdef BUILD_X86
+	simulator.getCPU(0).setRegisterContent(reg_cr0, cr0);
+	#endif
+
+	uint8_t Message_Digest[20];
+	err = SHA1Result(&sha, Message_Digest);
+	assert(err == 0);
+
+	stringstream s;
+	s.fill('0');
+	for (size_t i = 0; i < 20; ++i)
+		s << setw(2) << hex << (unsigned short) Message_Digest[i];
+	return s.str();
+}
+
+void StateHash::record(uint64_t instr, uint64_t serial_length)
+{
+	Record r;
+	r.instr = instr;
+	r.digest = digest();
+	r.serial_length = serial_length;
+	m_records.push_back(r);
+}
+
+bool StateHash::save(const string& file)
+{
+	ofstream os(file.c_str());
+	if (!os.is_open()) {
+		m_log << "Could not open " << file << " for writing." << endl;
+		return false;
+	}
+	os << "statehash " << dec << m_interval << " " << m_ranges.size() << endl;
+	for (vector<address_range>::const_iterator it = m_ranges.begin(); it != m_ranges.end(); ++it) {
+		os << hex << it->first << "\t" << it->second << endl;
+	}
+	for (vector<Record>::const_iterator it = m_records.begin(); it != m_records.end(); ++it) {
+		os << dec << it->instr << "\t" << it->digest << "\t" << it->serial_length << endl;
+	}
+	return !os.fail();
+}
+
+bool StateHash::load(const string& file)
+{
+	ifstream is(file.c_str());
+	if (!is.is_open()) {
+		m_log << "Could not open " << file << " for reading." << endl;
+		return false;
+	}
+	string magic;
+	size_t ranges;
+	is >> magic >> dec >> m_interval >> ranges;
+	if (!is || magic != "statehash") {
+		m_log << file << " is not a state-hash file." << endl;
+		return false;
+	}
+	m_ranges.clear();
+	for (size_t i = 0; i < ranges; ++i) {
+		address_range r;
+		is >> hex >> r.first >> r.second;
+		m_ranges.push_back(r);
+	}
+	m_records.clear();
+	Record r;
+	while (is >> dec >> r.instr >> r.digest >> r.serial_length) {
+		m_records.push_back(r);
+	}
+	if (!is.eof()) {
+		m_log << "Parse error in " << file << "." << endl;
+		return false;
+	}
+	m_log << "Loaded " << m_records.size() << " state hashes from " << file << "." << endl;
+	return true;
+}
+
+static bool record_before(uint64_t instr, const StateHash::Record& r)
+{
+	return instr < r.instr;
+}
+
+const StateHash::Record *StateHash::next(uint64_t instr) const
+{
+	vector<Record>::const_iterator it =
+		upper_bound(m_records.begin(), m_records.end(), instr, record_before);
+	return it == m_records.end() ? 0 : &*it;
+}
@@ -0,0 +1,75 @@
+#ifndef __StateHash_HPP__
+#define __StateHash_HPP__
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include "sal/SALConfig.hpp"
+#include "util/Logger.hpp"
+
+/**
+ * @class StateHash
+ * @brief SHA1 digests of the machine state (all CPU registers plus a set of
+ * memory ranges) at fixed dynamic instruction counts.
+ *
+ * In the golden run, record() is called every getInterval() instructions and
+ * the digests are saved to a file.  An experiment loads this file and
+ * compares the state at the same instruction counts: once the digests match
+ * again after an injection, the fault has been masked and the remaining run
+ * is identical to the golden run.
+ *
+ * Instruction counts are the number of triggered BPSingleListener(ANY_ADDR)
+ * events since the start state, i.e., the same unit as
+ * DatabaseCampaignMessage::injection_instr.  Memory not covered by the ranges
+ * (and device state) is not compared.  A range covering the whole memory pool
+ * is hashed via MemoryManager::fingerprint(), which only rehashes the pages
+ * modified since the previous digest on backends with dirty-page tracking
+ * (Bochs: CONFIG_DIRTY_PAGES).
+ */
+class StateHash
+{
+public:
+	typedef std::pair<fail::address_t, fail::address_t> address_range; //!< [begin, end)
+
+	struct Record {
+		uint64_t instr;          //!< dynamic instruction count
+		std::string digest;      //!< SHA1 (hex)
+		uint64_t serial_length;  //!< serial output produced up to here
+	};
+
+private:
+	std::vector<address_range> m_ranges;
+	uint64_t m_interval;
+	std::vector<Record> m_records;
+	fail::Logger m_log;
+
+public:
+	StateHash() : m_interval(10000), m_log("StateHash", false) {}
+
+	//! Add a memory range [begin, end) to the digest (before the first record).
+	void addRange(fail::address_t begin, fail::address_t end) { m_ranges.push_back(address_range(begin, end)); }
+	const std::vector<address_range>& getRanges() const { return m_ranges; }
+
+	void setInterval(uint64_t interval) { m_interval = interval; }
+	uint64_t getInterval() const { return m_interval; }
+
+	//! Digest of the current machine state (hex)
+	std::string digest();
+
+	//! Append a golden-run record for the current machine state.
+	void record(uint64_t instr, uint64_t serial_length = 0);
+
+	//! Write the ranges and all records to a file.
+	bool save(const std::string& file);
+
+	//! Read ranges and records from a file written by save().
+	bool load(const std::string& file);
+
+	//! The first record after instruction count "instr" (0 if none).
+	const Record *next(uint64_t instr) const;
+
+	size_t size() const { return m_records.size(); }
+};
+
+#endif // __StateHash_HPP__
@@ -40,6 +40,11 @@ public:
 	 * Returns the output variable.
 	 */
 	std::string getOutput();
+	/**
+	 * Replaces the recorded output, e.g., with the golden run's output up
+	 * to a restored checkpoint.
+	 */
+	void setOutput(const std::string& output) { m_output = output; }
 	/**
 	 * Re-sets the port.  Will not work properly if the plugin is already
 	 * running.
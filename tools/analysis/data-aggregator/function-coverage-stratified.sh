@@ -0,0 +1,24 @@
+#!/bin/bash
+
+source $(dirname $0)/fail-analysis-common.inc.sh
+
+# Per-function estimates of the stratified-sampling pruner: each stratum is a
+# simple random sample of its function's fault space.
+$MYSQL << EOT
+SELECT v.benchmark, v.variant, m.method, s.name, s.area, s.samples, CONCAT(r.resulttype) AS resulttype,
+  SUM(sp.hits) / s.samples AS coverage,
+
+         SQRT(SUM(sp.hits) / s.samples * (1 - SUM(sp.hits) / s.samples) / s.samples) AS standard_error,
+  1.96 * SQRT(SUM(sp.hits) / s.samples * (1 - SUM(sp.hits) / s.samples) / s.samples) AS confidence95,
+  2.576 * SQRT(SUM(sp.hits) / s.samples * (1 - SUM(sp.hits) / s.samples) / s.samples) AS confidence99
+
+FROM variant v
+JOIN fspstratum s ON s.variant_id = v.id
+JOIN fspmethod m ON m.id = s.fspmethod_id
+JOIN fspstratum_pilot sp ON sp.variant_id = s.variant_id AND sp.fspmethod_id = s.fspmethod_id AND sp.stratum_id = s.id
+JOIN result_GenericExperimentMessage r ON r.pilot_id = sp.pilot_id
+WHERE $FILTER
+GROUP BY v.id, s.fspmethod_id, s.id, r.resulttype
+ORDER BY v.benchmark, v.variant, m.method, s.area DESC, s.name, CONCAT(r.resulttype)
+;
+EOT
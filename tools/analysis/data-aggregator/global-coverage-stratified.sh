@@ -0,0 +1,39 @@
+#!/bin/bash
+
+source $(dirname $0)/fail-analysis-common.inc.sh
+
+# Stratified estimate (stratified-sampling pruner): each stratum (function)
+# contributes its coverage weighted by its share of the fault space,
+# variance = SUM(w^2 * p * (1 - p) / n) over the strata.
+$MYSQL << EOT
+SELECT v.benchmark, v.variant, m.method, x.resulttype,
+  SUM(x.w * x.p) AS coverage,
+
+         SQRT(SUM(x.w * x.w * x.p * (1 - x.p) / x.n)) AS standard_error,
+  1.96 * SQRT(SUM(x.w * x.w * x.p * (1 - x.p) / x.n)) AS confidence95,
+  2.326347874041 * SQRT(SUM(x.w * x.w * x.p * (1 - x.p) / x.n)) AS confidence98,
+  2.576 * SQRT(SUM(x.w * x.w * x.p * (1 - x.p) / x.n)) AS confidence99,
+
+  MAX(x.total_samples) AS n
+
+FROM
+  (SELECT s.variant_id, s.fspmethod_id, CONCAT(r.resulttype) AS resulttype,
+     s.samples AS n, tot.samples AS total_samples,
+     s.area / tot.area AS w,
+     SUM(sp.hits) / s.samples AS p
+   FROM fspstratum s
+   JOIN (SELECT variant_id, fspmethod_id, SUM(area) AS area, SUM(samples) AS samples
+         FROM fspstratum
+         GROUP BY variant_id, fspmethod_id
+        ) tot ON tot.variant_id = s.variant_id AND tot.fspmethod_id = s.fspmethod_id
+   JOIN fspstratum_pilot sp ON sp.variant_id = s.variant_id AND sp.fspmethod_id = s.fspmethod_id AND sp.stratum_id = s.id
+   JOIN result_GenericExperimentMessage r ON r.pilot_id = sp.pilot_id
+   GROUP BY s.variant_id, s.fspmethod_id, s.id, r.resulttype
+  ) x
+JOIN variant v ON v.id = x.variant_id
+JOIN fspmethod m ON m.id = x.fspmethod_id
+WHERE $FILTER
+GROUP BY x.variant_id, x.fspmethod_id, x.resulttype
+ORDER BY v.benchmark, v.variant, m.method, x.resulttype
+;
+EOT
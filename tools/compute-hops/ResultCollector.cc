@@ -9,13 +9,17 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cmath>
 #include <numeric>
 #include <algorithm>
 
 #include <vector>
+#include <boost/thread.hpp>
 
 #include "comm/InjectionPointHopsMessage.pb.h"
+#include "util/ProtoBatch.hpp"
+#include "util/SynchronizedQueue.hpp"
 
 //#define MEASURE_MEM_USAGE
 
@@ -32,10 +36,212 @@ extern std::ofstream g_cp_ofstream;
 
 extern fail::Logger LOG;
 
+// hand a batch of results to an encoder thread when it holds this many hops
+static const size_t BATCH_HOPS = 256 * 1024;
+
+// Writes the hop chain [begin, end) to ps, or as text to text if ps is 0.
+// Returns the number of bytes written to ps.
+static size_t
+encodeResult(const result_tuple *begin, const result_tuple *end, unsigned int costs,
+	std::ostream& text, ProtoOStream *ps)
+{
+	if (ps) {
+		InjectionPointMessage hc;
+		hc.set_costs(costs);
+		if (begin != end) {
+			hc.set_target_trace_position((end - 1)->second);
+		}
+		// If checkpoint at beginning of hop-chain, add its id to InjectionPointMessage
+		const result_tuple *it_hop = begin;
+		if (it_hop != end && it_hop->first.second == ACCESS_CHECKPOINT) {
+			hc.set_checkpoint_id(it_hop->first.first);
+			hc.set_checkpoint_trace_position(it_hop->second);
+			it_hop++;
+		}
+
+		for (; it_hop != end;
+			it_hop++) {
+			InjectionPointMessage_Hops *hop = hc.add_hops();
+			hop->set_address(it_hop->first.first);
+
+			InjectionPointMessage::Hops::AccessType at;
+			switch (it_hop->first.second) {
+			case ACCESS_NONE:
+				at = InjectionPointMessage::Hops::EXECUTE;
+				break;
+			case ACCESS_READ:
+				at = InjectionPointMessage::Hops::READ;
+				break;
+			case ACCESS_WRITE:
+				at = InjectionPointMessage::Hops::WRITE;
+				break;
+			case ACCESS_READORWRITE:
+				LOG << "ReadOrWrite memory access event not yet"
+				" covered" << std::endl;
+				exit(-1);
+				break;
+			case ACCESS_CHECKPOINT:
+				LOG << "Checkpoint not allowed after beginning of hop chain" << std::endl;
+				exit(-1);
+			default:
+				LOG << "Unknown memory-access event" << std::endl;
+				exit(-1);
+			}
+			hop->set_accesstype(at);
+		}
+		ps->writeMessage(&hc);
+		return sizeof(uint32_t) + hc.ByteSize();
+	} else {
+		for (const result_tuple *it_hop = begin;
+				it_hop != end;
+				it_hop++) {
+			address_t add = it_hop->first.first;
+			mem_access_type_e mem_acc_type = it_hop->first.second;
+			std::string prefix = (mem_acc_type == ACCESS_READ)?"R":((mem_acc_type == ACCESS_WRITE)?"W":((mem_acc_type == ACCESS_NONE)?"X":((mem_acc_type == ACCESS_CHECKPOINT)?"C":"")));
+			text << prefix << hex << add << dec << separator;
+		}
+
+		if (begin != end)
+			text << '\n';
+	}
+	return 0;
+}
+
+namespace {
+
+// Hop chains (concatenated) to be encoded; the encoding goes to data
+struct ResultBatch : public ProtoBatch {
+	std::vector<result_tuple> hops;
+	std::vector<size_t> ends;      // end of each chain in hops
+	std::vector<unsigned int> costs;
+	std::vector<size_t> lengths;   // encoded length of each chain
+};
+
+} // anonymous namespace
+
+// Encodes batches of results in several threads, and writes them in their
+// original order in another one.  The queues bound the number of batches in
+// flight, and with it the memory usage.
+class ResultCollector::Encoder {
+	SynchronizedQueue<ResultBatch *> m_work, m_order;
+	boost::thread_group m_threads;
+	ResultBatch *m_batch; // currently filled batch
+	std::ostream *m_out;
+	bool m_proto;
+	HopTableWriter *m_table;
+
+	void encode();
+	void write();
+	void flush();
+public:
+	Encoder(std::ostream *out, bool proto, HopTableWriter *table, unsigned threads);
+
+	void add(const std::vector<result_tuple >& res, unsigned int costs);
+
+	// Writes all remaining results and stops the threads
+	void finish();
+};
+
+ResultCollector::Encoder::Encoder(std::ostream *out, bool proto, HopTableWriter *table,
+	unsigned threads)
+	: m_work(2 * threads), m_order(4 * threads), m_batch(new ResultBatch),
+	  m_out(out), m_proto(proto), m_table(table)
+{
+	for (unsigned i = 0; i < threads; ++i) {
+		m_threads.create_thread([this] { encode(); });
+	}
+	m_threads.create_thread([this] { write(); });
+}
+
+void
+ResultCollector::Encoder::add(const std::vector<result_tuple >& res, unsigned int costs)
+{
+	m_batch->hops.insert(m_batch->hops.end(), res.begin(), res.end());
+	m_batch->ends.push_back(m_batch->hops.size());
+	m_batch->costs.push_back(costs);
+	if (m_batch->hops.size() >= BATCH_HOPS) {
+		flush();
+		m_batch = new ResultBatch;
+	}
+}
+
+void
+ResultCollector::Encoder::flush()
+{
+	// encoders may finish batches in any order, the writer takes them in
+	// this one
+	m_order.Enqueue(m_batch);
+	m_work.Enqueue(m_batch);
+}
+
 void
-ResultCollector::setProtoOStream(ProtoOStream* protoOStream)
+ResultCollector::Encoder::finish()
 {
-	ps = protoOStream;
+	flush();
+	m_batch = 0;
+	m_work.setIsFinished();
+	m_order.setIsFinished();
+	m_threads.join_all();
+}
+
+void
+ResultCollector::Encoder::encode()
+{
+	ResultBatch *batch;
+	while ((batch = m_work.Dequeue()) != 0) {
+		std::ostringstream data;
+		ProtoOStream ps(&data);
+		size_t begin = 0;
+		for (size_t i = 0; i < batch->ends.size(); ++i) {
+			const result_tuple *hops = batch->hops.data();
+			batch->lengths.push_back(encodeResult(hops + begin,
+				hops + batch->ends[i], batch->costs[i], data, m_proto ? &ps : 0));
+			begin = batch->ends[i];
+		}
+		batch->data = data.str();
+		// the chains are not needed anymore
+		std::vector<result_tuple>().swap(batch->hops);
+		batch->finish();
+	}
+}
+
+void
+ResultCollector::Encoder::write()
+{
+	ResultBatch *batch;
+	while ((batch = m_order.Dequeue()) != 0) {
+		batch->wait();
+		m_out->write(batch->data.data(), batch->data.size());
+		if (m_table) {
+			for (size_t i = 0; i < batch->lengths.size(); ++i) {
+				m_table->add(batch->lengths[i], batch->costs[i]);
+			}
+		}
+		delete batch;
+	}
+}
+
+ResultCollector::~ResultCollector()
+{
+	if (m_encoder) {
+		m_encoder->finish();
+		delete m_encoder;
+	}
+	delete ps;
+}
+
+void
+ResultCollector::setProtoOutput(std::ostream *out)
+{
+	m_proto_out = out;
+	ps = new ProtoOStream(out);
+}
+
+void
+ResultCollector::setTableOutput(HopTableWriter *table)
+{
+	m_table = table;
+	setProtoOutput(&table->stream());
 }
 
 unsigned int calculate_costs(std::vector<result_tuple >& res)
@@ -75,60 +281,18 @@ ResultCollector::addResult(std::vector<result_tuple >& res, unsigned int costs)
 	if (m_output_mode == OUTPUT_COSTS) {
 		m_ostream << m_res_count++ << separator << costs << '\n';
 	} else if (m_output_mode == OUTPUT_RESULT) {
-		if (ps) {
-			InjectionPointMessage hc;
-			hc.set_costs(costs);
-			hc.set_target_trace_position(res.back().second);
-			// If checkpoint at beginning of hop-chain, add its id to InjectionPointMessage
-			std::vector<result_tuple >::iterator it_hop = res.begin();
-			if (it_hop != res.end() && it_hop->first.second == ACCESS_CHECKPOINT) {
-				hc.set_checkpoint_id(it_hop->first.first);
-				it_hop++;
-			}
-
-			for (; it_hop != res.end();
-				it_hop++) {
-				InjectionPointMessage_Hops *hop = hc.add_hops();
-				hop->set_address(it_hop->first.first);
-
-				InjectionPointMessage::Hops::AccessType at;
-				switch (it_hop->first.second) {
-				case ACCESS_NONE:
-					at = InjectionPointMessage::Hops::EXECUTE;
-					break;
-				case ACCESS_READ:
-					at = InjectionPointMessage::Hops::READ;
-					break;
-				case ACCESS_WRITE:
-					at = InjectionPointMessage::Hops::WRITE;
-					break;
-				case ACCESS_READORWRITE:
-					LOG << "ReadOrWrite memory access event not yet"
-					" covered" << std::endl;
-					exit(-1);
-					break;
-				case ACCESS_CHECKPOINT:
-					LOG << "Checkpoint not allowed after beginning of hop chain" << std::endl;
-					exit(-1);
-				default:
-					LOG << "Unknown memory-access event" << std::endl;
-					exit(-1);
-				}
-				hop->set_accesstype(at);
+		if (m_threads > 0) {
+			if (!m_encoder) {
+				m_encoder = new Encoder(ps ? m_proto_out : &m_ostream, ps != 0,
+					m_table, m_threads);
 			}
-			ps->writeMessage(&hc);
+			m_encoder->add(res, costs);
 		} else {
-			for (std::vector<result_tuple >::iterator it_hop = res.begin();
-					it_hop != res.end();
-					it_hop++) {
-				address_t add = it_hop->first.first;
-				mem_access_type_e mem_acc_type = it_hop->first.second;
-				std::string prefix = (mem_acc_type == ACCESS_READ)?"R":((mem_acc_type == ACCESS_WRITE)?"W":((mem_acc_type == ACCESS_NONE)?"X":((mem_acc_type == ACCESS_CHECKPOINT)?"C":"")));
-				m_ostream << prefix << hex << add << dec << separator;
+			size_t len = encodeResult(res.data(), res.data() + res.size(), costs,
+				m_ostream, ps);
+			if (m_table) {
+				m_table->add(len, costs);
 			}
-
-			if (res.size() > 0)
-				m_ostream << '\n';
 		}
 	} else if (m_output_mode == OUTPUT_STATISTICS) {
 		// Calculate mean
@@ -139,6 +303,8 @@ ResultCollector::addResult(std::vector<result_tuple >& res, unsigned int costs)
 	}
 }
 
+// One "id trace_position" line per checkpoint, ids as in the hop chains
+// (InjectionPointMessage::checkpoint_id)
 void
 ResultCollector::addCheckpoint(unsigned int pos)
 {
@@ -173,6 +339,15 @@ void
 ResultCollector::finish()
 {
 	// Print results if buffered
+	if (m_encoder) {
+		m_encoder->finish();
+		delete m_encoder;
+		m_encoder = 0;
+	}
+
+	if (m_table && !m_table->close()) {
+		LOG << "Unable to write hop table" << std::endl;
+	}
 
 	// Print statistics
 	if (m_output_mode == OUTPUT_STATISTICS) {
@@ -13,6 +13,7 @@
 #include <iostream>
 
 #include "../../src/core/util/smarthops/TraceReader.hpp"
+#include "../../src/core/util/smarthops/HopTable.hpp"
 
 #include "util/WallclockTimer.hpp"
 
@@ -42,10 +43,16 @@ public:
 		m_output_mode(output_mode),
 		m_mem_usage(0),
 		m_result_size(0),
-		m_checkpoint_count(1),
+		m_checkpoint_count(0),
 		m_it_mean_costs(0),
 		m_max_costs(0),
-		ps(0) {}
+		ps(0),
+		m_proto_out(0),
+		m_table(0),
+		m_threads(0),
+		m_encoder(0) {}
+
+	~ResultCollector();
 
 	void
 	addResult(std::vector<result_tuple >& res, unsigned int costs);
@@ -62,8 +69,20 @@ public:
 	void
 	setMaxMemUsage();
 
+	// Results are written in protobuf (HopChain) format to out
+	void
+	setProtoOutput(std::ostream *out);
+
+	// Results are written to an indexed hop table (protobuf format, one
+	// chain per trace position); table is closed by finish()
 	void
-	setProtoOStream(ProtoOStream* protoOStream);
+	setTableOutput(HopTableWriter *table);
+
+	// Encodes the results in threads worker threads, and writes them in a
+	// further one, in the same order and format as without threads (0, the
+	// default). Must be called before the first addResult().
+	void
+	setThreads(unsigned threads) { m_threads = threads; }
 
 	// Prints buffered results on output stream
 	void
@@ -84,6 +103,12 @@ private:
 	fail::WallclockTimer m_timer;
 
 	fail::ProtoOStream *ps;
+	std::ostream *m_proto_out;
+	HopTableWriter *m_table;
+
+	class Encoder;
+	unsigned m_threads;
+	Encoder *m_encoder;
 };
 
 #endif /* STATISTICSCOLLECTOR_HPP_ */
@@ -55,6 +55,8 @@ bool SmartAlgorithm::calculateAllHops(TraceReader& trace)
 					result.clear();
 					result.push_back(result_tuple(*it_te, trace_pos));
 					costs = COST_CHANGE;
+					// no chain can return to the checkpoints before
+					m_checkpoints.clear();
 					m_resultCollector->addResult(result, costs);
 					hop_found = true;
 				}
@@ -107,10 +109,10 @@ bool SmartAlgorithm::calculateAllHops(TraceReader& trace)
 			if ((rit_pre_last == result.rend())) {
 				// First node in hop list is Checkpoint? => Look at result before CP-Creation
 				if (rit_last->first.second == ACCESS_CHECKPOINT) {
-					rit_pre_last = (m_checkpoints[rit_last->first.first]).second.rbegin();
+					rit_pre_last = m_checkpoints[rit_last->first.first].second.rbegin();
 
 					// This should never happen:
-					if (rit_pre_last == (m_checkpoints[rit_last->first.first]).second.rend()) {
+					if (rit_pre_last == m_checkpoints[rit_last->first.first].second.rend()) {
 						break;
 					}
 
@@ -156,18 +158,19 @@ bool SmartAlgorithm::calculateAllHops(TraceReader& trace)
 			// There will be no past in the trace
 			// Reconfigure result and iterators
 			if (rit_last->first.second == ACCESS_CHECKPOINT) {
-				costs = m_checkpoints[rit_last->first.first].first;
+				std::map<unsigned int, checkpoint_tuple_t>::iterator cp =
+					m_checkpoints.find(rit_last->first.first);
+				costs = cp->second.first;
 
 				result.clear();
-				std::vector<result_tuple > *tmp = &(m_checkpoints[rit_last->first.first].second);
-				result.insert(result.end(), tmp->begin(), tmp->end());
+				result.insert(result.end(), cp->second.second.begin(), cp->second.second.end());
 
 				rit_last = result.rbegin();
 				rit_pre_last = result.rbegin();
 				rit_pre_last++;
 
-				// CP could be removed from m_checkpoints, but to do this
-				// m_checkpoints needs to be a map (CP-ID is implicit as vector index)
+				// the chain is past this CP now
+				m_checkpoints.erase(cp);
 
 				continue;
 			}
@@ -196,7 +199,7 @@ bool SmartAlgorithm::calculateAllHops(TraceReader& trace)
 		// Check if Checkpoint needed
 		if (g_use_checkpoints && (costs > g_cp_thresh) && !checkpoint_forbidden) {
 			checkpoint_tuple_t new_cp(costs, std::vector<result_tuple >(result));
-			m_checkpoints.push_back(new_cp);
+			m_checkpoints.insert(std::make_pair(m_next_cp_id, new_cp));
 			result.clear();
 			result.push_back(result_tuple(trace_event_tuple_t(m_next_cp_id++,
 																ACCESS_CHECKPOINT),
@@ -32,7 +32,8 @@ private:
 							mem_access_type_e acc);
 
 	std::map<trace_event_tuple_t, trace_pos_t> m_last_positions;
-	std::vector<checkpoint_tuple_t > m_checkpoints;
+	// CPs the current hop chain may still return to, by ID
+	std::map<unsigned int, checkpoint_tuple_t> m_checkpoints;
 	unsigned int m_next_cp_id;
 };
 
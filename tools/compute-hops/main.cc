@@ -2,6 +2,7 @@
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <boost/thread.hpp>
 
 #include "../../src/core/util/smarthops/TraceReader.hpp"
 #include "BasicAlgorithm.hpp"
@@ -63,6 +64,11 @@ int main(int argc, char *argv[])
 		cmd.addOption("b", "protobuf-output", Arg::None,
 			"-b,--protobuf-output \tOutput file will be created in protobuf (HopChain) format");
 
+	CommandLine::option_handle OUTPUT_TABLE =
+		cmd.addOption("t", "table", Arg::None,
+			"-t,--table \tOutput file will be an indexed hop table, as used by the campaign "
+			"server ($FAIL_HOPS_TABLE)");
+
 	CommandLine::option_handle USE_COSTS =
 		cmd.addOption("c", "use-costs", Arg::None,
 			"-c,--use-costs \tUse hop costs for calculations of Smart-Hopping algorithm");
@@ -89,7 +95,13 @@ int main(int argc, char *argv[])
 
 	CommandLine::option_handle CHECKPOINT_OUTPUT_FILE =
 		cmd.addOption("", "cp-output", Arg::Required,
-			"--cp-output \tCheckpoint output file");
+			"--cp-output \tCheckpoint output file (\"id trace_position\" lines, the golden run "
+			"captures them with generic-tracing --checkpoint-positions)");
+
+	CommandLine::option_handle THREADS =
+		cmd.addOption("j", "threads", Arg::Required,
+			"-j,--threads N \tDecode the trace and encode the results with N threads each, "
+			"output is identical to sequential operation (default: number of CPUs, 0: no threads)");
 
 	for (int i = 1; i < argc; ++i) {
 		cmd.add_args(argv[i]);
@@ -167,7 +179,13 @@ int main(int argc, char *argv[])
 		output_mode = OUTPUT_RESULT;
 	}
 
+	unsigned threads = boost::thread::hardware_concurrency();
+	if (cmd[THREADS]) {
+		threads = strtoul(cmd[THREADS].first()->arg, NULL, 0);
+	}
+
 	fail::TraceReader trace;
+	trace.setThreads(threads);
 
 	if (cmd[TRACE_FILE].count() > 0) {
 		const char *filename = cmd[TRACE_FILE].first()->arg;
@@ -182,7 +200,15 @@ int main(int argc, char *argv[])
 
 	std::ostream *outFile;
 
-	if (cmd[OUTPUT_FILE].count() > 0) {
+	if (cmd[OUTPUT_TABLE] && (!cmd[OUTPUT_FILE]
+		|| strcmp(cmd[OUTPUT_FILE].first()->arg, STDOUT_CMD_STRING) == 0
+		|| cmd[OUTPUT_FILE_PROTOBUF] || output_mode != OUTPUT_RESULT)) {
+		LOG << "A hop table needs an output file, and cannot be combined with "
+			"protobuf output or other output modes" << std::endl;
+		exit(-1);
+	}
+
+	if (cmd[OUTPUT_FILE].count() > 0 && !cmd[OUTPUT_TABLE]) {
 		std::string filename(cmd[OUTPUT_FILE].first()->arg);
 
 		if (filename.compare(STDOUT_CMD_STRING) == 0) {
@@ -277,12 +303,20 @@ int main(int argc, char *argv[])
 
 
 	ogzstream zipstream;
+	HopTableWriter table;
 
 	ResultCollector rc(*outFile, output_mode);
+	rc.setThreads(threads);
 
 	if (cmd[OUTPUT_FILE_PROTOBUF]) {
 		zipstream.open(cmd[OUTPUT_FILE].first()->arg);
-		rc.setProtoOStream(new ProtoOStream(&zipstream));
+		rc.setProtoOutput(&zipstream);
+	} else if (cmd[OUTPUT_TABLE]) {
+		if (!table.open(cmd[OUTPUT_FILE].first()->arg)) {
+			LOG << "Unable to open output file " << cmd[OUTPUT_FILE].first()->arg << std::endl;
+			exit(-1);
+		}
+		rc.setTableOutput(&table);
 	}
 
 	BasicAlgorithm *algo;
@@ -0,0 +1,421 @@
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread.hpp>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include "TraceDiffer.hpp"
+#include "comm/TracePlugin.pb.h"
+#include "util/Logger.hpp"
+#include "util/ProtoBatch.hpp"
+#include "util/SynchronizedQueue.hpp"
+
+using namespace fail;
+using std::endl;
+using std::hex;
+using std::dec;
+
+static Logger LOG("diff-trace", true);
+
+// hand a batch of encoded events to the comparing thread at this size
+static const size_t BATCH_SIZE = 1024 * 1024;
+
+namespace {
+
+// Reads encoded events into batches
+class FrameReader {
+	std::istream *in;
+	SynchronizedQueue<ProtoBatch *> *queue;
+	std::atomic<bool> *stop;
+	bool *ok;
+public:
+	FrameReader(std::istream *in, SynchronizedQueue<ProtoBatch *> *queue,
+		std::atomic<bool> *stop, bool *ok)
+		: in(in), queue(queue), stop(stop), ok(ok) {}
+	void operator()();
+};
+
+void FrameReader::operator()()
+{
+	ProtoIStream ps(in);
+	bool more;
+	do {
+		ProtoBatch *batch = new ProtoBatch;
+		more = batch->fill(ps, BATCH_SIZE);
+		queue->Enqueue(batch);
+	} while (more && !*stop);
+	if (ps.truncated()) {
+		LOG << "trace file truncated" << endl;
+		*ok = false;
+	}
+	queue->setIsFinished();
+}
+
+// Does the encoded event lack a memaddr, i.e., is it an IP event?
+static bool isInstruction(const char *p, uint32_t size)
+{
+	using google::protobuf::internal::WireFormatLite;
+	google::protobuf::io::CodedInputStream cis(reinterpret_cast<const uint8_t *>(p), size);
+	uint32_t tag;
+	while ((tag = cis.ReadTag()) != 0) {
+		if (WireFormatLite::GetTagFieldNumber(tag) == Trace_Event::kMemaddrFieldNumber) {
+			return false;
+		}
+		if (!WireFormatLite::SkipField(&cis, tag)) {
+			break;
+		}
+	}
+	return true;
+}
+
+/**
+ * Sequential access to the encoded events of a trace, which is read by a
+ * separate thread.  Events can be buffered for looking ahead; events and
+ * instructions are counted when they are consumed with advance() or drop().
+ */
+class TraceCursor {
+	SynchronizedQueue<ProtoBatch *> m_queue;
+	std::atomic<bool> m_stop;
+	bool m_ok;
+	boost::thread m_thread;
+
+	ProtoBatch *m_batch;
+	size_t m_pos;
+	bool m_end;
+	std::deque<std::string> m_ahead;
+	uint64_t m_events, m_instr;
+
+	bool readFrame(const char *&p, uint32_t& size);
+	void count(const char *p, uint32_t size)
+	{
+		++m_events;
+		if (isInstruction(p, size)) {
+			++m_instr;
+		}
+	}
+public:
+	TraceCursor(std::istream& in)
+		: m_queue(4), m_stop(false), m_ok(true), m_batch(0), m_pos(0),
+		  m_end(false), m_events(0), m_instr(0)
+	{
+		m_thread = boost::thread(FrameReader(&in, &m_queue, &m_stop, &m_ok));
+	}
+	~TraceCursor();
+
+	/**
+	 * Next event without consuming it, false at the end of the trace.
+	 */
+	bool front(const char *&p, uint32_t& size);
+	/**
+	 * Consumes the next event.
+	 */
+	void advance();
+	/**
+	 * Buffers up to n events for at(), returns the number buffered.
+	 */
+	size_t fill(size_t n);
+	const std::string& at(size_t i) const { return m_ahead[i]; }
+	/**
+	 * Consumes n buffered events.
+	 */
+	void drop(size_t n);
+	/**
+	 * Consumes the rest of the trace.
+	 */
+	void drain();
+
+	uint64_t events() const { return m_events; }
+	uint64_t instructions() const { return m_instr; }
+	bool ok() const { return m_ok; }
+};
+
+TraceCursor::~TraceCursor()
+{
+	// make the reader stop, and unblock it if it waits for a free slot
+	m_stop = true;
+	delete m_batch;
+	ProtoBatch *batch;
+	while ((batch = m_queue.Dequeue()) != 0) {
+		delete batch;
+	}
+	m_thread.join();
+}
+
+bool TraceCursor::readFrame(const char *&p, uint32_t& size)
+{
+	while (!m_batch || !m_batch->next(m_pos, p, size)) {
+		if (m_end) {
+			return false;
+		}
+		delete m_batch;
+		m_batch = m_queue.Dequeue();
+		m_pos = 0;
+		if (!m_batch) {
+			m_end = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TraceCursor::front(const char *&p, uint32_t& size)
+{
+	if (!m_ahead.empty()) {
+		p = m_ahead.front().data();
+		size = m_ahead.front().size();
+		return true;
+	}
+	if (!readFrame(p, size)) {
+		return false;
+	}
+	// the frame lies within the current batch, step back
+	m_pos -= sizeof(size) + size;
+	return true;
+}
+
+void TraceCursor::advance()
+{
+	if (!m_ahead.empty()) {
+		drop(1);
+		return;
+	}
+	const char *p;
+	uint32_t size;
+	if (readFrame(p, size)) {
+		count(p, size);
+	}
+}
+
+size_t TraceCursor::fill(size_t n)
+{
+	const char *p;
+	uint32_t size;
+	while (m_ahead.size() < n && readFrame(p, size)) {
+		m_ahead.push_back(std::string(p, size));
+	}
+	return m_ahead.size();
+}
+
+void TraceCursor::drop(size_t n)
+{
+	for (size_t i = 0; i < n && !m_ahead.empty(); ++i) {
+		count(m_ahead.front().data(), m_ahead.front().size());
+		m_ahead.pop_front();
+	}
+}
+
+void TraceCursor::drain()
+{
+	drop(m_ahead.size());
+	const char *p;
+	uint32_t size;
+	while (readFrame(p, size)) {
+		count(p, size);
+	}
+}
+
+// Turns encoded events into comparable byte strings
+class KeyMaker {
+	bool compare_time;
+	Trace_Event ev;
+public:
+	KeyMaker(bool compare_time) : compare_time(compare_time) {}
+	void operator()(const char *p, uint32_t size, std::string& key)
+	{
+		if (compare_time || !ev.ParseFromArray(p, size)) {
+			key.assign(p, size);
+			return;
+		}
+		ev.clear_time_delta();
+		ev.SerializeToString(&key);
+	}
+};
+
+std::string formatEvent(const char *p, uint32_t size)
+{
+	Trace_Event ev;
+	if (!ev.ParseFromArray(p, size)) {
+		return "(undecodable event)";
+	}
+	std::stringstream s;
+	if (!ev.has_memaddr()) {
+		s << "IP " << hex << ev.ip() << dec;
+	} else {
+		s << "MEM " << (ev.accesstype() == Trace_Event_AccessType_READ ? "R" : "W") << " "
+		  << hex << ev.memaddr() << dec << " width " << ev.width()
+		  << hex << " IP " << ev.ip() << dec;
+	}
+	if (ev.has_time_delta()) {
+		s << " dt=" << ev.time_delta();
+	}
+	if (ev.has_trace_ext()) {
+		const Trace_Event_Extended& ext = ev.trace_ext();
+		s << hex << " DATA " << (uint64_t) ext.data();
+		for (int i = 0; i < ext.registers_size(); i++) {
+			const Trace_Event_Extended_Registers& reg = ext.registers(i);
+			s << " REG " << (unsigned) reg.id() << " = ";
+			if (reg.has_value()) {
+				s << reg.value();
+			} else {
+				s << "??";
+			}
+			s << " -> ";
+			if (reg.has_value_deref()) {
+				s << reg.value_deref();
+			} else {
+				s << "??";
+			}
+		}
+		if (ext.stack_size() > 0) {
+			s << " STACK:";
+			for (int i = 0; i < ext.stack_size(); i++) {
+				s << " " << ext.stack(i).value();
+			}
+		}
+		s << dec;
+	}
+	return s.str();
+}
+
+} // anonymous namespace
+
+TraceDiffer::Result TraceDiffer::diff(std::istream& golden, std::istream& faulty, std::ostream& out)
+{
+	TraceCursor a(golden), b(faulty);
+	KeyMaker key(m_compare_time);
+	std::string key_a, key_b;
+	uint64_t equal = 0;
+	unsigned regions = 0;
+	bool resync_failed = false;
+
+	while (true) {
+		const char *pa, *pb;
+		uint32_t sa, sb;
+		bool ha = a.front(pa, sa), hb = b.front(pb, sb);
+		if (!ha && !hb) {
+			break;
+		}
+		if (ha && hb) {
+			// fast path: identical encodings
+			if (sa == sb && memcmp(pa, pb, sa) == 0) {
+				a.advance();
+				b.advance();
+				++equal;
+				continue;
+			}
+			key(pa, sa, key_a);
+			key(pb, sb, key_b);
+			if (key_a == key_b) {
+				a.advance();
+				b.advance();
+				++equal;
+				continue;
+			}
+		}
+
+		if (regions == 0) {
+			out << "first divergence: golden event " << a.events()
+				<< " (instruction " << a.instructions() << "), faulty event "
+				<< b.events() << " (instruction " << b.instructions() << ")\n"
+				<< "  golden: " << (ha ? formatEvent(pa, sa) : "end of trace") << "\n"
+				<< "  faulty: " << (hb ? formatEvent(pb, sb) : "end of trace") << "\n";
+		}
+		++regions;
+
+		// Look for the nearest pair of positions (x, y) -- minimizing x + y --
+		// from which on m_sync events are equal.  Candidates are found by
+		// hashing the m_sync keys following each position.
+		size_t na = a.fill(m_window + m_sync), nb = b.fill(m_window + m_sync);
+		std::vector<std::string> keys_a(na), keys_b(nb);
+		for (size_t i = 0; i < na; ++i) {
+			key(a.at(i).data(), a.at(i).size(), keys_a[i]);
+		}
+		for (size_t i = 0; i < nb; ++i) {
+			key(b.at(i).data(), b.at(i).size(), keys_b[i]);
+		}
+		std::hash<std::string> hasher;
+		std::vector<size_t> hash_a(na), hash_b(nb);
+		for (size_t i = 0; i < na; ++i) {
+			hash_a[i] = hasher(keys_a[i]);
+		}
+		for (size_t i = 0; i < nb; ++i) {
+			hash_b[i] = hasher(keys_b[i]);
+		}
+		std::unordered_map<size_t, size_t> first_b;
+		for (size_t y = 0; y + m_sync <= nb; ++y) {
+			size_t sig = 0;
+			for (unsigned k = 0; k < m_sync; ++k) {
+				sig = sig * 31 + hash_b[y + k];
+			}
+			first_b.insert(std::make_pair(sig, y));
+		}
+		size_t best = ~(size_t) 0, best_x = na, best_y = nb;
+		for (size_t x = 0; x < best && x + m_sync <= na; ++x) {
+			size_t sig = 0;
+			for (unsigned k = 0; k < m_sync; ++k) {
+				sig = sig * 31 + hash_a[x + k];
+			}
+			std::unordered_map<size_t, size_t>::const_iterator it = first_b.find(sig);
+			if (it == first_b.end() || x + it->second >= best) {
+				continue;
+			}
+			size_t y = it->second;
+			unsigned k = 0;
+			while (k < m_sync && keys_a[x + k] == keys_b[y + k]) {
+				++k;
+			}
+			if (k == m_sync) {
+				best = x + y;
+				best_x = x;
+				best_y = y;
+			}
+		}
+
+		// without a synchronization point, the region extends to the end of
+		// both traces; that is certain if one of them ends within the window
+		bool found = best != ~(size_t) 0;
+		bool at_end = na < m_window + m_sync || nb < m_window + m_sync;
+		uint64_t ea = a.events(), ia = a.instructions();
+		uint64_t eb = b.events(), ib = b.instructions();
+		if (found) {
+			a.drop(best_x);
+			b.drop(best_y);
+		} else {
+			a.drain();
+			b.drain();
+		}
+		out << "region " << regions << ": golden events [" << ea << ", " << a.events()
+			<< ") instructions [" << ia << ", " << a.instructions() << "), "
+			<< "faulty events [" << eb << ", " << b.events()
+			<< ") instructions [" << ib << ", " << b.instructions() << ")";
+		if (!found && !at_end) {
+			out << ", no resynchronization within " << m_window << " events";
+			resync_failed = true;
+		}
+		out << "\n";
+		if (!found) {
+			break;
+		}
+
+		if (m_max_regions != 0 && regions >= m_max_regions) {
+			out << "stopping after " << regions << " regions\n";
+			a.drain();
+			b.drain();
+			break;
+		}
+	}
+
+	out << "golden: " << a.events() << " events (" << a.instructions() << " instructions), "
+		<< "faulty: " << b.events() << " events (" << b.instructions() << " instructions), "
+		<< equal << " equal events, " << regions << " divergence regions"
+		<< (resync_failed ? " (last one unresolved)" : "") << "\n" << std::flush;
+
+	if (!a.ok() || !b.ok()) {
+		return FAILED;
+	}
+	return regions == 0 ? IDENTICAL : DIFFERENT;
+}
@@ -0,0 +1,56 @@
+#ifndef __DIFFTRACE_TRACEDIFFER_HPP__
+#define __DIFFTRACE_TRACEDIFFER_HPP__
+
+#include <iostream>
+#include <stdint.h>
+
+/**
+ * \class TraceDiffer
+ *
+ * Compares a golden-run trace with the trace of a faulty run.  Both traces
+ * are read in lockstep; as long as they agree, encoded events are only
+ * compared bytewise, events are decoded when the encodings differ (e.g., in
+ * time_delta only) or the traces diverge.  After a divergence (control flow,
+ * memory addresses, or data/register values from Trace_Event_Extended), the
+ * differ looks ahead in both traces for the nearest point where they agree
+ * again for a number of consecutive events, reports the divergence region in
+ * between, and continues from there.
+ */
+class TraceDiffer {
+public:
+	enum Result { IDENTICAL, DIFFERENT, FAILED };
+
+private:
+	uint64_t m_window;
+	unsigned m_sync;
+	bool m_compare_time;
+	unsigned m_max_regions;
+
+public:
+	TraceDiffer()
+		: m_window(100000), m_sync(16), m_compare_time(false), m_max_regions(0) {}
+
+	/**
+	 * Number of events to look ahead in each trace when resynchronizing.
+	 */
+	void setWindow(uint64_t window) { m_window = window; }
+	/**
+	 * Number of consecutive equal events that count as resynchronized.
+	 */
+	void setSyncLength(unsigned sync) { m_sync = sync > 0 ? sync : 1; }
+	/**
+	 * Also compare the time_delta of the events.
+	 */
+	void setCompareTime(bool compare) { m_compare_time = compare; }
+	/**
+	 * Stop after this many divergence regions (0 = never).
+	 */
+	void setMaxRegions(unsigned regions) { m_max_regions = regions; }
+
+	/**
+	 * Compares the traces and writes a report to "out".
+	 */
+	Result diff(std::istream& golden, std::istream& faulty, std::ostream& out);
+};
+
+#endif // __DIFFTRACE_TRACEDIFFER_HPP__
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <fstream>
+#include <stdlib.h>
+
+#include "TraceDiffer.hpp"
+
+#include "util/CommandLine.hpp"
+#include "util/TraceFile.hpp"
+#include "util/Logger.hpp"
+
+using namespace fail;
+using std::endl;
+
+static Logger LOG("diff-trace", true);
+
+int main(int argc, char *argv[])
+{
+	CommandLine &cmd = CommandLine::Inst();
+	CommandLine::option_handle UNKNOWN =
+		cmd.addOption("", "", Arg::None, "usage: diff-trace [options] golden.tc faulty.tc");
+	CommandLine::option_handle HELP =
+		cmd.addOption("h", "help", Arg::None, "-h/--help \tPrint usage and exit");
+	CommandLine::option_handle WINDOW =
+		cmd.addOption("w", "window", Arg::Required,
+			"-w/--window N \tLook ahead N events in each trace to resynchronize after a divergence (default: 100000)");
+	CommandLine::option_handle SYNC =
+		cmd.addOption("s", "sync", Arg::Required,
+			"-s/--sync N \tTraces are resynchronized after N equal events (default: 16)");
+	CommandLine::option_handle TIME =
+		cmd.addOption("", "compare-time", Arg::None,
+			"--compare-time \tAlso compare the time deltas of the events");
+	CommandLine::option_handle MAX_REGIONS =
+		cmd.addOption("n", "max-regions", Arg::Required,
+			"-n/--max-regions N \tStop after N divergence regions (default: 0 = all)");
+
+	for (int i = 1; i < argc; ++i) {
+		cmd.add_args(argv[i]);
+	}
+	if (!cmd.parse()) {
+		std::cerr << "Error parsing arguments." << endl;
+		return 2;
+	}
+
+	if (cmd[HELP] || cmd[UNKNOWN] || cmd.parser()->nonOptionsCount() != 2) {
+		for (option::Option* opt = cmd[UNKNOWN]; opt; opt = opt->next()) {
+			std::cerr << "Unknown option: " << opt->name << "\n";
+		}
+		for (int i = 2; i < cmd.parser()->nonOptionsCount(); ++i) {
+			std::cerr << "Unknown non-option: " << cmd.parser()->nonOption(i) << "\n";
+		}
+		cmd.printUsage();
+		if (cmd[HELP]) {
+			exit(0);
+		} else {
+			exit(2);
+		}
+	}
+
+	TraceDiffer differ;
+	if (cmd[WINDOW]) {
+		differ.setWindow(strtoull(cmd[WINDOW].first()->arg, 0, 10));
+	}
+	if (cmd[SYNC]) {
+		differ.setSyncLength(strtoul(cmd[SYNC].first()->arg, 0, 10));
+	}
+	if (cmd[MAX_REGIONS]) {
+		differ.setMaxRegions(strtoul(cmd[MAX_REGIONS].first()->arg, 0, 10));
+	}
+	differ.setCompareTime(cmd[TIME]);
+
+	std::ifstream golden_normal, faulty_normal;
+	igzstream golden_gz, faulty_gz;
+	std::istream *golden = openStream(cmd.parser()->nonOption(0), golden_normal, golden_gz);
+	if (!golden) {
+		LOG << "couldn't open " << cmd.parser()->nonOption(0) << endl;
+		return 2;
+	}
+	std::istream *faulty = openStream(cmd.parser()->nonOption(1), faulty_normal, faulty_gz);
+	if (!faulty) {
+		LOG << "couldn't open " << cmd.parser()->nonOption(1) << endl;
+		return 2;
+	}
+
+	// exit codes as with diff(1)
+	switch (differ.diff(*golden, *faulty, std::cout)) {
+	case TraceDiffer::IDENTICAL:
+		return 0;
+	case TraceDiffer::DIFFERENT:
+		return 1;
+	default:
+		return 2;
+	}
+}
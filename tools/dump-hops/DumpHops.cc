@@ -94,6 +94,9 @@ int main(int argc, char *argv[])
 
 		if (ev.has_checkpoint_id()) {
 			cout << " CP" << ev.checkpoint_id();
+			if (ev.has_checkpoint_trace_position()) {
+				cout << "@" << ev.checkpoint_trace_position();
+			}
 		}
 
 		for (int i = 0; i < ev.hops_size(); i++) {
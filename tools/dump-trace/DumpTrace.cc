@@ -1,12 +1,15 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <set>
+#include <stdlib.h>
+#include <boost/thread.hpp>
 #include "comm/TracePlugin.pb.h"
 #include "util/ProtoStream.hpp"
 #include "../../src/core/util/Logger.hpp"
 #include "../../src/core/util/gzstream/gzstream.h"
 #include "util/CommandLine.hpp"
+#include "util/ElfReader.hpp"
+#include "TraceStats.hpp"
 
 using namespace fail;
 using std::stringstream;
@@ -60,6 +63,15 @@ int main(int argc, char *argv[])
 	CommandLine::option_handle EXTENDED_TRACE =
 		cmd.addOption("", "extended-trace", Arg::None,
 			"--extended-trace \tDump extended trace information if available");
+	CommandLine::option_handle THREADS =
+		cmd.addOption("j", "threads", Arg::Required,
+			"-j/--threads N \tDecode the trace with N threads in --stats mode (default: number of CPUs)");
+	CommandLine::option_handle ELF_FILE =
+		cmd.addOption("e", "elf-file", Arg::Required,
+			"-e/--elf-file \tELF binary for per-function/per-section histograms in --stats mode");
+	CommandLine::option_handle TOP =
+		cmd.addOption("", "top", Arg::Required,
+			"--top N \tOnly show the N most active functions (default: 30, 0 = all)");
 
 	for (int i = 1; i < argc; ++i) {
 		cmd.add_args(argv[i]);
@@ -89,28 +101,45 @@ int main(int argc, char *argv[])
 
 	std::ifstream normal_stream;
 	igzstream gz_stream;
-	ProtoIStream ps(&openStream(cmd.parser()->nonOption(0), normal_stream, gz_stream));
+	std::istream& in = openStream(cmd.parser()->nonOption(0), normal_stream, gz_stream);
 
+	if (stats_only) {
+		unsigned threads = boost::thread::hardware_concurrency();
+		if (cmd[THREADS]) {
+			threads = strtoul(cmd[THREADS].first()->arg, 0, 10);
+		}
+		unsigned top = 30;
+		if (cmd[TOP]) {
+			top = strtoul(cmd[TOP].first()->arg, 0, 10);
+		}
+
+		RegionIndex functions, sections;
+		bool histograms = false;
+		if (cmd[ELF_FILE]) {
+			ElfReader elf(cmd[ELF_FILE].first()->arg);
+			functions.load(elf, true);
+			sections.load(elf, false);
+			histograms = true;
+		}
+
+		TraceStats stats(histograms ? &functions : 0, histograms ? &sections : 0);
+		bool ok = collect_trace_stats(in, threads, stats);
+		stats.print(cout, top);
+		return ok ? 0 : 1;
+	}
+
+	ProtoIStream ps(&in);
 	uint64_t acctime = 0;
-	uint64_t stats_instr = 0, stats_reads = 0, stats_writes = 0;
-	uint64_t stats_read_b = 0, stats_write_b = 0, starttime = 0;
-	std::set<uint64_t> stats_mem_locations;
 
 	while (ps.getNext(&ev)) {
 		if (ev.has_time_delta()) {
-			if (!acctime) {
-				starttime = ev.time_delta();
-			}
 			acctime += ev.time_delta();
 		}
 		if (!ev.has_memaddr()) {
-			++stats_instr;
-			if (!stats_only) {
-				cout << "IP " << hex << ev.ip() << dec << " t=" << acctime << "\n";
-			}
+			cout << "IP " << hex << ev.ip() << dec << " t=" << acctime << "\n";
 		} else {
 			stringstream ext;
-			if (ev.has_trace_ext() && !stats_only && extended) {
+			if (ev.has_trace_ext() && extended) {
 				const Trace_Event_Extended& temp_ext = ev.trace_ext();
 				ext << " DATA " << std::hex;
 				ext << (uint64_t) temp_ext.data();
@@ -138,38 +167,15 @@ int main(int argc, char *argv[])
 					}
 				}
 			}
-			if (!stats_only) {
-				cout << "MEM "
-				     << (ev.accesstype() == Trace_Event_AccessType_READ ? "R" : "W") << " "
-				     << hex << ev.memaddr()
-				     << dec << " width " << ev.width()
-				     << hex << " IP " << ev.ip()
-				     << dec << " t=" << acctime
-				     << ext.str() << "\n";
-			} else {
-				for (uint64_t addr = ev.memaddr(); addr < ev.memaddr() + ev.width(); addr++){
-					stats_mem_locations.insert(addr);
-				}
-			}
-			if (ev.accesstype() == Trace_Event_AccessType_READ) {
-				stats_reads++;
-				stats_read_b += ev.width();
-			} else {
-				stats_writes++;
-				stats_write_b += ev.width();
-			}
+			cout << "MEM "
+			     << (ev.accesstype() == Trace_Event_AccessType_READ ? "R" : "W") << " "
+			     << hex << ev.memaddr()
+			     << dec << " width " << ev.width()
+			     << hex << " IP " << ev.ip()
+			     << dec << " t=" << acctime
+			     << ext.str() << "\n";
 		}
 	}
 
-	if (stats_only) {
-		cout << "#instructions: " << stats_instr << "\n"
-			 << "#memLocations: " << stats_mem_locations.size() << "\n"
-			 << "#memR:         " << stats_reads << "\n"
-			 << "#memR_bytes:   " << stats_read_b << "\n"
-			 << "#memW:         " << stats_writes << "\n"
-			 << "#memW_bytes:   " << stats_write_b << "\n"
-			 << "duration:      " << (acctime - starttime + 1) << endl;
-	}
-
 	return 0;
 }
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <boost/thread.hpp>
+#include "TraceStats.hpp"
+#include "util/ElfReader.hpp"
+#include "util/Logger.hpp"
+#include "util/ProtoBatch.hpp"
+#include "util/SynchronizedQueue.hpp"
+
+using namespace fail;
+using std::endl;
+
+static Logger LOG("dump-trace", true);
+
+// hand a batch of encoded events to a worker when it reaches this size
+static const size_t BATCH_SIZE = 4 * 1024 * 1024;
+
+PagedBitmap::~PagedBitmap()
+{
+	for (page_map::iterator it = m_pages.begin(); it != m_pages.end(); ++it) {
+		delete it->second;
+	}
+}
+
+PagedBitmap::Page *PagedBitmap::page(uint64_t pageno)
+{
+	if (m_last_page && m_last_pageno == pageno) {
+		return m_last_page;
+	}
+	Page *&p = m_pages[pageno];
+	if (!p) {
+		p = new Page;
+		memset(p->bits, 0, sizeof(p->bits));
+	}
+	m_last_pageno = pageno;
+	m_last_page = p;
+	return p;
+}
+
+void PagedBitmap::merge(const PagedBitmap& other)
+{
+	for (page_map::const_iterator it = other.m_pages.begin(); it != other.m_pages.end(); ++it) {
+		Page *p = page(it->first);
+		for (unsigned i = 0; i < PAGE_WORDS; ++i) {
+			p->bits[i] |= it->second->bits[i];
+		}
+	}
+}
+
+uint64_t PagedBitmap::count() const
+{
+	uint64_t count = 0;
+	for (page_map::const_iterator it = m_pages.begin(); it != m_pages.end(); ++it) {
+		for (unsigned i = 0; i < PAGE_WORDS; ++i) {
+			count += __builtin_popcountll(it->second->bits[i]);
+		}
+	}
+	return count;
+}
+
+void RegionIndex::add(const std::string& name, uint64_t start, uint64_t end)
+{
+	Region r;
+	r.start = start;
+	r.end = end;
+	r.name = name;
+	m_regions.push_back(r);
+}
+
+void RegionIndex::finish()
+{
+	std::sort(m_regions.begin(), m_regions.end());
+	// drop aliases and other overlapping regions, the first one wins
+	std::vector<Region> regions;
+	for (std::vector<Region>::const_iterator it = m_regions.begin(); it != m_regions.end(); ++it) {
+		if (regions.size() == 0 || it->start >= regions.back().end) {
+			regions.push_back(*it);
+		}
+	}
+	m_regions.swap(regions);
+}
+
+unsigned RegionIndex::lookup(uint64_t addr) const
+{
+	// first region starting after addr, its predecessor may contain addr
+	Region r;
+	r.start = addr;
+	std::vector<Region>::const_iterator it =
+		std::upper_bound(m_regions.begin(), m_regions.end(), r);
+	if (it == m_regions.begin() || (--it)->end <= addr) {
+		return m_regions.size();
+	}
+	return it - m_regions.begin();
+}
+
+void RegionIndex::load(ElfReader& elf, bool functions)
+{
+	if (functions) {
+		for (ElfReader::symbol_iterator it = elf.sym_begin(); it != elf.sym_end(); ++it) {
+			if (it->getSymbolType() == STT_FUNC && it->getSize() > 0) {
+				add(it->getDemangledName(), it->getStart(), it->getEnd());
+			}
+		}
+	} else {
+		for (ElfReader::section_iterator it = elf.sec_begin(); it != elf.sec_end(); ++it) {
+			// non-allocated sections (.comment, .debug_*) live at address 0
+			if (it->getAddress() != 0 && it->getSize() > 0) {
+				add(it->getName(), it->getStart(), it->getEnd());
+			}
+		}
+	}
+	finish();
+}
+
+TraceStats::TraceStats(const RegionIndex *functions, const RegionIndex *sections)
+	: m_functions(functions), m_sections(sections),
+	  instr(0), reads(0), writes(0), read_b(0), write_b(0),
+	  time_sum(0), start_time(0), start_batch(~0ULL)
+{
+	if (m_functions) {
+		func_instr.resize(m_functions->size() + 1);
+		func_reads.resize(m_functions->size() + 1);
+		func_writes.resize(m_functions->size() + 1);
+	}
+	if (m_sections) {
+		sec_reads.resize(m_sections->size() + 1);
+		sec_writes.resize(m_sections->size() + 1);
+	}
+}
+
+void TraceStats::add(const Trace_Event& ev)
+{
+	if (ev.has_time_delta()) {
+		time_sum += ev.time_delta();
+	}
+	unsigned func = m_functions ? m_functions->lookup(ev.ip()) : 0;
+	if (!ev.has_memaddr()) {
+		++instr;
+		if (m_functions) {
+			++func_instr[func];
+		}
+		return;
+	}
+
+	mem_locations.insert(ev.memaddr(), ev.width());
+	unsigned sec = m_sections ? m_sections->lookup(ev.memaddr()) : 0;
+	if (ev.accesstype() == Trace_Event_AccessType_READ) {
+		++reads;
+		read_b += ev.width();
+		if (m_functions) {
+			++func_reads[func];
+		}
+		if (m_sections) {
+			++sec_reads[sec];
+		}
+	} else {
+		++writes;
+		write_b += ev.width();
+		if (m_functions) {
+			++func_writes[func];
+		}
+		if (m_sections) {
+			++sec_writes[sec];
+		}
+	}
+}
+
+void TraceStats::merge(const TraceStats& other)
+{
+	instr += other.instr;
+	reads += other.reads;
+	writes += other.writes;
+	read_b += other.read_b;
+	write_b += other.write_b;
+	time_sum += other.time_sum;
+	if (other.start_batch < start_batch) {
+		start_batch = other.start_batch;
+		start_time = other.start_time;
+	}
+	mem_locations.merge(other.mem_locations);
+	for (unsigned i = 0; i < func_instr.size(); ++i) {
+		func_instr[i] += other.func_instr[i];
+		func_reads[i] += other.func_reads[i];
+		func_writes[i] += other.func_writes[i];
+	}
+	for (unsigned i = 0; i < sec_reads.size(); ++i) {
+		sec_reads[i] += other.sec_reads[i];
+		sec_writes[i] += other.sec_writes[i];
+	}
+}
+
+// sorts histogram indexes by descending count
+struct HistogramOrder {
+	const std::vector<uint64_t> &a, &b, &c;
+	HistogramOrder(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b,
+		const std::vector<uint64_t>& c) : a(a), b(b), c(c) {}
+	bool operator()(unsigned x, unsigned y) const
+	{
+		return a[x] + b[x] + c[x] > a[y] + b[y] + c[y];
+	}
+};
+
+void TraceStats::print(std::ostream& out, unsigned top) const
+{
+	out << "#instructions: " << instr << "\n"
+		<< "#memLocations: " << mem_locations.count() << "\n"
+		<< "#memR:         " << reads << "\n"
+		<< "#memR_bytes:   " << read_b << "\n"
+		<< "#memW:         " << writes << "\n"
+		<< "#memW_bytes:   " << write_b << "\n"
+		<< "duration:      " << (time_sum - start_time + 1) << "\n";
+
+	if (m_functions) {
+		std::vector<unsigned> order;
+		for (unsigned i = 0; i < func_instr.size(); ++i) {
+			order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), HistogramOrder(func_instr, func_reads, func_writes));
+		out << "\n#instructions\t#memR\t#memW\tfunction\n";
+		for (unsigned i = 0; i < order.size() && (top == 0 || i < top); ++i) {
+			unsigned idx = order[i];
+			if (func_instr[idx] + func_reads[idx] + func_writes[idx] == 0) {
+				break;
+			}
+			out << func_instr[idx] << "\t" << func_reads[idx] << "\t" << func_writes[idx] << "\t"
+				<< (idx < m_functions->size() ? m_functions->name(idx) : "[unknown]") << "\n";
+		}
+	}
+
+	if (m_sections) {
+		std::vector<unsigned> order;
+		for (unsigned i = 0; i < sec_reads.size(); ++i) {
+			order.push_back(i);
+		}
+		std::vector<uint64_t> none(sec_reads.size());
+		std::sort(order.begin(), order.end(), HistogramOrder(sec_reads, sec_writes, none));
+		out << "\n#memR\t#memW\tsection\n";
+		for (unsigned i = 0; i < order.size(); ++i) {
+			unsigned idx = order[i];
+			if (sec_reads[idx] + sec_writes[idx] == 0) {
+				break;
+			}
+			out << sec_reads[idx] << "\t" << sec_writes[idx] << "\t"
+				<< (idx < m_sections->size() ? m_sections->name(idx) : "[unknown]") << "\n";
+		}
+	}
+	out << std::flush;
+}
+
+namespace {
+
+// A sequence of encoded trace events, numbered in trace order
+struct TraceBatch : public ProtoBatch {
+	uint64_t seq;
+};
+
+// Decodes batches from the queue until it is finished
+class StatsWorker {
+	SynchronizedQueue<TraceBatch *> *queue;
+	TraceStats *stats;
+public:
+	StatsWorker(SynchronizedQueue<TraceBatch *> *queue, TraceStats *stats)
+		: queue(queue), stats(stats) {}
+	void operator()();
+};
+
+void StatsWorker::operator()()
+{
+	Trace_Event ev;
+	TraceBatch *batch;
+	while ((batch = queue->Dequeue()) != 0) {
+		uint64_t batch_time = 0;
+		size_t pos = 0;
+		const char *msg;
+		uint32_t size;
+		while (batch->next(pos, msg, size)) {
+			if (!ev.ParseFromArray(msg, size)) {
+				LOG << "cannot decode trace event, skipping" << endl;
+			}
+
+			// the start time is the time_delta of the first timed event(s)
+			// (see the sequential implementation), the earliest batch wins
+			if (ev.has_time_delta() && batch_time == 0 && batch->seq <= stats->start_batch) {
+				stats->start_batch = batch->seq;
+				stats->start_time = ev.time_delta();
+			}
+			if (ev.has_time_delta()) {
+				batch_time += ev.time_delta();
+			}
+			stats->add(ev);
+		}
+		delete batch;
+	}
+}
+
+} // anonymous namespace
+
+bool collect_trace_stats(std::istream& in, unsigned threads, TraceStats& total)
+{
+	if (threads == 0) {
+		threads = 1;
+	}
+
+	SynchronizedQueue<TraceBatch *> queue(2 * threads);
+	std::vector<TraceStats *> stats;
+	boost::thread_group workers;
+	for (unsigned i = 0; i < threads; ++i) {
+		stats.push_back(new TraceStats(total.functions(), total.sections()));
+		workers.create_thread(StatsWorker(&queue, stats.back()));
+	}
+
+	ProtoIStream ps(&in);
+	uint64_t seq = 0;
+	bool more;
+	do {
+		TraceBatch *batch = new TraceBatch;
+		batch->seq = seq++;
+		more = batch->fill(ps, BATCH_SIZE);
+		queue.Enqueue(batch);
+	} while (more);
+	queue.setIsFinished();
+	workers.join_all();
+
+	bool ok = !ps.truncated();
+	if (!ok) {
+		LOG << "trace file truncated" << endl;
+	}
+
+	for (std::vector<TraceStats *>::iterator it = stats.begin(); it != stats.end(); ++it) {
+		total.merge(**it);
+		delete *it;
+	}
+	return ok;
+}
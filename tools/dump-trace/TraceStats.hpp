@@ -0,0 +1,144 @@
+#ifndef __DUMPTRACE_TRACESTATS_HPP__
+#define __DUMPTRACE_TRACESTATS_HPP__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include "comm/TracePlugin.pb.h"
+
+namespace fail {
+	class ElfReader;
+}
+
+/**
+ * \class PagedBitmap
+ *
+ * Exact set of byte addresses.  Addresses are grouped into 4 KiB pages, and
+ * each touched page is represented by a bitmap (one bit per address) that is
+ * allocated on first use.  Compared to a std::set<uint64_t> this needs 1/8
+ * byte instead of ~40 bytes per address, and inserting is a hash lookup
+ * (usually skipped due to locality) and a bit operation.
+ */
+class PagedBitmap {
+	static const unsigned PAGE_BITS = 12;
+	static const unsigned PAGE_WORDS = (1 << PAGE_BITS) / 64;
+	struct Page {
+		uint64_t bits[PAGE_WORDS];
+	};
+	typedef std::unordered_map<uint64_t, Page *> page_map;
+
+	page_map m_pages;
+	uint64_t m_last_pageno; // !< one-entry lookup cache
+	Page *m_last_page;
+
+	Page *page(uint64_t pageno);
+
+	// not copyable
+	PagedBitmap(const PagedBitmap&);
+	PagedBitmap& operator=(const PagedBitmap&);
+public:
+	PagedBitmap() : m_last_pageno(0), m_last_page(0) {}
+	~PagedBitmap();
+
+	void insert(uint64_t addr)
+	{
+		Page *p = page(addr >> PAGE_BITS);
+		unsigned bit = addr & ((1 << PAGE_BITS) - 1);
+		p->bits[bit / 64] |= 1ULL << (bit % 64);
+	}
+	/**
+	 * Inserts all addresses in [addr, addr + width).
+	 */
+	void insert(uint64_t addr, unsigned width)
+	{
+		for (uint64_t a = addr; a < addr + width; ++a) {
+			insert(a);
+		}
+	}
+	/**
+	 * Adds all addresses contained in other.
+	 */
+	void merge(const PagedBitmap& other);
+	/**
+	 * Number of distinct addresses.
+	 */
+	uint64_t count() const;
+};
+
+/**
+ * \class RegionIndex
+ *
+ * Maps addresses to a set of non-overlapping named regions (ELF functions or
+ * sections) with a binary search.
+ */
+class RegionIndex {
+	struct Region {
+		uint64_t start, end;
+		std::string name;
+		bool operator<(const Region& other) const { return start < other.start; }
+	};
+	std::vector<Region> m_regions;
+public:
+	void add(const std::string& name, uint64_t start, uint64_t end);
+	/**
+	 * Must be called after the last add() and before lookup().
+	 */
+	void finish();
+	/**
+	 * Index of the region containing addr, or size() if there is none.
+	 */
+	unsigned lookup(uint64_t addr) const;
+	unsigned size() const { return m_regions.size(); }
+	const std::string& name(unsigned idx) const { return m_regions[idx].name; }
+
+	/**
+	 * Fills the index with the function symbols (functions == true) or the
+	 * sections of an ELF binary.
+	 */
+	void load(fail::ElfReader& elf, bool functions);
+};
+
+/**
+ * \class TraceStats
+ *
+ * Statistics of (a part of) a trace.  Statistics of trace parts collected in
+ * parallel are combined with merge().
+ */
+class TraceStats {
+	const RegionIndex *m_functions, *m_sections;
+public:
+	uint64_t instr, reads, writes, read_b, write_b;
+	uint64_t time_sum;      // !< sum of all time deltas
+	uint64_t start_time;    // !< time_delta of the first timed event
+	uint64_t start_batch;   // !< batch start_time stems from (~0 = none yet)
+	PagedBitmap mem_locations;
+	// per function (index from RegionIndex, last entry = unknown)
+	std::vector<uint64_t> func_instr, func_reads, func_writes;
+	// per section of the accessed data address
+	std::vector<uint64_t> sec_reads, sec_writes;
+
+	TraceStats(const RegionIndex *functions, const RegionIndex *sections);
+
+	const RegionIndex *functions() const { return m_functions; }
+	const RegionIndex *sections() const { return m_sections; }
+
+	void add(const Trace_Event& ev);
+	void merge(const TraceStats& other);
+
+	/**
+	 * Prints the summary (and histograms, if an ELF binary was given).
+	 */
+	void print(std::ostream& out, unsigned top) const;
+};
+
+/**
+ * Collects statistics for the whole trace in "in".  The calling thread only
+ * splits the stream into batches of still encoded events, "threads" worker
+ * threads decode them into private TraceStats objects, which are merged into
+ * "total" at the end.  Memory use is bounded by a few batches per thread.
+ */
+bool collect_trace_stats(std::istream& in, unsigned threads, TraceStats& total);
+
+#endif // __DUMPTRACE_TRACESTATS_HPP__
@@ -27,7 +27,9 @@ bool ElfImporter::cb_commandline_init()
 	CommandLine &cmd = CommandLine::Inst();
 
 	OBJDUMP = cmd.addOption("", "objdump", Arg::Required,
-		"--objdump \tObjdump: location of objdump binary, otherwise LLVM Disassembler is used");
+		"--objdump \tObjdump: location of objdump binary, otherwise only the instruction cache is written (Capstone)");
+	INSTR_CACHE = cmd.addOption("", "instr-cache", Arg::Required,
+		"--instr-cache FILE \tSidecar file for the decoded instructions (default: ELF file + .instrs)");
 	SOURCECODE = cmd.addOption("", "sources", Arg::None,
 		"--sources \timport all source files and the mapping of code line<->static instruction into the database");
 	return true;
@@ -110,7 +112,20 @@ bool ElfImporter::copy_to_database(ProtoIStream &ps)
 			return false;
 		}
 	} else {
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+		// the region pruners read this sidecar (prune-trace --elf-file)
+		// instead of the objdump table
+		CapstoneInstrCache cache;
+		std::string cache_file = cmd[INSTR_CACHE] ? cmd[INSTR_CACHE].first()->arg
+			: CapstoneInstrCache::defaultPath(m_elf->getFilename());
+		if (!cache.load(m_elf->getFilename(), cache_file)) {
+			return false;
+		}
+		LOG << "instruction cache " << cache_file << ": " << cache.getTable().size()
+		    << " instructions" << std::endl;
+#else
 		LOG << "importing an objdump with internal llvm dissassembler is not yet implemented" << std::endl;
+#endif
 	}
 
 	if (cmd[SOURCECODE]) { // import sources
@@ -222,12 +237,10 @@ bool ElfImporter::import_instruction(fail::address_t addr, char *opcode, int opc
 	const std::string &instruction, const std::string &comment)
 {
 	/* Prepare a mysql statement if it was not done before */
-	static MYSQL_STMT *stmt = 0;
+	static Database::Statement *stmt = 0;
 	if (!stmt) {
 		std::string sql("INSERT INTO objdump (variant_id, instr_address, opcode, disassemble, comment) VALUES (?,?,?,?,?)");
-		stmt = mysql_stmt_init(db->getHandle());
-		if (mysql_stmt_prepare(stmt, sql.c_str(), sql.length())) {
-			LOG << "query '" << sql << "' failed: " << mysql_error(db->getHandle()) << std::endl;
+		if (!(stmt = db->prepare(sql))) {
 			return false;
 		}
 	}
@@ -262,16 +275,7 @@ bool ElfImporter::import_instruction(fail::address_t addr, char *opcode, int opc
 	}
 
 
-	if (mysql_stmt_bind_param(stmt, bind)) {
-		LOG << "mysql_stmt_bind_param() failed: " << mysql_stmt_error(stmt) << std::endl;
-		return false;
-	}
-	if (mysql_stmt_execute(stmt)) {
-		LOG << "mysql_stmt_execute() failed: " << mysql_stmt_error(stmt) << std::endl;
-		return false;
-	}
-
-	return true;
+	return db->execute(stmt, bind);
 }
 
 static inline std::string rtrim(std::string str)
@@ -302,12 +306,12 @@ bool ElfImporter::import_source_code(std::string fileName)
 	ss << "SELECT file_id FROM dbg_filename "
 		<< "WHERE path = '" << fileName.c_str() << "' "
 		<< "AND variant_id = " << m_variant_id;
-	MYSQL_RES *res = db->query(ss.str().c_str(), true);
+	Database::Result *res = db->query(ss.str().c_str(), true);
 	if (!res) {
 		return false;
 	}
 	MYSQL_ROW row;
-	if (!(row = mysql_fetch_row(res))) {
+	if (!(row = db->fetch_row(res))) {
 		// this should not happen
 		LOG << "error: no entry for '" << fileName.c_str() << "' in dbg_filename, aborting" << std::endl;
 		return false;
@@ -375,12 +379,12 @@ bool ElfImporter::import_mapping(std::string fileName)
 			<< "WHERE path = '" << tmp_mapping.line_source << "' "
 			<< "AND variant_id = " << m_variant_id;
 
-		MYSQL_RES *res = db->query(ss.str().c_str(), true);
+		Database::Result *res = db->query(ss.str().c_str(), true);
 		if (!res) {
 			return false;
 		}
 		MYSQL_ROW row;
-		row = mysql_fetch_row(res);
+		row = db->fetch_row(res);
 
 		// INSERT group entry
 		std::stringstream sql;
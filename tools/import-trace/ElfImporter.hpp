@@ -10,6 +10,7 @@
 
 #if defined(BUILD_CAPSTONE_DISASSEMBLER)
 #include "util/capstonedisassembler/CapstoneDisassembler.hpp"
+#include "util/capstonedisassembler/CapstoneInstrCache.hpp"
 #elif defined(BUILD_LLVM_DISASSEMBLER)
 #include "util/llvmdisassembler/LLVMDisassembler.hpp"
 #endif
@@ -24,7 +25,9 @@
 	the database.
 
 	The ElfImporter calls objdump to dissassemble an ELF binary, and
-	imports the results into the database.
+	imports the results into the database.  Without objdump (and with the
+	Capstone disassembler), the binary is disassembled in-process and only
+	the instruction cache sidecar used by prune-trace --elf-file is written.
 
 	In addition, debugging information can be imported: If the --sources
 	option is set, the source files will be imported into the database.
@@ -40,6 +43,7 @@ class ElfImporter : public Importer {
 #endif
 
 	fail::CommandLine::option_handle OBJDUMP;
+	fail::CommandLine::option_handle INSTR_CACHE;
 	fail::CommandLine::option_handle SOURCECODE;
 	fail::CommandLine::option_handle DEBUGINFO;
 	fail::DwarfReader dwReader;
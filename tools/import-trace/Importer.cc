@@ -22,6 +22,16 @@ bool Importer::init(const std::string &variant, const std::string &benchmark, Da
 }
 
 bool Importer::create_database() {
+	// In --defer-keys mode, a freshly created trace table gets its primary
+	// key only after the import (see build_deferred_keys()).
+	if (m_defer_keys) {
+		Database::Result *res = db->query("SHOW TABLES LIKE 'trace'", true);
+		if (!res) {
+			return false;
+		}
+		m_trace_pk_deferred = db->num_rows(res) == 0;
+	}
+
 	std::stringstream create_statement;
 	create_statement << "CREATE TABLE IF NOT EXISTS trace ("
 		"	variant_id int(11) NOT NULL,"
@@ -43,10 +53,29 @@ bool Importer::create_database() {
 		}
 	}
 	create_statement << database_additional_columns();
-	create_statement <<
-		"	PRIMARY KEY (variant_id,data_address,instr2)"
-		") engine=MyISAM ";
-	return db->query(create_statement.str().c_str());
+	std::string sql = create_statement.str();
+	if (m_trace_pk_deferred) {
+		// drop trailing comma
+		sql.resize(sql.find_last_of(','));
+	} else {
+		sql += "	PRIMARY KEY (variant_id,data_address,instr2)";
+	}
+	sql += ") engine=MyISAM ";
+	if (!db->query(sql.c_str())) {
+		return false;
+	}
+	return !m_defer_keys || db->disable_keys("trace");
+}
+
+bool Importer::build_deferred_keys() {
+	if (m_trace_pk_deferred) {
+		LOG << "adding primary key to trace table ..." << std::endl;
+		if (!db->query("ALTER TABLE trace ADD PRIMARY KEY (variant_id,data_address,instr2)")) {
+			return false;
+		}
+		m_trace_pk_deferred = false;
+	}
+	return db->enable_keys("trace");
 }
 
 
@@ -62,9 +91,9 @@ bool Importer::clear_database() {
 bool Importer::sanitycheck(std::string check_name, std::string fail_msg, std::string sql)
 {
 	LOG << "Sanity check: " << check_name << " ..." << std::flush;
-	MYSQL_RES *res = db->query(sql.c_str(), true);
+	Database::Result *res = db->query(sql.c_str(), true);
 
-	if (res && mysql_num_rows(res) == 0) {
+	if (res && db->num_rows(res) == 0) {
 		std::cout << " OK" << std::endl;
 		return true;
 	} else {
@@ -160,6 +189,11 @@ bool Importer::copy_to_database(fail::ProtoIStream &ps) {
 	// flush cache before sanity checks
 	db->insert_multiple();
 
+	if (m_defer_keys && !build_deferred_keys()) {
+		LOG << "building deferred trace table keys failed" << std::endl;
+		return false;
+	}
+
 	// sanity checks
 	if (m_sanitychecks) {
 		std::stringstream ss;
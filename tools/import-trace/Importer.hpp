@@ -28,6 +28,8 @@ protected:
 	bool m_import_write_ecs;
 	bool m_extended_trace;
 	bool m_cover_memorymap;
+	bool m_defer_keys;
+	bool m_trace_pk_deferred;
 	fail::Database *db;
 	fail::Architecture m_arch;
 	fail::UniformRegisterSet *m_extended_trace_regs;
@@ -119,10 +121,16 @@ protected:
 	 * any result rows, and provides some diagnostics.
 	 */
 	bool sanitycheck(std::string check_name, std::string fail_msg, std::string sql);
+
+	/**
+	 * Builds the trace table keys that were deferred by create_database()
+	 * in --defer-keys mode.
+	 */
+	bool build_deferred_keys();
 public:
 	Importer() : m_variant_id(0), m_elf(NULL), m_mm(NULL), m_faultspace_rightmargin('W'),
 		m_sanitychecks(false), m_import_write_ecs(true), m_extended_trace(false),
-		m_cover_memorymap(false), db(NULL),
+		m_cover_memorymap(false), m_defer_keys(false), m_trace_pk_deferred(false), db(NULL),
 		m_extended_trace_regs(NULL), m_row_count(0), m_time_trace_start(0),
 		m_last_ip(0), m_last_instr(0), m_last_time(0) {}
 	bool init(const std::string &variant, const std::string &benchmark, fail::Database *db);
@@ -145,6 +153,7 @@ public:
 	void set_import_write_ecs(bool enabled) { m_import_write_ecs = enabled; }
 	void set_extended_trace(bool enabled) { m_extended_trace = enabled; }
 	void set_cover_memorymap(bool enabled) { m_cover_memorymap = enabled; }
+	void set_defer_keys(bool enabled) { m_defer_keys = enabled; }
 };
 
 #endif
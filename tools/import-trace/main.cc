@@ -128,6 +128,10 @@ int main(int argc, char *argv[]) {
 		cmd.addOption("", "no-write-ecs", Arg::None,
 			"--no-write-ecs \tDo not import any write ECs into the database; "
 			"results in a perforated fault space and is OK if you only use absolute failure numbers");
+	CommandLine::option_handle DEFER_KEYS =
+		cmd.addOption("", "defer-keys", Arg::None,
+			"--defer-keys \tBuild the trace table's keys after the import instead of "
+			"maintaining them row by row (best combined with --bulk-load)");
 	CommandLine::option_handle EXTENDED_TRACE =
 		cmd.addOption("", "extended-trace", Arg::None,
 			"--extended-trace \tImport extended trace information if available");
@@ -256,6 +260,7 @@ int main(int argc, char *argv[]) {
 	importer->set_extended_trace(cmd[EXTENDED_TRACE]);
 	importer->set_import_write_ecs(!cmd[NO_WRITE_ECS]);
 	importer->set_cover_memorymap(cmd[COVER_MEMORYMAP]);
+	importer->set_defer_keys(cmd[DEFER_KEYS]);
 
 	if (!importer->init(variant, benchmark, db)) {
 		LOG << "importer->init() failed" << endl;
@@ -48,8 +48,9 @@ bool BasicBlockPruner::create_database() {
         "     p.id as pilot_id,"
         "     t.time2 > R.time2 as is_outer,"
         "     (t.time2 - t.time1 + 1) as weight_regular,"
-        "     IFNULL((t.time2 > R.time2) * (R.weight_inner + R.weight_outer) / R.count_outer, 0) as weight_mean,"
-        "     IFNULL(((t.time2 > R.time2) * ((t.time2 - t.time1 + 1) / R.weight_outer) * (R.weight_inner + R.weight_outer)), 0) as weight_wmean"
+        // "* 1.0": floating-point division in SQLite, too
+        "     IFNULL((t.time2 > R.time2) * (R.weight_inner + R.weight_outer) * 1.0 / R.count_outer, 0) as weight_mean,"
+        "     IFNULL(((t.time2 > R.time2) * ((t.time2 - t.time1 + 1) * 1.0 / R.weight_outer) * (R.weight_inner + R.weight_outer)), 0) as weight_wmean"
         " FROM fspregion R"
         " STRAIGHT_JOIN trace t USE INDEX(time1)  ON t.time1 between R.time1 and R.time2"
         " JOIN fsppilot p ON p.fspmethod_id = (select id from fspmethod where method = 'basic')"
@@ -92,7 +93,31 @@ std::ostream& operator<<(std::ostream& os, const BasicBlockPruner::region &R) {
 }
 
 
+bool BasicBlockPruner::commandline_init() {
+    fail::CommandLine &cmd = fail::CommandLine::Inst();
+    ELF_FILE = cmd.addOption("e", "elf-file", Arg::Required,
+        "-e/--elf-file \tDisassemble this ELF binary (shared by all variants) instead of reading the objdump table");
+    INSTR_CACHE = cmd.addOption("", "instr-cache", Arg::Required,
+        "--instr-cache FILE \tSidecar file caching the decoded instructions of --elf-file (default: ELF file + .instrs)");
+    return true;
+}
+
 bool BasicBlockPruner::prune_all(){
+    fail::CommandLine &cmd = fail::CommandLine::Inst();
+    if (cmd[ELF_FILE]) {
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+        std::string elf_file(cmd[ELF_FILE].first()->arg);
+        std::string cache_file = cmd[INSTR_CACHE] ? cmd[INSTR_CACHE].first()->arg : "";
+        if (!elf_instrs.load(elf_file, cache_file) || elf_instrs.empty()) {
+            LOG << "ERROR: could not disassemble " << elf_file << std::endl;
+            return false;
+        }
+#else
+        LOG << "ERROR: --elf-file needs FAIL* built with BUILD_CAPSTONE_DISASSEMBLER" << std::endl;
+        return false;
+#endif
+    }
+
     for (const variant_t & variant : m_variants) {
         instructions.clear();
         leaders.clear();
@@ -100,7 +125,12 @@ bool BasicBlockPruner::prune_all(){
 
         LOG << "Pruning for variant: " << variant.variant << "/" << variant.benchmark << endl;
 
-        // Import Objdump events
+        // Import Objdump events (or the instructions of the ELF binary)
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+        if (!elf_instrs.empty()) {
+            if(!this->importInstrCache(elf_instrs)) return false;
+        } else
+#endif
         if(!this->importObjdump(variant)) return false;
 
         // Find basic blocks..
@@ -192,18 +222,19 @@ bool BasicBlockPruner::importObjdump(const variant_t &variant){
        << variant.id
        << " ORDER BY instr_address";
 
-    MYSQL_RES *res = db->query_stream(ss.str().c_str());
+    fail::Database::Result *res = db->query_stream(ss.str().c_str());
     if (!res) {
         LOG << "ERROR: sql read to objdump table failed" << std::endl;
         return false;
     }
 
     MYSQL_ROW row;
-    while ((row = mysql_fetch_row(res))) {
+    while ((row = db->fetch_row(res))) {
         static_instr_t pc   =  std::strtoul(row[0], 0, 10);
         instr_width_t width =  std::strtoul(row[1], 0, 10);
         this->instructions[pc] = width;
     }
+    db->free_result(res);
     LOG << "objdump: " << this->instructions.size() << " instructions" << endl;
     if (this->instructions.size() == 0) {
         LOG << "ERROR: No objdump found" << std::endl;
@@ -212,6 +243,16 @@ bool BasicBlockPruner::importObjdump(const variant_t &variant){
     return true;
 }
 
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+bool BasicBlockPruner::importInstrCache(const fail::CapstoneInstrCache &cache){
+    const fail::CapstoneInstrCache::table_t &table = cache.getTable();
+    for (const fail::CapstoneInstrCache::Entry &e : table) {
+        this->instructions.emplace_hint(this->instructions.end(), e.address, e.length);
+    }
+    LOG << "elf: " << this->instructions.size() << " instructions" << endl;
+    return !this->instructions.empty();
+}
+#endif
 
 bool BasicBlockPruner::findRegionLeaders(){
     trace_stream stream(trace_file);
@@ -7,19 +7,29 @@
 #include "util/gzstream/gzstream.h"
 #include "comm/TracePlugin.pb.h"
 #include "sal/SALConfig.hpp"
+#include "config/VariantConfig.hpp"
+#include "util/CommandLine.hpp"
 #include <functional>
 
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+#include "util/capstonedisassembler/CapstoneInstrCache.hpp"
+#endif
+
 
 
 class BasicBlockPruner : public Pruner {
 protected:
     fail::Logger LOG;
 
+    fail::CommandLine::option_handle ELF_FILE;
+    fail::CommandLine::option_handle INSTR_CACHE;
+
 public:
     BasicBlockPruner() : LOG("BasicBlockPruner") {}
     virtual ~BasicBlockPruner() {};
 
     virtual std::string method_name() { return std::string("basic-block"); }
+    virtual bool commandline_init();
     virtual bool prune_all();
     void getAliases(std::deque<std::string> *aliases) {
         aliases->push_back("BasicBlockPruner");
@@ -65,6 +75,13 @@ public:
     /*  Import objectdump to find jumps */
     virtual bool importObjdump(const variant_t &variant);
 
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+    /*  Instructions of the --elf-file binary, decoded once and shared by all
+        variants (instead of their objdump tables) */
+    fail::CapstoneInstrCache elf_instrs;
+    virtual bool importInstrCache(const fail::CapstoneInstrCache &cache);
+#endif
+
     // list of instructions: PC -> width_of_instruction
     std::map<static_instr_t, instr_width_t> instructions;
 
@@ -9,6 +9,7 @@ public:
 	BasicPruner(bool use_instr1 = false) : use_instr1(use_instr1) {}
 	virtual std::string method_name() { return std::string("basic") + (use_instr1 ? "-left" : ""); }
 	virtual bool prune_all();
+	virtual Pruner *clone() const { return new BasicPruner(*this); }
 
 	void getAliases(std::deque<std::string> *aliases) {
 		aliases->push_back("BasicPruner");
@@ -19,6 +20,7 @@ public:
 class BasicPrunerLeft : public BasicPruner {
 public:
 	BasicPrunerLeft() : BasicPruner(true) {}
+	virtual Pruner *clone() const { return new BasicPrunerLeft(*this); }
 	void getAliases(std::deque<std::string> *aliases) {
 		aliases->push_back("BasicPrunerLeft");
 		aliases->push_back("basic-left");
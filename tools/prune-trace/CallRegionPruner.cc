@@ -12,11 +12,11 @@ bool CallRegionPruner::importObjdump(const variant_t &variant){
        << variant.id
        << " ORDER BY instr_address";
 
-    MYSQL_RES *res = db->query_stream(ss.str().c_str());
+    fail::Database::Result *res = db->query_stream(ss.str().c_str());
     assert(res && "Reading objdump failed");
 
     MYSQL_ROW row;
-    while ((row = mysql_fetch_row(res))) {
+    while ((row = db->fetch_row(res))) {
         static_instr_t pc   =  std::strtoul(row[0], 0, 10);
         instr_width_t width =  std::strtoul(row[1], 0, 10);
         std::string disas   = std::string(row[2]);
@@ -29,6 +29,7 @@ bool CallRegionPruner::importObjdump(const variant_t &variant){
             this->call_or_ret.insert(pc);
         }
     }
+    db->free_result(res);
     LOG << "objdump: " << this->instructions.size() << " instructions" << endl;
     LOG << "objdump: " << this->call_or_ret.size() << " calls/returns" << endl;
 
@@ -40,6 +41,21 @@ bool CallRegionPruner::importObjdump(const variant_t &variant){
     return true;
 }
 
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+bool CallRegionPruner::importInstrCache(const fail::CapstoneInstrCache &cache){
+    if (!BasicBlockPruner::importInstrCache(cache)) return false;
+
+    // Record calls and returns
+    for (const fail::CapstoneInstrCache::Entry &e : cache.getTable()) {
+        if (e.flags & fail::CapstoneInstrCache::CALL_OR_RET) {
+            this->call_or_ret.insert(e.address);
+        }
+    }
+    LOG << "elf: " << this->call_or_ret.size() << " calls/returns" << endl;
+    return true;
+}
+#endif
+
 bool CallRegionPruner::inSameRegion(static_instr_t previous, static_instr_t next) {
     // We are not in the same region, if we have encountered a call or a return
     if (call_or_ret.count(previous) > 0) {
@@ -26,6 +26,9 @@ public:
 protected:
     /*  Import objectdump to find jumps */
     virtual bool importObjdump(const variant_t &variant);
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+    virtual bool importInstrCache(const fail::CapstoneInstrCache &cache);
+#endif
 
     // list of instructions: PC -> is a call or ret instruction
     std::set<static_instr_t> call_or_ret;
@@ -1,27 +1,21 @@
 #include <sstream>
 #include <stdlib.h>
-#include <fstream>
 #include <algorithm>
 #include "FESamplingPruner.hpp"
 #include "util/Logger.hpp"
 #include "util/CommandLine.hpp"
-#include "util/SumTree.hpp"
+#include "util/Sampling.hpp"
 
 static fail::Logger LOG("FESamplingPruner");
 using std::endl;
 
 struct Pilot {
-	uint64_t duration;
-
 	uint32_t instr2;
 	union {
 	uint32_t instr2_absolute;
 	uint32_t id;
 	};
 	uint32_t data_address;
-
-	typedef uint64_t size_type;
-	size_type size() const { return duration; }
 };
 
 bool FESamplingPruner::commandline_init()
@@ -35,10 +29,12 @@ bool FESamplingPruner::commandline_init()
 	NO_WEIGHTING = cmd.addOption("", "no-weighting", Arg::None,
 		"--no-weighting \tDisable weighted sampling (weight = 1 for all ECs) "
 		"(don't do this unless you know what you're doing)");
+	SEED = cmd.addOption("", "seed", Arg::Required,
+		"--seed N \tSeed for the random number generator, makes the sample reproducible (default: random)");
 	return true;
 }
 
-bool FESamplingPruner::prune_all()
+bool FESamplingPruner::prepare()
 {
 	fail::CommandLine &cmd = fail::CommandLine::Inst();
 	if (!cmd[SAMPLESIZE]) {
@@ -55,6 +51,17 @@ bool FESamplingPruner::prune_all()
 		m_weighting = false;
 	}
 
+	if (cmd[SEED]) {
+		m_seed = strtoull(cmd[SEED].first()->arg, 0, 10);
+	} else {
+		m_seed = fail::random_seed();
+	}
+	LOG << "sampling with seed " << m_seed << " (use --seed to reproduce)" << endl;
+	return true;
+}
+
+bool FESamplingPruner::prune_all()
+{
 	// for each variant:
 	for (std::vector<fail::Database::Variant>::const_iterator it = m_variants.begin();
 		it != m_variants.end(); ++it) {
@@ -66,35 +73,20 @@ bool FESamplingPruner::prune_all()
 	return true;
 }
 
-// TODO: replace with a less syscall-intensive RNG
-static std::ifstream dev_urandom("/dev/urandom", std::ifstream::binary);
-static uint64_t my_rand(uint64_t limit)
-{
-	// find smallest bitpos that satisfies (1 << bitpos) > limit
-	int bitpos = 0;
-	while (limit >> bitpos) {
-		bitpos++;
-	}
-
-	uint64_t retval;
-
-	do {
-		dev_urandom.read((char *) &retval, sizeof(retval));
-		retval &= (1ULL << bitpos) - 1;
-	} while (retval > limit);
-
-	return retval;
-}
-
 bool FESamplingPruner::sampling_prune(const fail::Database::Variant& variant)
 {
-	fail::SumTree<Pilot> pop; // sample population
+	std::vector<Pilot> picked; // the sampled pilots, in the order drawn
 	std::stringstream ss;
-	MYSQL_RES *res;
+	fail::Database::Result *res;
 	MYSQL_ROW row;
 
 	uint64_t pilotcount = 0, samplerows;
 
+	// The population is streamed (in primary-key order, to make the sample
+	// reproducible) through a reservoir that only keeps the current sample,
+	// so memory use depends on the sample size only.
+	fail::WeightedReservoir<Pilot> reservoir(m_samplesize, fail::derive_seed(m_seed, variant.id));
+
 	if (!m_use_known_results) {
 		LOG << "loading trace entries for " << variant.variant << "/" << variant.benchmark << " ..." << endl;
 
@@ -102,22 +94,20 @@ bool FESamplingPruner::sampling_prune(const fail::Database::Variant& variant)
 		ss << "SELECT instr2, instr2_absolute, data_address, time2-time1+1 AS duration"
 			<< " FROM trace"
 			<< " WHERE variant_id = " << variant.id
-			<< " AND accesstype = 'R'";
+			<< " AND accesstype = 'R'"
+			<< " ORDER BY data_address, instr2";
 		res = db->query_stream(ss.str().c_str());
 		ss.str("");
 		if (!res) return false;
-		while ((row = mysql_fetch_row(res))) {
+		while ((row = db->fetch_row(res))) {
 			Pilot p;
 			p.instr2 = strtoul(row[0], 0, 10);
 			p.instr2_absolute = strtoul(row[1], 0, 10);
 			p.data_address = strtoul(row[2], 0, 10);
-			p.duration = m_weighting ? strtoull(row[3], 0, 10) : 1;
-			pop.add(p);
+			reservoir.offer(pilotcount, m_weighting ? strtoull(row[3], 0, 10) : 1, p);
 			++pilotcount;
 		}
-		mysql_free_result(res);
-
-		samplerows = std::min(pilotcount, m_samplesize);
+		db->free_result(res);
 	} else {
 		LOG << "loading pilots for " << variant.variant << "/" << variant.benchmark << " ..." << endl;
 
@@ -128,22 +118,20 @@ bool FESamplingPruner::sampling_prune(const fail::Database::Variant& variant)
 			<< " ON t.variant_id = p.variant_id AND t.data_address = p.data_address AND t.instr2 = p.instr2"
 			<< " WHERE p.fspmethod_id = " << db->get_fspmethod_id("basic")
 			<< " AND p.variant_id = " << variant.id
-			<< " AND p.known_outcome = 0";
+			<< " AND p.known_outcome = 0"
+			<< " ORDER BY p.data_address, p.instr2";
 		res = db->query_stream(ss.str().c_str());
 		ss.str("");
 		if (!res) return false;
-		while ((row = mysql_fetch_row(res))) {
+		while ((row = db->fetch_row(res))) {
 			Pilot p;
 			p.id = strtoul(row[0], 0, 10);
 			p.instr2 = strtoul(row[1], 0, 10);
 			p.data_address = strtoul(row[2], 0, 10);
-			p.duration = m_weighting ? strtoull(row[3], 0, 10) : 1;
-			pop.add(p);
+			reservoir.offer(pilotcount, m_weighting ? strtoull(row[3], 0, 10) : 1, p);
 			++pilotcount;
 		}
-		mysql_free_result(res);
-
-		samplerows = std::min(pilotcount, m_samplesize);
+		db->free_result(res);
 	}
 
 	if (pilotcount == 0) {
@@ -151,8 +139,11 @@ bool FESamplingPruner::sampling_prune(const fail::Database::Variant& variant)
 		return true;
 	}
 
-	LOG << "loaded " << pilotcount << " entries, sampling "
-		<< samplerows << " entries with fault expansion ..." << endl;
+	// pilots with a zero duration cannot be picked
+	reservoir.result(picked);
+	samplerows = picked.size();
+	LOG << "streamed " << pilotcount << " entries, sampled "
+		<< samplerows << " entries with fault expansion" << endl;
 
 	uint64_t num_fspgroup_entries = 0;
 	uint32_t known_pilot_method_id = m_method_id;
@@ -165,8 +156,7 @@ bool FESamplingPruner::sampling_prune(const fail::Database::Variant& variant)
 		ss.str("");
 
 		for (uint64_t i = 0; i < samplerows; ++i) {
-			uint64_t pos = my_rand(pop.get_size() - 1);
-			Pilot p = pop.remove(pos);
+			const Pilot& p = picked[i];
 			ss << "(0," << variant.id << "," << p.instr2 << "," << p.instr2
 				<< "," << p.instr2_absolute << "," << p.data_address
 				<< ",1," << m_method_id << ")";
@@ -207,8 +197,7 @@ bool FESamplingPruner::sampling_prune(const fail::Database::Variant& variant)
 		ss.str("");
 
 		for (uint64_t i = 0; i < samplerows; ++i) {
-			uint64_t pos = my_rand(pop.get_size() - 1);
-			Pilot p = pop.remove(pos);
+			const Pilot& p = picked[i];
 			ss << "(" << variant.id << "," << p.instr2
 				<< "," << p.data_address << "," << m_method_id
 				<< "," << p.id << ")";
@@ -12,21 +12,26 @@
 /// technique (FE-VRT) as described in: Smith, D. Todd and Johnson, Barry W.
 /// and Andrianos, Nikos and Profeta, III, Joseph A., "A variance-reduction
 /// technique via fault-expansion for fault-coverage estimation" (1997),
-/// 366--374.
+/// 366--374.  The population is streamed from the database through a
+/// weighted reservoir; only the sampled ECs are kept in memory.
 ///
 class FESamplingPruner : public Pruner {
 	fail::CommandLine::option_handle SAMPLESIZE;
 	fail::CommandLine::option_handle USE_KNOWN_RESULTS;
 	fail::CommandLine::option_handle NO_WEIGHTING;
+	fail::CommandLine::option_handle SEED;
 
 	uint64_t m_samplesize;
+	uint64_t m_seed;
 	bool m_use_known_results, m_weighting;
 
 public:
-	FESamplingPruner() : m_samplesize(0), m_use_known_results(false), m_weighting(true) { }
+	FESamplingPruner() : m_samplesize(0), m_seed(0), m_use_known_results(false), m_weighting(true) { }
 	virtual std::string method_name() { return "FESampling"; }
 	virtual bool commandline_init();
+	virtual bool prepare();
 	virtual bool prune_all();
+	virtual Pruner *clone() const { return new FESamplingPruner(*this); }
 
 	void getAliases(std::deque<std::string> *aliases) {
 		aliases->push_back("FESamplingPruner");
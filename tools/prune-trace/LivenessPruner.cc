@@ -0,0 +1,449 @@
+#include <sstream>
+#include <fstream>
+#include <stdlib.h>
+#include <algorithm>
+#include "LivenessPruner.hpp"
+#include "util/Logger.hpp"
+#include "util/ProtoStream.hpp"
+#include "util/TraceFile.hpp"
+#include "comm/TracePlugin.pb.h"
+
+#if defined(BUILD_LLVM_DISASSEMBLER)
+using namespace llvm;
+using namespace llvm::object;
+#endif
+
+static fail::Logger LOG("LivenessPruner");
+using std::endl;
+
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+typedef fail::CapstoneDisassembler Disassembler;
+typedef fail::CapstoneToFailTranslator Translator;
+#elif defined(BUILD_LLVM_DISASSEMBLER)
+typedef fail::LLVMDisassembler Disassembler;
+typedef fail::LLVMtoFailTranslator Translator;
+#endif
+
+namespace {
+
+// a static instruction seen in the trace
+struct StaticInstr {
+	std::vector<uint32_t> successors;
+	bool accesses_memory;
+	bool last; // !< last instruction of the trace
+	StaticInstr() : accesses_memory(false), last(false) {}
+};
+
+// bit set over the register bytes, stored in a flat array of words
+class ByteSets {
+	size_t m_words;
+	std::vector<uint64_t> m_bits;
+public:
+	ByteSets(size_t sets, size_t bits) : m_words((bits + 63) / 64), m_bits(sets * m_words) {}
+	size_t words() const { return m_words; }
+	uint64_t *operator[](size_t set) { return &m_bits[set * m_words]; }
+	void set(size_t set, size_t bit) { (*this)[set][bit / 64] |= 1ULL << (bit % 64); }
+};
+
+struct TraceRow {
+	uint32_t instr2;
+	uint32_t data_address;
+	uint32_t width;
+};
+
+} // anonymous namespace
+
+bool LivenessPruner::commandline_init()
+{
+	fail::CommandLine &cmd = fail::CommandLine::Inst();
+	ELF_FILE = cmd.addOption("e", "elf-file", Arg::Required,
+		"-e/--elf-file \tELF binary the trace was recorded from (for the liveness analysis)");
+	return true;
+}
+
+bool LivenessPruner::prune_all()
+{
+	fail::CommandLine &cmd = fail::CommandLine::Inst();
+	if (!cmd[ELF_FILE]) {
+		LOG << "parameter -e/--elf-file required, aborting" << endl;
+		return false;
+	}
+	// the trace file belongs to one variant
+	if (m_variants.size() != 1) {
+		LOG << "the trace file matches exactly one variant, but "
+		    << m_variants.size() << " were selected" << endl;
+		return false;
+	}
+
+	fail::ElfReader elf(cmd[ELF_FILE].first()->arg);
+	if (!analyze(elf)) {
+		return false;
+	}
+	return prune_variant(m_variants[0]);
+}
+
+bool LivenessPruner::read_is_live(uint32_t ip) const
+{
+	std::unordered_map<uint32_t, bool>::const_iterator it = m_reads_live.find(ip);
+	// not analyzed: assume the worst
+	return it == m_reads_live.end() || it->second;
+}
+
+bool LivenessPruner::analyze(fail::ElfReader& elf)
+{
+	/* Disassemble the binary */
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+	Disassembler disas(&elf);
+	disas.disassemble();
+#elif defined(BUILD_LLVM_DISASSEMBLER)
+	llvm::InitializeAllTargetInfos();
+	llvm::InitializeAllTargetMCs();
+	llvm::InitializeAllDisassemblers();
+
+	Expected<OwningBinary<Binary>> BinaryOrErr = createBinary(elf.getFilename());
+	if (!BinaryOrErr) {
+		std::string Buf;
+		raw_string_ostream OS(Buf);
+		logAllUnhandledErrors(std::move(BinaryOrErr.takeError()), OS, "");
+		OS.flush();
+		LOG << elf.getFilename() << "': " << Buf << ".\n";
+		return false;
+	}
+	Binary *binary = BinaryOrErr.get().getBinary();
+// necessary due to an AspectC++ bug triggered by LLVM 3.3's dyn_cast()
+#ifndef __puma
+	ObjectFile *obj = dyn_cast<ObjectFile>(binary);
+	Disassembler disas(obj);
+#endif
+	disas.disassemble();
+#else
+	LOG << "prune-trace was built without a disassembler (BUILD_CAPSTONE_DISASSEMBLER/BUILD_LLVM_DISASSEMBLER)" << endl;
+	return false;
+#endif
+
+#if defined(BUILD_CAPSTONE_DISASSEMBLER) || defined(BUILD_LLVM_DISASSEMBLER)
+	const Disassembler::InstrMap &instr_map = disas.getInstrMap();
+	Translator *translator = disas.getTranslator();
+	LOG << "instructions disassembled: " << instr_map.size() << endl;
+
+	/* Control flow edges and memory accesses, as seen in the trace */
+	std::unordered_map<uint32_t, StaticInstr> seen;
+	{
+		std::ifstream normal_stream;
+		igzstream gz_stream;
+		std::istream *in = fail::openStream(trace_file.c_str(), normal_stream, gz_stream);
+		if (!in) {
+			LOG << "couldn't open " << trace_file << endl;
+			return false;
+		}
+		fail::ProtoIStream ps(in);
+		Trace_Event ev;
+		StaticInstr *prev = 0;
+		while (ps.getNext(&ev)) {
+			if (ev.has_memaddr()) {
+				if (prev) {
+					prev->accesses_memory = true;
+				}
+				continue;
+			}
+			StaticInstr *cur = &seen[ev.ip()];
+			if (prev) {
+				std::vector<uint32_t>& succ = prev->successors;
+				if (std::find(succ.begin(), succ.end(), (uint32_t) ev.ip()) == succ.end()) {
+					succ.push_back(ev.ip());
+				}
+			}
+			prev = cur;
+		}
+		if (prev) {
+			prev->last = true;
+		}
+	}
+	LOG << "static instructions in the trace: " << seen.size() << endl;
+
+	/* Register uses/defs, byte-wise as in the RegisterImporter */
+	std::vector<uint32_t> ips;
+	std::unordered_map<uint32_t, size_t> index; // ip -> position in ips
+	std::vector<std::vector<size_t> > use_bytes, def_bytes;
+	std::vector<bool> essential;
+	std::unordered_map<int, size_t> byte_index; // FAIL* data address -> bit
+	for (std::unordered_map<uint32_t, StaticInstr>::const_iterator it = seen.begin();
+		it != seen.end(); ++it) {
+		Disassembler::InstrMap::const_iterator instr_it = instr_map.find(it->first);
+		if (instr_it == instr_map.end()) {
+			continue;
+		}
+		const Disassembler::Instr& instr = instr_it->second;
+		const StaticInstr& si = it->second;
+
+		// instructions with effects beyond their register results always
+		// need their inputs
+		bool ess = si.accesses_memory || si.last || instr.conditional_branch
+			|| instr.reg_defs.empty();
+		for (size_t i = 0; i < si.successors.size(); ++i) {
+			ess = ess || si.successors[i] != instr.address + instr.length;
+		}
+
+		std::vector<size_t> bytes[2];
+		for (int d = 0; d < 2; ++d) {
+			const std::vector<Disassembler::register_t>& regs = d ? instr.reg_defs : instr.reg_uses;
+			for (size_t r = 0; r < regs.size(); ++r) {
+				const Translator::reginfo_t &info = translator->getFailRegisterInfo(regs[r]);
+				if (&info == &translator->notfound) {
+					// unknown register: cannot reason about it
+					ess = true;
+					continue;
+				}
+				Translator::reginfo_t one_byte_window = info;
+				one_byte_window.width = 8;
+				int from = one_byte_window.toDataAddress();
+				int to = from + (int) (info.width / 8);
+				for (int addr = from; addr < to; ++addr) {
+					std::unordered_map<int, size_t>::const_iterator b = byte_index.find(addr);
+					if (b == byte_index.end()) {
+						b = byte_index.insert(std::make_pair(addr, byte_index.size())).first;
+					}
+					bytes[d].push_back(b->second);
+				}
+			}
+		}
+		index[it->first] = ips.size();
+		ips.push_back(it->first);
+		use_bytes.push_back(bytes[0]);
+		def_bytes.push_back(bytes[1]);
+		essential.push_back(ess);
+	}
+
+	/* Strong liveness ("faint variables"): the uses of an instruction are
+	   only live if it is essential or one of its results is live.
+	   Iterate to the least fixpoint; unknown successors keep everything
+	   alive. */
+	size_t n = ips.size();
+	ByteSets uses(n, byte_index.size()), defs(n, byte_index.size()), live_in(n, byte_index.size());
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t b = 0; b < use_bytes[i].size(); ++b) {
+			uses.set(i, use_bytes[i][b]);
+		}
+		for (size_t b = 0; b < def_bytes[i].size(); ++b) {
+			defs.set(i, def_bytes[i][b]);
+		}
+	}
+	std::vector<std::vector<size_t> >().swap(use_bytes);
+	std::vector<std::vector<size_t> >().swap(def_bytes);
+
+	size_t words = uses.words();
+	std::vector<uint64_t> out(words);
+	std::vector<bool> reads_live(n);
+	bool changed = true;
+	unsigned rounds = 0;
+	while (changed) {
+		changed = false;
+		++rounds;
+		for (size_t i = n; i-- > 0; ) {
+			const StaticInstr& si = seen[ips[i]];
+			bool all = si.last;
+			std::fill(out.begin(), out.end(), 0);
+			for (size_t s = 0; s < si.successors.size() && !all; ++s) {
+				std::unordered_map<uint32_t, size_t>::const_iterator succ = index.find(si.successors[s]);
+				if (succ == index.end()) {
+					all = true;
+					break;
+				}
+				for (size_t w = 0; w < words; ++w) {
+					out[w] |= live_in[succ->second][w];
+				}
+			}
+			if (all) {
+				std::fill(out.begin(), out.end(), ~0ULL);
+			}
+
+			bool live = essential[i];
+			for (size_t w = 0; w < words && !live; ++w) {
+				live = (defs[i][w] & out[w]) != 0;
+			}
+			reads_live[i] = live;
+			for (size_t w = 0; w < words; ++w) {
+				uint64_t in = (out[w] & ~defs[i][w]) | (live ? uses[i][w] : 0);
+				if (in != live_in[i][w]) {
+					live_in[i][w] = in;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	unsigned dead = 0;
+	for (size_t i = 0; i < n; ++i) {
+		m_reads_live[ips[i]] = reads_live[i];
+		dead += !reads_live[i];
+	}
+	LOG << "liveness analysis: " << rounds << " rounds, " << dead << " of " << n
+	    << " static instructions read no live register" << endl;
+	return true;
+#endif
+}
+
+bool LivenessPruner::prune_variant(const fail::Database::Variant& variant)
+{
+	std::stringstream ss;
+	ss << "SELECT instr2, instr2_absolute, data_address, accesstype, width FROM trace"
+	   << " WHERE variant_id = " << variant.id
+	   << " ORDER BY data_address, instr2";
+	fail::Database::Result *res = db->query_stream(ss.str().c_str());
+	ss.str("");
+	if (!res) {
+		return false;
+	}
+
+	// pilots (in insertion order), and the trace rows grouped with them
+	const uint32_t KNOWN = ~0U;
+	std::vector<TraceRow> pilots;
+	std::vector<uint32_t> pilots_absolute; // 0: NULL
+	std::vector<std::pair<TraceRow, uint32_t> > groups; // trace row, index in pilots or KNOWN
+	std::vector<TraceRow> pending; // rows ending with a dead read
+	TraceRow known = { KNOWN, 0, 0 };
+	uint32_t known_absolute = 0;
+	uint64_t reads = 0, dead_reads = 0;
+
+	MYSQL_ROW row;
+	while ((row = db->fetch_row(res))) {
+		TraceRow t;
+		t.instr2 = strtoul(row[0], 0, 10);
+		uint32_t absolute = row[1] ? strtoul(row[1], 0, 10) : 0;
+		t.data_address = strtoul(row[2], 0, 10);
+		t.width = strtoul(row[4], 0, 10);
+		bool is_read = row[3][0] == 'R';
+
+		if (!pending.empty() && pending.back().data_address != t.data_address) {
+			// never read again
+			for (size_t i = 0; i < pending.size(); ++i) {
+				groups.push_back(std::make_pair(pending[i], KNOWN));
+			}
+			pending.clear();
+		}
+
+		uint32_t pilot = KNOWN;
+		if (is_read) {
+			++reads;
+			// right margin (no IP): must be treated as a read
+			if (row[1] && !read_is_live(absolute)) {
+				++dead_reads;
+				pending.push_back(t);
+				continue;
+			}
+			pilot = pilots.size();
+			pilots.push_back(t);
+			pilots_absolute.push_back(absolute);
+		} else if (t.instr2 < known.instr2) {
+			known = t;
+			known_absolute = absolute;
+		}
+		for (size_t i = 0; i < pending.size(); ++i) {
+			groups.push_back(std::make_pair(pending[i], pilot));
+		}
+		pending.clear();
+		groups.push_back(std::make_pair(t, pilot));
+	}
+	db->free_result(res);
+	if (db->error().size()) {
+		LOG << "MYSQL ERROR: " << db->error() << endl;
+		return false;
+	}
+	for (size_t i = 0; i < pending.size(); ++i) {
+		groups.push_back(std::make_pair(pending[i], KNOWN));
+	}
+	LOG << reads << " read ECs, " << dead_reads << " of them end with a dead read" << endl;
+
+	/* fsppilot */
+	ss << "INSERT INTO fsppilot (known_outcome, variant_id, instr2, injection_instr, "
+	      "injection_instr_absolute, data_address, data_width, fspmethod_id) VALUES ";
+	std::string insert_pilot = ss.str();
+	ss.str("");
+	for (size_t i = 0; i < pilots.size(); ++i) {
+		ss << "(0," << variant.id << "," << pilots[i].instr2 << "," << pilots[i].instr2 << ",";
+		if (pilots_absolute[i]) {
+			ss << pilots_absolute[i];
+		} else {
+			ss << "NULL";
+		}
+		ss << "," << pilots[i].data_address << "," << pilots[i].width << "," << m_method_id << ")";
+		if (!db->insert_multiple(insert_pilot.c_str(), ss.str().c_str())) {
+			return false;
+		}
+		ss.str("");
+	}
+	if (!db->insert_multiple()) {
+		return false;
+	}
+
+	uint32_t known_pilot_id = 0;
+	bool has_known = false;
+	for (size_t i = 0; i < groups.size() && !has_known; ++i) {
+		has_known = groups[i].second == KNOWN;
+	}
+	if (has_known) {
+		if (known.instr2 == KNOWN) {
+			// only reads without effect, no write: pick any of them
+			for (size_t i = 0; i < groups.size(); ++i) {
+				if (groups[i].second == KNOWN) {
+					known = groups[i].first;
+					break;
+				}
+			}
+		}
+		ss << insert_pilot << "(1," << variant.id << "," << known.instr2 << "," << known.instr2 << ",";
+		if (known_absolute) {
+			ss << known_absolute;
+		} else {
+			ss << "NULL";
+		}
+		ss << "," << known.data_address << "," << known.width << "," << m_method_id << ")";
+		if (!db->query(ss.str().c_str())) {
+			return false;
+		}
+		ss.str("");
+		known_pilot_id = db->insert_id();
+	}
+	LOG << "created " << (pilots.size() + has_known) << " fsppilot entries" << endl;
+
+	/* pilot IDs */
+	std::unordered_map<uint64_t, uint32_t> pilot_ids;
+	ss << "SELECT id, instr2, data_address FROM fsppilot"
+	      " WHERE known_outcome = 0 AND fspmethod_id = " << m_method_id
+	   << " AND variant_id = " << variant.id;
+	res = db->query_stream(ss.str().c_str());
+	ss.str("");
+	if (!res) {
+		return false;
+	}
+	while ((row = db->fetch_row(res))) {
+		uint64_t key = ((uint64_t) strtoul(row[1], 0, 10) << 32) | strtoul(row[2], 0, 10);
+		pilot_ids[key] = strtoul(row[0], 0, 10);
+	}
+	db->free_result(res);
+
+	/* fspgroup */
+	ss << "INSERT INTO fspgroup (variant_id, instr2, data_address, fspmethod_id, pilot_id) VALUES ";
+	std::string insert_group = ss.str();
+	ss.str("");
+	for (size_t i = 0; i < groups.size(); ++i) {
+		const TraceRow& t = groups[i].first;
+		uint32_t pilot_id = known_pilot_id;
+		if (groups[i].second != KNOWN) {
+			const TraceRow& p = pilots[groups[i].second];
+			pilot_id = pilot_ids[((uint64_t) p.instr2 << 32) | p.data_address];
+		}
+		ss << "(" << variant.id << "," << t.instr2 << "," << t.data_address << ","
+		   << m_method_id << "," << pilot_id << ")";
+		if (!db->insert_multiple(insert_group.c_str(), ss.str().c_str())) {
+			return false;
+		}
+		ss.str("");
+	}
+	if (!db->insert_multiple()) {
+		return false;
+	}
+	LOG << "created " << groups.size() << " fspgroup entries" << endl;
+
+	return true;
+}
@@ -0,0 +1,56 @@
+#ifndef __LIVENESS_PRUNER_H__
+#define __LIVENESS_PRUNER_H__
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include "Pruner.hpp"
+#include "config/VariantConfig.hpp"
+#include "util/CommandLine.hpp"
+#include "util/ElfReader.hpp"
+
+#if defined(BUILD_CAPSTONE_DISASSEMBLER)
+#include "util/capstonedisassembler/CapstoneDisassembler.hpp"
+#elif defined(BUILD_LLVM_DISASSEMBLER)
+#include "util/llvmdisassembler/LLVMDisassembler.hpp"
+#endif
+
+///
+/// LivenessPruner: def/use pruning that ignores register reads without effect
+///
+/// Works like the BasicPruner, but a read access only terminates an EC if the
+/// reading instruction may propagate the value: instructions whose register
+/// results are all dead (faint) on every path seen in the trace, and that
+/// neither branch nor access memory, cannot turn a fault in their inputs
+/// into a failure.  Such reads are skipped, i.e., the ECs before and after
+/// them share one pilot (or become known outcome, if the next real access is
+/// a write).
+///
+/// The liveness analysis runs on the static instructions of the ELF binary
+/// (disassembled with the configured disassembler), with the control flow
+/// edges observed in the trace file.  It is meant for traces imported with
+/// the RegisterImporter, but memory ECs are handled correctly as well (as
+/// memory-accessing instructions always count as real reads).
+///
+class LivenessPruner : public Pruner {
+	fail::CommandLine::option_handle ELF_FILE;
+
+	// per static instruction: do its register reads matter?
+	std::unordered_map<uint32_t, bool> m_reads_live;
+
+	bool analyze(fail::ElfReader& elf);
+	bool prune_variant(const fail::Database::Variant& variant);
+	bool read_is_live(uint32_t ip) const;
+
+public:
+	virtual std::string method_name() { return "liveness"; }
+	virtual bool commandline_init();
+	virtual bool prune_all();
+
+	void getAliases(std::deque<std::string> *aliases) {
+		aliases->push_back("LivenessPruner");
+		aliases->push_back("liveness");
+	}
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <boost/thread.hpp>
 #include "util/Logger.hpp"
 
 using namespace fail;
@@ -31,20 +33,19 @@ bool Pruner::init(
 		for (std::vector<fail::Database::Variant>::iterator it = m_variants.begin();
 			it != m_variants.end(); ) {
 			std::stringstream ss;
-			MYSQL_RES *res;
-			ss << "(SELECT variant_id FROM fsppilot WHERE "
+			Database::Result *res;
+			// (no parenthesized UNION, SQLite does not understand it)
+			ss << "SELECT id FROM variant WHERE id = " << it->id
+			   << " AND (EXISTS (SELECT variant_id FROM fsppilot WHERE "
 			   << " variant_id = " << it->id << " AND "
-			   << " fspmethod_id = " << m_method_id
-			   << " LIMIT 1)"
-			   << " UNION ALL "
-			   << "(SELECT variant_id FROM fspgroup WHERE "
+			   << " fspmethod_id = " << m_method_id << ")"
+			   << " OR EXISTS (SELECT variant_id FROM fspgroup WHERE "
 			   << " variant_id = " << it->id << " AND "
-			   << " fspmethod_id = " << m_method_id
-			   << " LIMIT 1)";
+			   << " fspmethod_id = " << m_method_id << "))";
 			if (!(res = db->query(ss.str().c_str(), true))) {
 				return false;
 			}
-			if (mysql_num_rows(res) > 0) {
+			if (db->num_rows(res) > 0) {
 				// skip this variant
 				LOG << "skipping " << it->variant << "/" << it->benchmark
 				    << " due to existing pruning data (use --overwrite to skip this check)"
@@ -122,3 +123,81 @@ bool Pruner::clear_database() {
 
 	return ret;
 }
+
+namespace {
+
+// Prunes the variants of "master" one by one with clones, until all are
+// taken or one failed
+class PruneWorker {
+	const Pruner *master;
+	const std::vector<Database::Variant> *variants;
+	boost::mutex *mutex;
+	size_t *next;
+	bool *failed;
+public:
+	PruneWorker(const Pruner *master, const std::vector<Database::Variant> *variants,
+		boost::mutex *mutex, size_t *next, bool *failed)
+		: master(master), variants(variants), mutex(mutex), next(next), failed(failed) {}
+	void operator()();
+};
+
+void PruneWorker::operator()()
+{
+	Database *db = Database::cmdline_connect();
+	while (true) {
+		size_t i;
+		{
+			boost::lock_guard<boost::mutex> lock(*mutex);
+			if (*failed || *next >= variants->size()) {
+				break;
+			}
+			i = (*next)++;
+		}
+		std::unique_ptr<Pruner> pruner(master->clone());
+		pruner->set_db(db);
+		pruner->set_variant((*variants)[i]);
+		if (!pruner->prune_all()) {
+			LOG << "pruning " << (*variants)[i].variant << "/" << (*variants)[i].benchmark
+			    << " failed" << std::endl;
+			boost::lock_guard<boost::mutex> lock(*mutex);
+			*failed = true;
+		}
+	}
+	delete db;
+}
+
+} // anonymous namespace
+
+void Pruner::set_variant(const Database::Variant& variant)
+{
+	m_variants.assign(1, variant);
+	std::stringstream ss;
+	ss << variant.id;
+	m_variants_sql = ss.str();
+}
+
+bool Pruner::prune_parallel(unsigned jobs)
+{
+	if (jobs > m_variants.size()) {
+		jobs = m_variants.size();
+	}
+	std::unique_ptr<Pruner> probe(clone());
+	if (jobs <= 1 || !probe) {
+		if (jobs > 1) {
+			LOG << method_name() << " cannot prune variants in parallel, continuing sequentially"
+			    << std::endl;
+		}
+		return prune_all();
+	}
+
+	LOG << "pruning " << m_variants.size() << " variants with " << jobs << " jobs" << std::endl;
+	boost::mutex mutex;
+	size_t next = 0;
+	bool failed = false;
+	boost::thread_group workers;
+	for (unsigned i = 0; i < jobs; ++i) {
+		workers.create_thread(PruneWorker(this, &m_variants, &mutex, &next, &failed));
+	}
+	workers.join_all();
+	return !failed;
+}
@@ -16,6 +16,8 @@ protected:
 public:
 	void set_db(fail::Database *db) { this->db = db; }
 	void set_traceFile(std::string trace_file) { this->trace_file = trace_file; }
+	//! Restricts the pruner to a single (already initialized) variant.
+	void set_variant(const fail::Database::Variant& variant);
 
 	bool init(
 		const std::vector<std::string>& variants,
@@ -35,8 +37,31 @@ public:
 	virtual bool create_database();
 	virtual bool clear_database();
 
+	/**
+	 * Called once after the command line was parsed and init() succeeded,
+	 * before prune_all() -- and before the pruner is cloned for parallel
+	 * pruning, so per-run settings (e.g., a random seed) are shared by all
+	 * clones.
+	 */
+	virtual bool prepare() { return true; }
+
 	virtual bool prune_all() = 0;
 
+	/**
+	 * Returns an independent copy of this pruner that prune_parallel() can
+	 * run on a subset of the variants, or 0 if the pruner cannot be run
+	 * this way (the default).
+	 */
+	virtual Pruner *clone() const { return 0; }
+
+	/**
+	 * Prunes the variants with up to "jobs" concurrent clones of this
+	 * pruner, one variant at a time and each with its own database
+	 * connection.  Falls back to prune_all() if the pruner cannot be
+	 * cloned.
+	 */
+	bool prune_parallel(unsigned jobs);
+
 	/**
 	 * Tell the pruner to work incrementally.  For example, a sampling pruner
 	 * could add more pilots to already existing ones (which already may be
@@ -10,20 +10,28 @@
 ///
 /// Unlike the FESamplingPruner, the SamplingPruner implements uniform
 /// fault-space sampling that counts multiple hits of an equivalence class.
+/// The population is streamed from the database; only the sampled ECs are
+/// kept in memory.
 ///
 class SamplingPruner : public Pruner {
 	fail::CommandLine::option_handle SAMPLESIZE;
 	fail::CommandLine::option_handle USE_KNOWN_RESULTS;
 	fail::CommandLine::option_handle NO_WEIGHTING;
+	fail::CommandLine::option_handle SEED;
+	fail::CommandLine::option_handle SAMPLING_THREADS;
 
 	uint64_t m_samplesize;
+	uint64_t m_seed;
+	unsigned m_threads;
 	bool m_use_known_results, m_weighting, m_incremental;
 
 public:
-	SamplingPruner() : m_samplesize(0), m_use_known_results(false), m_weighting(true), m_incremental(false) { }
+	SamplingPruner() : m_samplesize(0), m_seed(0), m_threads(1), m_use_known_results(false), m_weighting(true), m_incremental(false) { }
 	virtual std::string method_name() { return "sampling"; }
 	virtual bool commandline_init();
+	virtual bool prepare();
 	virtual bool prune_all();
+	virtual Pruner *clone() const { return new SamplingPruner(*this); }
 
 	void getAliases(std::deque<std::string> *aliases) {
 		aliases->push_back("SamplingPruner");
@@ -0,0 +1,516 @@
+#include <sstream>
+#include <stdlib.h>
+#include <math.h>
+#include <elf.h>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <boost/thread.hpp>
+#include "StratifiedSamplingPruner.hpp"
+#include "util/Logger.hpp"
+#include "util/CommandLine.hpp"
+#include "util/ElfReader.hpp"
+#include "util/Sampling.hpp"
+
+static fail::Logger LOG("StratifiedSamplingPruner");
+using std::endl;
+
+// the largest fspgroup weight of a pilot (see sampling_prune()); the weight
+// column is int(11) UNSIGNED
+static const double MAX_WEIGHT = 1000000000;
+
+struct StratumSample {
+	uint32_t id;
+	uint32_t instr2;
+	uint32_t instr2_absolute;
+	uint32_t data_address;
+	uint32_t hits;
+	unsigned stratum;
+};
+
+static inline uint64_t pilot_key(uint32_t instr2, uint32_t data_address)
+{
+	return ((uint64_t) instr2 << 32) | data_address;
+}
+
+bool StratifiedSamplingPruner::commandline_init()
+{
+	fail::CommandLine &cmd = fail::CommandLine::Inst();
+	ELF_FILE = cmd.addOption("e", "elf-file", Arg::Required,
+		"-e/--elf-file \tELF binary whose functions form the strata");
+	SAMPLESIZE = cmd.addOption("", "samplesize", Arg::Required,
+		"--samplesize N \tNumber of samples to take (per variant)");
+	MIN_PER_STRATUM = cmd.addOption("", "min-per-stratum", Arg::Required,
+		"--min-per-stratum N \tSample each stratum at least N times (default: 2)");
+	PILOT_RESULTS = cmd.addOption("", "pilot-results", Arg::Required,
+		"--pilot-results TABLE \tNeyman allocation with the outcome variance per stratum from this "
+		"result table (default: allocation proportional to the area)");
+	PILOT_METHOD = cmd.addOption("", "pilot-method", Arg::Required,
+		"--pilot-method M \tPruning method(s) of the pilot run's pilots (default: sampling; "
+		"use % and _ as wildcard characters)");
+	OUTCOME_FIELD = cmd.addOption("", "outcome-field", Arg::Required,
+		"--outcome-field F \tColumn of the pilot results holding the outcome (default: resulttype)");
+	NO_WEIGHTING = cmd.addOption("", "no-weighting", Arg::None,
+		"--no-weighting \tDisable weighted sampling (weight = 1 for all ECs) "
+		"(don't do this unless you know what you're doing)");
+	SEED = cmd.addOption("", "seed", Arg::Required,
+		"--seed N \tSeed for the random number generator, makes the sample reproducible (default: random)");
+	SAMPLING_THREADS = cmd.addOption("", "sampling-threads", Arg::Required,
+		"--sampling-threads N \tDraw samples with N threads (default: number of CPUs)");
+	return true;
+}
+
+bool StratifiedSamplingPruner::create_database()
+{
+	if (!Pruner::create_database()) {
+		return false;
+	}
+	std::string create_statement = "CREATE TABLE IF NOT EXISTS fspstratum ("
+	    "  variant_id   int(11) NOT NULL,"
+	    "  fspmethod_id int(11) NOT NULL,"
+	    "  id           int(11) NOT NULL,"
+	    "  name         varchar(255) NOT NULL,"
+	    "  area         bigint(20) UNSIGNED NOT NULL,"  // sum of the EC lengths
+	    "  ecs          bigint(20) UNSIGNED NOT NULL,"
+	    "  samples      bigint(20) UNSIGNED NOT NULL,"
+	    "  deviation    double,"                        // from the pilot run
+	    "  hit_weight   double NOT NULL,"               // fspgroup weight of one hit
+	    "  PRIMARY KEY (variant_id, fspmethod_id, id)"
+	    ") engine=MyISAM";
+	if (!db->query(create_statement.c_str())) {
+		return false;
+	}
+	create_statement = "CREATE TABLE IF NOT EXISTS fspstratum_pilot ("
+	    "  variant_id   int(11) NOT NULL,"
+	    "  fspmethod_id int(11) NOT NULL,"
+	    "  pilot_id     int(11) NOT NULL,"
+	    "  stratum_id   int(11) NOT NULL,"
+	    "  hits         int(11) UNSIGNED NOT NULL,"
+	    "  PRIMARY KEY (variant_id, fspmethod_id, pilot_id),"
+	    "  KEY stratum (variant_id, fspmethod_id, stratum_id)"
+	    ") engine=MyISAM";
+	return db->query(create_statement.c_str());
+}
+
+bool StratifiedSamplingPruner::clear_database()
+{
+	bool ret = Pruner::clear_database();
+	std::stringstream ss;
+	ss << "DELETE FROM fspstratum WHERE variant_id IN (" << m_variants_sql
+	   << ") AND fspmethod_id = " << m_method_id;
+	ret = ret && db->query(ss.str().c_str());
+	LOG << "deleted " << db->affected_rows() << " rows from fspstratum table" << endl;
+	ss.str("");
+	ss << "DELETE FROM fspstratum_pilot WHERE variant_id IN (" << m_variants_sql
+	   << ") AND fspmethod_id = " << m_method_id;
+	ret = ret && db->query(ss.str().c_str());
+	LOG << "deleted " << db->affected_rows() << " rows from fspstratum_pilot table" << endl;
+	return ret;
+}
+
+bool StratifiedSamplingPruner::prepare()
+{
+	fail::CommandLine &cmd = fail::CommandLine::Inst();
+	if (!cmd[SAMPLESIZE]) {
+		LOG << "parameter --samplesize required, aborting" << endl;
+		return false;
+	}
+	m_samplesize = strtoul(cmd[SAMPLESIZE].first()->arg, 0, 10);
+
+	if (!cmd[ELF_FILE]) {
+		LOG << "parameter -e/--elf-file required, aborting" << endl;
+		return false;
+	}
+	if (!load_functions(cmd[ELF_FILE].first()->arg)) {
+		return false;
+	}
+
+	if (cmd[MIN_PER_STRATUM]) {
+		m_min_per_stratum = strtoul(cmd[MIN_PER_STRATUM].first()->arg, 0, 10);
+	}
+	if (cmd[PILOT_RESULTS]) {
+		m_pilot_results = cmd[PILOT_RESULTS].first()->arg;
+	}
+	if (cmd[PILOT_METHOD]) {
+		m_pilot_method = cmd[PILOT_METHOD].first()->arg;
+	}
+	if (cmd[OUTCOME_FIELD]) {
+		m_outcome_field = cmd[OUTCOME_FIELD].first()->arg;
+	}
+	if (cmd[NO_WEIGHTING]) {
+		m_weighting = false;
+	}
+
+	if (cmd[SEED]) {
+		m_seed = strtoull(cmd[SEED].first()->arg, 0, 10);
+	} else {
+		m_seed = fail::random_seed();
+	}
+	LOG << "sampling with seed " << m_seed << " (use --seed to reproduce)" << endl;
+
+	m_threads = boost::thread::hardware_concurrency();
+	if (cmd[SAMPLING_THREADS]) {
+		m_threads = strtoul(cmd[SAMPLING_THREADS].first()->arg, 0, 10);
+	}
+	return true;
+}
+
+bool StratifiedSamplingPruner::load_functions(const std::string& elf_file)
+{
+	fail::ElfReader elf(elf_file.c_str());
+	std::vector<std::pair<Function, std::string> > functions;
+	for (fail::ElfReader::symbol_iterator it = elf.sym_begin(); it != elf.sym_end(); ++it) {
+		if (it->getSymbolType() != STT_FUNC || it->getSize() == 0) {
+			continue;
+		}
+		Function f;
+		f.start = it->getStart();
+		f.end = it->getEnd();
+		functions.push_back(std::make_pair(f, it->getName()));
+	}
+	std::sort(functions.begin(), functions.end());
+
+	m_functions.clear();
+	m_stratum_names.assign(1, "(none)");
+	for (size_t i = 0; i < functions.size(); ++i) {
+		Function f = functions[i].first;
+		// aliases and overlapping symbols belong to the first function
+		if (!m_functions.empty() && f.start < m_functions.back().end) {
+			continue;
+		}
+		f.stratum = m_stratum_names.size();
+		m_functions.push_back(f);
+		m_stratum_names.push_back(functions[i].second);
+	}
+	if (m_functions.empty()) {
+		LOG << "no function symbols found in " << elf_file << endl;
+		return false;
+	}
+	LOG << m_functions.size() << " functions (strata) in " << elf_file << endl;
+	return true;
+}
+
+unsigned StratifiedSamplingPruner::stratum_of(uint32_t ip) const
+{
+	Function key;
+	key.start = ip;
+	std::vector<Function>::const_iterator it =
+		std::upper_bound(m_functions.begin(), m_functions.end(), key);
+	if (it == m_functions.begin()) {
+		return 0;
+	}
+	--it;
+	return ip < it->end ? it->stratum : 0;
+}
+
+bool StratifiedSamplingPruner::pilot_deviations(const fail::Database::Variant& variant,
+	std::vector<double>& deviation)
+{
+	// outcome counts of the pilot run per stratum
+	std::vector<std::map<std::string, uint64_t> > outcomes(m_stratum_names.size());
+	std::stringstream ss;
+	ss << "SELECT p.injection_instr_absolute, r.`" << m_outcome_field << "`, COUNT(*)"
+	   << " FROM fsppilot p"
+	   << " JOIN " << m_pilot_results << " r ON r.pilot_id = p.id"
+	   << " WHERE p.variant_id = " << variant.id
+	   << "   AND p.fspmethod_id IN (SELECT id FROM fspmethod WHERE method LIKE '" << m_pilot_method << "')"
+	   << " GROUP BY p.injection_instr_absolute, r.`" << m_outcome_field << "`";
+	fail::Database::Result *res = db->query_stream(ss.str().c_str());
+	if (!res) {
+		return false;
+	}
+	MYSQL_ROW row;
+	uint64_t experiments = 0;
+	while ((row = db->fetch_row(res))) {
+		unsigned s = row[0] ? stratum_of(strtoul(row[0], 0, 10)) : 0;
+		outcomes[s][row[1] ? row[1] : "NULL"] += strtoull(row[2], 0, 10);
+		experiments += strtoull(row[2], 0, 10);
+	}
+	db->free_result(res);
+
+	// standard deviation of the outcome: sqrt of the summed variances of the
+	// outcome indicators, sum p(1-p) = 1 - sum p^2
+	deviation.assign(m_stratum_names.size(), -1);
+	double known_sum = 0;
+	unsigned known = 0;
+	for (size_t s = 0; s < outcomes.size(); ++s) {
+		uint64_t n = 0;
+		for (std::map<std::string, uint64_t>::const_iterator it = outcomes[s].begin();
+			it != outcomes[s].end(); ++it) {
+			n += it->second;
+		}
+		if (n == 0) {
+			continue;
+		}
+		double sum_sq = 0;
+		for (std::map<std::string, uint64_t>::const_iterator it = outcomes[s].begin();
+			it != outcomes[s].end(); ++it) {
+			double p = (double) it->second / n;
+			sum_sq += p * p;
+		}
+		deviation[s] = sqrt(std::max(0.0, 1 - sum_sq));
+		known_sum += deviation[s];
+		++known;
+	}
+	LOG << "pilot run: " << experiments << " experiments in " << known << " strata" << endl;
+	// strata the pilot run did not hit: assume an average deviation
+	double fallback = known ? known_sum / known : 1;
+	for (size_t s = 0; s < deviation.size(); ++s) {
+		if (deviation[s] < 0) {
+			deviation[s] = fallback;
+		}
+	}
+	return true;
+}
+
+void StratifiedSamplingPruner::allocate(const std::vector<uint64_t>& area,
+	const std::vector<double>& deviation, std::vector<uint64_t>& samples) const
+{
+	size_t strata = area.size();
+	double total = 0;
+	for (size_t s = 0; s < strata; ++s) {
+		total += area[s] * deviation[s];
+	}
+	bool by_area = total <= 0;
+	if (by_area) {
+		// no variance anywhere: proportional allocation
+		for (size_t s = 0; s < strata; ++s) {
+			total += area[s];
+		}
+	}
+
+	samples.assign(strata, 0);
+	std::vector<std::pair<double, size_t> > remainders;
+	uint64_t allocated = 0;
+	for (size_t s = 0; s < strata; ++s) {
+		if (area[s] == 0) {
+			continue;
+		}
+		double share = m_samplesize * area[s] * (by_area ? 1 : deviation[s]) / total;
+		samples[s] = (uint64_t) share;
+		remainders.push_back(std::make_pair(share - samples[s], s));
+		if (samples[s] < m_min_per_stratum) {
+			samples[s] = m_min_per_stratum;
+		}
+		allocated += samples[s];
+	}
+	// largest remainders first
+	std::sort(remainders.rbegin(), remainders.rend());
+	for (size_t i = 0; i < remainders.size() && allocated < m_samplesize; ++i) {
+		++samples[remainders[i].second];
+		++allocated;
+	}
+	if (allocated > m_samplesize) {
+		LOG << "--min-per-stratum raises the sample size to " << allocated << endl;
+	}
+}
+
+bool StratifiedSamplingPruner::prune_all()
+{
+	// for each variant:
+	for (std::vector<fail::Database::Variant>::const_iterator it = m_variants.begin();
+		it != m_variants.end(); ++it) {
+		if (!sampling_prune(*it)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool StratifiedSamplingPruner::sampling_prune(const fail::Database::Variant& variant)
+{
+	std::stringstream ss;
+	fail::Database::Result *res;
+	MYSQL_ROW row;
+	size_t strata = m_stratum_names.size();
+
+	// first pass: area and size of each stratum
+	LOG << "stratifying trace entries for " << variant.variant << "/" << variant.benchmark << " ..." << endl;
+	std::string from_where;
+	ss << " FROM trace"
+	   << " WHERE variant_id = " << variant.id
+	   << " AND accesstype = 'R'";
+	from_where = ss.str();
+	ss.str("");
+	ss << "SELECT instr2_absolute, time2-time1+1 AS duration" << from_where;
+	res = db->query_stream(ss.str().c_str());
+	ss.str("");
+	if (!res) return false;
+	std::vector<uint64_t> area(strata), ecs(strata);
+	// stratum lookups per static instruction
+	std::unordered_map<uint32_t, unsigned> stratum_cache;
+	while ((row = db->fetch_row(res))) {
+		unsigned s = 0;
+		if (row[0]) {
+			uint32_t ip = strtoul(row[0], 0, 10);
+			std::unordered_map<uint32_t, unsigned>::const_iterator it = stratum_cache.find(ip);
+			s = it != stratum_cache.end() ? it->second : (stratum_cache[ip] = stratum_of(ip));
+		}
+		area[s] += m_weighting ? strtoull(row[1], 0, 10) : 1;
+		++ecs[s];
+	}
+	db->free_result(res);
+
+	uint64_t total_area = 0, populated = 0;
+	for (size_t s = 0; s < strata; ++s) {
+		total_area += area[s];
+		populated += area[s] > 0;
+	}
+	if (total_area == 0) {
+		LOG << "no entries found, nothing to sample from!" << endl;
+		return true;
+	}
+
+	std::vector<double> deviation(strata, 1);
+	if (!m_pilot_results.empty() && !pilot_deviations(variant, deviation)) {
+		return false;
+	}
+	std::vector<uint64_t> samples;
+	allocate(area, deviation, samples);
+	LOG << populated << " populated strata, " << (m_pilot_results.empty() ? "proportional" : "Neyman")
+	    << " allocation of " << m_samplesize << " samples" << endl;
+
+	// second pass: sample each stratum (in primary-key order, to make the
+	// sample reproducible)
+	std::vector<fail::SortedSampler> samplers;
+	uint64_t variant_seed = fail::derive_seed(m_seed, variant.id);
+	for (size_t s = 0; s < strata; ++s) {
+		samplers.push_back(fail::SortedSampler(area[s], samples[s],
+			fail::derive_seed(variant_seed, s), m_threads));
+	}
+	ss << "SELECT instr2, instr2_absolute, data_address, time2-time1+1 AS duration"
+	   << from_where << " ORDER BY data_address, instr2";
+	res = db->query_stream(ss.str().c_str());
+	ss.str("");
+	if (!res) return false;
+	std::vector<StratumSample> sample;
+	while ((row = db->fetch_row(res))) {
+		unsigned s = 0;
+		if (row[1]) {
+			s = stratum_cache[strtoul(row[1], 0, 10)];
+		}
+		uint32_t hits = samplers[s].hits(m_weighting ? strtoull(row[3], 0, 10) : 1);
+		if (hits == 0) {
+			continue;
+		}
+		StratumSample p;
+		p.id = 0;
+		p.instr2 = strtoul(row[0], 0, 10);
+		p.instr2_absolute = row[1] ? strtoul(row[1], 0, 10) : 0;
+		p.data_address = strtoul(row[2], 0, 10);
+		p.hits = hits;
+		p.stratum = s;
+		sample.push_back(p);
+	}
+	db->free_result(res);
+	for (size_t s = 0; s < strata; ++s) {
+		if (!samplers[s].done()) {
+			LOG << "population changed while sampling, aborting" << endl;
+			return false;
+		}
+	}
+	std::unordered_map<uint32_t, unsigned>().swap(stratum_cache);
+
+	// fspgroup weight of a hit: the area it represents, scaled so the largest
+	// pilot weight (hits * hit_weight) is MAX_WEIGHT
+	std::vector<double> hit_weight(strata, 0);
+	double max_pilot_area = 0;
+	for (size_t i = 0; i < sample.size(); ++i) {
+		const StratumSample& p = sample[i];
+		max_pilot_area = std::max(max_pilot_area, p.hits * ((double) area[p.stratum] / samples[p.stratum]));
+	}
+	for (size_t s = 0; s < strata; ++s) {
+		if (samples[s] > 0 && max_pilot_area > 0) {
+			hit_weight[s] = (double) area[s] / samples[s] * MAX_WEIGHT / max_pilot_area;
+		}
+	}
+
+	ss << "INSERT INTO fsppilot (known_outcome, variant_id, instr2, injection_instr, "
+	   << "injection_instr_absolute, data_address, data_width, fspmethod_id) VALUES ";
+	std::string insert_sql(ss.str());
+	ss.str("");
+	std::unordered_map<uint64_t, size_t> by_key;
+	for (size_t i = 0; i < sample.size(); ++i) {
+		const StratumSample& p = sample[i];
+		ss << "(0," << variant.id << "," << p.instr2 << "," << p.instr2 << ",";
+		if (p.instr2_absolute) {
+			ss << p.instr2_absolute;
+		} else {
+			ss << "NULL";
+		}
+		ss << "," << p.data_address << ",1," << m_method_id << ")";
+		if (!db->insert_multiple(insert_sql.c_str(), ss.str().c_str())) return false;
+		ss.str("");
+		by_key[pilot_key(p.instr2, p.data_address)] = i;
+	}
+	if (!db->insert_multiple()) return false;
+	LOG << "created " << sample.size() << " fsppilot entries" << endl;
+
+	// the AUTO_INCREMENT ids of the new pilots
+	ss << "SELECT id, instr2, data_address FROM fsppilot"
+	      " WHERE known_outcome = 0 AND fspmethod_id = " << m_method_id <<
+	      " AND variant_id = " << variant.id;
+	res = db->query_stream(ss.str().c_str());
+	ss.str("");
+	if (!res) return false;
+	while ((row = db->fetch_row(res))) {
+		std::unordered_map<uint64_t, size_t>::const_iterator it =
+			by_key.find(pilot_key(strtoul(row[1], 0, 10), strtoul(row[2], 0, 10)));
+		if (it != by_key.end()) {
+			sample[it->second].id = strtoul(row[0], 0, 10);
+		}
+	}
+	db->free_result(res);
+	std::unordered_map<uint64_t, size_t>().swap(by_key);
+
+	LOG << "creating fspgroup and fspstratum entries ..." << endl;
+	std::string insert_group = "INSERT INTO fspgroup (variant_id, instr2, data_address, fspmethod_id, pilot_id, weight) VALUES ";
+	std::string insert_stratum_pilot = "INSERT INTO fspstratum_pilot (variant_id, fspmethod_id, pilot_id, stratum_id, hits) VALUES ";
+	double max_rounding = 0;
+	for (size_t i = 0; i < sample.size(); ++i) {
+		const StratumSample& p = sample[i];
+		double w = p.hits * hit_weight[p.stratum];
+		uint64_t weight = std::max<uint64_t>(1, llround(w));
+		max_rounding = std::max(max_rounding, fabs(weight - w) / w);
+		ss << "(" << variant.id << "," << p.instr2 << "," << p.data_address
+		   << "," << m_method_id << "," << p.id << "," << weight << ")";
+		if (!db->insert_multiple(insert_group.c_str(), ss.str().c_str())) return false;
+		ss.str("");
+	}
+	if (!db->insert_multiple()) return false;
+	for (size_t i = 0; i < sample.size(); ++i) {
+		const StratumSample& p = sample[i];
+		ss << "(" << variant.id << "," << m_method_id << "," << p.id
+		   << "," << p.stratum << "," << p.hits << ")";
+		if (!db->insert_multiple(insert_stratum_pilot.c_str(), ss.str().c_str())) return false;
+		ss.str("");
+	}
+	if (!db->insert_multiple()) return false;
+	if (max_rounding > 0.001) {
+		LOG << "warning: fspgroup weights are off by up to " << max_rounding * 100
+		    << "% due to rounding (very unequal strata), prefer the *-stratified.sh scripts" << endl;
+	}
+
+	std::string insert_stratum = "INSERT INTO fspstratum (variant_id, fspmethod_id, id, name, area, ecs, samples, deviation, hit_weight) VALUES ";
+	for (size_t s = 0; s < strata; ++s) {
+		if (area[s] == 0) {
+			continue;
+		}
+		ss << "(" << variant.id << "," << m_method_id << "," << s << ",'"
+		   << db->escape_string(m_stratum_names[s].substr(0, 255)) << "'," << area[s] << "," << ecs[s]
+		   << "," << samples[s] << ",";
+		if (m_pilot_results.empty()) {
+			ss << "NULL";
+		} else {
+			ss << deviation[s];
+		}
+		ss << "," << hit_weight[s] << ")";
+		if (!db->insert_multiple(insert_stratum.c_str(), ss.str().c_str())) return false;
+		ss.str("");
+	}
+	if (!db->insert_multiple()) return false;
+	LOG << "created " << sample.size() << " fspgroup entries in " << populated << " strata" << endl;
+
+	return true;
+}
@@ -0,0 +1,80 @@
+#ifndef __STRATIFIED_SAMPLING_PRUNER_H__
+#define __STRATIFIED_SAMPLING_PRUNER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Pruner.hpp"
+#include "util/CommandLine.hpp"
+
+///
+/// StratifiedSamplingPruner: fault-space sampling stratified by function
+///
+/// Partitions the read ECs of a variant into strata by the function (ELF
+/// symbol) containing the injection instruction, and samples each stratum
+/// separately, with replacement and weighted by EC length like the
+/// SamplingPruner.  The samples are allocated to the strata proportionally
+/// to their fault-space area, or -- given the results of a previous (pilot)
+/// campaign -- with Neyman allocation, i.e., proportionally to area times
+/// the standard deviation of the outcome within the stratum, which gives
+/// tighter bounds for the same number of experiments.
+///
+/// Each fspgroup entry is weighted by the fault-space area its samples
+/// represent (hits * stratum area / stratum samples, scaled to integers), so
+/// the existing sampling data-aggregator queries stay unbiased.  The strata
+/// (area, #samples) and the pilots' strata are kept in the fspstratum and
+/// fspstratum_pilot tables for per-function estimates with confidence
+/// intervals (see the *-stratified.sh data-aggregator scripts).
+///
+class StratifiedSamplingPruner : public Pruner {
+	fail::CommandLine::option_handle ELF_FILE;
+	fail::CommandLine::option_handle SAMPLESIZE;
+	fail::CommandLine::option_handle MIN_PER_STRATUM;
+	fail::CommandLine::option_handle PILOT_RESULTS;
+	fail::CommandLine::option_handle PILOT_METHOD;
+	fail::CommandLine::option_handle OUTCOME_FIELD;
+	fail::CommandLine::option_handle NO_WEIGHTING;
+	fail::CommandLine::option_handle SEED;
+	fail::CommandLine::option_handle SAMPLING_THREADS;
+
+	struct Function {
+		uint32_t start, end;
+		unsigned stratum;
+		bool operator<(const Function& other) const { return start < other.start; }
+	};
+	// function address ranges, sorted; stratum 0 is "outside any function"
+	std::vector<Function> m_functions;
+	std::vector<std::string> m_stratum_names;
+
+	uint64_t m_samplesize;
+	uint64_t m_min_per_stratum;
+	uint64_t m_seed;
+	unsigned m_threads;
+	std::string m_pilot_results, m_pilot_method, m_outcome_field;
+	bool m_weighting;
+
+	unsigned stratum_of(uint32_t ip) const;
+	bool load_functions(const std::string& elf_file);
+	bool pilot_deviations(const fail::Database::Variant& variant, std::vector<double>& deviation);
+	void allocate(const std::vector<uint64_t>& area, const std::vector<double>& deviation,
+		std::vector<uint64_t>& samples) const;
+	bool sampling_prune(const fail::Database::Variant& variant);
+
+public:
+	StratifiedSamplingPruner() : m_samplesize(0), m_min_per_stratum(2), m_seed(0), m_threads(1),
+		m_pilot_method("sampling"), m_outcome_field("resulttype"), m_weighting(true) { }
+	virtual std::string method_name() { return "stratified-sampling"; }
+	virtual bool commandline_init();
+	virtual bool create_database();
+	virtual bool clear_database();
+	virtual bool prepare();
+	virtual bool prune_all();
+	virtual Pruner *clone() const { return new StratifiedSamplingPruner(*this); }
+
+	void getAliases(std::deque<std::string> *aliases) {
+		aliases->push_back("StratifiedSamplingPruner");
+		aliases->push_back("stratified-sampling");
+	}
+};
+
+#endif
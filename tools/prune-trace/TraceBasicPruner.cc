@@ -0,0 +1,320 @@
+#include <sstream>
+#include <fstream>
+#include <stdlib.h>
+#include <algorithm>
+#include <unordered_map>
+#include "TraceBasicPruner.hpp"
+#include "util/Logger.hpp"
+#include "util/ProtoStream.hpp"
+#include "util/TraceFile.hpp"
+#include "comm/TracePlugin.pb.h"
+
+static fail::Logger LOG("TraceBasicPruner");
+using std::endl;
+using fail::address_t;
+using fail::simtime_t;
+
+// left margin of the EC currently open for one memory byte
+struct OpenEC {
+	uint32_t instr1;
+	simtime_t time1;
+};
+
+// a closed EC; read ECs wait here for their pilot ID
+struct ClosedEC {
+	uint32_t instr2;
+	uint32_t data_address;
+	uint32_t pilot_id;
+	uint64_t weight;
+};
+
+static inline uint64_t ec_key(uint32_t instr2, uint32_t data_address)
+{
+	return ((uint64_t) instr2 << 32) | data_address;
+}
+
+static bool operator<(const ClosedEC& a, const ClosedEC& b)
+{
+	return ec_key(a.instr2, a.data_address) < ec_key(b.instr2, b.data_address);
+}
+
+// Turns closed ECs into fsppilot rows (reads, streamed to the database) and
+// the records needed for the fspgroup rows.
+class ECCollector {
+	fail::Database *db;
+	int variant_id, method_id;
+	std::stringstream ss;
+public:
+	std::string insert_pilot;
+	std::vector<ClosedEC> reads;
+	std::vector<ClosedEC> writes; // pilot_id unused
+	// the earliest write EC becomes the (single) known-outcome pilot
+	uint64_t first_write_ip;
+
+	ECCollector(fail::Database *db, int variant_id, int method_id)
+		: db(db), variant_id(variant_id), method_id(method_id), first_write_ip(0)
+	{
+		insert_pilot = "INSERT INTO fsppilot (known_outcome, variant_id, instr2, injection_instr, "
+			"injection_instr_absolute, data_address, data_width, fspmethod_id) VALUES ";
+	}
+
+	// closes the EC of one byte at (instr2, time2) with an access of type
+	// "accesstype" at "ip" (0: none, right margin)
+	bool close(const OpenEC& ec, uint32_t data_address, uint32_t instr2,
+		simtime_t time2, char accesstype, uint64_t ip)
+	{
+		ClosedEC e;
+		e.instr2 = instr2;
+		e.data_address = data_address;
+		e.pilot_id = 0;
+		e.weight = time2 - ec.time1 + 1;
+		if (accesstype != 'R') {
+			if (writes.empty()) {
+				first_write_ip = ip;
+			}
+			writes.push_back(e);
+			return true;
+		}
+		ss << "(0," << variant_id << "," << instr2 << "," << instr2 << ",";
+		if (ip) {
+			ss << ip;
+		} else {
+			ss << "NULL";
+		}
+		ss << "," << data_address << ",1," << method_id << ")";
+		bool ret = db->insert_multiple(insert_pilot.c_str(), ss.str().c_str());
+		ss.str("");
+		reads.push_back(e);
+		return ret;
+	}
+};
+
+bool TraceBasicPruner::commandline_init()
+{
+	fail::CommandLine &cmd = fail::CommandLine::Inst();
+	MEMORYMAP = cmd.addOption("", "memory-map", Arg::Required,
+		"--memory-map FILE \tRestrict the fault space to the addresses in FILE (as import-trace -m)");
+	RIGHTMARGIN = cmd.addOption("", "faultspace-rightmargin", Arg::Required,
+		"--faultspace-rightmargin R/W \tAccess type completing the fault space at the right margin "
+		"(as import-trace, default: W)");
+	COVER_MEMORYMAP = cmd.addOption("", "cover-memorymap", Arg::None,
+		"--cover-memorymap \tAlso cover memory-map addresses never accessed in the trace (as import-trace)");
+	return true;
+}
+
+bool TraceBasicPruner::single_variant()
+{
+	// the trace file belongs to one variant
+	if (m_variants.size() != 1) {
+		LOG << "the trace file matches exactly one variant, but "
+		    << m_variants.size() << " were selected" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool TraceBasicPruner::clear_database()
+{
+	// don't delete the pilots of other variants before prepare() fails
+	return single_variant() && Pruner::clear_database();
+}
+
+bool TraceBasicPruner::prepare()
+{
+	return single_variant();
+}
+
+bool TraceBasicPruner::prune_all()
+{
+	fail::CommandLine &cmd = fail::CommandLine::Inst();
+	if (cmd[MEMORYMAP]) {
+		m_mm = new fail::MemoryMap();
+		if (!m_mm->readFromFile(cmd[MEMORYMAP].first()->arg)) {
+			LOG << "failed to load memory map " << cmd[MEMORYMAP].first()->arg << endl;
+			return false;
+		}
+	}
+	if (cmd[RIGHTMARGIN]) {
+		std::string rightmargin(cmd[RIGHTMARGIN].first()->arg);
+		if (rightmargin != "R" && rightmargin != "W") {
+			LOG << "unknown memory access type '" << rightmargin << "', using default" << endl;
+		} else {
+			m_faultspace_rightmargin = rightmargin[0];
+		}
+	}
+	m_cover_memorymap = cmd[COVER_MEMORYMAP];
+	if (m_cover_memorymap && !m_mm) {
+		LOG << "--cover-memorymap needs a --memory-map" << endl;
+		return false;
+	}
+
+	return prune_variant(m_variants[0]);
+}
+
+bool TraceBasicPruner::prune_variant(const fail::Database::Variant& variant)
+{
+	LOG << "reading " << trace_file << " for " << variant.variant << "/"
+	    << variant.benchmark << " ..." << endl;
+
+	std::ifstream normal_stream;
+	igzstream gz_stream;
+	std::istream *in = fail::openStream(trace_file.c_str(), normal_stream, gz_stream);
+	if (!in) {
+		LOG << "couldn't open " << trace_file << endl;
+		return false;
+	}
+	fail::ProtoIStream ps(in);
+
+	ECCollector ecs(db, variant.id, m_method_id);
+	std::unordered_map<address_t, OpenEC> open_ecs;
+
+	simtime_t curtime = 0, time_trace_start = 0;
+	uint32_t instr = 0, instr_memaccess = 0;
+	Trace_Event ev;
+
+	while (ps.getNext(&ev)) {
+		if (ev.has_time_delta()) {
+			if (time_trace_start == 0) {
+				time_trace_start = ev.time_delta();
+			}
+			curtime += ev.time_delta();
+		}
+
+		if (!ev.has_memaddr()) {
+			if (instr == 0xffffffffU) {
+				LOG << "error: instruction counter overflow, aborting" << endl;
+				return false;
+			}
+			instr_memaccess = instr++;
+			continue;
+		}
+
+		char accesstype = ev.accesstype() == ev.READ ? 'R' : 'W';
+		address_t to = ev.memaddr() + ev.width();
+		for (address_t data_address = ev.memaddr(); data_address < to; ++data_address) {
+			if (m_mm && !m_mm->isMatching(data_address)) {
+				continue;
+			}
+			OpenEC& ec = open_ecs[data_address];
+			// (defaulting to 0 would give early reads an unnaturally high weight)
+			if (ec.time1 == 0) {
+				ec.time1 = time_trace_start;
+			}
+			// skip zero-sized intervals: an instruction accessing a location
+			// more than once
+			if (ec.instr1 > instr_memaccess) {
+				continue;
+			}
+			if (!ecs.close(ec, data_address, instr_memaccess, curtime, accesstype, ev.ip())) {
+				return false;
+			}
+			ec.instr1 = instr_memaccess + 1;
+			ec.time1 = curtime + 1;
+		}
+	}
+	if (instr == 0) {
+		LOG << "no instructions in the trace" << endl;
+		return false;
+	}
+
+	// complete the fault space at the right margin
+	if (m_cover_memorymap) {
+		for (fail::MemoryMap::iterator it = m_mm->begin(); it != m_mm->end(); ++it) {
+			if (open_ecs.count(*it) == 0) {
+				OpenEC& ec = open_ecs[*it];
+				ec.instr1 = 0;
+				ec.time1 = time_trace_start;
+			}
+		}
+	}
+	uint32_t last_instr = instr - 1;
+	for (std::unordered_map<address_t, OpenEC>::const_iterator it = open_ecs.begin();
+		it != open_ecs.end(); ++it) {
+		if (it->second.instr1 > last_instr) {
+			continue;
+		}
+		if (!ecs.close(it->second, it->first, last_instr, curtime, m_faultspace_rightmargin, 0)) {
+			return false;
+		}
+	}
+	std::unordered_map<address_t, OpenEC>().swap(open_ecs);
+
+	if (!db->insert_multiple()) {
+		return false;
+	}
+	std::vector<ClosedEC>& reads = ecs.reads;
+	std::vector<ClosedEC>& writes = ecs.writes;
+	std::stringstream ss;
+	LOG << "trace: " << instr << " instructions, " << reads.size() << " read ECs, "
+	    << writes.size() << " write ECs" << endl;
+
+	// known outcome: a single pilot for all write ECs
+	uint32_t known_pilot_id = 0;
+	if (!writes.empty()) {
+		const ClosedEC& first = writes[0];
+		ss << ecs.insert_pilot << "(1," << variant.id << "," << first.instr2 << "," << first.instr2 << ",";
+		if (ecs.first_write_ip) {
+			ss << ecs.first_write_ip;
+		} else {
+			ss << "NULL";
+		}
+		ss << "," << first.data_address << ",1," << m_method_id << ")";
+		if (!db->query(ss.str().c_str())) {
+			return false;
+		}
+		ss.str("");
+		known_pilot_id = db->insert_id();
+	}
+	LOG << "created " << (reads.size() + !writes.empty()) << " fsppilot entries" << endl;
+
+	// pilot IDs of the read ECs
+	std::sort(reads.begin(), reads.end());
+	ss << "SELECT id, instr2, data_address FROM fsppilot"
+	      " WHERE known_outcome = 0 AND fspmethod_id = " << m_method_id
+	   << " AND variant_id = " << variant.id;
+	fail::Database::Result *res = db->query_stream(ss.str().c_str());
+	ss.str("");
+	if (!res) {
+		return false;
+	}
+	MYSQL_ROW row;
+	while ((row = db->fetch_row(res))) {
+		ClosedEC key;
+		key.instr2 = strtoul(row[1], 0, 10);
+		key.data_address = strtoul(row[2], 0, 10);
+		std::vector<ClosedEC>::iterator it = std::lower_bound(reads.begin(), reads.end(), key);
+		if (it != reads.end() && !(key < *it)) {
+			it->pilot_id = strtoul(row[0], 0, 10);
+		}
+	}
+	db->free_result(res);
+
+	ss << "INSERT INTO fspgroup (variant_id, instr2, data_address, fspmethod_id, pilot_id, weight) VALUES ";
+	std::string insert_group = ss.str();
+	ss.str("");
+	uint64_t groups = 0;
+	for (int known = 0; known <= 1; ++known) {
+		const std::vector<ClosedEC>& ecs = known ? writes : reads;
+		for (std::vector<ClosedEC>::const_iterator it = ecs.begin(); it != ecs.end(); ++it) {
+			uint32_t pilot_id = known ? known_pilot_id : it->pilot_id;
+			if (pilot_id == 0) {
+				LOG << "no pilot found for instr2=" << it->instr2
+				    << " data_address=" << it->data_address << endl;
+				return false;
+			}
+			ss << "(" << variant.id << "," << it->instr2 << "," << it->data_address << ","
+			   << m_method_id << "," << pilot_id << "," << it->weight << ")";
+			if (!db->insert_multiple(insert_group.c_str(), ss.str().c_str())) {
+				return false;
+			}
+			ss.str("");
+			++groups;
+		}
+	}
+	if (!db->insert_multiple()) {
+		return false;
+	}
+	LOG << "created " << groups << " fspgroup entries" << endl;
+
+	return true;
+}
@@ -0,0 +1,53 @@
+#ifndef __TRACE_BASIC_PRUNER_H__
+#define __TRACE_BASIC_PRUNER_H__
+
+#include <stdint.h>
+#include "Pruner.hpp"
+#include "util/CommandLine.hpp"
+#include "util/MemoryMap.hpp"
+
+///
+/// TraceBasicPruner: def/use pruning directly from the trace file
+///
+/// Produces the same pilots as the BasicPruner (method "basic"), under the
+/// method name "basic-trace", but
+/// determines the def/use equivalence classes while reading the trace file
+/// instead of querying the trace table.  Only per-address state (the open
+/// EC) and one small record per read EC are kept in memory; the trace table
+/// is neither read nor written.  The fspgroup entries additionally carry the
+/// EC length (time2 - time1 + 1) as weight.
+///
+/// Use the same --memory-map/--faultspace-rightmargin/--cover-memorymap
+/// settings as for import-trace, otherwise the ECs differ from the ones in
+/// the trace table (which the campaign still needs for instr1).  As the
+/// trace file belongs to one variant, exactly one must be selected.
+///
+class TraceBasicPruner : public Pruner {
+	fail::CommandLine::option_handle MEMORYMAP;
+	fail::CommandLine::option_handle RIGHTMARGIN;
+	fail::CommandLine::option_handle COVER_MEMORYMAP;
+
+	fail::MemoryMap *m_mm;
+	char m_faultspace_rightmargin;
+	bool m_cover_memorymap;
+
+public:
+	TraceBasicPruner() : m_mm(0), m_faultspace_rightmargin('W'), m_cover_memorymap(false) {}
+	virtual ~TraceBasicPruner() { delete m_mm; }
+	virtual std::string method_name() { return "basic-trace"; }
+	virtual bool commandline_init();
+	virtual bool clear_database();
+	virtual bool prepare();
+	virtual bool prune_all();
+
+	void getAliases(std::deque<std::string> *aliases) {
+		aliases->push_back("TraceBasicPruner");
+		aliases->push_back("basic-trace");
+	}
+
+private:
+	bool single_variant();
+	bool prune_variant(const fail::Database::Variant& variant);
+};
+
+#endif
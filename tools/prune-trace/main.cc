@@ -15,8 +15,11 @@ using std::endl;
 #include "BasicPruner.hpp"
 #include "FESamplingPruner.hpp"
 #include "SamplingPruner.hpp"
+#include "StratifiedSamplingPruner.hpp"
 #include "BasicBlockPruner.hpp"
 #include "CallRegionPruner.hpp"
+#include "TraceBasicPruner.hpp"
+#include "LivenessPruner.hpp"
 
 int main(int argc, char *argv[]) {
 	std::string username, hostname, database, trace_file;
@@ -31,10 +34,16 @@ int main(int argc, char *argv[]) {
 	registry.add(&fesamplingpruner);
 	SamplingPruner samplingpruner;
 	registry.add(&samplingpruner);
+	StratifiedSamplingPruner stratifiedsamplingpruner;
+	registry.add(&stratifiedsamplingpruner);
 	BasicBlockPruner basicblockpruner;
 	registry.add(&basicblockpruner);
 	CallRegionPruner callregionpruner;
 	registry.add(&callregionpruner);
+	TraceBasicPruner tracebasicpruner;
+	registry.add(&tracebasicpruner);
+	LivenessPruner livenesspruner;
+	registry.add(&livenesspruner);
 
 	std::string pruners = registry.getPrimeAliasesCSV();
 
@@ -74,6 +83,14 @@ int main(int argc, char *argv[]) {
 	CommandLine::option_handle INCREMENTAL =
 		cmd.addOption("", "incremental", Arg::None,
 			"--incremental \tTell the pruner to work incrementally (if supported)");
+	CommandLine::option_handle DEFER_KEYS =
+		cmd.addOption("", "defer-keys", Arg::None,
+			"--defer-keys \tRebuild the fsppilot/fspgroup indexes after pruning instead of "
+			"maintaining them row by row (best combined with --bulk-load)");
+	CommandLine::option_handle JOBS =
+		cmd.addOption("j", "jobs", Arg::Required,
+			"-j/--jobs N \tPrune up to N variants concurrently, each with its own database connection "
+			"(default: 1; not all pruning methods support this)");
 	CommandLine::option_handle TRACE_FILE =
 		cmd.addOption("t", "trace-file", Arg::Required,
 			"-t/--trace-file \tFile to load the execution trace from\n");
@@ -197,10 +214,30 @@ int main(int argc, char *argv[]) {
 		exit(-1);
 	}
 
-	if (!pruner->prune_all()) {
+	if (cmd[DEFER_KEYS] && !(db->disable_keys("fsppilot") && db->disable_keys("fspgroup"))) {
+		LOG << "disabling fsppilot/fspgroup keys failed" << endl;
+		exit(-1);
+	}
+
+	if (!pruner->prepare()) {
+		LOG << "pruner->prepare() failed" << endl;
+		exit(-1);
+	}
+
+	unsigned jobs = 1;
+	if (cmd[JOBS]) {
+		jobs = strtoul(cmd[JOBS].first()->arg, 0, 10);
+	}
+
+	if (!pruner->prune_parallel(jobs)) {
 		LOG << "prune_all() failed" << endl;
 		exit(-1);
 	}
 
+	if (cmd[DEFER_KEYS] && !(db->enable_keys("fsppilot") && db->enable_keys("fspgroup"))) {
+		LOG << "rebuilding fsppilot/fspgroup keys failed" << endl;
+		exit(-1);
+	}
+
 	return 0;
 }
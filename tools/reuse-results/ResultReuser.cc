@@ -0,0 +1,217 @@
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include "ResultReuser.hpp"
+#include "util/Logger.hpp"
+
+using namespace fail;
+using std::endl;
+
+static Logger LOG("ResultReuser", true);
+
+namespace {
+
+struct OldPilot {
+	uint32_t id;
+	uint32_t instr1;
+	uint32_t injection_offset; // injection_instr - instr2
+	uint32_t data_width;
+};
+
+inline uint64_t pilot_key(uint32_t instr2, uint32_t data_address)
+{
+	return ((uint64_t) instr2 << 32) | data_address;
+}
+
+} // anonymous namespace
+
+bool ResultReuser::fetch_columns(const std::string& table, std::string& insert_cols, std::string& select_cols)
+{
+	std::stringstream sql;
+	sql << "SELECT COLUMN_NAME, EXTRA FROM INFORMATION_SCHEMA.COLUMNS"
+	    << " WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" << table << "'"
+	    << " ORDER BY ORDINAL_POSITION";
+	Database::Result *res = db->query(sql.str().c_str(), true);
+	if (!res) {
+		return false;
+	}
+	std::stringstream ins, sel;
+	bool has_pilot_id = false, comma = false;
+	MYSQL_ROW row;
+	while ((row = db->fetch_row(res))) {
+		std::string field(row[0]);
+		if (row[1] && strstr(row[1], "auto_increment")) {
+			continue;
+		}
+		if (comma) {
+			ins << ", ";
+			sel << ", ";
+		}
+		comma = true;
+		ins << "`" << field << "`";
+		if (field == "pilot_id") {
+			sel << "m.new_id";
+			has_pilot_id = true;
+		} else {
+			sel << "r.`" << field << "`";
+		}
+	}
+	if (!has_pilot_id) {
+		LOG << table << " has no pilot_id column" << endl;
+		return false;
+	}
+	insert_cols = ins.str();
+	select_cols = sel.str();
+	return true;
+}
+
+bool ResultReuser::reuse(const Database::Variant& old_variant,
+	const Database::Variant& new_variant, const TraceAligner& aligner)
+{
+	std::stringstream sql;
+	MYSQL_ROW row;
+
+	// old pilots with (partial or complete) results
+	LOG << "loading pilots with results of " << old_variant.variant << "/"
+	    << old_variant.benchmark << " ..." << endl;
+	sql << "SELECT p.id, t.instr1, t.instr2, p.injection_instr, p.data_address, p.data_width"
+	    << " FROM fsppilot p"
+	    << " JOIN trace t"
+	    << " ON t.variant_id = p.variant_id AND t.data_address = p.data_address AND t.instr2 = p.instr2"
+	    << " WHERE p.variant_id = " << old_variant.id
+	    << "   AND p.known_outcome = 0"
+	    << "   AND p.fspmethod_id IN (SELECT id FROM fspmethod WHERE method LIKE '" << m_fspmethod << "')"
+	    << "   AND p.id IN (SELECT pilot_id FROM " << m_result_table << ")";
+	Database::Result *res = db->query_stream(sql.str().c_str());
+	sql.str("");
+	if (!res) {
+		return false;
+	}
+	std::unordered_map<uint64_t, OldPilot> old_pilots;
+	while ((row = db->fetch_row(res))) {
+		OldPilot p;
+		p.id = strtoul(row[0], 0, 10);
+		p.instr1 = strtoul(row[1], 0, 10);
+		uint32_t instr2 = strtoul(row[2], 0, 10);
+		p.injection_offset = strtoul(row[3], 0, 10) - instr2;
+		p.data_width = strtoul(row[5], 0, 10);
+		old_pilots[pilot_key(instr2, strtoul(row[4], 0, 10))] = p;
+	}
+	db->free_result(res);
+	LOG << old_pilots.size() << " old pilots with results" << endl;
+	if (old_pilots.empty()) {
+		return true;
+	}
+
+	if (!m_dry_run) {
+		if (!db->query("CREATE TEMPORARY TABLE IF NOT EXISTS reuse_pilot_map ("
+				" old_id int(11) UNSIGNED NOT NULL,"
+				" new_id int(11) UNSIGNED NOT NULL,"
+				" PRIMARY KEY (new_id)) engine=MEMORY")
+			|| !db->query("DELETE FROM reuse_pilot_map")) {
+			return false;
+		}
+	}
+
+	// new pilots without results
+	sql << "SELECT p.id, t.instr1, t.instr2, p.injection_instr, p.data_address, p.data_width"
+	    << " FROM fsppilot p"
+	    << " JOIN trace t"
+	    << " ON t.variant_id = p.variant_id AND t.data_address = p.data_address AND t.instr2 = p.instr2"
+	    << " WHERE p.variant_id = " << new_variant.id
+	    << "   AND p.known_outcome = 0"
+	    << "   AND p.fspmethod_id IN (SELECT id FROM fspmethod WHERE method LIKE '" << m_fspmethod << "')"
+	    << "   AND p.id NOT IN (SELECT pilot_id FROM " << m_result_table << ")";
+	res = db->query_stream(sql.str().c_str());
+	sql.str("");
+	if (!res) {
+		return false;
+	}
+	uint64_t new_pilots = 0, matched = 0, unaligned = 0;
+	std::vector<std::pair<uint32_t, uint32_t> > pairs;
+	while ((row = db->fetch_row(res))) {
+		++new_pilots;
+		uint32_t id = strtoul(row[0], 0, 10);
+		uint32_t instr1 = strtoul(row[1], 0, 10);
+		uint32_t instr2 = strtoul(row[2], 0, 10);
+		uint32_t injection_offset = strtoul(row[3], 0, 10) - instr2;
+		uint32_t data_address = strtoul(row[4], 0, 10);
+		uint32_t data_width = strtoul(row[5], 0, 10);
+
+		const TraceAligner::Segment *s = aligner.find(instr1);
+		uint64_t seg_end = s ? s->new_begin + s->length : 0;
+		if (!s || instr2 >= seg_end
+			|| (!m_allow_resync && (s->new_begin != 0 || s->old_begin != 0))
+			|| (!aligner.reachesEnd(*s) && (m_horizon == 0 || instr2 + m_horizon >= seg_end))) {
+			++unaligned;
+			continue;
+		}
+		uint64_t delta = s->old_begin - s->new_begin; // modulo 2^64
+		std::unordered_map<uint64_t, OldPilot>::const_iterator it =
+			old_pilots.find(pilot_key(instr2 + delta, data_address));
+		if (it == old_pilots.end()
+			|| it->second.instr1 != (uint32_t) (instr1 + delta)
+			|| it->second.data_width != data_width
+			|| it->second.injection_offset != injection_offset) {
+			continue;
+		}
+		pairs.push_back(std::make_pair(it->second.id, id));
+		++matched;
+	}
+	db->free_result(res);
+	std::unordered_map<uint64_t, OldPilot>().swap(old_pilots);
+
+	LOG << new_pilots << " new pilots without results: " << matched << " equivalent to an old pilot, "
+	    << unaligned << " outside the (reusable) aligned golden run" << endl;
+	if (m_dry_run || pairs.empty()) {
+		return true;
+	}
+
+	// copy the results (one INSERT ... SELECT over the pilot map)
+	const char *insert_map = "INSERT INTO reuse_pilot_map (old_id, new_id) VALUES ";
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		sql << "(" << pairs[i].first << "," << pairs[i].second << ")";
+		if (!db->insert_multiple(insert_map, sql.str().c_str())) {
+			return false;
+		}
+		sql.str("");
+	}
+	if (!db->insert_multiple()) {
+		return false;
+	}
+
+	// packed results (see DatabaseProtobufAdapter::set_packed()): the result
+	// table is a view, copy the underlying tables
+	std::vector<std::string> tables;
+	sql << "SHOW TABLES LIKE '" << m_result_table << "_packed'";
+	res = db->query(sql.str().c_str(), true);
+	sql.str("");
+	if (!res) {
+		return false;
+	}
+	if (db->fetch_row(res)) {
+		tables.push_back(m_result_table + "_packed");
+		tables.push_back(m_result_table + "_detail");
+	} else {
+		tables.push_back(m_result_table);
+	}
+
+	for (size_t i = 0; i < tables.size(); ++i) {
+		std::string insert_cols, select_cols;
+		if (!fetch_columns(tables[i], insert_cols, select_cols)) {
+			return false;
+		}
+		sql << "INSERT IGNORE INTO " << tables[i] << " (" << insert_cols << ")"
+		    << " SELECT " << select_cols
+		    << " FROM " << tables[i] << " r"
+		    << " JOIN reuse_pilot_map m ON r.pilot_id = m.old_id";
+		if (!db->query(sql.str().c_str())) {
+			return false;
+		}
+		sql.str("");
+		LOG << "copied " << db->affected_rows() << " rows of " << tables[i] << " to " << matched << " pilots" << endl;
+	}
+
+	return db->query("DROP TEMPORARY TABLE reuse_pilot_map");
+}
@@ -0,0 +1,68 @@
+#ifndef __REUSERESULTS_RESULTREUSER_HPP__
+#define __REUSERESULTS_RESULTREUSER_HPP__
+
+#include <string>
+#include <stdint.h>
+#include "TraceAligner.hpp"
+#include "util/Database.hpp"
+
+/**
+ * \class ResultReuser
+ *
+ * Copies experiment results from the pilots of an old variant to the
+ * equivalent pilots of a new variant (typically the same benchmark, rebuilt
+ * after a small change), so a subsequent campaign only runs experiments for
+ * the changed part of the fault space: the campaign's completed-pilots check
+ * (DatabaseCampaign::load_completed_pilots) counts the copied results like
+ * its own.
+ *
+ * A new pilot is considered equivalent to an old one if, according to the
+ * aligned golden-run traces (extended traces: IPs, accessed addresses, data
+ * values and registers must agree, as well as the instruction bytes at each
+ * executed IP in both ELF binaries),
+ * - its EC [instr1, instr2] lies within one aligned segment and maps onto an
+ *   old EC with exactly the same bounds, data address and width, and the
+ *   same injection point relative to instr2,
+ * - the segment starts at the beginning of both traces, i.e., the state at
+ *   the time of injection has been reached in the same way (unless
+ *   setAllowResync()), and
+ * - the golden runs also agree after the EC, up to the end of both traces
+ *   (or for setHorizon() instructions): a faulty run that returns to the
+ *   golden run's control flow sees the same code.
+ * Faulty runs that leave the golden run's control flow may still execute
+ * changed code that no golden run shows; a non-zero horizon or allowing
+ * resynchronization trades this guarantee for more reuse.
+ */
+class ResultReuser {
+	fail::Database *db;
+	std::string m_result_table;
+	std::string m_fspmethod;
+	uint64_t m_horizon;
+	bool m_allow_resync;
+	bool m_dry_run;
+
+	bool fetch_columns(const std::string& table, std::string& insert_cols, std::string& select_cols);
+
+public:
+	ResultReuser(fail::Database *db, const std::string& result_table)
+		: db(db), m_result_table(result_table), m_fspmethod("%"), m_horizon(0),
+		  m_allow_resync(false), m_dry_run(false) {}
+
+	//! Pruning method(s) of the pilots (SQL LIKE pattern, default: "%").
+	void setPruneMethod(const std::string& method) { m_fspmethod = method; }
+	//! Instructions after the EC the golden runs must agree on (0: up to the end).
+	void setHorizon(uint64_t horizon) { m_horizon = horizon; }
+	//! Also reuse results for ECs behind a divergence of the golden runs.
+	void setAllowResync(bool allow) { m_allow_resync = allow; }
+	//! Only report what would be copied.
+	void setDryRun(bool dry_run) { m_dry_run = dry_run; }
+
+	/**
+	 * Matches the pilots of "new_variant" to those of "old_variant" with
+	 * results, and copies these results.
+	 */
+	bool reuse(const fail::Database::Variant& old_variant,
+		const fail::Database::Variant& new_variant, const TraceAligner& aligner);
+};
+
+#endif // __REUSERESULTS_RESULTREUSER_HPP__
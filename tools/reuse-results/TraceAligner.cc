@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <unordered_map>
+#include "TraceAligner.hpp"
+#include "comm/TracePlugin.pb.h"
+#include "util/ElfReader.hpp"
+#include "util/Logger.hpp"
+#include "util/ProtoStream.hpp"
+
+using namespace fail;
+using std::endl;
+
+static Logger LOG("TraceAligner", true);
+
+namespace {
+
+inline uint64_t mix(uint64_t h, uint64_t v)
+{
+	// splitmix64 finalizer over the running hash
+	h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+/**
+ * Reads a trace as a sequence of instruction signatures.  An instruction is
+ * an IP event together with the memory events following it (the same
+ * grouping as in import-trace).
+ */
+class SignatureStream {
+	ProtoIStream m_ps;
+	const CodeImage *m_code;
+	Trace_Event m_ev;
+	bool m_have; // m_ev holds the first event of the next instruction
+	bool m_end;
+public:
+	std::deque<uint64_t> buf; // look-ahead
+	uint64_t pos;             // instruction number of buf.front()
+	uint64_t mem_events;      // memory events read so far
+	uint64_t mem_without_data; // ... of which without a data value
+
+	SignatureStream(std::istream& in, const CodeImage *code)
+		: m_ps(&in), m_code(code), m_have(false), m_end(false), pos(0), mem_events(0), mem_without_data(0) {}
+
+	bool next(uint64_t& sig);
+	//! Fills the look-ahead buffer with up to n signatures.
+	void fill(size_t n)
+	{
+		uint64_t sig;
+		while (buf.size() < n && next(sig)) {
+			buf.push_back(sig);
+		}
+	}
+	void drop(size_t n)
+	{
+		buf.erase(buf.begin(), buf.begin() + n);
+		pos += n;
+	}
+	//! Number of instructions in the whole trace (consumes the rest).
+	uint64_t count()
+	{
+		uint64_t sig, n = pos + buf.size();
+		while (next(sig)) {
+			++n;
+		}
+		return n;
+	}
+};
+
+bool SignatureStream::next(uint64_t& sig)
+{
+	if (m_end || (!m_have && !m_ps.getNext(&m_ev))) {
+		m_end = true;
+		return false;
+	}
+	m_have = false;
+	bool seen_ip = false;
+	sig = 0;
+	do {
+		if (!m_ev.has_memaddr()) {
+			if (seen_ip) {
+				m_have = true;
+				return true;
+			}
+			seen_ip = true;
+			sig = mix(sig, m_ev.ip());
+			if (m_code) {
+				sig = mix(sig, m_code->hash(m_ev.ip()));
+			}
+		} else {
+			sig = mix(sig, m_ev.memaddr());
+			sig = mix(sig, ((uint64_t) m_ev.width() << 8) | m_ev.accesstype());
+			++mem_events;
+			if (m_ev.has_trace_ext() && m_ev.trace_ext().has_data()) {
+				const Trace_Event_Extended& ext = m_ev.trace_ext();
+				sig = mix(sig, ext.data());
+				for (int i = 0; i < ext.registers_size(); ++i) {
+					sig = mix(sig, ((uint64_t) ext.registers(i).id() << 32) ^ ext.registers(i).value());
+				}
+			} else {
+				++mem_without_data;
+			}
+		}
+	} while (m_ps.getNext(&m_ev));
+	m_end = true;
+	return true;
+}
+
+// hash of the "len" signatures starting at buf[i]
+inline uint64_t window_hash(const std::deque<uint64_t>& buf, size_t i, size_t len)
+{
+	uint64_t h = len;
+	for (size_t k = i; k < i + len; ++k) {
+		h = mix(h, buf[k]);
+	}
+	return h;
+}
+
+inline bool window_equal(const std::deque<uint64_t>& a, size_t i,
+	const std::deque<uint64_t>& b, size_t j, size_t len)
+{
+	for (size_t k = 0; k < len; ++k) {
+		if (a[i + k] != b[j + k]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+const unsigned CodeImage::MAX_INSTR_LEN;
+
+bool CodeImage::load(const char *elf_path)
+{
+	ElfReader elf(elf_path);
+	std::ifstream in(elf_path, std::ios::binary);
+	m_segments.clear();
+	m_cache.clear();
+	for (ElfReader::segment_iterator it = elf.seg_begin(); it != elf.seg_end(); ++it) {
+		if (!it->isExecutable()) {
+			continue;
+		}
+		Segment s;
+		s.start = it->getStart();
+		s.bytes.resize(it->getSize());
+		size_t filesize = std::min<size_t>(it->getFileSize(), it->getSize());
+		if (filesize > 0 && !in.seekg(it->getFileOffset())
+			.read(reinterpret_cast<char *>(&s.bytes[0]), filesize)) {
+			LOG << "couldn't read segment at 0x" << std::hex << s.start << std::dec
+			    << " of " << elf_path << endl;
+			return false;
+		}
+		m_segments.push_back(s);
+	}
+	if (m_segments.empty()) {
+		LOG << "no executable segment in " << elf_path << endl;
+		return false;
+	}
+	return true;
+}
+
+uint64_t CodeImage::hash(uint64_t ip) const
+{
+	std::unordered_map<uint64_t, uint64_t>::const_iterator it = m_cache.find(ip);
+	if (it != m_cache.end()) {
+		return it->second;
+	}
+	uint64_t h = 0;
+	for (size_t i = 0; i < m_segments.size(); ++i) {
+		const Segment& s = m_segments[i];
+		if (ip < s.start || ip - s.start >= s.bytes.size()) {
+			continue;
+		}
+		size_t end = std::min<size_t>(ip - s.start + MAX_INSTR_LEN, s.bytes.size());
+		h = MAX_INSTR_LEN;
+		for (size_t k = ip - s.start; k < end; ++k) {
+			h = mix(h, s.bytes[k]);
+		}
+		break;
+	}
+	m_cache[ip] = h;
+	return h;
+}
+
+bool TraceAligner::align(std::istream& new_trace, std::istream& old_trace)
+{
+	SignatureStream n(new_trace, m_new_code), o(old_trace, m_old_code);
+	Segment cur;
+	bool open = false;
+	m_segments.clear();
+
+	while (true) {
+		n.fill(1);
+		o.fill(1);
+		if (n.buf.empty() || o.buf.empty()) {
+			break;
+		}
+		if (n.buf.front() == o.buf.front()) {
+			if (!open) {
+				cur.new_begin = n.pos;
+				cur.old_begin = o.pos;
+				cur.length = 0;
+				open = true;
+			}
+			++cur.length;
+			n.drop(1);
+			o.drop(1);
+			continue;
+		}
+
+		// divergence: find the nearest resynchronization point (a, b), i.e.,
+		// minimal a + b with m_sync equal instructions at n[a] and o[b]
+		if (open) {
+			m_segments.push_back(cur);
+			open = false;
+		}
+		n.fill(m_window + m_sync);
+		o.fill(m_window + m_sync);
+		if (n.buf.size() < m_sync || o.buf.size() < m_sync) {
+			break;
+		}
+		std::unordered_map<uint64_t, size_t> old_windows;
+		for (size_t b = o.buf.size() - m_sync + 1; b-- > 0; ) {
+			// descending, so the smallest b wins
+			old_windows[window_hash(o.buf, b, m_sync)] = b;
+		}
+		size_t best_a = 0, best_b = 0;
+		bool found = false;
+		for (size_t a = 0; a + m_sync <= n.buf.size(); ++a) {
+			if (found && a >= best_a + best_b) {
+				break;
+			}
+			std::unordered_map<uint64_t, size_t>::const_iterator it =
+				old_windows.find(window_hash(n.buf, a, m_sync));
+			if (it == old_windows.end()
+				|| !window_equal(n.buf, a, o.buf, it->second, m_sync)) {
+				continue;
+			}
+			if (!found || a + it->second < best_a + best_b) {
+				best_a = a;
+				best_b = it->second;
+				found = true;
+			}
+		}
+		if (!found) {
+			LOG << "traces diverge at instruction " << n.pos << " (new) / " << o.pos
+			    << " (old) and do not resynchronize within " << m_window << " instructions" << endl;
+			break;
+		}
+		LOG << "divergence: new [" << n.pos << ", " << n.pos + best_a << "), old ["
+		    << o.pos << ", " << o.pos + best_b << ")" << endl;
+		n.drop(best_a);
+		o.drop(best_b);
+	}
+	if (open) {
+		m_segments.push_back(cur);
+	}
+	m_new_instrs = n.count();
+	m_old_instrs = o.count();
+	m_data_values = n.mem_events > 0 && n.mem_without_data == 0
+		&& o.mem_events > 0 && o.mem_without_data == 0;
+	if (m_new_instrs == 0 || m_old_instrs == 0) {
+		LOG << "empty trace" << endl;
+		return false;
+	}
+	return true;
+}
+
+const TraceAligner::Segment *TraceAligner::find(uint64_t instr) const
+{
+	// the last segment starting at or before instr
+	std::vector<Segment>::const_iterator it = m_segments.begin(), end = m_segments.end();
+	size_t count = end - it;
+	while (count > 0) {
+		size_t step = count / 2;
+		if ((it + step)->new_begin <= instr) {
+			it += step + 1;
+			count -= step + 1;
+		} else {
+			count = step;
+		}
+	}
+	if (it == m_segments.begin()) {
+		return 0;
+	}
+	--it;
+	return instr < it->new_begin + it->length ? &*it : 0;
+}
@@ -0,0 +1,134 @@
+#ifndef __REUSERESULTS_TRACEALIGNER_HPP__
+#define __REUSERESULTS_TRACEALIGNER_HPP__
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+/**
+ * \class CodeImage
+ *
+ * The executable segments of an ELF file, for comparing the code at the
+ * IPs of a golden run.
+ */
+class CodeImage {
+	struct Segment {
+		uint64_t start;
+		std::vector<unsigned char> bytes; //!< zero-filled beyond the file size
+	};
+	std::vector<Segment> m_segments;
+	mutable std::unordered_map<uint64_t, uint64_t> m_cache;
+
+public:
+	//! Upper bound of an instruction's length (x86: 15 bytes)
+	static const unsigned MAX_INSTR_LEN = 16;
+
+	/**
+	 * Reads the executable segments; returns false if the file could not be
+	 * read or has no executable segment.
+	 */
+	bool load(const char *elf_path);
+	/**
+	 * Hash of the MAX_INSTR_LEN code bytes at "ip" (or fewer, up to the end
+	 * of its segment); 0 for addresses outside all executable segments.
+	 */
+	uint64_t hash(uint64_t ip) const;
+};
+
+/**
+ * \class TraceAligner
+ *
+ * Aligns the golden-run traces of two variants (an old one, whose results
+ * exist, and a new one) at the granularity of dynamic instructions, as
+ * counted by import-trace.  Each instruction is reduced to a signature of
+ * its IP and its memory accesses (address, width, access type, and the data
+ * value and register contents if the trace is extended), and, if the code of
+ * both variants is known (setCode()), the instruction bytes at the IP.  Both
+ * signature streams are compared in
+ * lockstep; after a divergence, the aligner looks ahead in both traces for
+ * the nearest point where they agree again for a number of consecutive
+ * instructions (like diff-trace), and continues from there.
+ *
+ * The result is a list of aligned segments: instruction ranges that are
+ * identical in both golden runs.  Without data values (see hasDataValues()),
+ * "identical" only means the same control flow and addresses: a rebuild that
+ * changes a constant or an opcode in place still aligns.  Data values alone
+ * don't help if the changed instruction happens to compute the same values in
+ * the golden run (e.g., "and $0xff" vs. "and $0xf" on 0x30); the instruction
+ * bytes do.  As instruction lengths are not known, the CodeImage::MAX_INSTR_LEN
+ * bytes at each IP are compared, so a change shortly behind an executed
+ * instruction also ends a segment.
+ */
+class TraceAligner {
+public:
+	struct Segment {
+		uint64_t new_begin; //!< first instruction in the new trace
+		uint64_t old_begin; //!< corresponding instruction in the old trace
+		uint64_t length;    //!< number of instructions
+	};
+
+private:
+	uint64_t m_window;
+	unsigned m_sync;
+
+	const CodeImage *m_new_code, *m_old_code;
+
+	std::vector<Segment> m_segments;
+	uint64_t m_new_instrs, m_old_instrs;
+	bool m_data_values;
+
+public:
+	TraceAligner() : m_window(100000), m_sync(16), m_new_code(0), m_old_code(0),
+		m_new_instrs(0), m_old_instrs(0), m_data_values(false) {}
+
+	/**
+	 * Number of instructions to look ahead in each trace when resynchronizing.
+	 */
+	void setWindow(uint64_t window) { m_window = window; }
+	/**
+	 * Number of consecutive equal instructions that count as resynchronized.
+	 */
+	void setSyncLength(unsigned sync) { m_sync = sync > 0 ? sync : 1; }
+	/**
+	 * Also compare the instruction bytes at each IP.  Both images must
+	 * outlive align().
+	 */
+	void setCode(const CodeImage *new_code, const CodeImage *old_code)
+	{
+		m_new_code = new_code;
+		m_old_code = old_code;
+	}
+	/**
+	 * Were the instruction bytes compared?
+	 */
+	bool hasCode() const { return m_new_code && m_old_code; }
+
+	/**
+	 * Aligns the traces; returns false if one of them could not be read.
+	 */
+	bool align(std::istream& new_trace, std::istream& old_trace);
+
+	const std::vector<Segment>& segments() const { return m_segments; }
+	uint64_t newInstructions() const { return m_new_instrs; }
+	uint64_t oldInstructions() const { return m_old_instrs; }
+	/**
+	 * Did every memory access in both traces carry its data value (extended
+	 * traces, generic-tracing --full-trace)?
+	 */
+	bool hasDataValues() const { return m_data_values; }
+
+	/**
+	 * The segment containing instruction "instr" of the new trace, or 0.
+	 */
+	const Segment *find(uint64_t instr) const;
+	/**
+	 * Is the segment the common suffix of both traces?
+	 */
+	bool reachesEnd(const Segment& s) const
+	{
+		return s.new_begin + s.length == m_new_instrs && s.old_begin + s.length == m_old_instrs;
+	}
+};
+
+#endif // __REUSERESULTS_TRACEALIGNER_HPP__
@@ -0,0 +1,195 @@
+#include <iostream>
+#include <fstream>
+#include <stdlib.h>
+
+#include "TraceAligner.hpp"
+#include "ResultReuser.hpp"
+
+#include "util/CommandLine.hpp"
+#include "util/Database.hpp"
+#include "util/TraceFile.hpp"
+#include "util/Logger.hpp"
+
+using namespace fail;
+using std::endl;
+
+static Logger LOG("reuse-results", true);
+
+static Database::Variant get_variant(Database *db, const std::string& variant, const std::string& benchmark)
+{
+	std::vector<Database::Variant> variants = db->get_variants(variant, benchmark);
+	if (variants.size() != 1) {
+		LOG << "variant " << variant << "/" << benchmark << " matches "
+		    << variants.size() << " variants, need exactly one" << endl;
+		exit(-1);
+	}
+	return variants[0];
+}
+
+int main(int argc, char *argv[])
+{
+	CommandLine &cmd = CommandLine::Inst();
+	for (int i = 1; i < argc; ++i) {
+		cmd.add_args(argv[i]);
+	}
+
+	CommandLine::option_handle UNKNOWN =
+		cmd.addOption("", "", Arg::None, "USAGE: reuse-results [options]\n"
+			"Copies results of an old variant's pilots to the equivalent pilots of a new variant,\n"
+			"based on the alignment of both golden-run traces.");
+	CommandLine::option_handle HELP = cmd.addOption("h", "help", Arg::None, "-h,--help \tPrint usage and exit");
+
+	Database::cmdline_setup();
+
+	CommandLine::option_handle VARIANT =
+		cmd.addOption("v", "variant", Arg::Required,
+			"-v/--variant \tVariant label of the new variant");
+	CommandLine::option_handle BENCHMARK =
+		cmd.addOption("b", "benchmark", Arg::Required,
+			"-b/--benchmark \tBenchmark label of the new variant");
+	CommandLine::option_handle OLD_VARIANT =
+		cmd.addOption("", "old-variant", Arg::Required,
+			"--old-variant \tVariant label of the old variant (default: same as --variant)");
+	CommandLine::option_handle OLD_BENCHMARK =
+		cmd.addOption("", "old-benchmark", Arg::Required,
+			"--old-benchmark \tBenchmark label of the old variant (default: same as --benchmark)");
+	CommandLine::option_handle TRACE_FILE =
+		cmd.addOption("t", "trace-file", Arg::Required,
+			"-t/--trace-file \tGolden-run trace of the new variant (as imported, extended with data values)");
+	CommandLine::option_handle OLD_TRACE_FILE =
+		cmd.addOption("", "old-trace-file", Arg::Required,
+			"--old-trace-file \tGolden-run trace of the old variant (as imported, extended with data values)");
+	CommandLine::option_handle ELF_FILE =
+		cmd.addOption("e", "elf-file", Arg::Required,
+			"-e/--elf-file \tELF binary of the new variant");
+	CommandLine::option_handle OLD_ELF_FILE =
+		cmd.addOption("", "old-elf-file", Arg::Required,
+			"--old-elf-file \tELF binary of the old variant");
+	CommandLine::option_handle RESULT_TABLE =
+		cmd.addOption("r", "result-table", Arg::Required,
+			"-r/--result-table \tResult table of the campaign (e.g., result_GenericExperimentMessage)");
+	CommandLine::option_handle PRUNER =
+		cmd.addOption("p", "prune-method", Arg::Required,
+			"-p/--prune-method \tPruning method(s) of the pilots (default: \"%\"; use % and _ as wildcard characters)");
+	CommandLine::option_handle WINDOW =
+		cmd.addOption("w", "window", Arg::Required,
+			"-w/--window N \tLook ahead N instructions in each trace to resynchronize after a divergence (default: 100000)");
+	CommandLine::option_handle SYNC =
+		cmd.addOption("s", "sync", Arg::Required,
+			"-s/--sync N \tTraces are resynchronized after N equal instructions (default: 16)");
+	CommandLine::option_handle HORIZON =
+		cmd.addOption("", "horizon", Arg::Required,
+			"--horizon N \tGolden runs must agree for N instructions after an EC (default: 0 = up to the end)");
+	CommandLine::option_handle ALLOW_RESYNC =
+		cmd.addOption("", "allow-resync", Arg::None,
+			"--allow-resync \tAlso reuse results for ECs after a divergence of the golden runs");
+	CommandLine::option_handle DRY_RUN =
+		cmd.addOption("n", "dry-run", Arg::None,
+			"-n/--dry-run \tOnly report how many pilots could reuse results");
+
+	if (!cmd.parse()) {
+		std::cerr << "Error parsing arguments." << endl;
+		exit(-1);
+	}
+
+	if (cmd[HELP] || cmd[UNKNOWN] || cmd.parser()->nonOptionsCount() > 0
+		|| !cmd[VARIANT] || !cmd[BENCHMARK] || !cmd[TRACE_FILE] || !cmd[OLD_TRACE_FILE]
+		|| !cmd[ELF_FILE] || !cmd[OLD_ELF_FILE] || !cmd[RESULT_TABLE]
+		|| (!cmd[OLD_VARIANT] && !cmd[OLD_BENCHMARK])) {
+		for (option::Option* opt = cmd[UNKNOWN]; opt; opt = opt->next()) {
+			std::cerr << "Unknown option: " << opt->name << "\n";
+		}
+		for (int i = 0; i < cmd.parser()->nonOptionsCount(); ++i) {
+			std::cerr << "Unknown non-option: " << cmd.parser()->nonOption(i) << "\n";
+		}
+		if (!cmd[HELP]) {
+			std::cerr << "-v, -b, -t, --old-trace-file, -e, --old-elf-file, -r and --old-variant and/or --old-benchmark are required\n";
+		}
+		cmd.printUsage();
+		exit(!cmd[HELP]);
+	}
+
+	std::string variant = cmd[VARIANT].first()->arg;
+	std::string benchmark = cmd[BENCHMARK].first()->arg;
+	std::string old_variant = cmd[OLD_VARIANT] ? cmd[OLD_VARIANT].first()->arg : variant;
+	std::string old_benchmark = cmd[OLD_BENCHMARK] ? cmd[OLD_BENCHMARK].first()->arg : benchmark;
+
+	Database *db = Database::cmdline_connect();
+	if (db->is_sqlite()) {
+		// temporary MEMORY tables, INSERT IGNORE, INFORMATION_SCHEMA
+		LOG << "reuse-results needs a MySQL database" << endl;
+		exit(-1);
+	}
+	Database::Variant new_v = get_variant(db, variant, benchmark);
+	Database::Variant old_v = get_variant(db, old_variant, old_benchmark);
+	if (new_v.id == old_v.id) {
+		LOG << "old and new variant are the same" << endl;
+		exit(-1);
+	}
+
+	// an instruction changed in place may compute the same values in the
+	// golden run, so the code at every executed IP must match as well
+	CodeImage new_code, old_code;
+	if (!new_code.load(cmd[ELF_FILE].first()->arg)
+		|| !old_code.load(cmd[OLD_ELF_FILE].first()->arg)) {
+		exit(-1);
+	}
+
+	TraceAligner aligner;
+	aligner.setCode(&new_code, &old_code);
+	if (cmd[WINDOW]) {
+		aligner.setWindow(strtoull(cmd[WINDOW].first()->arg, 0, 10));
+	}
+	if (cmd[SYNC]) {
+		aligner.setSyncLength(strtoul(cmd[SYNC].first()->arg, 0, 10));
+	}
+
+	LOG << "aligning golden runs ..." << endl;
+	{
+		std::ifstream new_normal, old_normal;
+		igzstream new_gz, old_gz;
+		std::istream *new_trace = openStream(cmd[TRACE_FILE].first()->arg, new_normal, new_gz);
+		if (!new_trace) {
+			LOG << "couldn't open " << cmd[TRACE_FILE].first()->arg << endl;
+			exit(-1);
+		}
+		std::istream *old_trace = openStream(cmd[OLD_TRACE_FILE].first()->arg, old_normal, old_gz);
+		if (!old_trace) {
+			LOG << "couldn't open " << cmd[OLD_TRACE_FILE].first()->arg << endl;
+			exit(-1);
+		}
+		if (!aligner.align(*new_trace, *old_trace)) {
+			exit(-1);
+		}
+	}
+	if (!aligner.hasDataValues()) {
+		// IPs and addresses alone don't reveal a changed constant or opcode
+		LOG << "both golden-run traces must be extended traces with data values"
+		    << " (generic-tracing --full-trace), refusing to reuse results" << endl;
+		exit(-1);
+	}
+	uint64_t aligned = 0;
+	for (size_t i = 0; i < aligner.segments().size(); ++i) {
+		aligned += aligner.segments()[i].length;
+	}
+	LOG << aligned << " of " << aligner.newInstructions() << " instructions of the new golden run aligned in "
+	    << aligner.segments().size() << " segment(s)" << endl;
+
+	ResultReuser reuser(db, cmd[RESULT_TABLE].first()->arg);
+	if (cmd[PRUNER]) {
+		reuser.setPruneMethod(cmd[PRUNER].first()->arg);
+	}
+	if (cmd[HORIZON]) {
+		reuser.setHorizon(strtoull(cmd[HORIZON].first()->arg, 0, 10));
+	}
+	reuser.setAllowResync(cmd[ALLOW_RESYNC]);
+	reuser.setDryRun(cmd[DRY_RUN]);
+
+	if (!reuser.reuse(old_v, new_v, aligner)) {
+		LOG << "reusing results failed: " << db->error() << endl;
+		exit(-1);
+	}
+
+	delete db;
+	return 0;
+}
@@ -0,0 +1,208 @@
+#include <atomic>
+#include <vector>
+#include <boost/thread.hpp>
+#include "TraceSlicer.hpp"
+#include "comm/TracePlugin.pb.h"
+#include "util/ProtoBatch.hpp"
+#include "util/Logger.hpp"
+#include "util/SynchronizedQueue.hpp"
+
+using namespace fail;
+using std::endl;
+
+static Logger LOG("slice-trace", true);
+
+// hand a batch of encoded events to a worker when it reaches this size
+static const size_t BATCH_SIZE = 1024 * 1024;
+
+namespace {
+
+// A sequence of encoded trace events, and the events of it that survived
+// filtering
+struct SliceBatch : public ProtoBatch {
+	// kept events (without time_delta), their time and dynamic instruction
+	// number relative to the batch start; memory accesses at the beginning of
+	// a batch belong to the last instruction of the preceding one (-1)
+	std::vector<Trace_Event> events;
+	std::vector<uint64_t> times;
+	std::vector<int64_t> instrs;
+	uint64_t time_sum, instr_count, event_count;
+
+	SliceBatch() : time_sum(0), instr_count(0), event_count(0) {}
+};
+
+struct SliceState {
+	SynchronizedQueue<SliceBatch *> work, order;
+	std::atomic<bool> stop;
+	bool ok;
+	SliceState(unsigned threads) : work(2 * threads), order(4 * threads), stop(false), ok(true) {}
+};
+
+// Decodes and filters batches from the work queue until it is finished
+class SliceWorker {
+	SliceState *state;
+	MemoryMap *ipMap, *memMap;
+	bool ip_events, mem_events;
+public:
+	SliceWorker(SliceState *state, MemoryMap *ipMap, MemoryMap *memMap,
+		bool ip_events, bool mem_events)
+		: state(state), ipMap(ipMap), memMap(memMap),
+		  ip_events(ip_events), mem_events(mem_events) {}
+	void operator()();
+};
+
+void SliceWorker::operator()()
+{
+	Trace_Event ev;
+	SliceBatch *batch;
+	while ((batch = state->work.Dequeue()) != 0) {
+		if (state->stop) {
+			// the writer is done, nothing to do but to release the batch
+			batch->finish();
+			continue;
+		}
+		size_t pos = 0;
+		const char *msg;
+		uint32_t size;
+		while (batch->next(pos, msg, size)) {
+			if (!ev.ParseFromArray(msg, size)) {
+				LOG << "cannot decode trace event, skipping" << endl;
+				continue;
+			}
+
+			++batch->event_count;
+			if (ev.has_time_delta()) {
+				batch->time_sum += ev.time_delta();
+			}
+
+			// same filter decisions as in TracingPlugin::run()
+			int64_t instr;
+			bool keep;
+			if (!ev.has_memaddr()) {
+				instr = batch->instr_count++;
+				keep = ip_events && (!ipMap || ipMap->isMatching(ev.ip()));
+			} else {
+				instr = (int64_t) batch->instr_count - 1;
+				keep = mem_events && (!ipMap || ipMap->isMatching(ev.ip()))
+					&& (!memMap || memMap->isMatching(ev.memaddr(), ev.width()));
+			}
+			if (!keep) {
+				continue;
+			}
+			ev.clear_time_delta();
+			batch->events.push_back(ev);
+			batch->times.push_back(batch->time_sum);
+			batch->instrs.push_back(instr);
+		}
+		// the encoded data is not needed anymore
+		std::string().swap(batch->data);
+		batch->finish();
+	}
+}
+
+// Writes the kept events of all batches in their original order
+class SliceWriter {
+	SliceState *state;
+	std::ostream *out;
+	uint64_t instr_begin, instr_end;
+	uint64_t *events_in, *events_out, *instr_in;
+public:
+	SliceWriter(SliceState *state, std::ostream *out, uint64_t instr_begin,
+		uint64_t instr_end, uint64_t *events_in, uint64_t *events_out,
+		uint64_t *instr_in)
+		: state(state), out(out), instr_begin(instr_begin), instr_end(instr_end),
+		  events_in(events_in), events_out(events_out), instr_in(instr_in) {}
+	void operator()();
+};
+
+void SliceWriter::operator()()
+{
+	ProtoOStream ps(out);
+	// absolute time and dynamic instruction number at the batch start
+	uint64_t base_time = 0, base_instr = 0;
+	// the first event gets an absolute time stamp, all others a delta to
+	// their last written predecessor
+	uint64_t prevtime = 0;
+
+	SliceBatch *batch;
+	while ((batch = state->order.Dequeue()) != 0) {
+		batch->wait();
+		if (state->stop) {
+			delete batch;
+			continue;
+		}
+
+		for (size_t i = 0; i < batch->events.size(); ++i) {
+			int64_t instr = (int64_t) base_instr + batch->instrs[i];
+			if (instr < 0) {
+				// memory accesses before the first instruction
+				instr = 0;
+			}
+			if ((uint64_t) instr < instr_begin || (uint64_t) instr >= instr_end) {
+				continue;
+			}
+
+			Trace_Event& ev = batch->events[i];
+			uint64_t curtime = base_time + batch->times[i];
+			// only store deltas != 0
+			if (curtime != prevtime) {
+				ev.set_time_delta(curtime - prevtime);
+				prevtime = curtime;
+			}
+			if (!ps.writeMessage(&ev)) {
+				LOG << "cannot write trace event" << endl;
+				state->ok = false;
+				state->stop = true;
+				break;
+			}
+			++*events_out;
+		}
+
+		base_time += batch->time_sum;
+		base_instr += batch->instr_count;
+		*events_in += batch->event_count;
+		*instr_in += batch->instr_count;
+		// memory accesses of instruction instr_end - 1 may still follow in
+		// the next batch
+		if (base_instr > instr_end) {
+			state->stop = true;
+		}
+		delete batch;
+	}
+}
+
+} // anonymous namespace
+
+bool TraceSlicer::slice(std::istream& in, std::ostream& out)
+{
+	m_events_in = m_events_out = m_instr_in = 0;
+
+	SliceState state(m_threads);
+	boost::thread_group threads;
+	for (unsigned i = 0; i < m_threads; ++i) {
+		threads.create_thread(SliceWorker(&state, m_ipMap, m_memMap,
+			m_ip_events, m_mem_events));
+	}
+	threads.create_thread(SliceWriter(&state, &out, m_instr_begin, m_instr_end,
+		&m_events_in, &m_events_out, &m_instr_in));
+
+	ProtoIStream ps(&in);
+	bool more;
+	do {
+		SliceBatch *batch = new SliceBatch;
+		more = batch->fill(ps, BATCH_SIZE);
+		// workers may finish batches in any order, the writer takes them
+		// in this one
+		state.order.Enqueue(batch);
+		state.work.Enqueue(batch);
+	} while (more && !state.stop);
+	state.work.setIsFinished();
+	state.order.setIsFinished();
+	threads.join_all();
+
+	if (ps.truncated()) {
+		LOG << "trace file truncated" << endl;
+		return false;
+	}
+	return state.ok;
+}
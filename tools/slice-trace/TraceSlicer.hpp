@@ -0,0 +1,86 @@
+#ifndef __SLICETRACE_TRACESLICER_HPP__
+#define __SLICETRACE_TRACESLICER_HPP__
+
+#include <iostream>
+#include <stdint.h>
+#include "util/MemoryMap.hpp"
+
+/**
+ * \class TraceSlicer
+ *
+ * Writes the subset of an existing trace that the TracingPlugin would have
+ * recorded with a more restrictive configuration: an instruction address
+ * filter (m_ipMap), a memory filter (m_memMap), IP-only or memory-only
+ * tracing, and additionally a window of dynamic instructions.  The
+ * time_delta fields of the remaining events are recomputed, i.e., each event
+ * carries the (non-zero) distance to its last written predecessor, just like
+ * in a trace recorded directly.
+ *
+ * The input is split into batches of encoded events that are decoded and
+ * filtered by worker threads; a writer thread puts the results back in order.
+ * The number of batches in flight is bounded, so memory use does not depend
+ * on the trace size.
+ */
+class TraceSlicer {
+public:
+	/**
+	 * Dynamic instruction number (counting the IP events of the input trace,
+	 * starting with 0) that marks "no limit" for setInstrWindow().
+	 */
+	static const uint64_t INSTR_INFINITE = ~0ULL;
+
+private:
+	fail::MemoryMap *m_ipMap;
+	fail::MemoryMap *m_memMap;
+	bool m_ip_events, m_mem_events;
+	uint64_t m_instr_begin, m_instr_end;
+	unsigned m_threads;
+
+	uint64_t m_events_in, m_events_out, m_instr_in;
+
+public:
+	TraceSlicer()
+		: m_ipMap(0), m_memMap(0), m_ip_events(true), m_mem_events(true),
+		  m_instr_begin(0), m_instr_end(INSTR_INFINITE), m_threads(1),
+		  m_events_in(0), m_events_out(0), m_instr_in(0) {}
+
+	/**
+	 * Only keep events whose instruction pointer matches the map.
+	 */
+	void setIPMap(fail::MemoryMap *map) { m_ipMap = map; }
+	/**
+	 * Only keep memory accesses that hit the map.
+	 */
+	void setMemoryMap(fail::MemoryMap *map) { m_memMap = map; }
+	/**
+	 * Drop all IP events.
+	 */
+	void setLogMemOnly(bool memonly = true) { m_ip_events = !memonly; }
+	/**
+	 * Drop all memory access events.
+	 */
+	void setLogIPOnly(bool iponly = true) { m_mem_events = !iponly; }
+	/**
+	 * Only keep events of the dynamic instructions [begin, end).  Memory
+	 * accesses belong to the preceding IP event.
+	 */
+	void setInstrWindow(uint64_t begin, uint64_t end)
+	{
+		m_instr_begin = begin;
+		m_instr_end = end;
+	}
+	void setThreads(unsigned threads) { m_threads = threads > 0 ? threads : 1; }
+
+	/**
+	 * Reads the trace from "in" and writes the slice to "out".
+	 * @return false if the input trace is damaged or the output could not be
+	 *         written
+	 */
+	bool slice(std::istream& in, std::ostream& out);
+
+	uint64_t eventsRead() const { return m_events_in; }
+	uint64_t eventsWritten() const { return m_events_out; }
+	uint64_t instructionsRead() const { return m_instr_in; }
+};
+
+#endif // __SLICETRACE_TRACESLICER_HPP__
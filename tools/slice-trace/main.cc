@@ -0,0 +1,187 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdlib.h>
+#include <boost/thread.hpp>
+
+#include "TraceSlicer.hpp"
+
+#include "util/CommandLine.hpp"
+#include "util/ElfReader.hpp"
+#include "util/MemoryMap.hpp"
+#include "util/gzstream/gzstream.h"
+#include "util/TraceFile.hpp"
+#include "util/Logger.hpp"
+
+using namespace fail;
+using std::endl;
+
+static Logger LOG("slice-trace", true);
+
+// parses FROM-TO (or a single address), the end is exclusive
+static bool parseRange(const std::string& range, address_t& from, address_t& to)
+{
+	char *end;
+	from = strtoull(range.c_str(), &end, 0);
+	if (end == range.c_str()) {
+		return false;
+	}
+	if (*end == '\0') {
+		to = from + 1;
+		return true;
+	}
+	if (*end != '-') {
+		return false;
+	}
+	const char *start = end + 1;
+	to = strtoull(start, &end, 0);
+	return end != start && *end == '\0' && to > from;
+}
+
+int main(int argc, char *argv[])
+{
+	CommandLine &cmd = CommandLine::Inst();
+	CommandLine::option_handle UNKNOWN =
+		cmd.addOption("", "", Arg::None, "usage: slice-trace [options] -t output.tc input.tc");
+	CommandLine::option_handle HELP =
+		cmd.addOption("h", "help", Arg::None, "-h/--help \tPrint usage and exit");
+	CommandLine::option_handle OUTFILE =
+		cmd.addOption("t", "trace", Arg::Required, "-t/--trace FILE \tOutput file (gzipped)");
+	CommandLine::option_handle MEMORY_MAP =
+		cmd.addOption("m", "memory-map", Arg::Required,
+			"-m/--memory-map FILE \tOnly keep memory accesses hitting this memory map");
+	CommandLine::option_handle IP_MAP =
+		cmd.addOption("", "ip-map", Arg::Required,
+			"--ip-map FILE \tOnly keep events of instructions in this memory map");
+	CommandLine::option_handle IP_RANGE =
+		cmd.addOption("", "ip-range", Arg::Required,
+			"--ip-range FROM-TO \tOnly keep events of instructions in [FROM, TO) (may be used multiple times)");
+	CommandLine::option_handle SYMBOL =
+		cmd.addOption("", "symbol", Arg::Required,
+			"--symbol NAME \tOnly keep events of instructions in this function (may be used multiple times, needs --elf-file)");
+	CommandLine::option_handle ELF_FILE =
+		cmd.addOption("e", "elf-file", Arg::Required,
+			"-e/--elf-file FILE \tELF binary to look up --symbol names in");
+	CommandLine::option_handle INSTR_BEGIN =
+		cmd.addOption("", "instr-begin", Arg::Required,
+			"--instr-begin N \tOnly keep events of the N-th dynamic instruction (counting from 0) and later");
+	CommandLine::option_handle INSTR_END =
+		cmd.addOption("", "instr-end", Arg::Required,
+			"--instr-end N \tOnly keep events of dynamic instructions before the N-th one");
+	CommandLine::option_handle MEM_ONLY =
+		cmd.addOption("", "mem-only", Arg::None,
+			"--mem-only \tDrop all IP events");
+	CommandLine::option_handle IP_ONLY =
+		cmd.addOption("", "ip-only", Arg::None,
+			"--ip-only \tDrop all memory access events");
+	CommandLine::option_handle THREADS =
+		cmd.addOption("j", "threads", Arg::Required,
+			"-j/--threads N \tDecode the trace with N threads (default: number of CPUs)");
+
+	for (int i = 1; i < argc; ++i) {
+		cmd.add_args(argv[i]);
+	}
+	if (!cmd.parse()) {
+		std::cerr << "Error parsing arguments." << endl;
+		return 1;
+	}
+
+	if (cmd[HELP] || !cmd[OUTFILE] || cmd[UNKNOWN] || cmd.parser()->nonOptionsCount() != 1
+		|| (cmd[SYMBOL] && !cmd[ELF_FILE]) || (cmd[MEM_ONLY] && cmd[IP_ONLY])) {
+		for (option::Option* opt = cmd[UNKNOWN]; opt; opt = opt->next()) {
+			std::cerr << "Unknown option: " << opt->name << "\n";
+		}
+		for (int i = 1; i < cmd.parser()->nonOptionsCount(); ++i) {
+			std::cerr << "Unknown non-option: " << cmd.parser()->nonOption(i) << "\n";
+		}
+		cmd.printUsage();
+		if (cmd[HELP]) {
+			exit(0);
+		} else {
+			exit(1);
+		}
+	}
+
+	TraceSlicer slicer;
+
+	MemoryMap memMap;
+	if (cmd[MEMORY_MAP]) {
+		if (!memMap.readFromFile(cmd[MEMORY_MAP].first()->arg)) {
+			LOG << "failed to load memory map " << cmd[MEMORY_MAP].first()->arg << endl;
+			return 1;
+		}
+		slicer.setMemoryMap(&memMap);
+	}
+
+	// all instruction filters end up in one map
+	MemoryMap ipMap;
+	if (cmd[IP_MAP]) {
+		if (!ipMap.readFromFile(cmd[IP_MAP].first()->arg)) {
+			LOG << "failed to load IP map " << cmd[IP_MAP].first()->arg << endl;
+			return 1;
+		}
+	}
+	for (option::Option *o = cmd[IP_RANGE]; o; o = o->next()) {
+		address_t from, to;
+		if (!parseRange(o->arg, from, to)) {
+			LOG << "invalid IP range " << o->arg << endl;
+			return 1;
+		}
+		ipMap.add(from, to - from);
+	}
+	if (cmd[SYMBOL]) {
+		ElfReader elf(cmd[ELF_FILE].first()->arg);
+		for (option::Option *o = cmd[SYMBOL]; o; o = o->next()) {
+			const ElfSymbol& sym = elf.getSymbol(o->arg);
+			if (!sym.isValid() || sym.getSize() == 0) {
+				LOG << "symbol " << o->arg << " not found" << endl;
+				return 1;
+			}
+			LOG << "symbol " << o->arg << ": " << std::hex << sym.getStart()
+				<< "-" << sym.getEnd() << std::dec << endl;
+			ipMap.add(sym.getStart(), sym.getSize());
+		}
+	}
+	if (cmd[IP_MAP] || cmd[IP_RANGE] || cmd[SYMBOL]) {
+		slicer.setIPMap(&ipMap);
+	}
+
+	uint64_t instr_begin = 0, instr_end = TraceSlicer::INSTR_INFINITE;
+	if (cmd[INSTR_BEGIN]) {
+		instr_begin = strtoull(cmd[INSTR_BEGIN].first()->arg, 0, 0);
+	}
+	if (cmd[INSTR_END]) {
+		instr_end = strtoull(cmd[INSTR_END].first()->arg, 0, 0);
+	}
+	slicer.setInstrWindow(instr_begin, instr_end);
+	slicer.setLogMemOnly(cmd[MEM_ONLY]);
+	slicer.setLogIPOnly(cmd[IP_ONLY]);
+
+	unsigned threads = boost::thread::hardware_concurrency();
+	if (cmd[THREADS]) {
+		threads = strtoul(cmd[THREADS].first()->arg, 0, 10);
+	}
+	slicer.setThreads(threads);
+
+	std::ifstream normal_stream;
+	igzstream gz_in;
+	std::istream *in = openStream(cmd.parser()->nonOption(0), normal_stream, gz_in);
+	if (!in) {
+		LOG << "couldn't open " << cmd.parser()->nonOption(0) << endl;
+		return 1;
+	}
+
+	std::string trace_file = cmd[OUTFILE].first()->arg;
+	ogzstream gz_out(trace_file.c_str());
+	if (!gz_out) {
+		LOG << "couldn't open " << trace_file << " for writing" << endl;
+		return 1;
+	}
+
+	bool ok = slicer.slice(*in, gz_out);
+	gz_out.close();
+
+	LOG << "kept " << slicer.eventsWritten() << " of " << slicer.eventsRead()
+		<< " events (" << slicer.instructionsRead() << " instructions read)" << endl;
+	return ok ? 0 : 1;
+}